@@ -10,6 +10,7 @@
  * 2020-03-20     SummerGift   fix bug caused by ORE
  * 2020-05-02     whj4674672   support stm32h7 uart dma
  * 2020-10-14     Dozingfiretruck   Porting for stm32wbxx
+ * 2020-11-20     luhuadong    report the idle line as rx timeout
  */
 
 #include "board.h"
@@ -332,10 +333,11 @@ static void uart_isr(struct rt_serial_device *serial)
         uart->dma_rx.last_index = recv_total_index;
         rt_hw_interrupt_enable(level);
 
-        if (recv_len)
-        {
-            rt_hw_serial_isr(serial, RT_SERIAL_EVENT_RX_DMADONE | (recv_len << 8));
-        }
+        /*
+         * the line is idle, report it even if no new data, so the data under
+         * rx notify threshold which is received by DMA HT/TC is notified.
+         */
+        rt_hw_serial_isr(serial, RT_SERIAL_EVENT_RX_TIMEOUT | (recv_len << 8));
         __HAL_UART_CLEAR_IDLEFLAG(&uart->handle);
     }
     else if (__HAL_UART_GET_FLAG(&(uart->handle), UART_FLAG_TC) &&
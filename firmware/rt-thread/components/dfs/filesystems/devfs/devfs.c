@@ -311,7 +311,7 @@ static const struct dfs_file_ops _device_fops =
 static const struct dfs_filesystem_ops _device_fs =
 {
     "devfs",
-    DFS_FS_FLAG_DEFAULT,
+    DFS_FS_FLAG_NOCACHE,
     &_device_fops,
 
     dfs_device_fs_mount,
@@ -113,6 +113,14 @@ struct jffs2_sb_info {
 	uint32_t fsdata_len;
 #endif
 
+#ifdef CONFIG_JFFS2_CHECKPOINT
+	/* The checkpoint for fast mount, see checkpoint.c */
+	uint32_t ckpt_offset;			/* reserved after the file system */
+	uint32_t ckpt_size;
+	int ckpt_valid;				/* the checkpoint matches the flash */
+	uint32_t ckpt_tick;			/* the tick of last checkpoint */
+#endif
+
 	/* OS-private pointer for getting back to master superblock info */
 	void *os_priv;
 };
@@ -1,6 +1,8 @@
 #ifndef JFFS2_CONFIG_H
 #define JFFS2_CONFIG_H
 
+#include <rtconfig.h>
+
 #define __ECOS  /* must be defined */
 
 #define FILE_PATH_MAX                128  /* the longest file path */
@@ -50,4 +52,11 @@
 //#define CONFIG_JFFS2_CMODE_NONE
 //#define CONFIG_JFFS2_CMODE_SIZE
 
+/* checkpoint section, the last erase blocks of device are reserved for it */
+#ifdef RT_DFS_JFFS2_CHECKPOINT
+#define CONFIG_JFFS2_CHECKPOINT
+#define CONFIG_JFFS2_CHECKPOINT_BLOCKS    RT_DFS_JFFS2_CHECKPOINT_BLOCKS
+#define CONFIG_JFFS2_CHECKPOINT_INTERVAL  RT_DFS_JFFS2_CHECKPOINT_INTERVAL /* seconds, 0: only at unmount */
+#endif
+
 #endif
@@ -351,6 +351,14 @@ int jffs2_do_mount_fs(struct jffs2_sb_info *c)
 	INIT_LIST_HEAD(&c->bad_used_list);
 	c->highest_ino = 1;
 
+#ifdef CONFIG_JFFS2_CHECKPOINT
+	/* Skip the scan if the checkpoint matches the medium */
+	if (!jffs2_checkpoint_load(c)) {
+		jffs2_calc_trigger_levels(c);
+		return 0;
+	}
+#endif
+
 	if (jffs2_build_filesystem(c)) {
 		D1(printk(KERN_DEBUG "build_fs failed\n"));
 		jffs2_free_ino_caches(c);
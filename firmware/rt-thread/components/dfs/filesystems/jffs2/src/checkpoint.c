@@ -0,0 +1,764 @@
+/*
+ * JFFS2 -- Journalling Flash File System, Version 2.
+ *
+ * The checkpoint of the in-memory state for fast mount on RT-Thread.
+ *
+ * For licensing information, see the file 'LICENCE' in this directory.
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * The checkpoint is the image of the state which is built by scanning the
+ * medium: the counters, the list and the raw node refs of each erase
+ * block, and the inode caches. It's saved in the last erase blocks of the
+ * device, which are reserved out of the file system, at clean unmount and
+ * when the files are closed or synced every CONFIG_JFFS2_CHECKPOINT_INTERVAL
+ * seconds.
+ *
+ * The header is written at last, and the 'valid' word in header is
+ * programmed to zero before the first write or erase of the file system
+ * after the checkpoint, so a checkpoint is only used when the file system
+ * isn't changed since it's written. The mount verifies the CRC of the
+ * checkpoint, the tail of the used space and the head of the free space of
+ * each block, then falls back to the full scan on any inconsistency.
+ */
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/crc32.h>
+#include "nodelist.h"
+#include <rtdevice.h>
+
+#ifdef CONFIG_JFFS2_CHECKPOINT
+
+#define JFFS2_CKPT_MAGIC	0x504b434a	/* "JCKP" */
+#define JFFS2_CKPT_VERSION	1
+#define JFFS2_CKPT_VALID	0xFFFFFFFF
+#define JFFS2_CKPT_TAIL		32		/* the bytes checked before free space */
+#define JFFS2_CKPT_BUF_SIZE	256
+
+/* the lists of erase block */
+enum {
+	CKPT_LIST_CLEAN = 1,
+	CKPT_LIST_VERY_DIRTY,
+	CKPT_LIST_DIRTY,
+	CKPT_LIST_ERASABLE,
+	CKPT_LIST_ERASE_PENDING,
+	CKPT_LIST_FREE,
+	CKPT_LIST_BAD,
+	CKPT_LIST_BAD_USED,
+	CKPT_LIST_NEXTBLOCK,
+	CKPT_LIST_GCBLOCK,
+};
+
+struct jffs2_ckpt_header {
+	uint32_t magic;
+	uint32_t valid;			/* programmed to zero when it's stale */
+	uint32_t version;
+	uint32_t sector_size;
+	uint32_t nr_blocks;
+	uint32_t nr_refs;
+	uint32_t nr_inos;
+	uint32_t length;		/* the length of body */
+	uint32_t body_crc;
+	uint32_t hdr_crc;		/* the CRC of header with valid word */
+};
+
+struct jffs2_ckpt_sb {
+	uint32_t highest_ino;
+	uint32_t used_size;
+	uint32_t dirty_size;
+	uint32_t wasted_size;
+	uint32_t free_size;
+	uint32_t erasing_size;
+	uint32_t bad_size;
+	uint32_t unchecked_size;
+	uint32_t nr_free_blocks;
+	uint32_t nr_erasing_blocks;
+};
+
+struct jffs2_ckpt_block {
+	uint32_t list;
+	uint32_t bad_count;
+	uint32_t unchecked_size;
+	uint32_t used_size;
+	uint32_t dirty_size;
+	uint32_t wasted_size;
+	uint32_t free_size;
+	uint32_t tail_crc;		/* the CRC of bytes before free space */
+	uint32_t nr_refs;
+};
+
+struct jffs2_ckpt_ref {
+	uint32_t flash_offset;
+	uint32_t totlen;
+};
+
+struct jffs2_ckpt_ino {
+	uint32_t ino;
+	uint32_t nlink;
+	uint32_t state;
+	uint32_t nr_nodes;		/* followed by the offsets of nodes */
+};
+
+struct jffs2_ckpt_stream {
+	struct rt_mtd_nor_device *mtd;
+	uint32_t ofs;			/* the offset on flash */
+	uint32_t end;
+	uint32_t crc;
+	uint32_t len;
+	uint32_t pos;
+	unsigned char buf[JFFS2_CKPT_BUF_SIZE];
+};
+
+#define ckpt_mtd(c)	RT_MTD_NOR_DEVICE(OFNI_BS_2SFFJ(c)->s_dev)
+#define ckpt_body(c)	((c)->ckpt_offset + sizeof(struct jffs2_ckpt_header))
+
+static inline struct jffs2_inode_cache *
+ckpt_first_inode(int *i, struct jffs2_sb_info *c)
+{
+	for (; *i < INOCACHE_HASHSIZE; (*i)++) {
+		if (c->inocache_list[*i])
+			return c->inocache_list[*i];
+	}
+	return NULL;
+}
+
+static inline struct jffs2_inode_cache *
+ckpt_next_inode(int *i, struct jffs2_inode_cache *ic, struct jffs2_sb_info *c)
+{
+	if (ic->next)
+		return ic->next;
+	(*i)++;
+	return ckpt_first_inode(i, c);
+}
+
+#define for_each_inode(i, c, ic)			\
+	for (i = 0, ic = ckpt_first_inode(&i, (c));	\
+	     ic;					\
+	     ic = ckpt_next_inode(&i, ic, (c)))
+
+static int ckpt_read(struct jffs2_sb_info *c, uint32_t ofs, void *buf, uint32_t len)
+{
+	if (rt_mtd_nor_read(ckpt_mtd(c), ofs, buf, len) != len)
+		return -EIO;
+	return 0;
+}
+
+static uint32_t ckpt_tail_crc(struct jffs2_sb_info *c, struct jffs2_eraseblock *jeb, int *err)
+{
+	unsigned char buf[JFFS2_CKPT_TAIL];
+	uint32_t end, len;
+
+	end = jeb->offset + c->sector_size - jeb->free_size;
+	len = c->sector_size - jeb->free_size;
+	if (len > JFFS2_CKPT_TAIL)
+		len = JFFS2_CKPT_TAIL;
+
+	*err = ckpt_read(c, end - len, buf, len);
+
+	return crc32(0, buf, len);
+}
+
+static int ckpt_flush(struct jffs2_ckpt_stream *s)
+{
+	if (!s->len)
+		return 0;
+	if (s->ofs + s->len > s->end ||
+	    rt_mtd_nor_write(s->mtd, s->ofs, s->buf, s->len) != s->len)
+		return -EIO;
+	s->ofs += s->len;
+	s->len = 0;
+	return 0;
+}
+
+static int ckpt_put(struct jffs2_ckpt_stream *s, const void *data, uint32_t len)
+{
+	uint32_t n;
+	int ret;
+
+	s->crc = crc32(s->crc, data, len);
+	while (len) {
+		n = JFFS2_CKPT_BUF_SIZE - s->len;
+		if (n > len)
+			n = len;
+		memcpy(s->buf + s->len, data, n);
+		s->len += n;
+		data = (const unsigned char *)data + n;
+		len -= n;
+
+		if (s->len == JFFS2_CKPT_BUF_SIZE) {
+			ret = ckpt_flush(s);
+			if (ret)
+				return ret;
+		}
+	}
+	return 0;
+}
+
+static int ckpt_get(struct jffs2_ckpt_stream *s, void *data, uint32_t len)
+{
+	uint32_t n;
+
+	while (len) {
+		if (s->pos == s->len) {
+			n = s->end - s->ofs;
+			if (!n)
+				return -EIO;
+			if (n > JFFS2_CKPT_BUF_SIZE)
+				n = JFFS2_CKPT_BUF_SIZE;
+			if (rt_mtd_nor_read(s->mtd, s->ofs, s->buf, n) != n)
+				return -EIO;
+			s->ofs += n;
+			s->len = n;
+			s->pos = 0;
+		}
+		n = s->len - s->pos;
+		if (n > len)
+			n = len;
+		memcpy(data, s->buf + s->pos, n);
+		s->crc = crc32(s->crc, s->buf + s->pos, n);
+		s->pos += n;
+		data = (unsigned char *)data + n;
+		len -= n;
+	}
+	return 0;
+}
+
+static void ckpt_stream_init(struct jffs2_sb_info *c, struct jffs2_ckpt_stream *s, uint32_t length)
+{
+	s->mtd = ckpt_mtd(c);
+	s->ofs = ckpt_body(c);
+	s->end = s->ofs + length;
+	s->crc = 0;
+	s->len = 0;
+	s->pos = 0;
+}
+
+static uint32_t ckpt_hdr_crc(struct jffs2_ckpt_header *hdr)
+{
+	struct jffs2_ckpt_header tmp = *hdr;
+
+	tmp.valid = JFFS2_CKPT_VALID;
+	return crc32(0, &tmp, sizeof(tmp) - sizeof(tmp.hdr_crc));
+}
+
+/* mark the list of each erase block */
+static int ckpt_block_lists(struct jffs2_sb_info *c, unsigned char *lists)
+{
+	static const int list_ids[] = {
+		CKPT_LIST_CLEAN, CKPT_LIST_VERY_DIRTY, CKPT_LIST_DIRTY, CKPT_LIST_ERASABLE,
+		CKPT_LIST_ERASE_PENDING, CKPT_LIST_FREE, CKPT_LIST_BAD, CKPT_LIST_BAD_USED,
+	};
+	struct list_head *heads[] = {
+		&c->clean_list, &c->very_dirty_list, &c->dirty_list, &c->erasable_list,
+		&c->erase_pending_list, &c->free_list, &c->bad_list, &c->bad_used_list,
+	};
+	struct list_head *this;
+	struct jffs2_eraseblock *jeb;
+	uint32_t i;
+
+	memset(lists, 0, c->nr_blocks);
+	for (i = 0; i < sizeof(list_ids) / sizeof(list_ids[0]); i++) {
+		list_for_each(this, heads[i]) {
+			jeb = list_entry(this, struct jffs2_eraseblock, list);
+			lists[jeb - c->blocks] = list_ids[i];
+		}
+	}
+	if (c->nextblock)
+		lists[c->nextblock - c->blocks] = CKPT_LIST_NEXTBLOCK;
+	if (c->gcblock)
+		lists[c->gcblock - c->blocks] = CKPT_LIST_GCBLOCK;
+
+	for (i = 0; i < c->nr_blocks; i++) {
+		if (!lists[i])
+			return -EBUSY;
+	}
+	return 0;
+}
+
+/* the blocks which are kept until the file system is changed */
+static inline int ckpt_block_stable(int list)
+{
+	return list != CKPT_LIST_ERASABLE && list != CKPT_LIST_ERASE_PENDING &&
+	       list != CKPT_LIST_BAD && list != CKPT_LIST_BAD_USED;
+}
+
+/*
+ * Write the checkpoint of current state. It's skipped when the erase is in
+ * progress or the checkpoint area is too small.
+ */
+int jffs2_checkpoint_write(struct jffs2_sb_info *c)
+{
+	struct jffs2_ckpt_stream *s = NULL;
+	struct jffs2_ckpt_header hdr;
+	struct jffs2_ckpt_sb csb;
+	struct jffs2_ckpt_block cblk;
+	struct jffs2_ckpt_ref cref;
+	struct jffs2_ckpt_ino cino;
+	struct jffs2_inode_cache *ic;
+	struct jffs2_raw_node_ref *raw;
+	struct jffs2_eraseblock *jeb;
+	unsigned char *lists = NULL;
+	uint32_t nr_refs = 0, nr_inos = 0, nr_nodes = 0, length, ofs;
+	int i, ret;
+
+	if (!c->ckpt_size || c->ckpt_valid)
+		return 0;
+
+	down(&c->alloc_sem);
+
+	ret = -EBUSY;
+	if (!list_empty(&c->erasing_list) || !list_empty(&c->erase_complete_list) ||
+	    !list_empty(&c->erasable_pending_wbuf_list))
+		goto out;
+
+	ret = -ENOMEM;
+	lists = rt_malloc(c->nr_blocks);
+	s = rt_malloc(sizeof(struct jffs2_ckpt_stream));
+	if (!lists || !s)
+		goto out;
+
+	ret = ckpt_block_lists(c, lists);
+	if (ret)
+		goto out;
+
+	for (i = 0; i < c->nr_blocks; i++) {
+		for (raw = c->blocks[i].first_node; raw; raw = raw->next_phys)
+			nr_refs++;
+	}
+	for_each_inode(i, c, ic) {
+		nr_inos++;
+		for (raw = ic->nodes; raw && raw != (void *)ic; raw = raw->next_in_ino) {
+			/* the removed file is still opened, it's dropped by next scan */
+			if (!ic->nlink && !ref_obsolete(raw)) {
+				ret = -EBUSY;
+				goto out;
+			}
+			nr_nodes++;
+		}
+	}
+
+	length = sizeof(struct jffs2_ckpt_sb) + c->nr_blocks * sizeof(struct jffs2_ckpt_block) +
+		 nr_refs * sizeof(struct jffs2_ckpt_ref) + nr_inos * sizeof(struct jffs2_ckpt_ino) +
+		 nr_nodes * sizeof(uint32_t);
+	ret = -ENOSPC;
+	if (sizeof(struct jffs2_ckpt_header) + length > c->ckpt_size) {
+		printk(KERN_NOTICE "JFFS2 checkpoint needs %u bytes, it's skipped\n",
+		       (unsigned int)(sizeof(struct jffs2_ckpt_header) + length));
+		goto out;
+	}
+
+	/* the old checkpoint is erased firstly */
+	ret = -EIO;
+	for (ofs = 0; ofs < sizeof(struct jffs2_ckpt_header) + length; ofs += c->sector_size) {
+		if (rt_mtd_nor_erase_block(ckpt_mtd(c), c->ckpt_offset + ofs, c->sector_size) != RT_EOK)
+			goto out;
+	}
+
+	ckpt_stream_init(c, s, length);
+
+	csb.highest_ino = c->highest_ino;
+	csb.used_size = c->used_size;
+	csb.dirty_size = c->dirty_size;
+	csb.wasted_size = c->wasted_size;
+	csb.free_size = c->free_size;
+	csb.erasing_size = c->erasing_size;
+	csb.bad_size = c->bad_size;
+	csb.unchecked_size = c->unchecked_size;
+	csb.nr_free_blocks = c->nr_free_blocks;
+	csb.nr_erasing_blocks = c->nr_erasing_blocks;
+	ret = ckpt_put(s, &csb, sizeof(csb));
+
+	for (i = 0; i < c->nr_blocks && !ret; i++) {
+		jeb = &c->blocks[i];
+
+		cblk.list = lists[i];
+		cblk.bad_count = jeb->bad_count;
+		cblk.unchecked_size = jeb->unchecked_size;
+		cblk.used_size = jeb->used_size;
+		cblk.dirty_size = jeb->dirty_size;
+		cblk.wasted_size = jeb->wasted_size;
+		cblk.free_size = jeb->free_size;
+		cblk.tail_crc = 0;
+		if (ckpt_block_stable(lists[i]) && jeb->free_size < c->sector_size)
+			cblk.tail_crc = ckpt_tail_crc(c, jeb, &ret);
+		cblk.nr_refs = 0;
+		for (raw = jeb->first_node; raw; raw = raw->next_phys)
+			cblk.nr_refs++;
+		if (!ret)
+			ret = ckpt_put(s, &cblk, sizeof(cblk));
+
+		for (raw = jeb->first_node; raw && !ret; raw = raw->next_phys) {
+			cref.flash_offset = raw->flash_offset;
+			cref.totlen = raw->__totlen;
+			ret = ckpt_put(s, &cref, sizeof(cref));
+		}
+	}
+
+	for_each_inode(i, c, ic) {
+		if (ret)
+			break;
+
+		cino.ino = ic->ino;
+		cino.nlink = ic->nlink;
+		/* the inodes in core are cleared on next mount */
+		cino.state = ic->state == INO_STATE_UNCHECKED ? INO_STATE_UNCHECKED : INO_STATE_CHECKEDABSENT;
+		cino.nr_nodes = 0;
+		for (raw = ic->nodes; raw && raw != (void *)ic; raw = raw->next_in_ino)
+			cino.nr_nodes++;
+		ret = ckpt_put(s, &cino, sizeof(cino));
+
+		for (raw = ic->nodes; raw && raw != (void *)ic && !ret; raw = raw->next_in_ino) {
+			ofs = ref_offset(raw);
+			ret = ckpt_put(s, &ofs, sizeof(ofs));
+		}
+	}
+	if (!ret)
+		ret = ckpt_flush(s);
+	if (ret)
+		goto out;
+
+	hdr.magic = JFFS2_CKPT_MAGIC;
+	hdr.valid = JFFS2_CKPT_VALID;
+	hdr.version = JFFS2_CKPT_VERSION;
+	hdr.sector_size = c->sector_size;
+	hdr.nr_blocks = c->nr_blocks;
+	hdr.nr_refs = nr_refs;
+	hdr.nr_inos = nr_inos;
+	hdr.length = length;
+	hdr.body_crc = s->crc;
+	hdr.hdr_crc = ckpt_hdr_crc(&hdr);
+	if (rt_mtd_nor_write(ckpt_mtd(c), c->ckpt_offset, (const rt_uint8_t *)&hdr, sizeof(hdr)) != sizeof(hdr)) {
+		ret = -EIO;
+		goto out;
+	}
+
+	c->ckpt_valid = 1;
+	c->ckpt_tick = rt_tick_get();
+	D1(printk(KERN_DEBUG "JFFS2 checkpoint: %u refs, %u inodes, %u bytes\n", nr_refs, nr_inos, length));
+
+out:
+	up(&c->alloc_sem);
+	rt_free(lists);
+	rt_free(s);
+	return ret;
+}
+
+/*
+ * Write the checkpoint when the file system has been changed for
+ * CONFIG_JFFS2_CHECKPOINT_INTERVAL seconds, it's called on close and sync.
+ */
+void jffs2_checkpoint_update(struct jffs2_sb_info *c)
+{
+#if CONFIG_JFFS2_CHECKPOINT_INTERVAL > 0
+	if (!c->ckpt_valid &&
+	    rt_tick_get() - c->ckpt_tick >= CONFIG_JFFS2_CHECKPOINT_INTERVAL * RT_TICK_PER_SECOND)
+		jffs2_checkpoint_write(c);
+#endif
+}
+
+/*
+ * The checkpoint becomes stale before the file system is changed, it's
+ * called before any write or erase.
+ */
+void jffs2_checkpoint_invalidate(struct jffs2_sb_info *c)
+{
+	uint32_t valid = 0;
+
+	c->ckpt_valid = 0;
+
+	if (rt_mtd_nor_write(ckpt_mtd(c), c->ckpt_offset + offsetof(struct jffs2_ckpt_header, valid),
+			     (const rt_uint8_t *)&valid, sizeof(valid)) == sizeof(valid) &&
+	    ckpt_read(c, c->ckpt_offset + offsetof(struct jffs2_ckpt_header, valid), &valid, sizeof(valid)) == 0 &&
+	    valid == 0)
+		return;
+
+	/* the flash doesn't support programming twice */
+	rt_mtd_nor_erase_block(ckpt_mtd(c), c->ckpt_offset, c->sector_size);
+}
+
+/* drop the partial state and prepare for scanning, as jffs2_do_mount_fs */
+static void ckpt_reset(struct jffs2_sb_info *c)
+{
+	int i;
+
+	jffs2_free_ino_caches(c);
+	jffs2_free_raw_node_refs(c);
+
+	for (i = 0; i < c->nr_blocks; i++) {
+		INIT_LIST_HEAD(&c->blocks[i].list);
+		c->blocks[i].free_size = c->sector_size;
+		c->blocks[i].dirty_size = 0;
+		c->blocks[i].wasted_size = 0;
+		c->blocks[i].unchecked_size = 0;
+		c->blocks[i].used_size = 0;
+		c->blocks[i].bad_count = 0;
+		c->blocks[i].gc_node = NULL;
+	}
+
+	INIT_LIST_HEAD(&c->clean_list);
+	INIT_LIST_HEAD(&c->very_dirty_list);
+	INIT_LIST_HEAD(&c->dirty_list);
+	INIT_LIST_HEAD(&c->erasable_list);
+	INIT_LIST_HEAD(&c->erase_pending_list);
+	INIT_LIST_HEAD(&c->free_list);
+	INIT_LIST_HEAD(&c->bad_list);
+	INIT_LIST_HEAD(&c->bad_used_list);
+
+	c->nextblock = NULL;
+	c->gcblock = NULL;
+	c->highest_ino = 1;
+	c->used_size = c->dirty_size = c->wasted_size = 0;
+	c->erasing_size = c->bad_size = c->unchecked_size = 0;
+	c->free_size = c->flash_size;
+	c->nr_free_blocks = c->nr_erasing_blocks = 0;
+}
+
+static struct jffs2_raw_node_ref *ckpt_find_ref(struct jffs2_raw_node_ref **refs, uint32_t nr_refs, uint32_t ofs)
+{
+	uint32_t low = 0, high = nr_refs;
+	uint32_t mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (ref_offset(refs[mid]) == ofs)
+			return refs[mid];
+		if (ref_offset(refs[mid]) < ofs)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return NULL;
+}
+
+static int ckpt_restore(struct jffs2_sb_info *c, struct jffs2_ckpt_header *hdr, struct jffs2_ckpt_stream *s,
+			struct jffs2_raw_node_ref **refs)
+{
+	struct jffs2_ckpt_sb csb;
+	struct jffs2_ckpt_block cblk;
+	struct jffs2_ckpt_ref cref;
+	struct jffs2_ckpt_ino cino;
+	struct jffs2_eraseblock *jeb;
+	struct jffs2_inode_cache *ic;
+	struct jffs2_raw_node_ref *raw, **prev;
+	struct list_head *head;
+	uint32_t i, j, n = 0, ofs, crc;
+	int ret;
+
+	ret = ckpt_get(s, &csb, sizeof(csb));
+	if (ret)
+		return ret;
+
+	for (i = 0; i < c->nr_blocks; i++) {
+		jeb = &c->blocks[i];
+
+		ret = ckpt_get(s, &cblk, sizeof(cblk));
+		if (ret)
+			return ret;
+		if (cblk.unchecked_size + cblk.used_size + cblk.dirty_size + cblk.wasted_size +
+		    cblk.free_size != c->sector_size || n + cblk.nr_refs > hdr->nr_refs)
+			return -EIO;
+
+		switch (cblk.list) {
+		case CKPT_LIST_CLEAN:		head = &c->clean_list; break;
+		case CKPT_LIST_VERY_DIRTY:	head = &c->very_dirty_list; break;
+		case CKPT_LIST_DIRTY:		head = &c->dirty_list; break;
+		case CKPT_LIST_ERASABLE:	head = &c->erasable_list; break;
+		case CKPT_LIST_ERASE_PENDING:	head = &c->erase_pending_list; break;
+		case CKPT_LIST_FREE:		head = &c->free_list; break;
+		case CKPT_LIST_BAD:		head = &c->bad_list; break;
+		case CKPT_LIST_BAD_USED:	head = &c->bad_used_list; break;
+		case CKPT_LIST_NEXTBLOCK:
+			if (c->nextblock)
+				return -EIO;
+			c->nextblock = jeb;
+			head = NULL;
+			break;
+		case CKPT_LIST_GCBLOCK:
+			if (c->gcblock)
+				return -EIO;
+			c->gcblock = jeb;
+			head = NULL;
+			break;
+		default:
+			return -EIO;
+		}
+		if (head)
+			list_add_tail(&jeb->list, head);
+
+		jeb->bad_count = cblk.bad_count;
+		jeb->unchecked_size = cblk.unchecked_size;
+		jeb->used_size = cblk.used_size;
+		jeb->dirty_size = cblk.dirty_size;
+		jeb->wasted_size = cblk.wasted_size;
+		jeb->free_size = cblk.free_size;
+
+		prev = &jeb->first_node;
+		for (j = 0; j < cblk.nr_refs; j++) {
+			ret = ckpt_get(s, &cref, sizeof(cref));
+			if (ret)
+				return ret;
+
+			ofs = cref.flash_offset & ~3;
+			if (ofs < jeb->offset || ofs + cref.totlen > jeb->offset + c->sector_size - jeb->free_size ||
+			    (n && ofs <= ref_offset(refs[n - 1])))
+				return -EIO;
+
+			raw = jffs2_alloc_raw_node_ref();
+			if (!raw)
+				return -ENOMEM;
+			raw->flash_offset = cref.flash_offset;
+			raw->__totlen = cref.totlen;
+			raw->next_in_ino = NULL;
+			raw->next_phys = NULL;
+			*prev = raw;
+			prev = &raw->next_phys;
+			jeb->last_node = raw;
+			refs[n++] = raw;
+		}
+
+		/* the blocks aren't changed since the checkpoint */
+		if (ckpt_block_stable(cblk.list)) {
+			if (jeb->free_size < c->sector_size) {
+				crc = ckpt_tail_crc(c, jeb, &ret);
+				if (ret || crc != cblk.tail_crc)
+					return -EIO;
+			}
+			if (jeb->free_size >= sizeof(uint32_t)) {
+				ret = ckpt_read(c, jeb->offset + c->sector_size - jeb->free_size, &ofs, sizeof(ofs));
+				if (ret || ofs != 0xFFFFFFFF)
+					return -EIO;
+			}
+		}
+	}
+	if (n != hdr->nr_refs)
+		return -EIO;
+
+	for (i = 0; i < hdr->nr_inos; i++) {
+		ret = ckpt_get(s, &cino, sizeof(cino));
+		if (ret)
+			return ret;
+		if (!cino.ino || jffs2_get_ino_cache(c, cino.ino))
+			return -EIO;
+
+		ic = jffs2_alloc_inode_cache();
+		if (!ic)
+			return -ENOMEM;
+		memset(ic, 0, sizeof(*ic));
+		ic->ino = cino.ino;
+		ic->nlink = cino.nlink;
+		ic->state = cino.state;
+		ic->nodes = (void *)ic;
+		jffs2_add_ino_cache(c, ic);
+
+		prev = &ic->nodes;
+		for (j = 0; j < cino.nr_nodes; j++) {
+			ret = ckpt_get(s, &ofs, sizeof(ofs));
+			if (ret)
+				return ret;
+
+			raw = ckpt_find_ref(refs, n, ofs);
+			if (!raw || raw->next_in_ino)
+				return -EIO;
+			*prev = raw;
+			prev = &raw->next_in_ino;
+		}
+		*prev = (void *)ic;
+	}
+
+	c->highest_ino = csb.highest_ino;
+	c->used_size = csb.used_size;
+	c->dirty_size = csb.dirty_size;
+	c->wasted_size = csb.wasted_size;
+	c->free_size = csb.free_size;
+	c->erasing_size = csb.erasing_size;
+	c->bad_size = csb.bad_size;
+	c->unchecked_size = csb.unchecked_size;
+	c->nr_free_blocks = csb.nr_free_blocks;
+	c->nr_erasing_blocks = csb.nr_erasing_blocks;
+	if (c->gcblock)
+		c->gcblock->gc_node = c->gcblock->first_node;
+
+	return 0;
+}
+
+/*
+ * Build the state from the checkpoint instead of scanning the medium,
+ * returns 0 on success. The state is reset for scanning on failure, and
+ * the rejected checkpoint is invalidated, because the writes after the
+ * scan don't invalidate it.
+ */
+int jffs2_checkpoint_load(struct jffs2_sb_info *c)
+{
+	struct jffs2_ckpt_stream *s = NULL;
+	struct jffs2_raw_node_ref **refs = NULL;
+	struct jffs2_ckpt_header hdr;
+	uint32_t n;
+	int ret;
+
+	if (!c->ckpt_size)
+		return -ENODEV;
+
+	ret = ckpt_read(c, c->ckpt_offset, &hdr, sizeof(hdr));
+	if (ret)
+		return ret;
+	if (hdr.magic != JFFS2_CKPT_MAGIC || hdr.valid != JFFS2_CKPT_VALID)
+		return -EINVAL;
+	if (hdr.hdr_crc != ckpt_hdr_crc(&hdr) || hdr.version != JFFS2_CKPT_VERSION ||
+	    hdr.sector_size != c->sector_size || hdr.nr_blocks != c->nr_blocks ||
+	    hdr.length > c->ckpt_size - sizeof(hdr)) {
+		D1(printk(KERN_DEBUG "JFFS2 checkpoint isn't valid, scanning\n"));
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = -ENOMEM;
+	s = rt_malloc(sizeof(struct jffs2_ckpt_stream));
+	refs = rt_malloc((hdr.nr_refs ? hdr.nr_refs : 1) * sizeof(struct jffs2_raw_node_ref *));
+	if (!s || !refs)
+		goto out;
+
+	/* check the whole body before building anything */
+	ckpt_stream_init(c, s, hdr.length);
+	while (s->ofs < s->end) {
+		n = s->end - s->ofs;
+		if (n > JFFS2_CKPT_BUF_SIZE)
+			n = JFFS2_CKPT_BUF_SIZE;
+		ret = ckpt_read(c, s->ofs, s->buf, n);
+		if (ret)
+			goto out;
+		s->crc = crc32(s->crc, s->buf, n);
+		s->ofs += n;
+	}
+	if (s->crc != hdr.body_crc) {
+		printk(KERN_NOTICE "JFFS2 checkpoint is corrupted, scanning\n");
+		ret = -EIO;
+		goto out;
+	}
+
+	ckpt_stream_init(c, s, hdr.length);
+	ret = ckpt_restore(c, &hdr, s, refs);
+	if (ret) {
+		printk(KERN_NOTICE "JFFS2 checkpoint doesn't match the medium, scanning\n");
+		ckpt_reset(c);
+		goto out;
+	}
+
+	jffs2_rotate_lists(c);
+	c->ckpt_valid = 1;
+	c->ckpt_tick = rt_tick_get();
+	D1(printk(KERN_DEBUG "JFFS2 mounted from checkpoint: %u refs, %u inodes\n", hdr.nr_refs, hdr.nr_inos));
+
+out:
+	if (ret)
+		jffs2_checkpoint_invalidate(c);
+	rt_free(refs);
+	rt_free(s);
+	return ret;
+}
+
+#endif /* CONFIG_JFFS2_CHECKPOINT */
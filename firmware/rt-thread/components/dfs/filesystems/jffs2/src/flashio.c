@@ -39,6 +39,10 @@ int jffs2_flash_write(struct jffs2_sb_info * c,
 	uint32_t len;
 	struct super_block *sb = OFNI_BS_2SFFJ(c);
 
+#ifdef CONFIG_JFFS2_CHECKPOINT
+	if (c->ckpt_valid)
+		jffs2_checkpoint_invalidate(c);
+#endif
 	len = rt_mtd_nor_write(RT_MTD_NOR_DEVICE(sb->s_dev), offset, buffer, size);
 	if (len != size)
 		return -EIO;
@@ -53,6 +57,10 @@ int jffs2_flash_erase(struct jffs2_sb_info * c,
 	rt_err_t result;
 	struct super_block *sb = OFNI_BS_2SFFJ(c);
 
+#ifdef CONFIG_JFFS2_CHECKPOINT
+	if (c->ckpt_valid)
+		jffs2_checkpoint_invalidate(c);
+#endif
 	result = rt_mtd_nor_erase_block(RT_MTD_NOR_DEVICE(sb->s_dev), jeb->offset, c->sector_size);
 	if (result != RT_EOK)
 		return -EIO;
@@ -462,6 +462,14 @@ static int jffs2_read_super(struct super_block *sb)
 	c->sector_size = device->block_size;
 	c->flash_size  = (device->block_end - device->block_start) * device->block_size;
 	c->cleanmarker_size = sizeof(struct jffs2_unknown_node);
+#ifdef CONFIG_JFFS2_CHECKPOINT
+	/* the last blocks of device are reserved for the checkpoint */
+	if (device->block_end - device->block_start > CONFIG_JFFS2_CHECKPOINT_BLOCKS) {
+		c->ckpt_size   = CONFIG_JFFS2_CHECKPOINT_BLOCKS * device->block_size;
+		c->flash_size -= c->ckpt_size;
+		c->ckpt_offset = c->flash_size;
+	}
+#endif
 
 	err = jffs2_do_mount_fs(c);
 	if (err) return -err;
@@ -640,6 +648,11 @@ static int jffs2_umount(cyg_mtab_entry * mte)
 		//Clear root inode
 		//root_i = NULL;
 
+#ifdef CONFIG_JFFS2_CHECKPOINT
+		// Save the state for the fast mount
+		jffs2_checkpoint_write(c);
+#endif
+
 		// Clean up the super block and root inode
 		jffs2_free_ino_caches(c);
 		jffs2_free_raw_node_refs(c);
@@ -1534,6 +1547,10 @@ static int jffs2_fo_fsync(struct CYG_FILE_TAG *fp, int mode)
 
 	D2(printf("jffs2_fo_fsync\n"));
 
+#ifdef CONFIG_JFFS2_CHECKPOINT
+	jffs2_checkpoint_update(JFFS2_SB_INFO(((struct _inode *) fp->f_data)->i_sb));
+#endif
+
 	return ENOERR;
 }
 
@@ -1545,6 +1562,9 @@ static int jffs2_fo_fsync(struct CYG_FILE_TAG *fp, int mode)
 static int jffs2_fo_close(struct CYG_FILE_TAG *fp)
 {
 	struct _inode *node = (struct _inode *) fp->f_data;
+#ifdef CONFIG_JFFS2_CHECKPOINT
+	struct jffs2_sb_info *c = JFFS2_SB_INFO(node->i_sb);
+#endif
 
 	D2(printf("jffs2_fo_close\n"));
 
@@ -1552,6 +1572,10 @@ static int jffs2_fo_close(struct CYG_FILE_TAG *fp)
 
 	fp->f_data = 0;		// zero data pointer
 
+#ifdef CONFIG_JFFS2_CHECKPOINT
+	jffs2_checkpoint_update(c);
+#endif
+
 	return ENOERR;
 }
 
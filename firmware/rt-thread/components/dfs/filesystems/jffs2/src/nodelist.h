@@ -399,6 +399,14 @@ void jffs2_rotate_lists(struct jffs2_sb_info *c);
 /* build.c */
 int jffs2_do_mount_fs(struct jffs2_sb_info *c);
 
+#ifdef CONFIG_JFFS2_CHECKPOINT
+/* checkpoint.c */
+int jffs2_checkpoint_load(struct jffs2_sb_info *c);
+int jffs2_checkpoint_write(struct jffs2_sb_info *c);
+void jffs2_checkpoint_update(struct jffs2_sb_info *c);
+void jffs2_checkpoint_invalidate(struct jffs2_sb_info *c);
+#endif
+
 /* erase.c */
 void jffs2_erase_pending_blocks(struct jffs2_sb_info *c, int count);
 
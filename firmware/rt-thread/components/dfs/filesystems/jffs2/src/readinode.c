@@ -186,10 +186,11 @@ read_direntry(struct jffs2_sb_info *c,
 		/* FIXME: point() */
 		int err;
 		int already = read - sizeof(*rd);
+		size_t retlen;
 			
 		err = jffs2_flash_read(c, (ref_offset(ref)) + read, 
-				rd->nsize - already, (size_t*)&read, &fd->name[already]);
-		if (unlikely(read != rd->nsize - already) && likely(!err))
+				rd->nsize - already, &retlen, &fd->name[already]);
+		if (unlikely(retlen != rd->nsize - already) && likely(!err))
 			return -EIO;
 			
 		if (unlikely(err)) {
@@ -273,13 +274,15 @@ read_dnode(struct jffs2_sb_info *c,
 			}
 #endif					
 			if(!pointed){
+				size_t retlen;
+
 				buf = kmalloc(je32_to_cpu(rd->csize), GFP_KERNEL);
 				if (!buf)
 					return -ENOMEM;
 				
 				err = jffs2_flash_read(c, ref_offset(ref) + sizeof(*rd), je32_to_cpu(rd->csize),
-							(size_t*)&read, buf);
-				if (unlikely(read != je32_to_cpu(rd->csize)) && likely(!err))
+							&retlen, buf);
+				if (unlikely(retlen != je32_to_cpu(rd->csize)) && likely(!err))
 					err = -EIO;
 				if (err) {
 					kfree(buf);
@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * jffs2_sim runs jffs2 on the host with a simulated NOR flash, and prints
+ * the mount time of the full scan and of the checkpoint for some flash
+ * sizes. It also checks that a rejected checkpoint is invalidated, so the
+ * writes after the scan can't bring it back at the next mount.
+ *
+ * The flash is a RAM buffer: programming can only clear bits, and the time
+ * of each operation is added up by the typical timing of SPI NOR flash
+ * (W25Q series): 45ms to erase 4KB, 0.7ms to program one 256 bytes page,
+ * and the data is transferred at 50MHz. The mount time is the time of the
+ * flash reads, the CPU time of the host isn't counted.
+ *
+ * jffs2 is built into this program with the configuration in rtconfig.h,
+ * the sources are the ones of SConscript without dfs_jffs2.c and porting.c:
+ *
+ *   R=../../../../..; J=..
+ *   gcc -std=gnu99 -O2 -w -I. -I$R/include -I$R/components/drivers/include \
+ *       -I$R/components/dfs/include -I$J -I$J/include -I$J/src -I$J/cyg \
+ *       -I$J/kernel -I$J/cyg/compress jffs2_sim.c $(find $J/src $J/cyg/crc -name '*.c') \
+ *       $J/kernel/rbtree.c $J/cyg/compress/src/{adler32,compress,deflate,infback,\
+ *       inffast,inflate,inftrees,trees,uncompr,zutil}.c -o jffs2_sim
+ *
+ * usage: jffs2_sim [block size] [record size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+#include "cyg/infra/cyg_type.h"
+#include "cyg/fileio/fileio.h"
+#include "port/codes.h"
+#include "port/fcntl.h"
+
+/* from porting.h, whose stat conflicts with the one of host */
+extern cyg_fileops jffs2_fileops;
+extern struct cyg_fstab_entry jffs2_fste;
+
+#define SIM_PAGE_SIZE       256
+#define SIM_ERASE_US        45000   /* erase 4KB */
+#define SIM_PROG_US         700     /* program one page */
+#define SIM_CMD_US          1       /* command and address */
+#define SIM_BYTE_NS         160     /* transfer one byte at 50MHz */
+
+#define SIM_FILES           8
+#define SIM_FILL            50      /* the percent of flash filled by files */
+
+/* the head of checkpoint header, see checkpoint.c */
+#define SIM_CKPT_MAGIC      0x504b434a
+#define SIM_CKPT_VALID      0xFFFFFFFF
+
+struct sim_flash
+{
+    struct rt_mtd_nor_device mtd;
+    rt_uint8_t *data;
+    rt_uint32_t size;
+
+    rt_uint64_t time_ns;            /* the time of all operations */
+    rt_uint32_t read_bytes;
+    rt_uint32_t erases;
+};
+
+static struct sim_flash flash;
+static struct cyg_mtab_entry mte;
+static rt_uint32_t record_size = 1024;
+static rt_uint32_t file_size;
+static rt_uint32_t mount_bytes;
+
+/* the stubs of kernel for jffs2 */
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void rt_free(void *ptr) { free(ptr); }
+rt_tick_t rt_tick_get(void) { return 0; }
+time_t jffs2_get_timestamp(void) { return 0; }
+
+static rt_size_t sim_read(struct rt_mtd_nor_device *device, rt_off_t offset, rt_uint8_t *data, rt_uint32_t length)
+{
+    if (offset + length > flash.size)
+        return 0;
+
+    memcpy(data, flash.data + offset, length);
+    flash.read_bytes += length;
+    flash.time_ns += SIM_CMD_US * 1000 + (rt_uint64_t)length * SIM_BYTE_NS;
+
+    return length;
+}
+
+static rt_size_t sim_write(struct rt_mtd_nor_device *device, rt_off_t offset, const rt_uint8_t *data, rt_uint32_t length)
+{
+    rt_uint32_t index, pages;
+
+    if (offset + length > flash.size)
+        return 0;
+
+    for (index = 0; index < length; index++)
+        flash.data[offset + index] &= data[index];
+
+    pages = (offset + length - 1) / SIM_PAGE_SIZE - offset / SIM_PAGE_SIZE + 1;
+    flash.time_ns += (rt_uint64_t)pages * (SIM_CMD_US + SIM_PROG_US) * 1000 + (rt_uint64_t)length * SIM_BYTE_NS;
+
+    return length;
+}
+
+static rt_err_t sim_erase(struct rt_mtd_nor_device *device, rt_off_t offset, rt_uint32_t length)
+{
+    if (offset % device->block_size || offset + length > flash.size)
+        return -RT_EINVAL;
+
+    memset(flash.data + offset, 0xFF, length);
+    flash.erases++;
+    flash.time_ns += (rt_uint64_t)length / 4096 * SIM_ERASE_US * 1000;
+
+    return RT_EOK;
+}
+
+static const struct rt_mtd_nor_driver_ops sim_ops =
+{
+    RT_NULL,
+    sim_read,
+    sim_write,
+    sim_erase,
+};
+
+static void sim_create(rt_uint32_t block_size, rt_uint32_t blocks)
+{
+    free(flash.data);
+    memset(&flash, 0, sizeof(flash));
+
+    flash.size = block_size * blocks;
+    flash.data = malloc(flash.size);
+    if (flash.data == RT_NULL)
+    {
+        fprintf(stderr, "no memory for the flash\n");
+        exit(1);
+    }
+    memset(flash.data, 0xFF, flash.size);
+
+    flash.mtd.block_size = block_size;
+    flash.mtd.block_start = 0;
+    flash.mtd.block_end = blocks;
+    flash.mtd.ops = &sim_ops;
+}
+
+static void sim_reset(void)
+{
+    flash.time_ns = 0;
+    flash.read_bytes = 0;
+    flash.erases = 0;
+}
+
+static double sim_ms(void)
+{
+    return flash.time_ns / 1000000.0;
+}
+
+static rt_uint32_t sim_ckpt_offset(void)
+{
+    return flash.size - RT_DFS_JFFS2_CHECKPOINT_BLOCKS * flash.mtd.block_size;
+}
+
+/* the valid word of checkpoint header, 0 if there is no checkpoint */
+static rt_uint32_t sim_ckpt_valid(void)
+{
+    rt_uint32_t head[2];
+
+    memcpy(head, flash.data + sim_ckpt_offset(), sizeof(head));
+    return head[0] == SIM_CKPT_MAGIC ? head[1] : 0;
+}
+
+static int sim_mount(void)
+{
+    memset(&mte, 0, sizeof(mte));
+    mte.name = "/";
+    mte.fsname = "jffs2";
+    mte.devname = NULL;
+    mte.data = (CYG_ADDRWORD)&(flash.mtd.parent);
+    mte.fs = &jffs2_fste;
+
+    return jffs2_fste.mount(NULL, &mte);
+}
+
+static void sim_unmount(void)
+{
+    if (jffs2_fste.umount(&mte) != 0)
+    {
+        fprintf(stderr, "unmount failed\n");
+        exit(1);
+    }
+}
+
+static void file_name(char *name, int index)
+{
+    sprintf(name, "sensor%d.log", index);
+}
+
+static rt_uint8_t file_byte(int index, rt_uint32_t pos)
+{
+    return (rt_uint8_t)(pos * 31 + index * 7 + (pos >> 8));
+}
+
+static int file_io(cyg_file *file, rt_uint8_t *buf, rt_uint32_t len, int write)
+{
+    struct CYG_UIO_TAG uio;
+    struct CYG_IOVEC_TAG iovec;
+    off_t pos = file->f_offset;
+    int result;
+
+    iovec.iov_base = buf;
+    iovec.iov_len = len;
+    uio.uio_iov = &iovec;
+    uio.uio_iovcnt = 1;
+    uio.uio_resid = len;
+
+    if (write)
+        result = jffs2_fileops.fo_write(file, &uio);
+    else
+        result = jffs2_fileops.fo_read(file, &uio);
+    if (result)
+        return -result;
+
+    return file->f_offset - pos;
+}
+
+/* the files are appended by records in turn, as the sensors log */
+static rt_uint32_t sim_populate(void)
+{
+    cyg_file files[SIM_FILES];
+    rt_uint8_t *buf;
+    char name[16];
+    rt_uint32_t pos, index;
+    int i;
+
+    buf = malloc(record_size);
+    memset(files, 0, sizeof(files));
+    for (i = 0; i < SIM_FILES; i++)
+    {
+        file_name(name, i);
+        if (jffs2_fste.open(&mte, 0, name, JFFS2_O_RDWR | JFFS2_O_CREAT | JFFS2_O_TRUNC, &files[i]) != 0)
+        {
+            fprintf(stderr, "open %s failed\n", name);
+            exit(1);
+        }
+    }
+
+    for (pos = 0; pos < file_size; pos += record_size)
+    {
+        for (i = 0; i < SIM_FILES; i++)
+        {
+            for (index = 0; index < record_size; index++)
+                buf[index] = file_byte(i, pos + index);
+            if (file_io(&files[i], buf, record_size, 1) != (int)record_size)
+            {
+                fprintf(stderr, "write failed at %u\n", pos);
+                exit(1);
+            }
+        }
+    }
+
+    for (i = 0; i < SIM_FILES; i++)
+        jffs2_fileops.fo_close(&files[i]);
+    free(buf);
+
+    return SIM_FILES * (file_size / record_size);
+}
+
+static int sim_check(void)
+{
+    cyg_file file;
+    rt_uint8_t *buf;
+    char name[16];
+    rt_uint32_t pos, index;
+    int i, bad = 0;
+
+    buf = malloc(record_size);
+    for (i = 0; i < SIM_FILES && !bad; i++)
+    {
+        memset(&file, 0, sizeof(file));
+        file_name(name, i);
+        if (jffs2_fste.open(&mte, 0, name, JFFS2_O_RDONLY, &file) != 0)
+            return -1;
+
+        for (pos = 0; pos < file_size && !bad; pos += record_size)
+        {
+            if (file_io(&file, buf, record_size, 0) != (int)record_size)
+                bad = 1;
+            for (index = 0; index < record_size && !bad; index++)
+                bad = buf[index] != file_byte(i, pos + index);
+        }
+        jffs2_fileops.fo_close(&file);
+    }
+    free(buf);
+
+    return bad ? -1 : 0;
+}
+
+/* mount and check the files, returns the simulated time in ms */
+static double sim_mount_check(const char *what)
+{
+    double ms;
+
+    sim_reset();
+    if (sim_mount() != 0)
+    {
+        fprintf(stderr, "%s: mount failed\n", what);
+        exit(1);
+    }
+    ms = sim_ms();
+    mount_bytes = flash.read_bytes;
+
+    if (sim_check() != 0)
+    {
+        fprintf(stderr, "%s: the files are corrupted\n", what);
+        exit(1);
+    }
+    sim_unmount();
+
+    return ms;
+}
+
+static void bench_mount(rt_uint32_t block_size, rt_uint32_t blocks)
+{
+    rt_uint32_t nodes, scan_bytes;
+    double scan_ms, ckpt_ms;
+
+    sim_create(block_size, blocks);
+    file_size = (rt_uint64_t)(blocks - RT_DFS_JFFS2_CHECKPOINT_BLOCKS) * block_size
+                * SIM_FILL / 100 / SIM_FILES / record_size * record_size;
+
+    if (sim_mount() != 0)
+    {
+        fprintf(stderr, "mount the blank flash failed\n");
+        exit(1);
+    }
+    nodes = sim_populate();
+    sim_unmount();
+    if (sim_ckpt_valid() != SIM_CKPT_VALID)
+    {
+        fprintf(stderr, "no checkpoint at unmount, it doesn't fit in %d blocks\n", RT_DFS_JFFS2_CHECKPOINT_BLOCKS);
+        exit(1);
+    }
+
+    /* without the checkpoint, the medium is scanned */
+    memset(flash.data + sim_ckpt_offset(), 0xFF, flash.size - sim_ckpt_offset());
+    scan_ms = sim_mount_check("scan");
+    scan_bytes = mount_bytes;
+
+    /* the checkpoint is written again at unmount */
+    ckpt_ms = sim_mount_check("checkpoint");
+
+    printf("%6uKB %8u %10u %10.1f %10u %10.1f %7.1fx\n", flash.size / 1024, nodes,
+           scan_bytes / 1024, scan_ms, mount_bytes / 1024, ckpt_ms, scan_ms / ckpt_ms);
+}
+
+/*
+ * A checkpoint rejected at mount must be invalidated: the writes after the
+ * scan don't invalidate it, and a power loss before the next unmount would
+ * leave a stale checkpoint that looks valid.
+ */
+static void test_rejected(rt_uint32_t block_size, rt_uint32_t blocks)
+{
+    rt_uint32_t body;
+
+    sim_create(block_size, blocks);
+    file_size = 4 * record_size;
+
+    if (sim_mount() != 0)
+    {
+        fprintf(stderr, "mount the blank flash failed\n");
+        exit(1);
+    }
+    sim_populate();
+    sim_unmount();
+
+    /* clear a bit in the body, the header is still valid */
+    body = sim_ckpt_offset() + 64;
+    while (flash.data[body] == 0)
+        body++;
+    flash.data[body] &= flash.data[body] - 1;
+
+    if (sim_mount() != 0)
+    {
+        fprintf(stderr, "mount with the corrupted checkpoint failed\n");
+        exit(1);
+    }
+    if (sim_ckpt_valid() == SIM_CKPT_VALID)
+    {
+        printf("rejected checkpoint: FAIL, it's still valid\n");
+        exit(1);
+    }
+    if (sim_check() != 0)
+    {
+        printf("rejected checkpoint: FAIL, the files are corrupted\n");
+        exit(1);
+    }
+    sim_unmount();
+
+    printf("rejected checkpoint: ok\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static const rt_uint32_t sizes[] = {1, 4, 16};
+    rt_uint32_t block_size = 64 * 1024;
+    int i;
+
+    if (argc > 1)
+        block_size = strtoul(argv[1], RT_NULL, 0);
+    if (argc > 2)
+        record_size = strtoul(argv[2], RT_NULL, 0);
+
+    printf("block %uKB, %d files of %uB records, %d%% full\n\n",
+           block_size / 1024, SIM_FILES, record_size, SIM_FILL);
+    printf("%8s %8s %10s %10s %10s %10s %8s\n",
+           "flash", "nodes", "scan(KB)", "scan(ms)", "ckpt(KB)", "ckpt(ms)", "speedup");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+        bench_mount(block_size, sizes[i] * 1024 * 1024 / block_size);
+    printf("\n");
+
+    test_rejected(block_size, 1024 * 1024 / block_size);
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/* the configuration of jffs2_sim, jffs2 is built for the host */
+
+#ifndef RT_CONFIG_H__
+#define RT_CONFIG_H__
+
+#define RT_NAME_MAX 8
+#define RT_ALIGN_SIZE 4
+#define RT_THREAD_PRIORITY_32
+#define RT_THREAD_PRIORITY_MAX 32
+#define RT_TICK_PER_SECOND 1000
+#define RT_DEBUG
+#define RT_USING_SEMAPHORE
+#define RT_USING_MUTEX
+#define RT_USING_HEAP
+#define RT_USING_DEVICE
+#define RT_USING_MTD_NOR
+
+/* the libc and the signals are from the host */
+#define RT_USING_NEWLIB
+#define LIBC_SIGNAL_H__
+#include <signal.h>
+#include <sys/stat.h>
+#include <asm/errno.h>
+
+/* jffs2 has the types and the stat of newlib */
+#define nlink_t jffs2_nlink_t
+#define uid_t   jffs2_uid_t
+#define gid_t   jffs2_gid_t
+/* the word of eCos holds the pointers, which are 64 bits on the host */
+#define cyg_haladdrword unsigned long
+
+#define RT_USING_DFS
+#define DFS_FILESYSTEMS_MAX 2
+#define DFS_FILESYSTEM_TYPES_MAX 2
+#define DFS_FD_MAX 4
+#define RT_USING_DFS_JFFS2
+
+#define RT_DFS_JFFS2_CHECKPOINT
+#define RT_DFS_JFFS2_CHECKPOINT_BLOCKS 2
+#define RT_DFS_JFFS2_CHECKPOINT_INTERVAL 0
+
+#endif
@@ -0,0 +1,1739 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * logfs is a log-structured file system for the NOR flash which is
+ * registered as MTD NOR device, it's designed for appending log files.
+ *
+ * The flash layout:
+ *
+ *   block 0, 1   the anchors, the records of current meta log are appended
+ *                to one of them, the other one is erased when it's full.
+ *   block 2 ~    the pool of meta blocks and data blocks.
+ *
+ * The meta log is a chain of meta blocks: a checkpoint of all files is
+ * written at the beginning, then the changes of files are appended as
+ * journal records. The chain is linked by the link record at the end of
+ * block. Mounting reads the anchors and the meta chain only, the RAM is
+ * bounded by the number of files and blocks. When the journal is longer
+ * than RT_DFS_LOGFS_JOURNAL_BLOCKS, a new checkpoint is written to a new
+ * chain and the old one is released after the anchor is updated.
+ *
+ * The data of file is saved in its own data blocks, so there is no garbage
+ * collection. The appended data is programmed into the erased area of last
+ * block, the overwritten block is copied to a new block. The size and the
+ * new blocks of file are recorded on fsync and close, a torn record is
+ * discarded by its CRC on mount.
+ *
+ * The blocks are allocated by a cursor which goes around the pool, and the
+ * data blocks are moved in turn every RT_DFS_LOGFS_WL_INTERVAL allocations,
+ * so the blocks of cold files are worn as the others.
+ *
+ * The files are in the root directory only.
+ *
+ * tools/logfs_sim.c runs logfs on a simulated NOR flash of the host, it
+ * prints the mount time, the write amplification and the throughput.
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <dfs.h>
+#include <dfs_fs.h>
+#include <dfs_file.h>
+
+#include "dfs_logfs.h"
+
+#ifndef RT_DFS_LOGFS_FILES_MAX
+#define RT_DFS_LOGFS_FILES_MAX      16
+#endif
+
+#ifndef RT_DFS_LOGFS_NAME_MAX
+#define RT_DFS_LOGFS_NAME_MAX       32
+#endif
+
+#ifndef RT_DFS_LOGFS_JOURNAL_BLOCKS
+#define RT_DFS_LOGFS_JOURNAL_BLOCKS 2
+#endif
+
+#ifndef RT_DFS_LOGFS_WL_INTERVAL
+#define RT_DFS_LOGFS_WL_INTERVAL    64
+#endif
+
+#define LOGFS_MAGIC                 0x53464C52  /* "RLFS" */
+#define LOGFS_BLOCK_NONE            0xFFFF
+#define LOGFS_ANCHOR_BLOCKS         2
+
+#define LOGFS_ALIGN(size)           RT_ALIGN(size, 4)
+#define LOGFS_BLOCKS_PER_RECORD     64
+#define LOGFS_RECORD_MAX            (sizeof(struct logfs_record) + \
+                                     LOGFS_ALIGN(sizeof(struct logfs_rec_blocks) + LOGFS_BLOCKS_PER_RECORD * 2))
+#define LOGFS_LINK_SIZE             (sizeof(struct logfs_record) + LOGFS_ALIGN(sizeof(struct logfs_rec_link)))
+
+/* the block types */
+enum
+{
+    LOGFS_BLOCK_META = 1,
+    LOGFS_BLOCK_DATA = 2,
+};
+
+/* the record types of meta log */
+enum
+{
+    LOGFS_REC_CKPT = 1,             /* the end of checkpoint */
+    LOGFS_REC_NAME,                 /* create or rename file */
+    LOGFS_REC_BLOCKS,               /* the size and blocks of file */
+    LOGFS_REC_DELETE,               /* remove file */
+    LOGFS_REC_LINK,                 /* the next block of meta chain */
+    LOGFS_REC_ERASED = 0xFF,
+};
+
+/* the header at the beginning of meta block and data block */
+struct logfs_block_header
+{
+    rt_uint32_t magic;
+    rt_uint32_t erase_count;
+    rt_uint32_t seq;                /* the sequence of meta chain */
+    rt_uint8_t  type;
+    rt_uint8_t  reserved;
+    rt_uint16_t check;              /* the low 16 bits of CRC */
+};
+
+struct logfs_anchor
+{
+    rt_uint32_t magic;
+    rt_uint32_t seq;                /* the sequence of meta chain */
+    rt_uint16_t block;              /* the first block of meta chain */
+    rt_uint16_t reserved;
+    rt_uint32_t crc;
+};
+
+struct logfs_record
+{
+    rt_uint8_t  type;
+    rt_uint8_t  reserved;
+    rt_uint16_t length;             /* the length of payload */
+    rt_uint32_t crc;                /* the CRC of type, length and payload */
+};
+
+struct logfs_rec_ckpt
+{
+    rt_uint16_t next_id;
+    rt_uint16_t cursor;
+};
+
+struct logfs_rec_name
+{
+    rt_uint16_t id;
+    char name[RT_DFS_LOGFS_NAME_MAX];
+};
+
+struct logfs_rec_blocks
+{
+    rt_uint16_t id;
+    rt_uint16_t start;              /* the index of first block in record */
+    rt_uint32_t size;
+    rt_uint16_t blocks[LOGFS_BLOCKS_PER_RECORD];
+};
+
+struct logfs_rec_delete
+{
+    rt_uint16_t id;
+};
+
+struct logfs_rec_link
+{
+    rt_uint16_t block;
+};
+
+struct logfs_inode
+{
+    struct logfs *fs;
+    rt_uint16_t id;                 /* 0 for unused inode */
+    rt_uint16_t ref_count;          /* the opened files */
+
+    rt_uint32_t size;
+    rt_uint16_t *blocks;
+    rt_uint16_t nblocks;
+    rt_uint16_t capacity;           /* the capacity of blocks */
+    rt_uint16_t synced;             /* the blocks which are recorded in meta log */
+    rt_uint8_t  dirty;              /* the size or blocks are not recorded */
+    rt_uint8_t  tail_clean;         /* the rest of last block is erased */
+
+    char name[RT_DFS_LOGFS_NAME_MAX + 1];
+};
+
+struct logfs
+{
+    struct rt_mtd_nor_device *mtd;
+    struct rt_mutex lock;
+    rt_slist_t list;
+
+    rt_uint32_t block_size;
+    rt_uint16_t block_count;
+    rt_uint16_t free_count;
+    rt_uint8_t *bitmap;             /* the used blocks */
+    rt_uint8_t *buf;                /* the buffer of one block */
+
+    rt_uint8_t  anchor;             /* the active anchor block */
+    rt_uint32_t anchor_pos;         /* the next anchor in active block */
+    rt_uint32_t seq;                /* the sequence of meta chain */
+
+    rt_uint16_t *chain;             /* the blocks of meta chain */
+    rt_uint16_t chain_count;
+    rt_uint16_t chain_capacity;
+    rt_uint16_t ckpt_blocks;        /* the blocks of checkpoint in chain */
+    rt_uint32_t meta_pos;           /* the next record in last block of chain */
+    rt_uint16_t ckpt_retry;         /* the chain length to retry a failed checkpoint */
+
+    rt_uint16_t next_id;
+    rt_uint16_t cursor;             /* the next block to allocate */
+    rt_uint16_t wl_cursor;          /* the next block to move for wear leveling */
+    rt_uint32_t alloc_count;
+    rt_uint32_t erase_hint;         /* the erase count of last allocated block */
+
+    struct logfs_inode inodes[RT_DFS_LOGFS_FILES_MAX];
+    rt_uint8_t rec[LOGFS_RECORD_MAX];
+
+    struct dfs_logfs_stat stat;
+};
+
+static rt_slist_t _logfs_list = RT_SLIST_OBJECT_INIT(_logfs_list);
+
+static rt_uint32_t logfs_crc32(rt_uint32_t crc, const void *buf, rt_size_t len)
+{
+    static const rt_uint32_t table[16] =
+    {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+        0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+    const rt_uint8_t *data = (const rt_uint8_t *)buf;
+
+    crc = ~crc;
+    while (len--)
+    {
+        crc = (crc >> 4) ^ table[(crc ^ *data) & 0x0f];
+        crc = (crc >> 4) ^ table[(crc ^ (*data >> 4)) & 0x0f];
+        data++;
+    }
+
+    return ~crc;
+}
+
+static rt_bool_t logfs_erased(const void *buf, rt_size_t len)
+{
+    const rt_uint8_t *data = (const rt_uint8_t *)buf;
+
+    while (len--)
+    {
+        if (*data++ != 0xFF)
+            return RT_FALSE;
+    }
+
+    return RT_TRUE;
+}
+
+/* the data bytes in one block */
+rt_inline rt_uint32_t logfs_usable(struct logfs *fs)
+{
+    return fs->block_size - sizeof(struct logfs_block_header);
+}
+
+rt_inline rt_uint16_t logfs_blocks_of(struct logfs *fs, rt_uint32_t size)
+{
+    return (size + logfs_usable(fs) - 1) / logfs_usable(fs);
+}
+
+static int logfs_read(struct logfs *fs, rt_uint16_t block, rt_uint32_t offset, void *buf, rt_uint32_t len)
+{
+    if (rt_mtd_nor_read(fs->mtd, block * fs->block_size + offset, (rt_uint8_t *)buf, len) != len)
+        return -EIO;
+
+    return 0;
+}
+
+static int logfs_prog(struct logfs *fs, rt_uint16_t block, rt_uint32_t offset, const void *buf, rt_uint32_t len)
+{
+    if (rt_mtd_nor_write(fs->mtd, block * fs->block_size + offset, (const rt_uint8_t *)buf, len) != len)
+        return -EIO;
+
+    fs->stat.prog_bytes += len;
+
+    return 0;
+}
+
+static int logfs_erase(struct logfs *fs, rt_uint16_t block)
+{
+    if (rt_mtd_nor_erase_block(fs->mtd, block * fs->block_size, fs->block_size) != RT_EOK)
+        return -EIO;
+
+    fs->stat.erases++;
+
+    return 0;
+}
+
+rt_inline rt_bool_t logfs_used(struct logfs *fs, rt_uint16_t block)
+{
+    return (fs->bitmap[block >> 3] & (1 << (block & 0x07))) != 0;
+}
+
+static void logfs_mark(struct logfs *fs, rt_uint16_t block)
+{
+    RT_ASSERT(!logfs_used(fs, block));
+
+    fs->bitmap[block >> 3] |= 1 << (block & 0x07);
+    fs->free_count--;
+}
+
+static void logfs_release(struct logfs *fs, rt_uint16_t block)
+{
+    RT_ASSERT(logfs_used(fs, block));
+
+    fs->bitmap[block >> 3] &= ~(1 << (block & 0x07));
+    fs->free_count++;
+}
+
+static rt_uint16_t logfs_header_check(const struct logfs_block_header *header)
+{
+    return logfs_crc32(0, header, sizeof(struct logfs_block_header) - sizeof(rt_uint16_t)) & 0xFFFF;
+}
+
+/* allocate a block at cursor, it's erased and the header is written */
+static int logfs_alloc(struct logfs *fs, rt_uint8_t type, rt_uint16_t *block)
+{
+    struct logfs_block_header header;
+    rt_uint16_t index, pool;
+    int result;
+
+    /* keep the blocks for the next checkpoint */
+    if (type == LOGFS_BLOCK_DATA && fs->free_count <= fs->ckpt_blocks + 1)
+        return -ENOSPC;
+
+    pool = fs->block_count - LOGFS_ANCHOR_BLOCKS;
+    for (index = 0; index < pool; index++)
+    {
+        *block = fs->cursor;
+        fs->cursor = fs->cursor + 1 < fs->block_count ? fs->cursor + 1 : LOGFS_ANCHOR_BLOCKS;
+        if (!logfs_used(fs, *block))
+            break;
+    }
+    if (index == pool)
+        return -ENOSPC;
+
+    /* keep the erase count in header */
+    result = logfs_read(fs, *block, 0, &header, sizeof(header));
+    if (result < 0)
+        return result;
+    if (header.magic == LOGFS_MAGIC && header.check == logfs_header_check(&header))
+        fs->erase_hint = header.erase_count + 1;
+
+    result = logfs_erase(fs, *block);
+    if (result < 0)
+        return result;
+
+    header.magic = LOGFS_MAGIC;
+    header.erase_count = fs->erase_hint;
+    header.seq = type == LOGFS_BLOCK_META ? fs->seq : 0;
+    header.type = type;
+    header.reserved = 0xFF;
+    header.check = logfs_header_check(&header);
+    result = logfs_prog(fs, *block, 0, &header, sizeof(header));
+    if (result < 0)
+        return result;
+
+    logfs_mark(fs, *block);
+    fs->alloc_count++;
+
+    return 0;
+}
+
+/* write a record at the end of meta log, there must be room for it */
+static int logfs_record_prog(struct logfs *fs, rt_uint8_t type, const void *payload, rt_uint16_t length)
+{
+    struct logfs_record *record = (struct logfs_record *)fs->rec;
+    rt_uint32_t size;
+    int result;
+
+    size = sizeof(struct logfs_record) + LOGFS_ALIGN(length);
+    RT_ASSERT(size <= sizeof(fs->rec));
+
+    rt_memset(fs->rec, 0xFF, size);
+    record->type = type;
+    record->reserved = 0xFF;
+    record->length = length;
+    rt_memcpy(record + 1, payload, length);
+    record->crc = logfs_crc32(0, record, sizeof(rt_uint32_t));
+    record->crc = logfs_crc32(record->crc, record + 1, length);
+
+    result = logfs_prog(fs, fs->chain[fs->chain_count - 1], fs->meta_pos, fs->rec, size);
+    if (result < 0)
+        return result;
+
+    fs->meta_pos += size;
+    fs->stat.meta_bytes += size;
+
+    return 0;
+}
+
+static int logfs_chain_append(struct logfs *fs, rt_uint16_t block)
+{
+    rt_uint16_t *chain;
+
+    if (fs->chain_count == fs->chain_capacity)
+    {
+        chain = (rt_uint16_t *)rt_realloc(fs->chain, (fs->chain_capacity + 4) * sizeof(rt_uint16_t));
+        if (chain == RT_NULL)
+            return -ENOMEM;
+
+        fs->chain = chain;
+        fs->chain_capacity += 4;
+    }
+    fs->chain[fs->chain_count++] = block;
+
+    return 0;
+}
+
+/* append a record to meta log, the chain is extended when the block is full */
+static int logfs_meta_write(struct logfs *fs, rt_uint8_t type, const void *payload, rt_uint16_t length)
+{
+    struct logfs_rec_link link;
+    int result;
+
+    if (fs->meta_pos + sizeof(struct logfs_record) + LOGFS_ALIGN(length) + LOGFS_LINK_SIZE > fs->block_size)
+    {
+        result = logfs_chain_append(fs, LOGFS_BLOCK_NONE);
+        if (result < 0)
+            return result;
+        fs->chain_count--;
+
+        /* the next block is ready before it's linked */
+        result = logfs_alloc(fs, LOGFS_BLOCK_META, &(link.block));
+        if (result < 0)
+            return result;
+
+        result = logfs_record_prog(fs, LOGFS_REC_LINK, &link, sizeof(link));
+        if (result < 0)
+        {
+            logfs_release(fs, link.block);
+            return result;
+        }
+
+        fs->chain[fs->chain_count++] = link.block;
+        fs->meta_pos = sizeof(struct logfs_block_header);
+    }
+
+    return logfs_record_prog(fs, type, payload, length);
+}
+
+/* record the size and the blocks from start of file */
+static int logfs_commit(struct logfs *fs, struct logfs_inode *inode, rt_uint16_t start)
+{
+    struct logfs_rec_blocks rec;
+    rt_uint16_t count;
+    int result;
+
+    if (start > inode->synced)
+        start = inode->synced;
+
+    do
+    {
+        count = inode->nblocks > start ? inode->nblocks - start : 0;
+        if (count > LOGFS_BLOCKS_PER_RECORD)
+            count = LOGFS_BLOCKS_PER_RECORD;
+
+        rec.id = inode->id;
+        rec.start = start;
+        rec.size = inode->size;
+        rt_memcpy(rec.blocks, inode->blocks + start, count * sizeof(rt_uint16_t));
+        result = logfs_meta_write(fs, LOGFS_REC_BLOCKS, &rec,
+                                  sizeof(rec) - sizeof(rec.blocks) + count * sizeof(rt_uint16_t));
+        if (result < 0)
+            return result;
+
+        start += count;
+    } while (start < inode->nblocks);
+
+    inode->synced = inode->nblocks;
+    inode->dirty = 0;
+
+    return 0;
+}
+
+static int logfs_record_name(struct logfs *fs, struct logfs_inode *inode)
+{
+    struct logfs_rec_name rec;
+    rt_size_t length;
+
+    length = rt_strlen(inode->name);
+    rec.id = inode->id;
+    rt_memcpy(rec.name, inode->name, length);
+
+    return logfs_meta_write(fs, LOGFS_REC_NAME, &rec, sizeof(rec.id) + length);
+}
+
+static int logfs_anchor_write(struct logfs *fs, rt_uint32_t seq, rt_uint16_t block)
+{
+    struct logfs_anchor anchor;
+    int result;
+
+    if (fs->anchor_pos + sizeof(anchor) > fs->block_size)
+    {
+        /* the active anchor is kept until the other one is written */
+        result = logfs_erase(fs, !fs->anchor);
+        if (result < 0)
+            return result;
+
+        fs->anchor = !fs->anchor;
+        fs->anchor_pos = 0;
+    }
+
+    anchor.magic = LOGFS_MAGIC;
+    anchor.seq = seq;
+    anchor.block = block;
+    anchor.reserved = 0xFFFF;
+    anchor.crc = logfs_crc32(0, &anchor, sizeof(anchor) - sizeof(anchor.crc));
+
+    result = logfs_prog(fs, fs->anchor, fs->anchor_pos, &anchor, sizeof(anchor));
+    fs->anchor_pos += sizeof(anchor);
+
+    return result;
+}
+
+/* write all of files to a new meta chain, and release the old one */
+static int logfs_checkpoint(struct logfs *fs)
+{
+    struct logfs_rec_ckpt ckpt;
+    struct logfs_inode *inode;
+    rt_uint16_t *old_chain, old_count, block;
+    rt_uint32_t old_pos;
+    int index, result;
+
+    old_chain = fs->chain;
+    old_count = fs->chain_count;
+    old_pos = fs->meta_pos;
+    fs->chain = RT_NULL;
+    fs->chain_count = 0;
+    fs->chain_capacity = 0;
+
+    fs->seq++;
+    result = logfs_alloc(fs, LOGFS_BLOCK_META, &block);
+    if (result < 0)
+        goto __exit;
+    result = logfs_chain_append(fs, block);
+    if (result < 0)
+    {
+        logfs_release(fs, block);
+        goto __exit;
+    }
+    fs->meta_pos = sizeof(struct logfs_block_header);
+
+    for (index = 0; index < RT_DFS_LOGFS_FILES_MAX; index++)
+    {
+        inode = &(fs->inodes[index]);
+        if (inode->id == 0)
+            continue;
+
+        inode->synced = 0;
+        result = logfs_record_name(fs, inode);
+        if (result == 0)
+            result = logfs_commit(fs, inode, 0);
+        if (result < 0)
+            goto __exit;
+    }
+
+    ckpt.next_id = fs->next_id;
+    ckpt.cursor = fs->cursor;
+    result = logfs_meta_write(fs, LOGFS_REC_CKPT, &ckpt, sizeof(ckpt));
+    if (result == 0)
+        result = logfs_anchor_write(fs, fs->seq, fs->chain[0]);
+
+__exit:
+    if (result < 0)
+    {
+        /* go on with the old chain */
+        for (index = 0; index < fs->chain_count; index++)
+            logfs_release(fs, fs->chain[index]);
+        rt_free(fs->chain);
+
+        fs->seq--;
+        fs->chain = old_chain;
+        fs->chain_count = old_count;
+        fs->chain_capacity = old_count;
+        fs->meta_pos = old_pos;
+        for (index = 0; index < RT_DFS_LOGFS_FILES_MAX; index++)
+        {
+            inode = &(fs->inodes[index]);
+            if (inode->id != 0)
+            {
+                inode->synced = 0;
+                inode->dirty = 1;
+            }
+        }
+
+        /* don't erase a new block on each operation until the journal grows */
+        fs->ckpt_retry = old_count + 1;
+
+        return result;
+    }
+
+    for (index = 0; index < old_count; index++)
+        logfs_release(fs, old_chain[index]);
+    rt_free(old_chain);
+
+    fs->ckpt_blocks = fs->chain_count;
+    fs->ckpt_retry = 0;
+    fs->stat.checkpoints++;
+
+    return 0;
+}
+
+/* write a new checkpoint when the journal is too long */
+static void logfs_meta_check(struct logfs *fs)
+{
+    if (fs->chain_count > fs->ckpt_blocks + RT_DFS_LOGFS_JOURNAL_BLOCKS &&
+        fs->chain_count >= fs->ckpt_retry)
+    {
+        logfs_checkpoint(fs);
+    }
+}
+
+static int logfs_inode_resize(struct logfs_inode *inode, rt_uint16_t nblocks)
+{
+    rt_uint16_t *blocks;
+
+    if (nblocks > inode->capacity)
+    {
+        blocks = (rt_uint16_t *)rt_realloc(inode->blocks, (nblocks + 8) * sizeof(rt_uint16_t));
+        if (blocks == RT_NULL)
+            return -ENOMEM;
+
+        inode->blocks = blocks;
+        inode->capacity = nblocks + 8;
+    }
+
+    while (inode->nblocks < nblocks)
+        inode->blocks[inode->nblocks++] = LOGFS_BLOCK_NONE;
+    inode->nblocks = nblocks;
+
+    return 0;
+}
+
+static void logfs_inode_free(struct logfs_inode *inode)
+{
+    rt_free(inode->blocks);
+    rt_memset(inode, 0, sizeof(struct logfs_inode));
+}
+
+static struct logfs_inode *logfs_inode_find(struct logfs *fs, const char *name)
+{
+    int index;
+
+    for (index = 0; index < RT_DFS_LOGFS_FILES_MAX; index++)
+    {
+        if (fs->inodes[index].id != 0 && rt_strcmp(fs->inodes[index].name, name) == 0)
+            return &(fs->inodes[index]);
+    }
+
+    return RT_NULL;
+}
+
+static struct logfs_inode *logfs_inode_get(struct logfs *fs, rt_uint16_t id, rt_bool_t create)
+{
+    struct logfs_inode *inode = RT_NULL;
+    int index;
+
+    for (index = 0; index < RT_DFS_LOGFS_FILES_MAX; index++)
+    {
+        if (fs->inodes[index].id == id)
+            return &(fs->inodes[index]);
+        if (fs->inodes[index].id == 0 && inode == RT_NULL)
+            inode = &(fs->inodes[index]);
+    }
+
+    if (!create || inode == RT_NULL)
+        return RT_NULL;
+
+    rt_memset(inode, 0, sizeof(struct logfs_inode));
+    inode->fs = fs;
+    inode->id = id;
+
+    return inode;
+}
+
+/* copy the block of file to a new block, and write data to it */
+static int logfs_block_cow(struct logfs *fs, struct logfs_inode *inode, rt_uint16_t index,
+                           rt_uint32_t offset, const void *data, rt_uint32_t len)
+{
+    rt_uint32_t valid, base;
+    rt_uint16_t old, block;
+    int result;
+
+    base = index * logfs_usable(fs);
+    valid = inode->size - base < logfs_usable(fs) ? inode->size - base : logfs_usable(fs);
+    old = inode->blocks[index];
+
+    result = logfs_read(fs, old, sizeof(struct logfs_block_header), fs->buf, valid);
+    if (result < 0)
+        return result;
+    if (len > 0)
+        rt_memcpy(fs->buf + offset, data, len);
+    if (offset + len > valid)
+        valid = offset + len;
+
+    result = logfs_alloc(fs, LOGFS_BLOCK_DATA, &block);
+    if (result < 0)
+        return result;
+    result = logfs_prog(fs, block, sizeof(struct logfs_block_header), fs->buf, valid);
+    if (result < 0)
+    {
+        logfs_release(fs, block);
+        return result;
+    }
+
+    /* the old block is released after the new one is recorded */
+    inode->blocks[index] = block;
+    result = logfs_commit(fs, inode, index);
+    if (result < 0)
+    {
+        inode->blocks[index] = old;
+        logfs_release(fs, block);
+        return result;
+    }
+    logfs_release(fs, old);
+
+    if (index == inode->nblocks - 1)
+        inode->tail_clean = 1;
+
+    return 0;
+}
+
+/* the rest of last block may be programmed by the write before power loss */
+static int logfs_tail_check(struct logfs *fs, struct logfs_inode *inode)
+{
+    rt_uint32_t valid;
+    rt_uint16_t index;
+    int result;
+
+    index = inode->nblocks - 1;
+    valid = inode->size - index * logfs_usable(fs);
+
+    result = logfs_read(fs, inode->blocks[index], sizeof(struct logfs_block_header) + valid,
+                        fs->buf, logfs_usable(fs) - valid);
+    if (result < 0)
+        return result;
+
+    if (logfs_erased(fs->buf, logfs_usable(fs) - valid))
+    {
+        inode->tail_clean = 1;
+        return 0;
+    }
+
+    return logfs_block_cow(fs, inode, index, valid, RT_NULL, 0);
+}
+
+/* move the next data block to a new block for wear leveling, so the cold blocks are erased too */
+static void logfs_wear_level(struct logfs *fs)
+{
+    struct logfs_inode *inode;
+    rt_uint16_t block, index, count;
+    int node;
+
+    if (RT_DFS_LOGFS_WL_INTERVAL == 0 || fs->alloc_count < RT_DFS_LOGFS_WL_INTERVAL)
+        return;
+    fs->alloc_count = 0;
+
+    for (count = fs->block_count - LOGFS_ANCHOR_BLOCKS; count > 0; count--)
+    {
+        block = fs->wl_cursor;
+        fs->wl_cursor = block + 1 < fs->block_count ? block + 1 : LOGFS_ANCHOR_BLOCKS;
+        if (!logfs_used(fs, block))
+            continue;
+
+        for (node = 0; node < RT_DFS_LOGFS_FILES_MAX; node++)
+        {
+            inode = &(fs->inodes[node]);
+            if (inode->id == 0)
+                continue;
+
+            for (index = 0; index < inode->nblocks; index++)
+            {
+                if (inode->blocks[index] == block)
+                {
+                    if (logfs_block_cow(fs, inode, index, 0, RT_NULL, 0) == 0)
+                        fs->stat.migrations++;
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static int logfs_file_write(struct logfs *fs, struct logfs_inode *inode, rt_uint32_t pos,
+                            const void *data, rt_size_t len)
+{
+    rt_uint32_t offset, valid, size;
+    rt_uint16_t index, block;
+    rt_size_t written = 0;
+    int result = 0;
+
+    while (len > 0)
+    {
+        index = pos / logfs_usable(fs);
+        offset = pos % logfs_usable(fs);
+        size = logfs_usable(fs) - offset < len ? logfs_usable(fs) - offset : len;
+
+        if (index < inode->nblocks)
+        {
+            valid = inode->size - index * logfs_usable(fs);
+            if (offset < valid)
+            {
+                /* overwrite the data */
+                result = logfs_block_cow(fs, inode, index, offset, data, size);
+            }
+            else
+            {
+                /* append to the last block */
+                if (!inode->tail_clean)
+                    result = logfs_tail_check(fs, inode);
+                if (result == 0)
+                    result = logfs_prog(fs, inode->blocks[index], sizeof(struct logfs_block_header) + offset,
+                                        data, size);
+            }
+        }
+        else
+        {
+            /* it will be recorded by fsync or close */
+            result = logfs_inode_resize(inode, inode->nblocks + 1);
+            if (result == 0)
+            {
+                result = logfs_alloc(fs, LOGFS_BLOCK_DATA, &block);
+                if (result < 0)
+                    inode->nblocks--;
+            }
+            if (result == 0)
+            {
+                inode->blocks[index] = block;
+                inode->tail_clean = 1;
+                result = logfs_prog(fs, block, sizeof(struct logfs_block_header), data, size);
+            }
+        }
+
+        if (result < 0)
+            break;
+
+        pos += size;
+        data = (const rt_uint8_t *)data + size;
+        len -= size;
+        written += size;
+        if (pos > inode->size)
+        {
+            inode->size = pos;
+            inode->dirty = 1;
+        }
+
+        logfs_wear_level(fs);
+    }
+
+    /* drop the block which is allocated for the failed write */
+    if (inode->nblocks > logfs_blocks_of(fs, inode->size))
+    {
+        logfs_release(fs, inode->blocks[--inode->nblocks]);
+    }
+    fs->stat.user_bytes += written;
+
+    return written > 0 ? (int)written : result;
+}
+
+static int logfs_file_fill(struct logfs *fs, struct logfs_inode *inode, rt_uint32_t length)
+{
+    static const rt_uint8_t zero[32] = {0};
+    rt_uint32_t size;
+    int result;
+
+    while (inode->size < length)
+    {
+        size = length - inode->size < sizeof(zero) ? length - inode->size : sizeof(zero);
+        result = logfs_file_write(fs, inode, inode->size, zero, size);
+        if (result < 0)
+            return result;
+    }
+
+    return 0;
+}
+
+static int logfs_truncate(struct logfs *fs, struct logfs_inode *inode, rt_uint32_t length)
+{
+    rt_uint16_t nblocks, old;
+    int result;
+
+    if (length >= inode->size)
+        return logfs_file_fill(fs, inode, length);
+
+    old = inode->nblocks;
+    nblocks = logfs_blocks_of(fs, length);
+
+    inode->size = length;
+    inode->nblocks = nblocks;
+    result = logfs_commit(fs, inode, nblocks);
+    if (result < 0)
+        return result;
+
+    /* the rest of last block has been programmed */
+    if (length % logfs_usable(fs))
+        inode->tail_clean = 0;
+
+    while (old > nblocks)
+        logfs_release(fs, inode->blocks[--old]);
+
+    return 0;
+}
+
+static int logfs_remove(struct logfs *fs, struct logfs_inode *inode)
+{
+    struct logfs_rec_delete rec;
+    int result;
+
+    rec.id = inode->id;
+    result = logfs_meta_write(fs, LOGFS_REC_DELETE, &rec, sizeof(rec));
+    if (result < 0)
+        return result;
+
+    while (inode->nblocks > 0)
+        logfs_release(fs, inode->blocks[--inode->nblocks]);
+    logfs_inode_free(inode);
+
+    return 0;
+}
+
+static int logfs_replay_record(struct logfs *fs, struct logfs_record *record)
+{
+    struct logfs_rec_name *name;
+    struct logfs_rec_blocks *blocks;
+    struct logfs_rec_ckpt *ckpt;
+    struct logfs_inode *inode;
+    rt_uint16_t index, count;
+    int result;
+
+    switch (record->type)
+    {
+    case LOGFS_REC_CKPT:
+        ckpt = (struct logfs_rec_ckpt *)(record + 1);
+        fs->next_id = ckpt->next_id;
+        fs->cursor = ckpt->cursor;
+        fs->ckpt_blocks = fs->chain_count;
+        break;
+
+    case LOGFS_REC_NAME:
+        name = (struct logfs_rec_name *)(record + 1);
+        if (record->length <= sizeof(name->id) || record->length > sizeof(struct logfs_rec_name))
+            return -EIO;
+
+        inode = logfs_inode_get(fs, name->id, RT_TRUE);
+        if (inode == RT_NULL)
+            return -ENOSPC;
+        rt_memcpy(inode->name, name->name, record->length - sizeof(name->id));
+        inode->name[record->length - sizeof(name->id)] = '\0';
+        if (name->id >= fs->next_id)
+            fs->next_id = name->id + 1;
+        break;
+
+    case LOGFS_REC_BLOCKS:
+        blocks = (struct logfs_rec_blocks *)(record + 1);
+        inode = logfs_inode_get(fs, blocks->id, RT_FALSE);
+        if (inode == RT_NULL)
+            return -EIO;
+
+        inode->size = blocks->size;
+        result = logfs_inode_resize(inode, logfs_blocks_of(fs, blocks->size));
+        if (result < 0)
+            return result;
+
+        count = (record->length - (sizeof(struct logfs_rec_blocks) - sizeof(blocks->blocks))) / sizeof(rt_uint16_t);
+        for (index = 0; index < count && blocks->start + index < inode->nblocks; index++)
+        {
+            inode->blocks[blocks->start + index] = blocks->blocks[index];
+        }
+        break;
+
+    case LOGFS_REC_DELETE:
+        inode = logfs_inode_get(fs, ((struct logfs_rec_delete *)(record + 1))->id, RT_FALSE);
+        if (inode != RT_NULL)
+            logfs_inode_free(inode);
+        break;
+
+    default:
+        break;
+    }
+
+    return 0;
+}
+
+/* read the meta chain from block, returns 1 when the end of log is not clean */
+static int logfs_replay(struct logfs *fs, rt_uint16_t block)
+{
+    struct logfs_block_header *header;
+    struct logfs_record *record;
+    rt_uint32_t pos, size;
+    int result;
+
+    while (1)
+    {
+        if (block < LOGFS_ANCHOR_BLOCKS || block >= fs->block_count)
+            return -EIO;
+
+        result = logfs_read(fs, block, 0, fs->buf, fs->block_size);
+        if (result < 0)
+            return result;
+
+        header = (struct logfs_block_header *)fs->buf;
+        if (header->magic != LOGFS_MAGIC || header->check != logfs_header_check(header) ||
+            header->type != LOGFS_BLOCK_META || header->seq != fs->seq)
+            return -EIO;
+        fs->erase_hint = header->erase_count;
+
+        result = logfs_chain_append(fs, block);
+        if (result < 0)
+            return result;
+
+        pos = sizeof(struct logfs_block_header);
+        while (1)
+        {
+            fs->meta_pos = pos;
+            if (pos + sizeof(struct logfs_record) > fs->block_size)
+                return 0;
+
+            record = (struct logfs_record *)(fs->buf + pos);
+            if (record->type == LOGFS_REC_ERASED)
+            {
+                return logfs_erased(fs->buf + pos, fs->block_size - pos) ? 0 : 1;
+            }
+
+            /* the torn record of power loss */
+            size = sizeof(struct logfs_record) + LOGFS_ALIGN(record->length);
+            if (pos + size > fs->block_size ||
+                record->crc != logfs_crc32(logfs_crc32(0, record, sizeof(rt_uint32_t)), record + 1, record->length))
+                return 1;
+
+            if (record->type == LOGFS_REC_LINK)
+            {
+                block = ((struct logfs_rec_link *)(record + 1))->block;
+                break;
+            }
+
+            result = logfs_replay_record(fs, record);
+            if (result < 0)
+                return result;
+            pos += size;
+        }
+    }
+}
+
+static int logfs_anchor_load(struct logfs *fs, rt_uint16_t *block)
+{
+    struct logfs_anchor *anchor;
+    rt_uint32_t pos, end[LOGFS_ANCHOR_BLOCKS];
+    rt_bool_t found = RT_FALSE;
+    int index, result;
+
+    for (index = 0; index < LOGFS_ANCHOR_BLOCKS; index++)
+    {
+        result = logfs_read(fs, index, 0, fs->buf, fs->block_size);
+        if (result < 0)
+            return result;
+
+        end[index] = 0;
+        for (pos = 0; pos + sizeof(struct logfs_anchor) <= fs->block_size; pos += sizeof(struct logfs_anchor))
+        {
+            /* a failed write leaves an erased anchor before the next one */
+            anchor = (struct logfs_anchor *)(fs->buf + pos);
+            if (logfs_erased(anchor, sizeof(struct logfs_anchor)))
+                continue;
+
+            end[index] = pos + sizeof(struct logfs_anchor);
+            if (anchor->magic != LOGFS_MAGIC ||
+                anchor->crc != logfs_crc32(0, anchor, sizeof(struct logfs_anchor) - sizeof(anchor->crc)))
+                continue;
+
+            if (!found || anchor->seq > fs->seq)
+            {
+                found = RT_TRUE;
+                fs->seq = anchor->seq;
+                fs->anchor = index;
+                *block = anchor->block;
+            }
+        }
+    }
+
+    if (!found)
+        return -EIO;
+
+    fs->anchor_pos = end[fs->anchor];
+
+    return 0;
+}
+
+static int logfs_load(struct logfs *fs)
+{
+    struct logfs_inode *inode;
+    rt_uint16_t block, index;
+    int node, result;
+
+    result = logfs_anchor_load(fs, &block);
+    if (result < 0)
+        return result;
+
+    fs->next_id = 1;
+    fs->cursor = LOGFS_ANCHOR_BLOCKS;
+    result = logfs_replay(fs, block);
+    if (result < 0)
+        return result;
+
+    /* build the bitmap of used blocks */
+    fs->free_count = fs->block_count;
+    logfs_mark(fs, 0);
+    logfs_mark(fs, 1);
+    for (index = 0; index < fs->chain_count; index++)
+    {
+        if (logfs_used(fs, fs->chain[index]))
+            return -EIO;
+        logfs_mark(fs, fs->chain[index]);
+    }
+
+    for (node = 0; node < RT_DFS_LOGFS_FILES_MAX; node++)
+    {
+        inode = &(fs->inodes[node]);
+        if (inode->id == 0)
+            continue;
+
+        for (index = 0; index < inode->nblocks; index++)
+        {
+            block = inode->blocks[index];
+            if (block < LOGFS_ANCHOR_BLOCKS || block >= fs->block_count || logfs_used(fs, block))
+            {
+                /* the blocks are partly recorded before power loss */
+                inode->size = index * logfs_usable(fs);
+                inode->nblocks = index;
+                inode->dirty = 1;
+                break;
+            }
+            logfs_mark(fs, block);
+        }
+        inode->synced = inode->dirty ? 0 : inode->nblocks;
+    }
+
+    if (fs->cursor < LOGFS_ANCHOR_BLOCKS || fs->cursor >= fs->block_count)
+        fs->cursor = LOGFS_ANCHOR_BLOCKS;
+
+    /* don't append to the torn record */
+    if (result == 1 || fs->meta_pos + LOGFS_LINK_SIZE > fs->block_size)
+    {
+        result = logfs_checkpoint(fs);
+        if (result < 0)
+            return result;
+    }
+
+    for (node = 0; node < RT_DFS_LOGFS_FILES_MAX; node++)
+    {
+        if (fs->inodes[node].dirty)
+            logfs_commit(fs, &(fs->inodes[node]), 0);
+    }
+
+    return 0;
+}
+
+static int logfs_format(struct logfs *fs)
+{
+    rt_uint16_t index;
+    int result;
+
+    for (index = 0; index < LOGFS_ANCHOR_BLOCKS; index++)
+    {
+        result = logfs_erase(fs, index);
+        if (result < 0)
+            return result;
+    }
+
+    fs->anchor = 0;
+    fs->anchor_pos = 0;
+    fs->seq = 0;
+    fs->next_id = 1;
+    fs->cursor = LOGFS_ANCHOR_BLOCKS;
+    fs->erase_hint = 1;
+
+    fs->free_count = fs->block_count;
+    logfs_mark(fs, 0);
+    logfs_mark(fs, 1);
+
+    return logfs_checkpoint(fs);
+}
+
+static struct logfs *logfs_create(rt_device_t dev_id)
+{
+    struct rt_mtd_nor_device *mtd;
+    struct logfs *fs;
+
+    if (dev_id == RT_NULL || dev_id->type != RT_Device_Class_MTD)
+        return RT_NULL;
+
+    mtd = RT_MTD_NOR_DEVICE(dev_id);
+    if (mtd->block_end - mtd->block_start <= LOGFS_ANCHOR_BLOCKS + 2 ||
+        mtd->block_end - mtd->block_start >= LOGFS_BLOCK_NONE ||
+        mtd->block_size < 512)
+        return RT_NULL;
+
+    fs = (struct logfs *)rt_malloc(sizeof(struct logfs));
+    if (fs == RT_NULL)
+        return RT_NULL;
+
+    rt_memset(fs, 0, sizeof(struct logfs));
+    fs->mtd = mtd;
+    fs->block_size = mtd->block_size;
+    fs->block_count = mtd->block_end - mtd->block_start;
+    fs->wl_cursor = LOGFS_ANCHOR_BLOCKS;
+    fs->bitmap = (rt_uint8_t *)rt_malloc((fs->block_count + 7) / 8);
+    fs->buf = (rt_uint8_t *)rt_malloc(fs->block_size);
+    if (fs->bitmap == RT_NULL || fs->buf == RT_NULL)
+    {
+        rt_free(fs->bitmap);
+        rt_free(fs->buf);
+        rt_free(fs);
+        return RT_NULL;
+    }
+    rt_memset(fs->bitmap, 0, (fs->block_count + 7) / 8);
+    rt_mutex_init(&(fs->lock), "logfs", RT_IPC_FLAG_FIFO);
+    rt_slist_init(&(fs->list));
+
+    return fs;
+}
+
+static void logfs_destroy(struct logfs *fs)
+{
+    int index;
+
+    for (index = 0; index < RT_DFS_LOGFS_FILES_MAX; index++)
+        rt_free(fs->inodes[index].blocks);
+
+    rt_mutex_detach(&(fs->lock));
+    rt_free(fs->chain);
+    rt_free(fs->bitmap);
+    rt_free(fs->buf);
+    rt_free(fs);
+}
+
+static const char *logfs_name(const char *path)
+{
+    while (*path == '/')
+        path++;
+
+    return path;
+}
+
+static int dfs_logfs_mount(struct dfs_filesystem *fs, unsigned long rwflag, const void *data)
+{
+    struct logfs *lfs;
+    rt_base_t level;
+    int result;
+
+    lfs = logfs_create(fs->dev_id);
+    if (lfs == RT_NULL)
+        return -EINVAL;
+
+    result = logfs_load(lfs);
+    if (result < 0)
+    {
+        logfs_destroy(lfs);
+        return result;
+    }
+
+    level = rt_hw_interrupt_disable();
+    rt_slist_append(&_logfs_list, &(lfs->list));
+    rt_hw_interrupt_enable(level);
+
+    fs->data = lfs;
+
+    return RT_EOK;
+}
+
+static int dfs_logfs_unmount(struct dfs_filesystem *fs)
+{
+    struct logfs *lfs = (struct logfs *)fs->data;
+    rt_base_t level;
+    int index;
+
+    rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+    for (index = 0; index < RT_DFS_LOGFS_FILES_MAX; index++)
+    {
+        if (lfs->inodes[index].dirty)
+            logfs_commit(lfs, &(lfs->inodes[index]), lfs->inodes[index].synced);
+    }
+    rt_mutex_release(&(lfs->lock));
+
+    level = rt_hw_interrupt_disable();
+    rt_slist_remove(&_logfs_list, &(lfs->list));
+    rt_hw_interrupt_enable(level);
+
+    logfs_destroy(lfs);
+    fs->data = RT_NULL;
+
+    return RT_EOK;
+}
+
+static int dfs_logfs_mkfs(rt_device_t dev_id)
+{
+    struct logfs *lfs;
+    int result;
+
+    lfs = logfs_create(dev_id);
+    if (lfs == RT_NULL)
+        return -EINVAL;
+
+    result = logfs_format(lfs);
+    logfs_destroy(lfs);
+
+    return result;
+}
+
+static int dfs_logfs_statfs(struct dfs_filesystem *fs, struct statfs *buf)
+{
+    struct logfs *lfs = (struct logfs *)fs->data;
+
+    buf->f_bsize  = lfs->block_size;
+    buf->f_blocks = lfs->block_count - LOGFS_ANCHOR_BLOCKS;
+    buf->f_bfree  = lfs->free_count;
+
+    return RT_EOK;
+}
+
+static int dfs_logfs_unlink(struct dfs_filesystem *fs, const char *path)
+{
+    struct logfs *lfs = (struct logfs *)fs->data;
+    struct logfs_inode *inode;
+    int result;
+
+    rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+    inode = logfs_inode_find(lfs, logfs_name(path));
+    if (inode == RT_NULL)
+        result = -ENOENT;
+    else if (inode->ref_count > 0)
+        result = -EBUSY;
+    else
+        result = logfs_remove(lfs, inode);
+    logfs_meta_check(lfs);
+    rt_mutex_release(&(lfs->lock));
+
+    return result;
+}
+
+static int dfs_logfs_stat(struct dfs_filesystem *fs, const char *path, struct stat *st)
+{
+    struct logfs *lfs = (struct logfs *)fs->data;
+    struct logfs_inode *inode;
+    const char *name;
+
+    name = logfs_name(path);
+
+    st->st_dev = 0;
+    st->st_mtime = 0;
+    if (*name == '\0')
+    {
+        st->st_mode = S_IFDIR | S_IRUSR | S_IRGRP | S_IROTH | S_IWUSR | S_IWGRP | S_IWOTH |
+                      S_IXUSR | S_IXGRP | S_IXOTH;
+        st->st_size = 0;
+
+        return RT_EOK;
+    }
+
+    rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+    inode = logfs_inode_find(lfs, name);
+    if (inode != RT_NULL)
+    {
+        st->st_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH |
+                      S_IWUSR | S_IWGRP | S_IWOTH;
+        st->st_size = inode->size;
+    }
+    rt_mutex_release(&(lfs->lock));
+
+    return inode != RT_NULL ? RT_EOK : -ENOENT;
+}
+
+static int dfs_logfs_rename(struct dfs_filesystem *fs, const char *oldpath, const char *newpath)
+{
+    struct logfs *lfs = (struct logfs *)fs->data;
+    struct logfs_inode *inode, *target;
+    char name[RT_DFS_LOGFS_NAME_MAX + 1];
+    const char *new_name;
+    int result = RT_EOK;
+
+    new_name = logfs_name(newpath);
+    if (rt_strlen(new_name) > RT_DFS_LOGFS_NAME_MAX)
+        return -ENAMETOOLONG;
+    if (*new_name == '\0' || strchr(new_name, '/') != RT_NULL)
+        return -EINVAL;
+
+    rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+    inode = logfs_inode_find(lfs, logfs_name(oldpath));
+    target = logfs_inode_find(lfs, new_name);
+    if (inode == RT_NULL)
+    {
+        result = -ENOENT;
+    }
+    else if (target != inode)
+    {
+        /* replace the existing file */
+        if (target != RT_NULL)
+            result = target->ref_count > 0 ? -EBUSY : logfs_remove(lfs, target);
+
+        if (result == RT_EOK)
+        {
+            rt_strncpy(name, inode->name, sizeof(name));
+            rt_strncpy(inode->name, new_name, sizeof(inode->name));
+            result = logfs_record_name(lfs, inode);
+            if (result < 0)
+                rt_strncpy(inode->name, name, sizeof(inode->name));
+        }
+    }
+    logfs_meta_check(lfs);
+    rt_mutex_release(&(lfs->lock));
+
+    return result;
+}
+
+static int dfs_logfs_open(struct dfs_fd *file)
+{
+    struct dfs_filesystem *fs = (struct dfs_filesystem *)file->data;
+    struct logfs *lfs = (struct logfs *)fs->data;
+    struct logfs_inode *inode;
+    const char *name;
+    int result = RT_EOK;
+
+    name = logfs_name(file->path);
+    if (file->flags & O_DIRECTORY)
+    {
+        /* there is only root directory */
+        if (file->flags & O_CREAT)
+            return -ENOSYS;
+        if (*name != '\0')
+            return -ENOENT;
+
+        file->data = lfs;
+        file->size = 0;
+        file->pos = 0;
+
+        return RT_EOK;
+    }
+
+    if (*name == '\0')
+        return -EISDIR;
+    if (strchr(name, '/') != RT_NULL)
+        return -ENOENT;
+    if (rt_strlen(name) > RT_DFS_LOGFS_NAME_MAX)
+        return -ENAMETOOLONG;
+
+    rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+    inode = logfs_inode_find(lfs, name);
+    if (inode == RT_NULL)
+    {
+        if (!(file->flags & O_CREAT))
+        {
+            result = -ENOENT;
+            goto __exit;
+        }
+
+        inode = logfs_inode_get(lfs, 0, RT_TRUE);
+        if (inode == RT_NULL)
+        {
+            result = -ENOSPC;
+            goto __exit;
+        }
+        inode->fs = lfs;
+        inode->id = lfs->next_id;
+        inode->tail_clean = 1;
+        rt_strncpy(inode->name, name, sizeof(inode->name));
+
+        result = logfs_record_name(lfs, inode);
+        if (result < 0)
+        {
+            logfs_inode_free(inode);
+            goto __exit;
+        }
+        lfs->next_id++;
+    }
+    else if ((file->flags & O_CREAT) && (file->flags & O_EXCL))
+    {
+        result = -EEXIST;
+        goto __exit;
+    }
+
+    if ((file->flags & O_TRUNC) && (file->flags & O_ACCMODE) != O_RDONLY)
+    {
+        result = logfs_truncate(lfs, inode, 0);
+        if (result < 0)
+            goto __exit;
+    }
+
+    inode->ref_count++;
+    file->data = inode;
+    file->size = inode->size;
+    file->pos = (file->flags & O_APPEND) ? inode->size : 0;
+
+__exit:
+    logfs_meta_check(lfs);
+    rt_mutex_release(&(lfs->lock));
+
+    return result;
+}
+
+static int dfs_logfs_close(struct dfs_fd *file)
+{
+    struct logfs_inode *inode;
+    struct logfs *lfs;
+    int result = RT_EOK;
+
+    if (file->flags & O_DIRECTORY)
+        return RT_EOK;
+
+    inode = (struct logfs_inode *)file->data;
+    lfs = inode->fs;
+
+    rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+    if (inode->dirty)
+        result = logfs_commit(lfs, inode, inode->synced);
+    inode->ref_count--;
+    logfs_meta_check(lfs);
+    rt_mutex_release(&(lfs->lock));
+
+    return result;
+}
+
+static int dfs_logfs_ioctl(struct dfs_fd *file, int cmd, void *args)
+{
+    struct logfs_inode *inode;
+    struct logfs *lfs;
+    int result;
+
+    if (file->flags & O_DIRECTORY)
+        return -EISDIR;
+
+    inode = (struct logfs_inode *)file->data;
+    lfs = inode->fs;
+
+    switch (cmd)
+    {
+    case RT_FIOFTRUNCATE:
+        if (*(off_t *)args < 0)
+            return -EINVAL;
+
+        rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+        result = logfs_truncate(lfs, inode, *(off_t *)args);
+        file->size = inode->size;
+        logfs_meta_check(lfs);
+        rt_mutex_release(&(lfs->lock));
+
+        return result;
+    }
+
+    return -EIO;
+}
+
+static int dfs_logfs_read(struct dfs_fd *file, void *buf, size_t count)
+{
+    struct logfs_inode *inode = (struct logfs_inode *)file->data;
+    struct logfs *lfs = inode->fs;
+    rt_uint32_t offset, size;
+    rt_size_t length = 0;
+    int result = 0;
+
+    if (file->flags & O_DIRECTORY)
+        return -EISDIR;
+
+    rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+    if ((rt_uint32_t)file->pos < inode->size && count > inode->size - file->pos)
+        count = inode->size - file->pos;
+    else if ((rt_uint32_t)file->pos >= inode->size)
+        count = 0;
+
+    while (length < count)
+    {
+        offset = file->pos % logfs_usable(lfs);
+        size = logfs_usable(lfs) - offset < count - length ? logfs_usable(lfs) - offset : count - length;
+
+        result = logfs_read(lfs, inode->blocks[file->pos / logfs_usable(lfs)],
+                            sizeof(struct logfs_block_header) + offset, (rt_uint8_t *)buf + length, size);
+        if (result < 0)
+            break;
+
+        file->pos += size;
+        length += size;
+    }
+    file->size = inode->size;
+    rt_mutex_release(&(lfs->lock));
+
+    return length > 0 ? (int)length : result;
+}
+
+static int dfs_logfs_write(struct dfs_fd *file, const void *buf, size_t count)
+{
+    struct logfs_inode *inode = (struct logfs_inode *)file->data;
+    struct logfs *lfs = inode->fs;
+    int result;
+
+    if (file->flags & O_DIRECTORY)
+        return -EISDIR;
+
+    rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+    if (file->flags & O_APPEND)
+        file->pos = inode->size;
+
+    /* fill the hole with zero */
+    result = logfs_file_fill(lfs, inode, file->pos);
+    if (result == 0)
+        result = logfs_file_write(lfs, inode, file->pos, buf, count);
+    if (result > 0)
+        file->pos += result;
+
+    file->size = inode->size;
+    logfs_meta_check(lfs);
+    rt_mutex_release(&(lfs->lock));
+
+    return result;
+}
+
+static int dfs_logfs_flush(struct dfs_fd *file)
+{
+    struct logfs_inode *inode = (struct logfs_inode *)file->data;
+    struct logfs *lfs = inode->fs;
+    int result = RT_EOK;
+
+    if (file->flags & O_DIRECTORY)
+        return -EISDIR;
+
+    rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+    if (inode->dirty)
+        result = logfs_commit(lfs, inode, inode->synced);
+    logfs_meta_check(lfs);
+    rt_mutex_release(&(lfs->lock));
+
+    return result;
+}
+
+static int dfs_logfs_lseek(struct dfs_fd *file, off_t offset)
+{
+    if (offset < 0)
+        return -EINVAL;
+
+    /* the hole is filled on write */
+    file->pos = offset;
+
+    return file->pos;
+}
+
+static int dfs_logfs_getdents(struct dfs_fd *file, struct dirent *dirp, uint32_t count)
+{
+    struct logfs *lfs = (struct logfs *)file->data;
+    struct logfs_inode *inode;
+    struct dirent *d;
+    rt_size_t index, end;
+    int node;
+
+    /* make integer count */
+    count = (count / sizeof(struct dirent));
+    if (count == 0)
+        return -EINVAL;
+
+    end = file->pos + count;
+    index = 0;
+    count = 0;
+
+    rt_mutex_take(&(lfs->lock), RT_WAITING_FOREVER);
+    for (node = 0; node < RT_DFS_LOGFS_FILES_MAX && index < end; node++)
+    {
+        inode = &(lfs->inodes[node]);
+        if (inode->id == 0)
+            continue;
+
+        if (index >= (rt_size_t)file->pos)
+        {
+            d = dirp + count;
+            d->d_type = DT_REG;
+            d->d_namlen = rt_strlen(inode->name);
+            d->d_reclen = (rt_uint16_t)sizeof(struct dirent);
+            rt_strncpy(d->d_name, inode->name, sizeof(d->d_name));
+
+            count += 1;
+            file->pos += 1;
+        }
+        index += 1;
+    }
+    rt_mutex_release(&(lfs->lock));
+
+    return count * sizeof(struct dirent);
+}
+
+static const struct dfs_file_ops _logfs_fops =
+{
+    dfs_logfs_open,
+    dfs_logfs_close,
+    dfs_logfs_ioctl,
+    dfs_logfs_read,
+    dfs_logfs_write,
+    dfs_logfs_flush,
+    dfs_logfs_lseek,
+    dfs_logfs_getdents,
+};
+
+static const struct dfs_filesystem_ops _logfs =
+{
+    "logfs",
+    DFS_FS_FLAG_DEFAULT,
+    &_logfs_fops,
+
+    dfs_logfs_mount,
+    dfs_logfs_unmount,
+    dfs_logfs_mkfs,
+    dfs_logfs_statfs,
+
+    dfs_logfs_unlink,
+    dfs_logfs_stat,
+    dfs_logfs_rename,
+};
+
+int dfs_logfs_init(void)
+{
+    /* register log-structured file system */
+    dfs_register(&_logfs);
+
+    return 0;
+}
+INIT_COMPONENT_EXPORT(dfs_logfs_init);
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+static int list_logfs(void)
+{
+    struct logfs *fs;
+    rt_slist_t *node;
+
+    rt_kprintf("device   blocks free  erases   prog(KB) user(KB) meta(KB) ckpt  moved\n");
+    rt_kprintf("-------- ------ ----- -------- -------- -------- -------- ----- -----\n");
+    rt_slist_for_each(node, &_logfs_list)
+    {
+        fs = rt_slist_entry(node, struct logfs, list);
+        rt_kprintf("%-8.*s %6d %5d %8d %8d %8d %8d %5d %5d\n", RT_NAME_MAX, fs->mtd->parent.parent.name,
+                   fs->block_count, fs->free_count, fs->stat.erases, fs->stat.prog_bytes / 1024,
+                   fs->stat.user_bytes / 1024, fs->stat.meta_bytes / 1024,
+                   fs->stat.checkpoints, fs->stat.migrations);
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(list_logfs, list the statistics of logfs);
+#endif
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+#ifndef __DFS_LOGFS_H__
+#define __DFS_LOGFS_H__
+
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the statistics of logfs, the write amplification is prog_bytes / user_bytes */
+struct dfs_logfs_stat
+{
+    rt_uint32_t erases;         /* the erased blocks */
+    rt_uint32_t prog_bytes;     /* the bytes programmed to flash */
+    rt_uint32_t user_bytes;     /* the bytes written by user */
+    rt_uint32_t meta_bytes;     /* the bytes of meta log */
+    rt_uint32_t checkpoints;    /* the checkpoints of meta log */
+    rt_uint32_t migrations;     /* the cold blocks moved by wear leveling */
+};
+
+int dfs_logfs_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,645 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * logfs_sim runs logfs on the host with a simulated NOR flash, and prints
+ * the mount time, the write amplification, the throughput and the wear of
+ * some sensor logging workloads. The power loss and the I/O errors are
+ * injected to check that the acknowledged data survives.
+ *
+ * The flash is a RAM buffer: programming can only clear bits, and the time
+ * of each operation is added up by the typical timing of SPI NOR flash
+ * (W25Q series): 45ms to erase 4KB, 0.7ms to program one 256 bytes page,
+ * and the data is transferred at 50MHz. The block size of logfs is the
+ * erase size, the times are scaled for the larger blocks.
+ *
+ * logfs is built into this program with the configuration in rtconfig.h:
+ *
+ *   gcc -O2 -I. -I../../../../../include -I../../../../../components/drivers/include \
+ *       -I../../../../../components/dfs/include logfs_sim.c -o logfs_sim
+ *
+ * usage: logfs_sim [block size] [block count] [record size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../dfs_logfs.c"
+
+#define SIM_PAGE_SIZE       256
+#define SIM_ERASE_US        45000   /* erase 4KB */
+#define SIM_PROG_US         700     /* program one page */
+#define SIM_CMD_US          1       /* command and address */
+#define SIM_BYTE_NS         160     /* transfer one byte at 50MHz */
+
+struct sim_flash
+{
+    struct rt_mtd_nor_device mtd;
+    rt_uint8_t *data;
+    rt_uint32_t size;
+
+    rt_uint64_t time_ns;            /* the time of all operations */
+    rt_uint32_t read_bytes;
+    rt_uint32_t erases;
+
+    long ops;                       /* the programs and erases */
+    long cut_at;                    /* the power is cut at this operation, -1 for never */
+    int  dead;                      /* the power is cut */
+    int  fail_every;                /* one of these operations fails randomly, 0 for never */
+    long failed;
+};
+
+static struct sim_flash flash;
+static struct dfs_filesystem dfs;
+static rt_uint32_t mount_bytes;
+static double mount_ms;
+
+/* the stubs of kernel for logfs */
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void *rt_realloc(void *ptr, rt_size_t size) { return realloc(ptr, size); }
+void rt_free(void *ptr) { free(ptr); }
+void *rt_memset(void *s, int c, rt_ubase_t count) { return memset(s, c, count); }
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count) { return count ? memcpy(dst, src, count) : dst; }
+rt_size_t rt_strlen(const char *s) { return strlen(s); }
+rt_int32_t rt_strcmp(const char *cs, const char *ct) { return strcmp(cs, ct); }
+char *rt_strncpy(char *dst, const char *src, rt_ubase_t n)
+{
+    rt_ubase_t index;
+
+    for (index = 0; index < n && src[index] != '\0'; index++)
+        dst[index] = src[index];
+    for (; index < n; index++)
+        dst[index] = '\0';
+
+    return dst;
+}
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag) { return RT_EOK; }
+rt_err_t rt_mutex_detach(rt_mutex_t mutex) { return RT_EOK; }
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time) { return RT_EOK; }
+rt_err_t rt_mutex_release(rt_mutex_t mutex) { return RT_EOK; }
+rt_base_t rt_hw_interrupt_disable(void) { return 0; }
+void rt_hw_interrupt_enable(rt_base_t level) { }
+int dfs_register(const struct dfs_filesystem_ops *ops) { return 0; }
+
+void rt_assert_handler(const char *ex, const char *func, rt_size_t line)
+{
+    fprintf(stderr, "(%s) assertion failed at function:%s, line number:%d\n", ex, func, (int)line);
+    abort();
+}
+
+/*
+ * 0 to go on, 1 if the operation fails and the flash is not changed,
+ * 2 if the power is cut in this operation
+ */
+static int sim_power(void)
+{
+    if (flash.dead)
+        return 1;
+
+    flash.ops++;
+    if (flash.cut_at >= 0 && flash.ops >= flash.cut_at)
+    {
+        flash.dead = 1;
+        return 2;
+    }
+    if (flash.fail_every && rand() % flash.fail_every == 0)
+    {
+        flash.failed++;
+        return 1;
+    }
+
+    return 0;
+}
+
+static rt_size_t sim_read(struct rt_mtd_nor_device *device, rt_off_t offset, rt_uint8_t *data, rt_uint32_t length)
+{
+    if (offset + length > flash.size)
+        return 0;
+
+    memcpy(data, flash.data + offset, length);
+    flash.read_bytes += length;
+    flash.time_ns += SIM_CMD_US * 1000 + (rt_uint64_t)length * SIM_BYTE_NS;
+
+    return length;
+}
+
+static rt_size_t sim_write(struct rt_mtd_nor_device *device, rt_off_t offset, const rt_uint8_t *data, rt_uint32_t length)
+{
+    rt_uint32_t index, done, pages;
+    int power;
+
+    if (offset + length > flash.size)
+        return 0;
+
+    power = sim_power();
+    if (power == 1)
+        return 0;
+
+    /* the half of data is programmed when the power is cut */
+    done = power == 2 ? length / 2 : length;
+    for (index = 0; index < done; index++)
+        flash.data[offset + index] &= data[index];
+
+    pages = (offset + length - 1) / SIM_PAGE_SIZE - offset / SIM_PAGE_SIZE + 1;
+    flash.time_ns += (rt_uint64_t)pages * (SIM_CMD_US + SIM_PROG_US) * 1000 + (rt_uint64_t)length * SIM_BYTE_NS;
+
+    return power == 2 ? 0 : length;
+}
+
+static rt_err_t sim_erase(struct rt_mtd_nor_device *device, rt_off_t offset, rt_uint32_t length)
+{
+    int power;
+
+    if (offset % device->block_size || offset + length > flash.size)
+        return -RT_EINVAL;
+
+    power = sim_power();
+    if (power == 1)
+        return -RT_EIO;
+
+    flash.erases++;
+    flash.time_ns += (rt_uint64_t)length / 4096 * SIM_ERASE_US * 1000;
+
+    /* the block is neither erased nor programmed after a broken erase */
+    if (power == 2)
+    {
+        memset(flash.data + offset, 0x5A, length);
+        return -RT_EIO;
+    }
+
+    memset(flash.data + offset, 0xFF, length);
+
+    return RT_EOK;
+}
+
+static const struct rt_mtd_nor_driver_ops sim_ops =
+{
+    RT_NULL,
+    sim_read,
+    sim_write,
+    sim_erase,
+};
+
+static void sim_reset(void)
+{
+    flash.time_ns = 0;
+    flash.read_bytes = 0;
+    flash.erases = 0;
+    flash.ops = 0;
+    flash.cut_at = -1;
+    flash.dead = 0;
+    flash.fail_every = 0;
+    flash.failed = 0;
+}
+
+static double sim_ms(void)
+{
+    return flash.time_ns / 1000000.0;
+}
+
+static struct logfs *sim_fs(void)
+{
+    return (struct logfs *)dfs.data;
+}
+
+static int sim_mount(void)
+{
+    dfs.dev_id = &(flash.mtd.parent);
+    dfs.data = RT_NULL;
+
+    return dfs_logfs_mount(&dfs, 0, RT_NULL);
+}
+
+static void sim_unmount(void)
+{
+    if (dfs.data != RT_NULL)
+        dfs_logfs_unmount(&dfs);
+    dfs.data = RT_NULL;
+}
+
+static void sim_format(void)
+{
+    memset(flash.data, 0xFF, flash.size);
+    sim_reset();
+    if (dfs_logfs_mkfs(&(flash.mtd.parent)) != 0 || sim_mount() != 0)
+    {
+        fprintf(stderr, "format failed\n");
+        exit(1);
+    }
+}
+
+static int file_open(struct dfs_fd *fd, const char *path, int flags)
+{
+    memset(fd, 0, sizeof(struct dfs_fd));
+    fd->path = (char *)path;
+    fd->flags = flags;
+    fd->data = &dfs;
+
+    return dfs_logfs_open(fd);
+}
+
+/* the content of file is known by its offset, so it can be checked after power loss */
+static rt_uint8_t file_byte(int id, long offset)
+{
+    return (rt_uint8_t)(offset * 7 + id * 13 + (offset >> 8));
+}
+
+/* append the records to file and close it, the data is acknowledged if 0 is returned */
+static int file_append(const char *path, int id, long length, int record)
+{
+    rt_uint8_t buf[512];
+    struct dfs_fd fd;
+    long done, count, index;
+    int result;
+
+    result = file_open(&fd, path, O_WRONLY | O_CREAT | O_APPEND);
+    if (result < 0)
+        return result;
+
+    for (done = 0; done < length; done += result)
+    {
+        count = length - done < record ? length - done : record;
+        for (index = 0; index < count; index++)
+            buf[index] = file_byte(id, fd.size + index);
+
+        result = dfs_logfs_write(&fd, buf, count);
+        if (result < 0)
+            break;
+    }
+
+    if (result < 0)
+    {
+        dfs_logfs_close(&fd);
+        return result;
+    }
+
+    return dfs_logfs_close(&fd);
+}
+
+static int file_truncate(const char *path)
+{
+    struct dfs_fd fd;
+    int result;
+
+    result = file_open(&fd, path, O_WRONLY | O_CREAT | O_TRUNC);
+    if (result < 0)
+        return result;
+
+    return dfs_logfs_close(&fd);
+}
+
+/* check the file has the acknowledged data at least, and the content is right */
+static void file_check(const char *path, int id, long length)
+{
+    struct dfs_fd fd;
+    rt_uint8_t *buf;
+    long index;
+    int result;
+
+    result = file_open(&fd, path, O_RDONLY);
+    if (result == -ENOENT && length == 0)
+        return;
+    if (result < 0 || (long)fd.size < length)
+    {
+        fprintf(stderr, "%s: %d bytes are found, %ld bytes are acknowledged\n",
+                path, result < 0 ? 0 : (int)fd.size, length);
+        exit(1);
+    }
+
+    buf = (rt_uint8_t *)malloc(fd.size + 1);
+    result = dfs_logfs_read(&fd, buf, fd.size);
+    for (index = 0; index < result; index++)
+    {
+        if (buf[index] != file_byte(id, index))
+            break;
+    }
+    if (result != (int)fd.size || index != result)
+    {
+        fprintf(stderr, "%s: the data is broken at %ld\n", path, index);
+        exit(1);
+    }
+
+    free(buf);
+    dfs_logfs_close(&fd);
+}
+
+/* the erase counts of blocks which have valid headers */
+static void wear_range(rt_uint32_t *min, rt_uint32_t *max)
+{
+    struct logfs_block_header *header;
+    rt_uint32_t block;
+
+    *min = ~0u;
+    *max = 0;
+    for (block = LOGFS_ANCHOR_BLOCKS; block < flash.mtd.block_end; block++)
+    {
+        header = (struct logfs_block_header *)(flash.data + block * flash.mtd.block_size);
+        if (header->magic != LOGFS_MAGIC || header->check != logfs_header_check(header))
+            continue;
+
+        if (header->erase_count < *min)
+            *min = header->erase_count;
+        if (header->erase_count > *max)
+            *max = header->erase_count;
+    }
+}
+
+static void bench_print(const char *name, long user, double ms)
+{
+    struct logfs *fs = sim_fs();
+
+    printf("%-10s %8ld %8u %6u %5.2f %9.1f %5u %5u\n", name, user / 1024,
+           fs->stat.prog_bytes / 1024, fs->stat.erases,
+           user ? (double)fs->stat.prog_bytes / user : 0.0,
+           ms > 0 ? user / 1024.0 / (ms / 1000.0) : 0.0,
+           fs->stat.checkpoints, fs->stat.migrations);
+}
+
+/* some sensors append records to their own files, each file is closed after a batch */
+static void bench_append(int record)
+{
+    const char *names[] = {"temp.log", "humi.log", "accel.log", "gps.log"};
+    long total[4] = {0}, user = 0, limit;
+    int file, batch;
+
+    sim_format();
+    sim_reset();
+
+    limit = (long)flash.mtd.block_size * (flash.mtd.block_end - LOGFS_ANCHOR_BLOCKS) / 2;
+    for (batch = 0; user < limit; batch++)
+    {
+        file = batch % 4;
+        if (file_append(names[file], file, record * 16, record) != 0)
+            break;
+        total[file] += record * 16;
+        user += record * 16;
+    }
+    bench_print("append", user, sim_ms());
+
+    /* the mount reads the anchors and the meta chain only */
+    sim_unmount();
+    sim_reset();
+    if (sim_mount() != 0)
+    {
+        fprintf(stderr, "mount failed\n");
+        exit(1);
+    }
+    mount_bytes = flash.read_bytes;
+    mount_ms = sim_ms();
+
+    for (file = 0; file < 4; file++)
+        file_check(names[file], file, total[file]);
+    sim_unmount();
+}
+
+/* a small file is rewritten while a cold file keeps its blocks */
+static void bench_rewrite(int record)
+{
+    long user = 0;
+    int round;
+
+    sim_format();
+    sim_reset();
+
+    file_append("cold.log", 1, flash.mtd.block_size * (flash.mtd.block_end / 3), 512);
+    memset(&(sim_fs()->stat), 0, sizeof(struct dfs_logfs_stat));
+    sim_reset();
+    for (round = 0; round < 2000; round++)
+    {
+        if (round % 8 == 0 && file_truncate("hot.log") != 0)
+            break;
+        if (file_append("hot.log", 2, record * 16, record) != 0)
+            break;
+        user += record * 16;
+    }
+    bench_print("rewrite", user, sim_ms());
+
+    sim_unmount();
+    if (sim_mount() != 0)
+    {
+        fprintf(stderr, "mount failed\n");
+        exit(1);
+    }
+    file_check("cold.log", 1, flash.mtd.block_size * (flash.mtd.block_end / 3));
+    sim_unmount();
+}
+
+/* the workload of power loss test, it returns 0 if all of it is done */
+static int powerloss_work(long *done_x)
+{
+    int index;
+
+    for (index = 0; index < 60; index++)
+    {
+        if (file_append("x.log", 1, 333, 64) != 0)
+            return -1;
+        *done_x += 333;
+        if (file_append("y.log", 2, 1000, 64) != 0)
+            return -1;
+        if (index % 20 == 19 && file_truncate("y.log") != 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* cut the power at each operation of workload, and check the data after mount */
+static void test_powerloss(void)
+{
+    rt_uint8_t *base;
+    long cut, done_x;
+    int runs = 0;
+
+    sim_format();
+    file_append("x.log", 1, 5000, 64);
+    sim_unmount();
+
+    base = (rt_uint8_t *)malloc(flash.size);
+    memcpy(base, flash.data, flash.size);
+    for (cut = 1; ; cut += cut < 200 ? 1 : cut / 50)
+    {
+        memcpy(flash.data, base, flash.size);
+        sim_reset();
+        flash.cut_at = cut;
+
+        done_x = 5000;
+        if (sim_mount() != 0)
+        {
+            fprintf(stderr, "mount failed before power loss\n");
+            exit(1);
+        }
+        if (powerloss_work(&done_x) == 0)
+            break;
+        sim_unmount();
+
+        flash.dead = 0;
+        flash.cut_at = -1;
+        if (sim_mount() != 0)
+        {
+            fprintf(stderr, "mount failed after power loss at %ld\n", cut);
+            exit(1);
+        }
+        file_check("x.log", 1, done_x);
+        file_check("y.log", 2, 0);
+        if (file_append("z.log", 3, 2000, 64) != 0)
+        {
+            fprintf(stderr, "write failed after power loss at %ld\n", cut);
+            exit(1);
+        }
+        sim_unmount();
+        runs++;
+    }
+    sim_unmount();
+    free(base);
+
+    printf("power loss: %d cuts in %ld operations, no acknowledged data is lost\n", runs, cut);
+}
+
+/* mount a copy of flash as the power is lost now, and check the acknowledged data */
+static void image_check(long done_x, long done_y)
+{
+    struct dfs_filesystem live = dfs;
+    struct sim_flash state = flash;
+    rt_uint8_t *image;
+
+    image = (rt_uint8_t *)malloc(flash.size);
+    memcpy(image, flash.data, flash.size);
+
+    sim_reset();
+    if (sim_mount() != 0)
+    {
+        fprintf(stderr, "mount failed after I/O errors\n");
+        exit(1);
+    }
+    file_check("x.log", 1, done_x);
+    file_check("y.log", 2, done_y);
+    flash.dead = 1;
+    sim_unmount();
+
+    memcpy(flash.data, image, flash.size);
+    free(image);
+    flash = state;
+    dfs = live;
+}
+
+/* some programs and erases fail, the failed checkpoints must keep the meta log */
+static void test_io_error(void)
+{
+    char name[RT_DFS_LOGFS_NAME_MAX + 1];
+    long done_x = 0, done_y = 0;
+    int index, failed = 0, overdue = 0;
+    struct logfs *fs;
+
+    /* more files make the checkpoint longer */
+    sim_format();
+    for (index = 0; index < RT_DFS_LOGFS_FILES_MAX - 2; index++)
+    {
+        snprintf(name, sizeof(name), "sensor_%02d_with_a_long_name.log", index);
+        file_append(name, 3, 100, 64);
+    }
+
+    fs = sim_fs();
+    srand(2);
+    flash.fail_every = 20;
+    for (index = 0; index < 3000; index++)
+    {
+        /* the data is not acknowledged after a truncation, which may fail */
+        if (index % 200 == 199)
+        {
+            file_truncate("x.log");
+            done_x = 0;
+        }
+        if (index % 50 == 49)
+        {
+            file_truncate("y.log");
+            done_y = 0;
+        }
+
+        if (file_append("x.log", 1, 256, 64) == 0)
+            done_x += 256;
+        else
+            failed++;
+        if (file_append("y.log", 2, 128, 64) == 0)
+            done_y += 128;
+        else
+            failed++;
+
+        /* the journal is appended after a failed checkpoint */
+        if (fs->chain_count > fs->ckpt_blocks + RT_DFS_LOGFS_JOURNAL_BLOCKS)
+        {
+            image_check(done_x, done_y);
+            overdue++;
+        }
+    }
+    printf("I/O error: %ld operations failed, %d writes failed, %u checkpoints, %d overdue, ",
+           flash.failed, failed, fs->stat.checkpoints, overdue);
+
+    /* the power is off before unmount, nothing is written at the end */
+    flash.dead = 1;
+    sim_unmount();
+
+    sim_reset();
+    if (sim_mount() != 0)
+    {
+        fprintf(stderr, "mount failed after I/O errors\n");
+        exit(1);
+    }
+    file_check("x.log", 1, done_x);
+    file_check("y.log", 2, done_y);
+    sim_unmount();
+
+    printf("no acknowledged data is lost\n");
+}
+
+int main(int argc, char **argv)
+{
+    rt_uint32_t block_size = 4096, block_count = 64, min, max;
+    int record = 64;
+
+    if (argc > 1)
+        block_size = strtoul(argv[1], RT_NULL, 0);
+    if (argc > 2)
+        block_count = strtoul(argv[2], RT_NULL, 0);
+    if (argc > 3)
+        record = atoi(argv[3]);
+    if (block_size < 4096 || block_size % 4096 || block_count < 8 || record <= 0 || record > 512)
+    {
+        fprintf(stderr, "usage: %s [block size] [block count] [record size]\n", argv[0]);
+        return 1;
+    }
+
+    flash.size = block_size * block_count;
+    flash.data = (rt_uint8_t *)malloc(flash.size);
+    flash.mtd.parent.type = RT_Device_Class_MTD;
+    flash.mtd.block_size = block_size;
+    flash.mtd.block_start = 0;
+    flash.mtd.block_end = block_count;
+    flash.mtd.ops = &sim_ops;
+
+    printf("flash: %u blocks of %u bytes, %d bytes records\n\n", block_count, block_size, record);
+    printf("workload   user(KB) prog(KB) erases    WA     KB/s  ckpt moved\n");
+    printf("---------- -------- -------- ------ ----- --------- ----- -----\n");
+    bench_append(record);
+    bench_rewrite(record);
+
+    wear_range(&min, &max);
+    printf("\nmount: %u bytes read in %.1fms, a full scan reads %u bytes in %.1fms\n",
+           mount_bytes, mount_ms, flash.size,
+           (SIM_CMD_US * 1000.0 + (double)flash.size * SIM_BYTE_NS) / 1000000.0);
+    printf("wear: the erase counts of blocks are %u ~ %u\n", min, max);
+
+    test_powerloss();
+    test_io_error();
+
+    free(flash.data);
+
+    return 0;
+}
@@ -1145,7 +1145,7 @@ static const struct dfs_file_ops nfs_fops =
 static const struct dfs_filesystem_ops _nfs =
 {
     "nfs",
-    DFS_FS_FLAG_DEFAULT,
+    DFS_FS_FLAG_NOCACHE,
     &nfs_fops,
     nfs_mount,
     nfs_unmount,
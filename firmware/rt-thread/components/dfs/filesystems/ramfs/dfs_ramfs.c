@@ -8,6 +8,9 @@
  * 2013-04-15     Bernard      the first version
  * 2013-05-05     Bernard      remove CRC for ramfs persistence
  * 2013-05-22     Bernard      fix the no entry issue.
+ * 2020-11-20     luhuadong    get the address of file data for mmap
+ * 2020-11-20     luhuadong    add hashed directory index, sub-directory and
+ *                             chunked file data
  */
 
 #include <rtthread.h>
@@ -17,6 +20,253 @@
 
 #include "dfs_ramfs.h"
 
+static void ramfs_lock(struct dfs_ramfs *ramfs)
+{
+    rt_mutex_take(&(ramfs->lock), RT_WAITING_FOREVER);
+}
+
+static void ramfs_unlock(struct dfs_ramfs *ramfs)
+{
+    rt_mutex_release(&(ramfs->lock));
+}
+
+/* allocate memory from memheap, the cached chunks are released on shortage */
+static void *ramfs_alloc(struct dfs_ramfs *ramfs, rt_size_t size)
+{
+    struct ramfs_chunk *chunk;
+    void *ptr;
+
+    ptr = rt_memheap_alloc(&(ramfs->memheap), size);
+    if (ptr == NULL && ramfs->free_chunks != NULL)
+    {
+        while (ramfs->free_chunks != NULL)
+        {
+            chunk = ramfs->free_chunks;
+            ramfs->free_chunks = chunk->next;
+            rt_memheap_free(chunk);
+        }
+        ramfs->free_count = 0;
+
+        ptr = rt_memheap_alloc(&(ramfs->memheap), size);
+    }
+
+    return ptr;
+}
+
+static struct ramfs_chunk *ramfs_chunk_alloc(struct dfs_ramfs *ramfs)
+{
+    struct ramfs_chunk *chunk;
+
+    chunk = ramfs->free_chunks;
+    if (chunk != NULL)
+    {
+        ramfs->free_chunks = chunk->next;
+        ramfs->free_count --;
+    }
+    else
+    {
+        chunk = (struct ramfs_chunk *)rt_memheap_alloc(&(ramfs->memheap),
+                                                       sizeof(struct ramfs_chunk));
+        if (chunk == NULL)
+            return NULL;
+    }
+    chunk->next = NULL;
+
+    return chunk;
+}
+
+/* release all data chunks of file to the free list */
+static void ramfs_truncate(struct ramfs_dirent *dirent)
+{
+    struct dfs_ramfs *ramfs = dirent->fs;
+
+    if (dirent->data != NULL)
+    {
+        dirent->tail->next = ramfs->free_chunks;
+        ramfs->free_chunks = dirent->data;
+        ramfs->free_count += (dirent->size + RAMFS_CHUNK_SIZE - 1) / RAMFS_CHUNK_SIZE;
+    }
+
+    dirent->data = NULL;
+    dirent->tail = NULL;
+    dirent->cursor = NULL;
+    dirent->cursor_pos = 0;
+    dirent->size = 0;
+}
+
+/* get the chunk which holds the file offset, the offset must be allocated */
+static struct ramfs_chunk *ramfs_chunk_seek(struct ramfs_dirent *dirent,
+                                            rt_size_t           pos)
+{
+    struct ramfs_chunk *chunk;
+    rt_size_t chunk_pos;
+
+    chunk_pos = pos - pos % RAMFS_CHUNK_SIZE;
+    if (dirent->cursor != NULL && dirent->cursor_pos <= chunk_pos)
+    {
+        chunk = dirent->cursor;
+        pos = dirent->cursor_pos;
+    }
+    else
+    {
+        chunk = dirent->data;
+        pos = 0;
+    }
+
+    while (pos < chunk_pos)
+    {
+        chunk = chunk->next;
+        pos += RAMFS_CHUNK_SIZE;
+    }
+
+    dirent->cursor = chunk;
+    dirent->cursor_pos = chunk_pos;
+
+    return chunk;
+}
+
+static rt_uint32_t ramfs_hash(struct ramfs_dirent *parent,
+                              const char          *name,
+                              rt_size_t            len)
+{
+    rt_uint32_t hash;
+
+    hash = (rt_uint32_t)(rt_ubase_t)parent;
+    while (len --)
+        hash = hash * 31 + (rt_uint8_t)*name ++;
+
+    return hash % RAMFS_HASH_SIZE;
+}
+
+/* find the entry of name in directory, the name may not be terminated */
+static struct ramfs_dirent *ramfs_find(struct dfs_ramfs    *ramfs,
+                                       struct ramfs_dirent *parent,
+                                       const char          *name,
+                                       rt_size_t            len)
+{
+    struct ramfs_dirent *dirent;
+
+    if (parent->type != RAMFS_TYPE_DIR || len >= RAMFS_NAME_MAX)
+        return NULL;
+
+    for (dirent = ramfs->hash[ramfs_hash(parent, name, len)];
+         dirent != NULL;
+         dirent = dirent->hash)
+    {
+        if (dirent->parent == parent &&
+            rt_strncmp(dirent->name, name, len) == 0 &&
+            dirent->name[len] == '\0')
+        {
+            return dirent;
+        }
+    }
+
+    return NULL;
+}
+
+/* link the entry to the directory and hash bucket */
+static void ramfs_link(struct dfs_ramfs    *ramfs,
+                       struct ramfs_dirent *parent,
+                       struct ramfs_dirent *dirent)
+{
+    rt_uint32_t index;
+
+    index = ramfs_hash(parent, dirent->name, rt_strlen(dirent->name));
+    dirent->parent = parent;
+    dirent->hash = ramfs->hash[index];
+    ramfs->hash[index] = dirent;
+
+    rt_list_insert_before(&(parent->children), &(dirent->list));
+}
+
+static void ramfs_unlink(struct dfs_ramfs *ramfs, struct ramfs_dirent *dirent)
+{
+    struct ramfs_dirent **link;
+
+    link = &(ramfs->hash[ramfs_hash(dirent->parent, dirent->name,
+                                    rt_strlen(dirent->name))]);
+    while (*link != dirent)
+        link = &((*link)->hash);
+    *link = dirent->hash;
+
+    rt_list_remove(&(dirent->list));
+    dirent->parent = NULL;
+}
+
+/**
+ * walk the path from root directory. If the name is not NULL, the walk stops
+ * at the parent of last component, and the last component is returned by name
+ * and len, the len is 0 for root directory.
+ */
+static struct ramfs_dirent *ramfs_walk(struct dfs_ramfs *ramfs,
+                                       const char       *path,
+                                       const char      **name,
+                                       rt_size_t        *len)
+{
+    struct ramfs_dirent *dirent;
+    const char *end, *next;
+
+    dirent = &(ramfs->root);
+    while (1)
+    {
+        while (*path == '/')
+            path ++;
+
+        if (*path == '\0')
+        {
+            if (name != NULL)
+            {
+                *name = path;
+                *len = 0;
+            }
+
+            return dirent;
+        }
+
+        for (end = path; *end != '/' && *end != '\0'; end ++);
+        for (next = end; *next == '/'; next ++);
+
+        if (name != NULL && *next == '\0')
+        {
+            *name = path;
+            *len = end - path;
+
+            return dirent;
+        }
+
+        dirent = ramfs_find(ramfs, dirent, path, end - path);
+        if (dirent == NULL)
+            return NULL;
+
+        path = end;
+    }
+}
+
+static struct ramfs_dirent *ramfs_create(struct dfs_ramfs    *ramfs,
+                                         struct ramfs_dirent *parent,
+                                         const char          *name,
+                                         rt_size_t            len,
+                                         rt_uint8_t           type)
+{
+    struct ramfs_dirent *dirent;
+
+    dirent = (struct ramfs_dirent *)ramfs_alloc(ramfs, sizeof(struct ramfs_dirent));
+    if (dirent == NULL)
+        return NULL;
+
+    memset(dirent, 0x00, sizeof(struct ramfs_dirent));
+    memcpy(dirent->name, name, len);
+    dirent->name[len] = '\0';
+    dirent->type = type;
+    dirent->fs = ramfs;
+    rt_list_init(&(dirent->list));
+    rt_list_init(&(dirent->children));
+
+    ramfs_link(ramfs, parent, dirent);
+
+    return dirent;
+}
+
 int dfs_ramfs_mount(struct dfs_filesystem *fs,
                     unsigned long          rwflag,
                     const void            *data)
@@ -47,77 +297,113 @@ int dfs_ramfs_statfs(struct dfs_filesystem *fs, struct statfs *buf)
     RT_ASSERT(ramfs != NULL);
     RT_ASSERT(buf != NULL);
 
+    ramfs_lock(ramfs);
     buf->f_bsize  = 512;
     buf->f_blocks = ramfs->memheap.pool_size / 512;
-    buf->f_bfree  = ramfs->memheap.available_size / 512;
+    buf->f_bfree  = (ramfs->memheap.available_size +
+                     ramfs->free_count * sizeof(struct ramfs_chunk)) / 512;
+    ramfs_unlock(ramfs);
 
     return RT_EOK;
 }
 
 int dfs_ramfs_ioctl(struct dfs_fd *file, int cmd, void *args)
 {
-    return -EIO;
+    struct ramfs_dirent *dirent;
+    int result = -EIO;
+
+    switch (cmd)
+    {
+    case RT_FIOGETADDR:
+        if (file->flags & O_DIRECTORY)
+            return -EISDIR;
+
+        /* only the data in one chunk is contiguous */
+        dirent = (struct ramfs_dirent *)file->data;
+        ramfs_lock(dirent->fs);
+        if (dirent->size <= RAMFS_CHUNK_SIZE)
+        {
+            *(rt_uint8_t **)args = dirent->data ? dirent->data->data : NULL;
+            result = RT_EOK;
+        }
+        ramfs_unlock(dirent->fs);
+        break;
+    }
+
+    return result;
 }
 
 struct ramfs_dirent *dfs_ramfs_lookup(struct dfs_ramfs *ramfs,
                                       const char       *path,
                                       rt_size_t        *size)
 {
-    const char *subpath;
     struct ramfs_dirent *dirent;
 
-    subpath = path;
-    while (*subpath == '/' && *subpath)
-        subpath ++;
-    if (! *subpath) /* is root directory */
-    {
-        *size = 0;
-
-        return &(ramfs->root);
-    }
-
-    for (dirent = rt_list_entry(ramfs->root.list.next, struct ramfs_dirent, list);
-         dirent != &(ramfs->root);
-         dirent = rt_list_entry(dirent->list.next, struct ramfs_dirent, list))
-    {
-        if (rt_strcmp(dirent->name, subpath) == 0)
-        {
-            *size = dirent->size;
-
-            return dirent;
-        }
-    }
+    dirent = ramfs_walk(ramfs, path, NULL, NULL);
+    if (dirent != NULL)
+        *size = dirent->size;
 
-    /* not found */
-    return NULL;
+    return dirent;
 }
 
 int dfs_ramfs_read(struct dfs_fd *file, void *buf, size_t count)
 {
-    rt_size_t length;
+    rt_size_t length, offset, size;
     struct ramfs_dirent *dirent;
+    struct ramfs_chunk *chunk;
 
     dirent = (struct ramfs_dirent *)file->data;
     RT_ASSERT(dirent != NULL);
 
+    ramfs_lock(dirent->fs);
+
+    /* the file may be truncated by another open */
+    file->size = dirent->size;
+    if (file->pos >= file->size)
+    {
+        ramfs_unlock(dirent->fs);
+
+        return 0;
+    }
+
     if (count < file->size - file->pos)
         length = count;
     else
         length = file->size - file->pos;
 
-    if (length > 0)
-        memcpy(buf, &(dirent->data[file->pos]), length);
+    chunk = ramfs_chunk_seek(dirent, file->pos);
+    offset = file->pos % RAMFS_CHUNK_SIZE;
+    for (count = 0; count < length; count += size)
+    {
+        size = RAMFS_CHUNK_SIZE - offset;
+        if (size > length - count)
+            size = length - count;
+
+        memcpy((rt_uint8_t *)buf + count, chunk->data + offset, size);
+        offset += size;
+        if (offset == RAMFS_CHUNK_SIZE && chunk->next != NULL)
+        {
+            chunk = chunk->next;
+            offset = 0;
+        }
+    }
 
     /* update file current position */
     file->pos += length;
+    dirent->cursor = chunk;
+    dirent->cursor_pos = file->pos - offset;
+
+    ramfs_unlock(dirent->fs);
 
     return length;
 }
 
 int dfs_ramfs_write(struct dfs_fd *fd, const void *buf, size_t count)
 {
+    rt_size_t capacity, length, offset, size;
     struct ramfs_dirent *dirent;
     struct dfs_ramfs *ramfs;
+    struct ramfs_chunk *chunk;
 
     dirent = (struct ramfs_dirent *)fd->data;
     RT_ASSERT(dirent != NULL);
@@ -125,30 +411,71 @@ int dfs_ramfs_write(struct dfs_fd *fd, const void *buf, size_t count)
     ramfs = dirent->fs;
     RT_ASSERT(ramfs != NULL);
 
-    if (count + fd->pos > fd->size)
+    if (count == 0)
+        return 0;
+
+    ramfs_lock(ramfs);
+
+    if (fd->pos > dirent->size)
+        fd->pos = dirent->size;
+
+    /* append the chunks to hold the data, no data is moved */
+    capacity = (dirent->size + RAMFS_CHUNK_SIZE - 1) / RAMFS_CHUNK_SIZE * RAMFS_CHUNK_SIZE;
+    while (capacity < fd->pos + count)
+    {
+        chunk = ramfs_chunk_alloc(ramfs);
+        if (chunk == NULL)
+            break;
+
+        if (dirent->tail != NULL)
+            dirent->tail->next = chunk;
+        else
+            dirent->data = chunk;
+        dirent->tail = chunk;
+        capacity += RAMFS_CHUNK_SIZE;
+    }
+
+    length = count;
+    if (capacity < fd->pos + count)
     {
-        rt_uint8_t *ptr;
-        ptr = rt_memheap_realloc(&(ramfs->memheap), dirent->data, fd->pos + count);
-        if (ptr == NULL)
+        length = capacity - fd->pos;
+        if (length == 0)
         {
+            ramfs_unlock(ramfs);
             rt_set_errno(-ENOMEM);
 
             return 0;
         }
+    }
+
+    chunk = ramfs_chunk_seek(dirent, fd->pos);
+    offset = fd->pos % RAMFS_CHUNK_SIZE;
+    for (count = 0; count < length; count += size)
+    {
+        size = RAMFS_CHUNK_SIZE - offset;
+        if (size > length - count)
+            size = length - count;
 
-        /* update dirent and file size */
-        dirent->data = ptr;
-        dirent->size = fd->pos + count;
-        fd->size = dirent->size;
+        memcpy(chunk->data + offset, (const rt_uint8_t *)buf + count, size);
+        offset += size;
+        if (offset == RAMFS_CHUNK_SIZE && chunk->next != NULL)
+        {
+            chunk = chunk->next;
+            offset = 0;
+        }
     }
 
-    if (count > 0)
-        memcpy(dirent->data + fd->pos, buf, count);
+    /* update dirent and file size */
+    fd->pos += length;
+    if (fd->pos > dirent->size)
+        dirent->size = fd->pos;
+    fd->size = dirent->size;
+    dirent->cursor = chunk;
+    dirent->cursor_pos = fd->pos - offset;
 
-    /* update file current position */
-    fd->pos += count;
+    ramfs_unlock(ramfs);
 
-    return count;
+    return length;
 }
 
 int dfs_ramfs_lseek(struct dfs_fd *file, off_t offset)
@@ -172,88 +499,91 @@ int dfs_ramfs_close(struct dfs_fd *file)
 
 int dfs_ramfs_open(struct dfs_fd *file)
 {
-    rt_size_t size;
+    rt_size_t len;
+    const char *name;
     struct dfs_ramfs *ramfs;
-    struct ramfs_dirent *dirent;
+    struct ramfs_dirent *dirent, *parent;
     struct dfs_filesystem *fs;
+    int result = RT_EOK;
 
     fs = (struct dfs_filesystem *)file->data;
 
     ramfs = (struct dfs_ramfs *)fs->data;
     RT_ASSERT(ramfs != NULL);
 
-    if (file->flags & O_DIRECTORY)
+    ramfs_lock(ramfs);
+
+    parent = ramfs_walk(ramfs, file->path, &name, &len);
+    if (parent == NULL)
     {
-        if (file->flags & O_CREAT)
+        result = -ENOENT;
+        goto __exit;
+    }
+
+    if (len == 0)
+        dirent = parent; /* it's root directory */
+    else
+        dirent = ramfs_find(ramfs, parent, name, len);
+
+    if (dirent == NULL)
+    {
+        if (!(file->flags & O_CREAT || file->flags & O_WRONLY))
         {
-            return -ENOSPC;
+            result = -ENOENT;
+            goto __exit;
         }
 
-        /* open directory */
-        dirent = dfs_ramfs_lookup(ramfs, file->path, &size);
+        if (parent->type != RAMFS_TYPE_DIR)
+        {
+            result = -ENOTDIR;
+            goto __exit;
+        }
+
+        if (len >= RAMFS_NAME_MAX)
+        {
+            result = -ENAMETOOLONG;
+            goto __exit;
+        }
+
+        /* create a directory or file entry */
+        dirent = ramfs_create(ramfs, parent, name, len,
+                              (file->flags & O_DIRECTORY) ? RAMFS_TYPE_DIR : RAMFS_TYPE_FILE);
         if (dirent == NULL)
-            return -ENOENT;
-        if (dirent == &(ramfs->root)) /* it's root directory */
         {
-            if (!(file->flags & O_DIRECTORY))
-            {
-                return -ENOENT;
-            }
+            result = -ENOMEM;
+            goto __exit;
         }
     }
-    else
+    else if (file->flags & O_DIRECTORY)
     {
-        dirent = dfs_ramfs_lookup(ramfs, file->path, &size);
-        if (dirent == &(ramfs->root)) /* it's root directory */
+        if (file->flags & O_CREAT)
         {
-            return -ENOENT;
+            result = -EEXIST;
+            goto __exit;
         }
+    }
 
-        if (dirent == NULL)
+    if (file->flags & O_DIRECTORY)
+    {
+        if (dirent->type != RAMFS_TYPE_DIR)
         {
-            if (file->flags & O_CREAT || file->flags & O_WRONLY)
-            {
-                char *name_ptr;
-
-                /* create a file entry */
-                dirent = (struct ramfs_dirent *)
-                         rt_memheap_alloc(&(ramfs->memheap),
-                                          sizeof(struct ramfs_dirent));
-                if (dirent == NULL)
-                {
-                    return -ENOMEM;
-                }
-
-                /* remove '/' separator */
-                name_ptr = file->path;
-                while (*name_ptr == '/' && *name_ptr)
-                    name_ptr ++;
-                strncpy(dirent->name, name_ptr, RAMFS_NAME_MAX);
-
-                rt_list_init(&(dirent->list));
-                dirent->data = NULL;
-                dirent->size = 0;
-                dirent->fs = ramfs;
-
-                /* add to the root directory */
-                rt_list_insert_after(&(ramfs->root.list), &(dirent->list));
-            }
-            else
-                return -ENOENT;
+            result = -ENOTDIR;
+            goto __exit;
+        }
+    }
+    else
+    {
+        if (dirent->type == RAMFS_TYPE_DIR)
+        {
+            result = -EISDIR;
+            goto __exit;
         }
 
         /* Creates a new file.
          * If the file is existing, it is truncated and overwritten.
          */
         if (file->flags & O_TRUNC)
-        {
-            dirent->size = 0;
-            if (dirent->data != NULL)
-            {
-                rt_memheap_free(dirent->data);
-                dirent->data = NULL;
-            }
-        }
+            ramfs_truncate(dirent);
     }
 
     file->data = dirent;
@@ -263,7 +593,10 @@ int dfs_ramfs_open(struct dfs_fd *file)
     else
         file->pos = 0;
 
-    return 0;
+__exit:
+    ramfs_unlock(ramfs);
+
+    return result;
 }
 
 int dfs_ramfs_stat(struct dfs_filesystem *fs,
@@ -275,17 +608,26 @@ int dfs_ramfs_stat(struct dfs_filesystem *fs,
     struct dfs_ramfs *ramfs;
 
     ramfs = (struct dfs_ramfs *)fs->data;
+    ramfs_lock(ramfs);
     dirent = dfs_ramfs_lookup(ramfs, path, &size);
-
     if (dirent == NULL)
+    {
+        ramfs_unlock(ramfs);
+
         return -ENOENT;
+    }
 
     st->st_dev = 0;
-    st->st_mode = S_IFREG | S_IRUSR | S_IRGRP | S_IROTH |
+    st->st_mode = S_IRUSR | S_IRGRP | S_IROTH |
                   S_IWUSR | S_IWGRP | S_IWOTH;
+    if (dirent->type == RAMFS_TYPE_DIR)
+        st->st_mode |= S_IFDIR | S_IXUSR | S_IXGRP | S_IXOTH;
+    else
+        st->st_mode |= S_IFREG;
 
-    st->st_size = dirent->size;
+    st->st_size = size;
     st->st_mtime = 0;
+    ramfs_unlock(ramfs);
 
     return RT_EOK;
 }
@@ -296,15 +638,16 @@ int dfs_ramfs_getdents(struct dfs_fd *file,
 {
     rt_size_t index, end;
     struct dirent *d;
-    struct ramfs_dirent *dirent;
+    struct ramfs_dirent *dirent, *child;
     struct dfs_ramfs *ramfs;
+    rt_list_t *node;
 
     dirent = (struct ramfs_dirent *)file->data;
 
     ramfs  = dirent->fs;
     RT_ASSERT(ramfs != RT_NULL);
 
-    if (dirent != &(ramfs->root))
+    if (dirent->type != RAMFS_TYPE_DIR)
         return -EINVAL;
 
     /* make integer count */
@@ -312,20 +655,24 @@ int dfs_ramfs_getdents(struct dfs_fd *file,
     if (count == 0)
         return -EINVAL;
 
+    ramfs_lock(ramfs);
+
     end = file->pos + count;
     index = 0;
     count = 0;
-    for (dirent = rt_list_entry(dirent->list.next, struct ramfs_dirent, list);
-         dirent != &(ramfs->root) && index < end;
-         dirent = rt_list_entry(dirent->list.next, struct ramfs_dirent, list))
+    for (node = dirent->children.next;
+         node != &(dirent->children) && index < end;
+         node = node->next)
     {
         if (index >= (rt_size_t)file->pos)
         {
+            child = rt_list_entry(node, struct ramfs_dirent, list);
+
             d = dirp + count;
-            d->d_type = DT_REG;
-            d->d_namlen = RT_NAME_MAX;
+            d->d_type = child->type == RAMFS_TYPE_DIR ? DT_DIR : DT_REG;
+            d->d_namlen = (rt_uint8_t)rt_strlen(child->name);
             d->d_reclen = (rt_uint16_t)sizeof(struct dirent);
-            rt_strncpy(d->d_name, dirent->name, RAMFS_NAME_MAX);
+            rt_strncpy(d->d_name, child->name, RAMFS_NAME_MAX);
 
             count += 1;
             file->pos += 1;
@@ -333,6 +680,8 @@ int dfs_ramfs_getdents(struct dfs_fd *file,
         index += 1;
     }
 
+    ramfs_unlock(ramfs);
+
     return count * sizeof(struct dirent);
 }
 
@@ -341,44 +690,98 @@ int dfs_ramfs_unlink(struct dfs_filesystem *fs, const char *path)
     rt_size_t size;
     struct dfs_ramfs *ramfs;
     struct ramfs_dirent *dirent;
+    int result = RT_EOK;
 
     ramfs = (struct dfs_ramfs *)fs->data;
     RT_ASSERT(ramfs != NULL);
 
+    ramfs_lock(ramfs);
+
     dirent = dfs_ramfs_lookup(ramfs, path, &size);
     if (dirent == NULL)
-        return -ENOENT;
+        result = -ENOENT;
+    else if (dirent == &(ramfs->root))
+        result = -EBUSY;
+    else if (!rt_list_isempty(&(dirent->children)))
+        result = -ENOTEMPTY;
+    else
+    {
+        ramfs_unlink(ramfs, dirent);
+        ramfs_truncate(dirent);
+        rt_memheap_free(dirent);
+    }
 
-    rt_list_remove(&(dirent->list));
-    if (dirent->data != NULL)
-        rt_memheap_free(dirent->data);
-    rt_memheap_free(dirent);
+    ramfs_unlock(ramfs);
 
-    return RT_EOK;
+    return result;
 }
 
 int dfs_ramfs_rename(struct dfs_filesystem *fs,
                      const char            *oldpath,
                      const char            *newpath)
 {
-    struct ramfs_dirent *dirent;
+    struct ramfs_dirent *dirent, *parent, *dir;
     struct dfs_ramfs *ramfs;
-    rt_size_t size;
+    const char *name;
+    rt_size_t size, len;
+    int result = RT_EOK;
 
     ramfs = (struct dfs_ramfs *)fs->data;
     RT_ASSERT(ramfs != NULL);
 
-    dirent = dfs_ramfs_lookup(ramfs, newpath, &size);
-    if (dirent != NULL)
-        return -EEXIST;
+    ramfs_lock(ramfs);
 
     dirent = dfs_ramfs_lookup(ramfs, oldpath, &size);
-    if (dirent == NULL)
-        return -ENOENT;
+    parent = ramfs_walk(ramfs, newpath, &name, &len);
+    if (dirent == NULL || parent == NULL)
+    {
+        result = -ENOENT;
+        goto __exit;
+    }
 
-    strncpy(dirent->name, newpath, RAMFS_NAME_MAX);
+    if (dirent == &(ramfs->root) || len == 0)
+    {
+        result = -EBUSY;
+        goto __exit;
+    }
 
-    return RT_EOK;
+    if (parent->type != RAMFS_TYPE_DIR)
+    {
+        result = -ENOTDIR;
+        goto __exit;
+    }
+
+    if (len >= RAMFS_NAME_MAX)
+    {
+        result = -ENAMETOOLONG;
+        goto __exit;
+    }
+
+    if (ramfs_find(ramfs, parent, name, len) != NULL)
+    {
+        result = -EEXIST;
+        goto __exit;
+    }
+
+    /* the directory can't be moved into itself */
+    for (dir = parent; dir != NULL; dir = dir->parent)
+    {
+        if (dir == dirent)
+        {
+            result = -EINVAL;
+            goto __exit;
+        }
+    }
+
+    ramfs_unlink(ramfs, dirent);
+    memcpy(dirent->name, name, len);
+    dirent->name[len] = '\0';
+    ramfs_link(ramfs, parent, dirent);
+
+__exit:
+    ramfs_unlock(ramfs);
+
+    return result;
 }
 
 static const struct dfs_file_ops _ram_fops =
@@ -440,11 +843,17 @@ struct dfs_ramfs *dfs_ramfs_create(rt_uint8_t *pool, rt_size_t size)
     /* initialize ramfs object */
     ramfs->magic = RAMFS_MAGIC;
     ramfs->memheap.parent.type = RT_Object_Class_MemHeap | RT_Object_Class_Static;
+    rt_mutex_init(&(ramfs->lock), "ramfs", RT_IPC_FLAG_FIFO);
+    memset(ramfs->hash, 0x00, sizeof(ramfs->hash));
+    ramfs->free_chunks = NULL;
+    ramfs->free_count = 0;
 
     /* initialize root directory */
     memset(&(ramfs->root), 0x00, sizeof(ramfs->root));
     rt_list_init(&(ramfs->root.list));
+    rt_list_init(&(ramfs->root.children));
     ramfs->root.size = 0;
+    ramfs->root.type = RAMFS_TYPE_DIR;
     strcpy(ramfs->root.name, ".");
     ramfs->root.fs = ramfs;
 
@@ -7,6 +7,8 @@
  * Date           Author       Notes
  * 2013-04-15     Bernard      the first version
  * 2013-05-05     Bernard      remove CRC for ramfs persistence
+ * 2020-11-20     luhuadong    add hashed directory index, sub-directory and
+ *                             chunked file data
  */
 
 #ifndef __DFS_RAMFS_H__
@@ -17,14 +19,39 @@
 
 #define RAMFS_NAME_MAX  32
 #define RAMFS_MAGIC     0x0A0A0A0A
+#define RAMFS_HASH_SIZE 64
+
+#ifdef RT_DFS_RAMFS_CHUNK_SIZE
+#define RAMFS_CHUNK_SIZE    RT_DFS_RAMFS_CHUNK_SIZE
+#else
+#define RAMFS_CHUNK_SIZE    512
+#endif
+
+#define RAMFS_TYPE_FILE 0x01
+#define RAMFS_TYPE_DIR  0x02
+
+struct ramfs_chunk
+{
+    struct ramfs_chunk *next;
+    rt_uint8_t data[RAMFS_CHUNK_SIZE];
+};
 
 struct ramfs_dirent
 {
-    rt_list_t list;
+    rt_list_t list;             /* the entries of parent directory */
+    struct ramfs_dirent *hash;  /* the next entry in hash bucket */
+    struct ramfs_dirent *parent;
     struct dfs_ramfs *fs;       /* file system ref */
 
     char name[RAMFS_NAME_MAX];  /* dirent name */
-    rt_uint8_t *data;
+    rt_uint8_t type;            /* file or directory */
+
+    rt_list_t children;         /* the entries of directory */
+
+    struct ramfs_chunk *data;   /* the chunks of file data */
+    struct ramfs_chunk *tail;
+    struct ramfs_chunk *cursor; /* the chunk of last access */
+    rt_size_t cursor_pos;       /* the file offset of cursor chunk */
 
     rt_size_t size;             /* file size */
 };
@@ -37,7 +64,15 @@ struct dfs_ramfs
     rt_uint32_t magic;
 
     struct rt_memheap memheap;
+    struct rt_mutex lock;
     struct ramfs_dirent root;
+
+    /* the entries of all directories hashed by parent and name */
+    struct ramfs_dirent *hash[RAMFS_HASH_SIZE];
+
+    /* the released chunks, they are reused before allocating from memheap */
+    struct ramfs_chunk *free_chunks;
+    rt_size_t free_count;
 };
 
 int dfs_ramfs_init(void);
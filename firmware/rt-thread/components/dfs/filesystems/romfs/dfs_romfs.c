@@ -5,6 +5,7 @@
  *
  * Change Logs:
  * Date           Author       Notes
+ * 2020-11-20     luhuadong    get the address of file data for mmap
  */
 
 #include <rtthread.h>
@@ -34,6 +35,20 @@ int dfs_romfs_unmount(struct dfs_filesystem *fs)
 
 int dfs_romfs_ioctl(struct dfs_fd *file, int cmd, void *args)
 {
+    struct romfs_dirent *dirent;
+
+    switch (cmd)
+    {
+    case RT_FIOGETADDR:
+        if (file->flags & O_DIRECTORY)
+            return -EISDIR;
+
+        /* the file data is in ROM or memory mapped flash */
+        dirent = (struct romfs_dirent *)file->data;
+        *(const rt_uint8_t **)args = dirent->data;
+        return RT_EOK;
+    }
+
     return -EIO;
 }
 
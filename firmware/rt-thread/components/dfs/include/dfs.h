@@ -49,6 +49,7 @@
 
 #define DFS_FS_FLAG_DEFAULT     0x00    /* default flag */
 #define DFS_FS_FLAG_FULLPATH    0x01    /* set full path to underlaying file system */
+#define DFS_FS_FLAG_NOCACHE     0x02    /* the files may appear without DFS, don't cache the paths */
 
 /* File types */
 #define FT_REGULAR               0   /* regular file */
@@ -101,6 +102,8 @@ void dfs_unlock(void);
 int fd_new(void);
 struct dfs_fd *fd_get(int fd);
 void fd_put(struct dfs_fd *fd);
+void fd_lock(struct dfs_fd *fd);
+void fd_unlock(struct dfs_fd *fd);
 int fd_is_open(const char *pathname);
 
 struct dfs_fdtable *dfs_fdtable_get(void);
@@ -52,6 +52,8 @@ struct dfs_fd
     off_t    pos;                /* Current file position */
 
     void *data;                  /* Specific file system data */
+
+    struct rt_mutex lock;        /* Serialize the operations on file position */
 };
 
 int dfs_file_open(struct dfs_fd *fd, const char *path, int flags);
@@ -70,6 +72,8 @@ int dfs_file_ftruncate(struct dfs_fd *fd, off_t length);
 
 /* 0x5254 is just a magic number to make these relatively unique ("RT") */
 #define RT_FIOFTRUNCATE 0x52540000U
+/* get the address of file data, for the file system which keeps the whole file in memory */
+#define RT_FIOGETADDR   0x52540001U
 
 #ifdef __cplusplus
 }
@@ -25,4 +25,19 @@ extern const struct dfs_mount_tbl mount_table[];
 
 extern char working_directory[];
 
+/* path lookup cache */
+#ifdef DFS_USING_DENTRY_CACHE
+void dfs_dentry_init(void);
+struct dfs_filesystem *dfs_dentry_lookup(const char *path, int *negative, rt_uint32_t *generation);
+void dfs_dentry_negative(struct dfs_filesystem *fs, const char *path, rt_uint32_t generation);
+void dfs_dentry_invalidate(struct dfs_filesystem *fs);
+void dfs_dentry_flush(void);
+#else
+#define dfs_dentry_init()                               do {} while (0)
+#define dfs_dentry_lookup(path, negative, generation)   (*(negative) = 0, *(generation) = 0, dfs_filesystem_lookup(path))
+#define dfs_dentry_negative(fs, path, generation)       do {} while (0)
+#define dfs_dentry_invalidate(fs)                       do {} while (0)
+#define dfs_dentry_flush()                              do {} while (0)
+#endif
+
 #endif
@@ -8,8 +8,10 @@
  * 2005-02-22     Bernard      The first version.
  * 2017-12-11     Bernard      Use rt_free to instead of free in fd_is_open().
  * 2018-03-20     Heyuanjie    dynamic allocation FD
+ * 2020-11-20     luhuadong    use fd table lock and lock-free fd lookup
  */
 
+#include <rthw.h>
 #include <dfs.h>
 #include <dfs_fs.h>
 #include <dfs_file.h>
@@ -28,6 +30,8 @@ struct dfs_filesystem filesystem_table[DFS_FILESYSTEMS_MAX];
 
 /* device filesystem lock */
 static struct rt_mutex fslock;
+/* fd table lock, the fd_get looks up the fd table without it */
+static struct rt_mutex fdlock;
 
 #ifdef DFS_USING_WORKDIR
 char working_directory[DFS_PATH_MAX] = {"/"};
@@ -64,6 +68,10 @@ int dfs_init(void)
 
     /* create device filesystem lock */
     rt_mutex_init(&fslock, "fslock", RT_IPC_FLAG_FIFO);
+    rt_mutex_init(&fdlock, "fdlock", RT_IPC_FLAG_FIFO);
+
+    /* initialize path lookup cache */
+    dfs_dentry_init();
 
 #ifdef DFS_USING_WORKDIR
     /* set current working directory */
@@ -121,37 +129,46 @@ void dfs_unlock(void)
 static int fd_alloc(struct dfs_fdtable *fdt, int startfd)
 {
     int idx;
+    rt_base_t level;
 
-    /* find an empty fd entry */
+    /* find an empty fd entry, the entry is freed when its ref_count is 0 */
     for (idx = startfd; idx < (int)fdt->maxfd; idx++)
     {
         if (fdt->fds[idx] == RT_NULL)
             break;
-        if (fdt->fds[idx]->ref_count == 0)
-            break;
     }
 
     /* allocate a larger FD container */
     if (idx == fdt->maxfd && fdt->maxfd < DFS_FD_MAX)
     {
         int cnt, index;
-        struct dfs_fd **fds;
+        struct dfs_fd **fds, **old_fds;
 
         /* increase the number of FD with 4 step length */
         cnt = fdt->maxfd + 4;
         cnt = cnt > DFS_FD_MAX ? DFS_FD_MAX : cnt;
 
-        fds = (struct dfs_fd **)rt_realloc(fdt->fds, cnt * sizeof(struct dfs_fd *));
+        /* the container may be used by fd_get, so it can't be reallocated in place */
+        fds = (struct dfs_fd **)rt_malloc(cnt * sizeof(struct dfs_fd *));
         if (fds == NULL) goto __exit; /* return fdt->maxfd */
 
+        for (index = 0; index < (int)fdt->maxfd; index ++)
+        {
+            fds[index] = fdt->fds[index];
+        }
         /* clean the new allocated fds */
         for (index = fdt->maxfd; index < cnt; index ++)
         {
             fds[index] = NULL;
         }
 
+        level = rt_hw_interrupt_disable();
+        old_fds    = fdt->fds;
         fdt->fds   = fds;
         fdt->maxfd = cnt;
+        rt_hw_interrupt_enable(level);
+
+        rt_free(old_fds);
     }
 
     /* allocate  'struct dfs_fd' */
@@ -177,10 +194,11 @@ int fd_new(void)
     struct dfs_fd *d;
     int idx;
     struct dfs_fdtable *fdt;
+    rt_base_t level;
 
     fdt = dfs_fdtable_get();
-    /* lock filesystem */
-    dfs_lock();
+    /* lock fd table */
+    rt_mutex_take(&fdlock, RT_WAITING_FOREVER);
 
     /* find an empty fd entry */
     idx = fd_alloc(fdt, 0);
@@ -194,11 +212,15 @@ int fd_new(void)
     }
 
     d = fdt->fds[idx];
+    rt_mutex_init(&d->lock, "fd", RT_IPC_FLAG_FIFO);
+
+    level = rt_hw_interrupt_disable();
     d->ref_count = 1;
     d->magic = DFS_FD_MAGIC;
+    rt_hw_interrupt_enable(level);
 
 __result:
-    dfs_unlock();
+    rt_mutex_release(&fdlock);
     return idx + DFS_FD_OFFSET;
 }
 
@@ -215,6 +237,7 @@ struct dfs_fd *fd_get(int fd)
 {
     struct dfs_fd *d;
     struct dfs_fdtable *fdt;
+    rt_base_t level;
 
 #if defined(RT_USING_DFS_DEVFS) && defined(RT_USING_POSIX)
     if ((0 <= fd) && (fd <= 2))
@@ -223,22 +246,29 @@ struct dfs_fd *fd_get(int fd)
 
     fdt = dfs_fdtable_get();
     fd = fd - DFS_FD_OFFSET;
-    if (fd < 0 || fd >= (int)fdt->maxfd)
+    if (fd < 0)
+        return NULL;
+
+    /* the fd table is only changed with interrupt disabled, it's not locked here */
+    level = rt_hw_interrupt_disable();
+    if (fd >= (int)fdt->maxfd)
+    {
+        rt_hw_interrupt_enable(level);
         return NULL;
+    }
 
-    dfs_lock();
     d = fdt->fds[fd];
 
     /* check dfs_fd valid or not */
-    if ((d == NULL) || (d->magic != DFS_FD_MAGIC))
+    if ((d == NULL) || (d->magic != DFS_FD_MAGIC) || (d->ref_count == 0))
     {
-        dfs_unlock();
+        rt_hw_interrupt_enable(level);
         return NULL;
     }
 
     /* increase the reference count */
     d->ref_count ++;
-    dfs_unlock();
+    rt_hw_interrupt_enable(level);
 
     return d;
 }
@@ -250,30 +280,72 @@ struct dfs_fd *fd_get(int fd)
  */
 void fd_put(struct dfs_fd *fd)
 {
-    RT_ASSERT(fd != NULL);
+    int ref_count;
+    rt_base_t level;
 
-    dfs_lock();
+    RT_ASSERT(fd != NULL);
 
-    fd->ref_count --;
+    level = rt_hw_interrupt_disable();
+    ref_count = -- fd->ref_count;
+    if (ref_count == 0)
+        fd->magic = 0;
+    rt_hw_interrupt_enable(level);
 
     /* clear this fd entry */
-    if (fd->ref_count == 0)
+    if (ref_count == 0)
     {
         int index;
         struct dfs_fdtable *fdt;
 
+        rt_mutex_take(&fdlock, RT_WAITING_FOREVER);
         fdt = dfs_fdtable_get();
         for (index = 0; index < (int)fdt->maxfd; index ++)
         {
             if (fdt->fds[index] == fd)
             {
-                rt_free(fd);
+                level = rt_hw_interrupt_disable();
                 fdt->fds[index] = 0;
+                rt_hw_interrupt_enable(level);
+
+                rt_mutex_detach(&fd->lock);
+                rt_free(fd);
                 break;
             }
         }
+        rt_mutex_release(&fdlock);
+    }
+}
+
+/**
+ * @ingroup Fd
+ *
+ * This function will lock the file descriptor, the operations on the position
+ * of regular file or directory are serialized. The device and socket are not
+ * locked, because they may be blocked by reading.
+ */
+void fd_lock(struct dfs_fd *fd)
+{
+    RT_ASSERT(fd != NULL);
+
+    if (fd->type == FT_REGULAR || fd->type == FT_DIRECTORY)
+    {
+        rt_mutex_take(&fd->lock, RT_WAITING_FOREVER);
+    }
+}
+
+/**
+ * @ingroup Fd
+ *
+ * This function will unlock the file descriptor.
+ */
+void fd_unlock(struct dfs_fd *fd)
+{
+    RT_ASSERT(fd != NULL);
+
+    if (fd->type == FT_REGULAR || fd->type == FT_DIRECTORY)
+    {
+        rt_mutex_release(&fd->lock);
     }
-    dfs_unlock();
 }
 
 /**
@@ -313,7 +385,7 @@ int fd_is_open(const char *pathname)
         else
             mountpath = fullpath + strlen(fs->path);
 
-        dfs_lock();
+        rt_mutex_take(&fdlock, RT_WAITING_FOREVER);
 
         for (index = 0; index < fdt->maxfd; index++)
         {
@@ -324,12 +396,12 @@ int fd_is_open(const char *pathname)
             {
                 /* found file in file descriptor table */
                 rt_free(fullpath);
-                dfs_unlock();
+                rt_mutex_release(&fdlock);
 
                 return 0;
             }
         }
-        dfs_unlock();
+        rt_mutex_release(&fdlock);
 
         rt_free(fullpath);
     }
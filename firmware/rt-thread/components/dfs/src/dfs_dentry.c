@@ -0,0 +1,302 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+#include <dfs.h>
+#include <dfs_fs.h>
+#include "dfs_private.h"
+
+/*
+ * The path lookup cache: the normalized full path which doesn't exist is
+ * cached as negative entry, so opening or stating it again fails without
+ * walking the path components in the file system, such as searching the
+ * directory clusters of FAT on SD card.
+ *
+ * The existing paths are not cached, the path components are resolved by
+ * each file system and DFS has no node to cache, and mapping the path to the
+ * mounted file system is not cheaper than dfs_filesystem_lookup().
+ *
+ * The entries are keyed by the path and the mounted file system, so the file
+ * systems without device such as ramfs and romfs are cached too. The file
+ * systems whose files may appear without DFS, such as devfs and network file
+ * system, set DFS_FS_FLAG_NOCACHE. The entries are invalidated by the
+ * generation of file system when a file is created or renamed, because the
+ * file name may be case insensitive, such as FAT.
+ */
+
+#ifndef DFS_DENTRY_CACHE_SIZE
+#define DFS_DENTRY_CACHE_SIZE   32
+#endif
+
+#define DFS_DENTRY_HASH_SIZE    ((DFS_DENTRY_CACHE_SIZE + 1) / 2)
+
+struct dfs_dentry
+{
+    rt_list_t hlist;                /* the hash list */
+    rt_list_t lru;                  /* the most recently used entry is the first */
+
+    char *path;                     /* the normalized full path, RT_NULL for unused entry */
+    rt_uint32_t hash;
+    struct dfs_filesystem *fs;      /* the mounted file system of path */
+    rt_uint32_t generation;         /* the generation of file system when it's cached */
+};
+
+static struct dfs_dentry _dentry_table[DFS_DENTRY_CACHE_SIZE];
+static rt_list_t _dentry_hash[DFS_DENTRY_HASH_SIZE];
+static rt_list_t _dentry_lru;
+static rt_uint32_t _dentry_generation[DFS_FILESYSTEMS_MAX];
+
+static struct
+{
+    rt_uint32_t lookups;
+    rt_uint32_t hits;
+    rt_uint32_t stale;
+    rt_uint32_t evictions;
+} _dentry_stat;
+
+static rt_uint32_t dfs_dentry_hash(const char *path)
+{
+    rt_uint32_t hash = 0;
+
+    while (*path)
+    {
+        hash = hash * 31 + (rt_uint8_t)*path++;
+    }
+
+    return hash;
+}
+
+static struct dfs_dentry *dfs_dentry_find(const char *path, rt_uint32_t hash)
+{
+    struct dfs_dentry *dentry;
+    rt_list_t *node;
+
+    rt_list_for_each(node, &_dentry_hash[hash % DFS_DENTRY_HASH_SIZE])
+    {
+        dentry = rt_list_entry(node, struct dfs_dentry, hlist);
+        if (dentry->hash == hash && strcmp(dentry->path, path) == 0)
+        {
+            return dentry;
+        }
+    }
+
+    return RT_NULL;
+}
+
+static void dfs_dentry_release(struct dfs_dentry *dentry)
+{
+    rt_list_remove(&dentry->hlist);
+    rt_free(dentry->path);
+    dentry->path = RT_NULL;
+
+    /* reuse it firstly */
+    rt_list_remove(&dentry->lru);
+    rt_list_insert_before(&_dentry_lru, &dentry->lru);
+}
+
+static struct dfs_dentry *dfs_dentry_insert(const char *path, rt_uint32_t hash, struct dfs_filesystem *fs,
+                                            rt_uint32_t generation)
+{
+    struct dfs_dentry *dentry;
+    char *dup_path;
+
+    dup_path = rt_strdup(path);
+    if (dup_path == RT_NULL)
+    {
+        return RT_NULL;
+    }
+
+    /* replace the least recently used entry */
+    dentry = rt_list_entry(_dentry_lru.prev, struct dfs_dentry, lru);
+    if (dentry->path != RT_NULL)
+    {
+        dfs_dentry_release(dentry);
+        _dentry_stat.evictions ++;
+    }
+
+    dentry->path = dup_path;
+    dentry->hash = hash;
+    dentry->fs = fs;
+    dentry->generation = generation;
+    rt_list_insert_after(&_dentry_hash[hash % DFS_DENTRY_HASH_SIZE], &dentry->hlist);
+    rt_list_remove(&dentry->lru);
+    rt_list_insert_after(&_dentry_lru, &dentry->lru);
+
+    return dentry;
+}
+
+/**
+ * this function will initialize the path lookup cache.
+ */
+void dfs_dentry_init(void)
+{
+    int index;
+
+    rt_list_init(&_dentry_lru);
+    for (index = 0; index < DFS_DENTRY_HASH_SIZE; index ++)
+    {
+        rt_list_init(&_dentry_hash[index]);
+    }
+
+    for (index = 0; index < DFS_DENTRY_CACHE_SIZE; index ++)
+    {
+        rt_memset(&_dentry_table[index], 0, sizeof(struct dfs_dentry));
+        rt_list_init(&_dentry_table[index].hlist);
+        rt_list_insert_before(&_dentry_lru, &_dentry_table[index].lru);
+    }
+}
+
+/**
+ * this function will return the file system mounted on the normalized path,
+ * and whether the path is known as not existing by the path lookup cache.
+ *
+ * @param path the normalized full path.
+ * @param negative return whether the path is known as not existing.
+ * @param generation return the generation of file system, it's passed to
+ *                   dfs_dentry_negative() when the path isn't found.
+ *
+ * @return the found file system or NULL if no file system mounted.
+ */
+struct dfs_filesystem *dfs_dentry_lookup(const char *path, int *negative, rt_uint32_t *generation)
+{
+    struct dfs_dentry *dentry;
+    struct dfs_filesystem *fs;
+    rt_uint32_t hash;
+
+    *negative = 0;
+    *generation = 0;
+
+    fs = dfs_filesystem_lookup(path);
+    /* the files of devfs and network file system are not cached */
+    if (fs == NULL || (fs->ops->flags & DFS_FS_FLAG_NOCACHE))
+        return fs;
+
+    hash = dfs_dentry_hash(path);
+
+    dfs_lock();
+    *generation = _dentry_generation[fs - filesystem_table];
+    _dentry_stat.lookups ++;
+    dentry = dfs_dentry_find(path, hash);
+    if (dentry != RT_NULL)
+    {
+        /* the file may be created after it's cached */
+        if (dentry->fs == fs && dentry->generation == _dentry_generation[fs - filesystem_table])
+        {
+            *negative = 1;
+            _dentry_stat.hits ++;
+
+            rt_list_remove(&dentry->lru);
+            rt_list_insert_after(&_dentry_lru, &dentry->lru);
+        }
+        else
+        {
+            dfs_dentry_release(dentry);
+            _dentry_stat.stale ++;
+        }
+    }
+    dfs_unlock();
+
+    return fs;
+}
+
+/**
+ * this function will cache the path which doesn't exist.
+ *
+ * @param fs the file system mounted on the path.
+ * @param path the normalized full path.
+ * @param generation the generation returned by dfs_dentry_lookup().
+ */
+void dfs_dentry_negative(struct dfs_filesystem *fs, const char *path, rt_uint32_t generation)
+{
+    struct dfs_dentry *dentry;
+    rt_uint32_t hash;
+
+    /* the files of devfs and network file system may appear without DFS */
+    if (fs->ops->flags & DFS_FS_FLAG_NOCACHE)
+        return;
+
+    hash = dfs_dentry_hash(path);
+
+    dfs_lock();
+    /* the path may be created by another thread after it's looked up */
+    if (generation != _dentry_generation[fs - filesystem_table])
+    {
+        dfs_unlock();
+        return;
+    }
+    dentry = dfs_dentry_find(path, hash);
+    if (dentry == RT_NULL)
+    {
+        /* it's not cached if there is no memory */
+        dfs_dentry_insert(path, hash, fs, generation);
+    }
+    else
+    {
+        dentry->fs = fs;
+        dentry->generation = generation;
+    }
+    dfs_unlock();
+}
+
+/**
+ * this function will invalidate the negative entries of file system, it
+ * should be called when a file is created or renamed.
+ *
+ * @param fs the file system.
+ */
+void dfs_dentry_invalidate(struct dfs_filesystem *fs)
+{
+    dfs_lock();
+    _dentry_generation[fs - filesystem_table] ++;
+    dfs_unlock();
+}
+
+/**
+ * this function will drop all of entries, it should be called when a file
+ * system is mounted or unmounted.
+ */
+void dfs_dentry_flush(void)
+{
+    int index;
+
+    dfs_lock();
+    for (index = 0; index < DFS_DENTRY_CACHE_SIZE; index ++)
+    {
+        if (_dentry_table[index].path != RT_NULL)
+        {
+            dfs_dentry_release(&_dentry_table[index]);
+        }
+    }
+    dfs_unlock();
+}
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+int list_dentry(void)
+{
+    int index, count = 0;
+
+    dfs_lock();
+    for (index = 0; index < DFS_DENTRY_CACHE_SIZE; index ++)
+    {
+        if (_dentry_table[index].path != RT_NULL)
+            count ++;
+    }
+
+    rt_kprintf("entries       : %d/%d\n", count, DFS_DENTRY_CACHE_SIZE);
+    rt_kprintf("lookups       : %d\n", _dentry_stat.lookups);
+    rt_kprintf("hits          : %d\n", _dentry_stat.hits);
+    rt_kprintf("stale         : %d\n", _dentry_stat.stale);
+    rt_kprintf("evictions     : %d\n", _dentry_stat.evictions);
+    dfs_unlock();
+
+    return 0;
+}
+MSH_CMD_EXPORT(list_dentry, list the statistics of path lookup cache);
+#endif
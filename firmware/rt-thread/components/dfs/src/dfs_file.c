@@ -9,6 +9,7 @@
  * 2011-12-08     Bernard      Merges rename patch from iamcacy.
  * 2015-05-27     Bernard      Fix the fd clear issue.
  * 2019-01-24     Bernard      Remove file repeatedly open check.
+ * 2020-11-20     luhuadong    add path lookup cache
  */
 
 #include <dfs.h>
@@ -34,7 +35,8 @@ int dfs_file_open(struct dfs_fd *fd, const char *path, int flags)
 {
     struct dfs_filesystem *fs;
     char *fullpath;
-    int result;
+    int result, negative;
+    rt_uint32_t generation;
 
     /* parameter check */
     if (fd == NULL)
@@ -50,8 +52,8 @@ int dfs_file_open(struct dfs_fd *fd, const char *path, int flags)
     LOG_D("open file:%s", fullpath);
 
     /* find filesystem */
-    fs = dfs_filesystem_lookup(fullpath);
-    if (fs == NULL)
+    fs = dfs_dentry_lookup(fullpath, &negative, &generation);
+    if (fs == NULL || (negative && !(flags & O_CREAT)))
     {
         rt_free(fullpath); /* release path */
 
@@ -75,11 +77,18 @@ int dfs_file_open(struct dfs_fd *fd, const char *path, int flags)
             fd->path = rt_strdup("/");
         else
             fd->path = rt_strdup(dfs_subdir(fs->path, fullpath));
-        rt_free(fullpath);
         LOG_D("Actual file path: %s", fd->path);
+
+        if (fd->path == NULL)
+        {
+            rt_free(fullpath);
+
+            return -ENOMEM;
+        }
     }
     else
     {
+        /* the full path is taken over by fd */
         fd->path = fullpath;
     }
 
@@ -87,6 +96,8 @@ int dfs_file_open(struct dfs_fd *fd, const char *path, int flags)
     if (fd->fops->open == NULL)
     {
         /* clear fd */
+        if (fd->path != fullpath)
+            rt_free(fullpath);
         rt_free(fd->path);
         fd->path = NULL;
 
@@ -95,15 +106,25 @@ int dfs_file_open(struct dfs_fd *fd, const char *path, int flags)
 
     if ((result = fd->fops->open(fd)) < 0)
     {
+        LOG_D("%s open failed", fullpath);
+        if (result == -ENOENT && !(flags & O_CREAT))
+            dfs_dentry_negative(fs, fullpath, generation);
+
         /* clear fd */
+        if (fd->path != fullpath)
+            rt_free(fullpath);
         rt_free(fd->path);
         fd->path = NULL;
 
-        LOG_D("%s open failed", fullpath);
-
         return result;
     }
 
+    /* the file may be created */
+    if (flags & O_CREAT)
+        dfs_dentry_invalidate(fs);
+    if (fd->path != fullpath)
+        rt_free(fullpath);
+
     fd->flags |= DFS_F_OPEN;
     if (flags & O_DIRECTORY)
     {
@@ -238,7 +259,8 @@ int dfs_file_getdents(struct dfs_fd *fd, struct dirent *dirp, size_t nbytes)
  */
 int dfs_file_unlink(const char *path)
 {
-    int result;
+    int result, negative;
+    rt_uint32_t generation;
     char *fullpath;
     struct dfs_filesystem *fs;
 
@@ -250,7 +272,7 @@ int dfs_file_unlink(const char *path)
     }
 
     /* get filesystem */
-    if ((fs = dfs_filesystem_lookup(fullpath)) == NULL)
+    if ((fs = dfs_dentry_lookup(fullpath, &negative, &generation)) == NULL || negative)
     {
         result = -ENOENT;
         goto __exit;
@@ -274,6 +296,9 @@ int dfs_file_unlink(const char *path)
         }
         else
             result = fs->ops->unlink(fs, fullpath);
+
+        if (result == 0 || result == -ENOENT)
+            dfs_dentry_negative(fs, fullpath, generation);
     }
     else result = -ENOSYS;
 
@@ -357,7 +382,8 @@ int dfs_file_lseek(struct dfs_fd *fd, off_t offset)
  */
 int dfs_file_stat(const char *path, struct stat *buf)
 {
-    int result;
+    int result, negative;
+    rt_uint32_t generation;
     char *fullpath;
     struct dfs_filesystem *fs;
 
@@ -367,7 +393,7 @@ int dfs_file_stat(const char *path, struct stat *buf)
         return -1;
     }
 
-    if ((fs = dfs_filesystem_lookup(fullpath)) == NULL)
+    if ((fs = dfs_dentry_lookup(fullpath, &negative, &generation)) == NULL)
     {
         LOG_E("can't find mounted filesystem on this path:%s", fullpath);
         rt_free(fullpath);
@@ -375,6 +401,13 @@ int dfs_file_stat(const char *path, struct stat *buf)
         return -ENOENT;
     }
 
+    if (negative)
+    {
+        rt_free(fullpath);
+
+        return -ENOENT;
+    }
+
     if ((fullpath[0] == '/' && fullpath[1] == '\0') ||
         (dfs_subdir(fs->path, fullpath) == NULL))
     {
@@ -408,6 +441,9 @@ int dfs_file_stat(const char *path, struct stat *buf)
             result = fs->ops->stat(fs, fullpath, buf);
         else
             result = fs->ops->stat(fs, dfs_subdir(fs->path, fullpath), buf);
+
+        if (result == -ENOENT)
+            dfs_dentry_negative(fs, fullpath, generation);
     }
 
     rt_free(fullpath);
@@ -425,7 +461,8 @@ int dfs_file_stat(const char *path, struct stat *buf)
  */
 int dfs_file_rename(const char *oldpath, const char *newpath)
 {
-    int result;
+    int result, negative;
+    rt_uint32_t generation;
     struct dfs_filesystem *oldfs, *newfs;
     char *oldfullpath, *newfullpath;
 
@@ -447,8 +484,13 @@ int dfs_file_rename(const char *oldpath, const char *newpath)
         goto __exit;
     }
 
-    oldfs = dfs_filesystem_lookup(oldfullpath);
-    newfs = dfs_filesystem_lookup(newfullpath);
+    oldfs = dfs_dentry_lookup(oldfullpath, &negative, &generation);
+    if (oldfs == NULL || negative)
+    {
+        result = -ENOENT;
+        goto __exit;
+    }
+    newfs = dfs_dentry_lookup(newfullpath, &negative, &generation);
 
     if (oldfs == newfs)
     {
@@ -465,6 +507,9 @@ int dfs_file_rename(const char *oldpath, const char *newpath)
                 result = oldfs->ops->rename(oldfs,
                                             dfs_subdir(oldfs->path, oldfullpath),
                                             dfs_subdir(newfs->path, newfullpath));
+
+            /* the new path is created */
+            dfs_dentry_invalidate(oldfs);
         }
     }
     else
@@ -10,6 +10,7 @@
  * 2011-03-12     Bernard      fix the filesystem lookup issue.
  * 2017-11-30     Bernard      fix the filesystem_operation_table issue.
  * 2017-12-05     Bernard      fix the fs type search issue in mkfs.
+ * 2020-11-20     luhuadong    unmount the file system without lock
  */
 
 #include <dfs_fs.h>
@@ -293,8 +294,8 @@ int dfs_mount(const char   *device_name,
         /* check if it is an empty filesystem table entry? if it is, save fs */
         if (iter->ops == NULL)
             (fs == NULL) ? (fs = iter) : 0;
-        /* check if the PATH is mounted */
-        else if (strcmp(iter->path, path) == 0)
+        /* check if the PATH is mounted, the path is NULL while unmounting */
+        else if (iter->path != NULL && strcmp(iter->path, path) == 0)
         {
             rt_set_errno(-EINVAL);
             goto err1;
@@ -312,6 +313,8 @@ int dfs_mount(const char   *device_name,
     fs->path   = fullpath;
     fs->ops    = *ops;
     fs->dev_id = dev_id;
+    /* the cached paths may be under the new mount point */
+    dfs_dentry_flush();
     /* release filesystem_table lock */
     dfs_unlock();
 
@@ -324,6 +327,7 @@ int dfs_mount(const char   *device_name,
             /* The underlying device has error, clear the entry. */
             dfs_lock();
             memset(fs, 0, sizeof(struct dfs_filesystem));
+            dfs_dentry_flush();
 
             goto err1;
         }
@@ -340,6 +344,7 @@ int dfs_mount(const char   *device_name,
         dfs_lock();
         /* clear filesystem table entry */
         memset(fs, 0, sizeof(struct dfs_filesystem));
+        dfs_dentry_flush();
 
         goto err1;
     }
@@ -353,6 +358,51 @@ err1:
     return -1;
 }
 
+/*
+ * unmount the file system which is found with lock, the lock is released
+ * before calling the unmount of file system, because it may access the slow
+ * device and the other file systems should not be blocked.
+ */
+static int dfs_filesystem_unmount(struct dfs_filesystem *fs)
+{
+    char *path;
+
+    if (fs == NULL || fs->ops->unmount == NULL)
+    {
+        dfs_unlock();
+        return -1;
+    }
+
+    /* the file system can't be looked up while unmounting */
+    path = fs->path;
+    fs->path = NULL;
+    dfs_dentry_flush();
+    dfs_unlock();
+
+    if (fs->ops->unmount(fs) < 0)
+    {
+        dfs_lock();
+        fs->path = path;
+        dfs_unlock();
+
+        return -1;
+    }
+
+    /* close device, but do not check the status of device */
+    if (fs->dev_id != NULL)
+        rt_device_close(fs->dev_id);
+
+    if (path != NULL)
+        rt_free(path);
+
+    /* clear this filesystem table entry */
+    dfs_lock();
+    memset(fs, 0, sizeof(struct dfs_filesystem));
+    dfs_unlock();
+
+    return 0;
+}
+
 /**
  * this function will unmount a file system on specified path.
  *
@@ -388,33 +438,9 @@ int dfs_unmount(const char *specialfile)
         }
     }
 
-    if (fs == NULL ||
-        fs->ops->unmount == NULL ||
-        fs->ops->unmount(fs) < 0)
-    {
-        goto err1;
-    }
-
-    /* close device, but do not check the status of device */
-    if (fs->dev_id != NULL)
-        rt_device_close(fs->dev_id);
-
-    if (fs->path != NULL)
-        rt_free(fs->path);
-
-    /* clear this filesystem table entry */
-    memset(fs, 0, sizeof(struct dfs_filesystem));
-
-    dfs_unlock();
-    rt_free(fullpath);
-
-    return 0;
-
-err1:
-    dfs_unlock();
     rt_free(fullpath);
 
-    return -1;
+    return dfs_filesystem_unmount(fs);
 }
 
 /**
@@ -568,38 +594,15 @@ int dfs_unmount_device(rt_device_t dev)
             iter < &filesystem_table[DFS_FILESYSTEMS_MAX]; iter++)
     {
         /* check if the PATH is mounted */
-        if (strcmp(iter->dev_id->parent.name, dev->parent.name) == 0)
+        if (iter->path != NULL && iter->dev_id != NULL &&
+            strcmp(iter->dev_id->parent.name, dev->parent.name) == 0)
         {
             fs = iter;
             break;
         }
     }
 
-    if (fs == NULL ||
-        fs->ops->unmount == NULL ||
-        fs->ops->unmount(fs) < 0)
-    {
-        goto err1;
-    }
-
-    /* close device, but do not check the status of device */
-    if (fs->dev_id != NULL)
-        rt_device_close(fs->dev_id);
-
-    if (fs->path != NULL)
-        rt_free(fs->path);
-
-    /* clear this filesystem table entry */
-    memset(fs, 0, sizeof(struct dfs_filesystem));
-
-    dfs_unlock();
-
-    return 0;
-
-err1:
-    dfs_unlock();
-
-    return -1;
+    return dfs_filesystem_unmount(fs);
 }
 
 #endif
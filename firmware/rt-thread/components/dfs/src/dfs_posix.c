@@ -7,6 +7,7 @@
  * Date           Author       Notes
  * 2009-05-27     Yi.qiu       The first version
  * 2018-02-07     Bernard      Change the 3rd parameter of open/fcntl/ioctl to '...'
+ * 2020-11-20     luhuadong    serialize the file position operations by fd lock
  */
 
 #include <dfs.h>
@@ -83,7 +84,9 @@ int close(int fd)
         return -1;
     }
 
+    fd_lock(d);
     result = dfs_file_close(d);
+    fd_unlock(d);
     fd_put(d);
 
     if (result < 0)
@@ -128,7 +131,9 @@ int read(int fd, void *buf, size_t len)
         return -1;
     }
 
+    fd_lock(d);
     result = dfs_file_read(d, buf, len);
+    fd_unlock(d);
     if (result < 0)
     {
         fd_put(d);
@@ -172,7 +177,9 @@ int write(int fd, const void *buf, size_t len)
         return -1;
     }
 
+    fd_lock(d);
     result = dfs_file_write(d, buf, len);
+    fd_unlock(d);
     if (result < 0)
     {
         fd_put(d);
@@ -211,6 +218,7 @@ off_t lseek(int fd, off_t offset, int whence)
         return -1;
     }
 
+    fd_lock(d);
     switch (whence)
     {
     case SEEK_SET:
@@ -225,6 +233,7 @@ off_t lseek(int fd, off_t offset, int whence)
         break;
 
     default:
+        fd_unlock(d);
         fd_put(d);
         rt_set_errno(-EINVAL);
 
@@ -233,12 +242,14 @@ off_t lseek(int fd, off_t offset, int whence)
 
     if (offset < 0)
     {
+        fd_unlock(d);
         fd_put(d);
         rt_set_errno(-EINVAL);
 
         return -1;
     }
     result = dfs_file_lseek(d, offset);
+    fd_unlock(d);
     if (result < 0)
     {
         fd_put(d);
@@ -395,7 +406,9 @@ int fsync(int fildes)
         return -1;
     }
 
+    fd_lock(d);
     ret = dfs_file_flush(d);
+    fd_unlock(d);
 
     fd_put(d);
     return ret;
@@ -501,7 +514,9 @@ int ftruncate(int fd, off_t length)
 
         return -1;
     }
+    fd_lock(d);
     result = dfs_file_ftruncate(d, length);
+    fd_unlock(d);
     if (result < 0)
     {
         fd_put(d);
@@ -699,9 +714,11 @@ struct dirent *readdir(DIR *d)
     if (!d->num || d->cur >= d->num)
     {
         /* get a new entry */
+        fd_lock(fd);
         result = dfs_file_getdents(fd,
                                    (struct dirent *)d->buf,
                                    sizeof(d->buf) - 1);
+        fd_unlock(fd);
         if (result <= 0)
         {
             fd_put(fd);
@@ -768,8 +785,10 @@ void seekdir(DIR *d, off_t offset)
     }
 
     /* seek to the offset position of directory */
+    fd_lock(fd);
     if (dfs_file_lseek(fd, offset) >= 0)
         d->num = d->cur = 0;
+    fd_unlock(fd);
     fd_put(fd);
 }
 RTM_EXPORT(seekdir);
@@ -793,8 +812,10 @@ void rewinddir(DIR *d)
     }
 
     /* seek to the beginning of directory */
+    fd_lock(fd);
     if (dfs_file_lseek(fd, 0) >= 0)
         d->num = d->cur = 0;
+    fd_unlock(fd);
     fd_put(fd);
 }
 RTM_EXPORT(rewinddir);
@@ -820,7 +841,9 @@ int closedir(DIR *d)
         return -1;
     }
 
+    fd_lock(fd);
     result = dfs_file_close(fd);
+    fd_unlock(fd);
     fd_put(fd);
 
     fd_put(fd);
@@ -875,13 +898,12 @@ int chdir(const char *path)
         return -1; /* build path failed */
     }
 
-    dfs_lock();
+    /* the directory is checked without lock, it may access the slow device */
     d = opendir(fullpath);
     if (d == NULL)
     {
         rt_free(fullpath);
         /* this is a not exist directory */
-        dfs_unlock();
 
         return -1;
     }
@@ -890,12 +912,12 @@ int chdir(const char *path)
     closedir(d);
 
     /* copy full path to working directory */
+    dfs_lock();
     strncpy(working_directory, fullpath, DFS_PATH_MAX);
+    dfs_unlock();
     /* release normalize directory path name */
     rt_free(fullpath);
 
-    dfs_unlock();
-
     return 0;
 }
 RTM_EXPORT(chdir);
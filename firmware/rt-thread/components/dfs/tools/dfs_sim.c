@@ -0,0 +1,500 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * dfs_sim runs DFS on the host with elmfat mounted on "/" and ramfs mounted
+ * on "/ram", and prints the throughput and the latency of 1, 2 and 4 threads
+ * which open, read and close their own ramfs files, in three workloads:
+ *
+ *   ramfs    the ramfs threads only.
+ *   +write   another thread appends 512 bytes to a file on elmfat, and closes
+ *            it every time.
+ *   +chdir   another thread also changes the working directory to a directory
+ *            on elmfat and back.
+ *
+ * elmfat is formatted on an image file, the reads and writes of the SD card
+ * are pread/pwrite of the image and a sleep: 200us and 2us for each sector
+ * to read, 1ms and 4us for each sector to write. The interrupt disabling is
+ * a global mutex, rt_mutex is a recursive pthread mutex and the threads are
+ * the pthreads with the same priority. The ramfs threads check the content
+ * which is read.
+ *
+ * The latency of each open, read and close is put into a histogram of 1us
+ * slots, the average, the 99th and the 99.9th percentiles are printed. The longest one
+ * is the preemption of the host, it isn't printed.
+ *
+ * DFS, elmfat and ramfs are built into this program with the configuration
+ * in rtconfig.h. DFS selects the directory of them, e.g. a copy of another
+ * version which is saved by git archive:
+ *
+ *   DFS=..
+ *   gcc -O2 -std=gnu99 -I. -I../../../include -I../../drivers/include -I$DFS/include \
+ *       -I$DFS/filesystems/elmfat -I$DFS/filesystems/ramfs dfs_sim.c $DFS/src/dfs.c \
+ *       $DFS/src/dfs_file.c $DFS/src/dfs_fs.c $DFS/src/dfs_posix.c \
+ *       $DFS/filesystems/elmfat/dfs_elm.c $DFS/filesystems/elmfat/ff.c \
+ *       $DFS/filesystems/elmfat/option/ccsbcs.c $DFS/filesystems/ramfs/dfs_ramfs.c -o dfs_sim -lpthread
+ *
+ * usage: dfs_sim [image file] [seconds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#include <rtthread.h>
+#include <rthw.h>
+#include <dfs_posix.h>
+#include <dfs_fs.h>
+#include <dfs_ramfs.h>
+
+/* unistd.h isn't included, its read and write are not the ones of DFS */
+extern ssize_t pread(int fd, void *buf, size_t count, off_t offset);
+extern ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset);
+extern int elm_init(void);
+
+#define SIM_SECTOR_SIZE     512
+#define SIM_SECTORS         (32 * 1024)     /* 16MB */
+#define SIM_READ_US         200
+#define SIM_READ_SECTOR_US  2
+#define SIM_WRITE_US        1000
+#define SIM_WRITE_SECTOR_US 4
+
+#define SIM_THREADS_MAX     4
+#define SIM_FILE_SIZE       64
+#define SIM_SLOTS           100000          /* the histogram of 1us slots */
+
+struct sim_stat
+{
+    unsigned long ops;
+    rt_uint64_t total_ns;
+    unsigned long hist[SIM_SLOTS];
+};
+
+static struct rt_device sim_sd;
+static int sim_image;
+
+static pthread_mutex_t irq_lock;
+static __thread rt_err_t thread_errno;
+
+static volatile int running;
+static struct sim_stat stats[SIM_THREADS_MAX];
+static unsigned long writes, chdirs;
+static int thread_index[SIM_THREADS_MAX];
+static int failed;
+
+/* the stubs of kernel for DFS and the file systems */
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void *rt_realloc(void *ptr, rt_size_t size) { return realloc(ptr, size); }
+void *rt_calloc(rt_size_t count, rt_size_t size) { return calloc(count, size); }
+void rt_free(void *ptr) { free(ptr); }
+char *rt_strdup(const char *s) { return strdup(s); }
+void *rt_memset(void *s, int c, rt_ubase_t count) { return memset(s, c, count); }
+rt_size_t rt_strlen(const char *s) { return strlen(s); }
+rt_int32_t rt_strcmp(const char *cs, const char *ct) { return strcmp(cs, ct); }
+rt_int32_t rt_strncmp(const char *cs, const char *ct, rt_ubase_t count) { return strncmp(cs, ct, count); }
+
+char *rt_strncpy(char *dst, const char *src, rt_ubase_t n)
+{
+    rt_ubase_t i;
+
+    for (i = 0; i < n && src[i]; i++)
+        dst[i] = src[i];
+    for (; i < n; i++)
+        dst[i] = '\0';
+
+    return dst;
+}
+
+rt_int32_t rt_snprintf(char *buf, rt_size_t size, const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    va_start(args, fmt);
+    n = vsnprintf(buf, size, fmt, args);
+    va_end(args);
+
+    return n;
+}
+
+void rt_set_errno(rt_err_t error) { thread_errno = error; }
+void rt_object_detach(rt_object_t object) { }
+
+void rt_assert_handler(const char *ex, const char *func, rt_size_t line)
+{
+    fprintf(stderr, "(%s) assertion failed at function:%s, line number:%d\n", ex, func, (int)line);
+    abort();
+}
+
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    pthread_mutex_lock(&irq_lock);
+
+    return 0;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+    pthread_mutex_unlock(&irq_lock);
+}
+
+/* the pthread mutex is kept in the name of object, it's as large as a pointer */
+static pthread_mutex_t *sim_mutex(rt_mutex_t mutex)
+{
+    pthread_mutex_t *m;
+
+    memcpy(&m, mutex->parent.parent.name, sizeof(m));
+
+    return m;
+}
+
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutex_t *m;
+
+    m = malloc(sizeof(*m));
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(m, &attr);
+    memcpy(mutex->parent.parent.name, &m, sizeof(m));
+
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_detach(rt_mutex_t mutex)
+{
+    pthread_mutex_destroy(sim_mutex(mutex));
+    free(sim_mutex(mutex));
+
+    return RT_EOK;
+}
+
+rt_mutex_t rt_mutex_create(const char *name, rt_uint8_t flag)
+{
+    rt_mutex_t mutex = malloc(sizeof(*mutex));
+
+    rt_mutex_init(mutex, name, flag);
+
+    return mutex;
+}
+
+rt_err_t rt_mutex_delete(rt_mutex_t mutex)
+{
+    rt_mutex_detach(mutex);
+    free(mutex);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
+{
+    pthread_mutex_lock(sim_mutex(mutex));
+
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_release(rt_mutex_t mutex)
+{
+    pthread_mutex_unlock(sim_mutex(mutex));
+
+    return RT_EOK;
+}
+
+/* ramfs allocates from its memheap, the memheap is the heap of host */
+rt_err_t rt_memheap_init(struct rt_memheap *memheap, const char *name, void *start_addr, rt_size_t size)
+{
+    return RT_EOK;
+}
+
+void *rt_memheap_alloc(struct rt_memheap *heap, rt_size_t size) { return malloc(size); }
+void *rt_memheap_realloc(struct rt_memheap *heap, void *ptr, rt_size_t newsize) { return realloc(ptr, newsize); }
+void rt_memheap_free(void *ptr) { free(ptr); }
+
+/* the SD card is the image file */
+static void sim_sleep_us(long us)
+{
+    struct timespec ts = { us / 1000000, us % 1000000 * 1000 };
+
+    nanosleep(&ts, NULL);
+}
+
+rt_device_t rt_device_find(const char *name)
+{
+    return strcmp(name, "sd0") == 0 ? &sim_sd : RT_NULL;
+}
+
+rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag) { return RT_EOK; }
+rt_err_t rt_device_close(rt_device_t dev) { return RT_EOK; }
+
+rt_size_t rt_device_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    sim_sleep_us(SIM_READ_US + SIM_READ_SECTOR_US * size);
+    if (pread(sim_image, buffer, size * SIM_SECTOR_SIZE, (off_t)pos * SIM_SECTOR_SIZE) != (ssize_t)(size * SIM_SECTOR_SIZE))
+        return 0;
+
+    return size;
+}
+
+rt_size_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    sim_sleep_us(SIM_WRITE_US + SIM_WRITE_SECTOR_US * size);
+    if (pwrite(sim_image, buffer, size * SIM_SECTOR_SIZE, (off_t)pos * SIM_SECTOR_SIZE) != (ssize_t)(size * SIM_SECTOR_SIZE))
+        return 0;
+
+    return size;
+}
+
+rt_err_t rt_device_control(rt_device_t dev, int cmd, void *args)
+{
+    struct rt_device_blk_geometry *geometry = args;
+
+    if (cmd == RT_DEVICE_CTRL_BLK_GETGEOME)
+    {
+        geometry->sector_count = SIM_SECTORS;
+        geometry->bytes_per_sector = SIM_SECTOR_SIZE;
+        geometry->block_size = SIM_SECTOR_SIZE;
+    }
+
+    return RT_EOK;
+}
+
+static rt_uint64_t sim_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (rt_uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sim_path(char *path, int index)
+{
+    rt_snprintf(path, DFS_PATH_MAX, "/ram/r%d.txt", index);
+}
+
+static void sim_content(char *buf, int index)
+{
+    int i;
+
+    for (i = 0; i < SIM_FILE_SIZE; i++)
+        buf[i] = 'a' + (index + i) % 26;
+}
+
+static void *sim_ramfs_thread(void *param)
+{
+    int index = *(int *)param;
+    struct sim_stat *stat = &stats[index];
+    char path[DFS_PATH_MAX], expected[SIM_FILE_SIZE], buf[SIM_FILE_SIZE];
+    rt_uint64_t start, ns;
+    int fd, len;
+
+    sim_path(path, index);
+    sim_content(expected, index);
+    while (running)
+    {
+        start = sim_now_ns();
+        fd = open(path, O_RDONLY, 0);
+        len = fd >= 0 ? read(fd, buf, sizeof(buf)) : -1;
+        if (fd >= 0)
+            close(fd);
+        ns = sim_now_ns() - start;
+
+        if (len != SIM_FILE_SIZE || memcmp(buf, expected, SIM_FILE_SIZE) != 0)
+        {
+            if (!failed)
+                printf("thread %d: read %d bytes of %s\n", index, len, path);
+            failed = 1;
+        }
+        stat->ops++;
+        stat->total_ns += ns;
+        stat->hist[ns / 1000 < SIM_SLOTS ? ns / 1000 : SIM_SLOTS - 1]++;
+    }
+
+    return NULL;
+}
+
+static void *sim_write_thread(void *param)
+{
+    char buf[SIM_SECTOR_SIZE];
+    int fd;
+
+    memset(buf, 'w', sizeof(buf));
+    while (running)
+    {
+        fd = open("/log.txt", O_WRONLY | O_CREAT | O_APPEND, 0);
+        if (fd < 0 || write(fd, buf, sizeof(buf)) != sizeof(buf))
+        {
+            if (!failed)
+                printf("failed to append /log.txt\n");
+            failed = 1;
+        }
+        if (fd >= 0)
+            close(fd);
+        writes++;
+
+        /* restart the log when it's 1MB */
+        if (writes % 2048 == 0)
+            unlink("/log.txt");
+    }
+
+    return NULL;
+}
+
+static void *sim_chdir_thread(void *param)
+{
+    while (running)
+    {
+        if (chdir("/dir") != 0 || chdir("/") != 0)
+        {
+            if (!failed)
+                printf("failed to change directory\n");
+            failed = 1;
+        }
+        chdirs++;
+    }
+
+    return NULL;
+}
+
+/* returns the time of the given percentile of all ramfs operations in us */
+static unsigned long sim_percentile(int threads, double percentile)
+{
+    unsigned long total = 0, count = 0;
+    int slot, index;
+
+    for (index = 0; index < threads; index++)
+        total += stats[index].ops;
+    for (slot = 0; slot < SIM_SLOTS - 1; slot++)
+    {
+        for (index = 0; index < threads; index++)
+            count += stats[index].hist[slot];
+        if (count >= total * percentile)
+            break;
+    }
+
+    return slot;
+}
+
+static void sim_run(const char *name, int threads, int writer, int changer, double seconds)
+{
+    pthread_t tids[SIM_THREADS_MAX], write_tid, chdir_tid;
+    unsigned long ops = 0;
+    rt_uint64_t total_ns = 0;
+    int index;
+
+    memset(stats, 0, sizeof(stats));
+    writes = chdirs = 0;
+    running = 1;
+    if (writer)
+        pthread_create(&write_tid, NULL, sim_write_thread, NULL);
+    if (changer)
+        pthread_create(&chdir_tid, NULL, sim_chdir_thread, NULL);
+    for (index = 0; index < threads; index++)
+    {
+        thread_index[index] = index;
+        pthread_create(&tids[index], NULL, sim_ramfs_thread, &thread_index[index]);
+    }
+
+    sim_sleep_us((long)(seconds * 1000000));
+    running = 0;
+    for (index = 0; index < threads; index++)
+        pthread_join(tids[index], NULL);
+    if (writer)
+        pthread_join(write_tid, NULL);
+    if (changer)
+        pthread_join(chdir_tid, NULL);
+
+    for (index = 0; index < threads; index++)
+    {
+        ops += stats[index].ops;
+        total_ns += stats[index].total_ns;
+    }
+    printf("%-8s %7d %10.0f %8.1f %8lu %8lu %9.1f %9.1f\n", name, threads, ops / seconds,
+           ops ? (double)total_ns / ops / 1000 : 0.0, sim_percentile(threads, 0.99), sim_percentile(threads, 0.999),
+           writes / seconds, chdirs / seconds);
+}
+
+static void sim_fail(const char *msg)
+{
+    printf("FAIL, %s\n", msg);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *image = "dfs_sim.img";
+    char path[DFS_PATH_MAX], buf[SIM_FILE_SIZE];
+    pthread_mutexattr_t attr;
+    double seconds = 1.0;
+    FILE *file;
+    int threads, index, fd;
+
+    if (argc > 1)
+        image = argv[1];
+    if (argc > 2)
+        seconds = atof(argv[2]);
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&irq_lock, &attr);
+
+    /* the file functions of host are hidden by the ones of DFS, stdio is used */
+    file = fopen(image, "w+b");
+    if (file == NULL)
+        sim_fail("can't create the image");
+    if (fseek(file, (long)SIM_SECTORS * SIM_SECTOR_SIZE - 1, SEEK_SET) != 0 || fputc(0, file) == EOF
+            || fflush(file) != 0)
+        sim_fail("can't resize the image");
+    sim_image = fileno(file);
+
+    dfs_init();
+    elm_init();
+    dfs_ramfs_init();
+    /* elmfat is the root, the ramfs of old version has no directory to mount on */
+    if (dfs_mkfs("elm", "sd0") != 0 || dfs_mount("sd0", "/", "elm", 0, 0) != 0)
+        sim_fail("can't format and mount elmfat");
+    if (mkdir("/dir", 0) != 0 || mkdir("/ram", 0) != 0)
+        sim_fail("can't create the directories on elmfat");
+    if (dfs_mount(RT_NULL, "/ram", "ram", 0, dfs_ramfs_create(malloc(1024 * 1024), 1024 * 1024)) != 0)
+        sim_fail("can't mount ramfs");
+
+    for (index = 0; index < SIM_THREADS_MAX; index++)
+    {
+        sim_path(path, index);
+        sim_content(buf, index);
+        fd = open(path, O_WRONLY | O_CREAT, 0);
+        if (fd < 0 || write(fd, buf, sizeof(buf)) != sizeof(buf))
+            sim_fail("can't create the ramfs files");
+        close(fd);
+    }
+
+    printf("%.1fs each, SD read %dus + %dus/sector, write %dus + %dus/sector\n\n", seconds,
+           SIM_READ_US, SIM_READ_SECTOR_US, SIM_WRITE_US, SIM_WRITE_SECTOR_US);
+    printf("%-8s %7s %10s %8s %8s %8s %9s %9s\n", "workload", "threads", "ramfs/s", "avg us", "99% us", "99.9% us",
+           "writes/s", "chdirs/s");
+    for (threads = 1; threads <= SIM_THREADS_MAX; threads *= 2)
+        sim_run("ramfs", threads, 0, 0, seconds);
+    for (threads = 1; threads <= SIM_THREADS_MAX; threads *= 2)
+        sim_run("+write", threads, 1, 0, seconds);
+    for (threads = 1; threads <= SIM_THREADS_MAX; threads *= 2)
+        sim_run("+chdir", threads, 1, 1, seconds);
+
+    dfs_unmount("/ram");
+    dfs_unmount("/");
+    fclose(file);
+    printf("\n%s\n", failed ? "FAIL" : "PASS");
+
+    return failed;
+}
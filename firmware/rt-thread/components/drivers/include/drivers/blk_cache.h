@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+#ifndef __BLK_CACHE_H__
+#define __BLK_CACHE_H__
+
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the statistics of block cache, got by RT_DEVICE_CTRL_BLK_CACHE_STAT */
+struct rt_blk_cache_stat
+{
+    rt_uint32_t blocks;             /* the number of cached sectors */
+    rt_uint32_t dirty;              /* the dirty sectors */
+
+    rt_uint32_t hits;               /* the sectors which are read or written in cache */
+    rt_uint32_t misses;             /* the sectors which are read from device */
+    rt_uint32_t read_ahead;         /* the sectors which are read ahead */
+    rt_uint32_t write_back;         /* the sectors which are written back to device */
+    rt_uint32_t write_through;      /* the sectors which are written to device directly */
+};
+
+/*
+ * The block cache device is a block device over another one, such as:
+ *
+ *     rt_blk_cache_create("sd0c", "sd0", 64);
+ *     dfs_mount("sd0c", "/", "elm", 0, 0);
+ *
+ * The dirty sectors are written back on eviction, RT_DEVICE_CTRL_BLK_SYNC,
+ * close and every RT_BLK_CACHE_FLUSH_PERIOD milliseconds.
+ */
+rt_device_t rt_blk_cache_create(const char *name, const char *blk_name, rt_uint32_t blocks);
+rt_err_t rt_blk_cache_destroy(rt_device_t dev);
+rt_err_t rt_blk_cache_flush(rt_device_t dev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BLK_CACHE_H__ */
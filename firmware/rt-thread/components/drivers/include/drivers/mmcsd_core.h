@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author		Notes
  * 2011-07-25     weety		first version
+ * 2020-11-20     luhuadong	add the statistics of block device
  */
 
 #ifndef __CORE_H__
@@ -234,6 +235,19 @@ struct rt_mmcsd_host *mmcsd_alloc_host(void);
 void mmcsd_free_host(struct rt_mmcsd_host *host);
 int rt_mmcsd_core_init(void);
 
+/* the statistics of mmcsd block device, got by RT_DEVICE_CTRL_BLK_MMCSD_STAT */
+struct rt_mmcsd_blk_stat {
+	rt_uint32_t	read_reqs;		/* the read requests sent to card */
+	rt_uint32_t	read_blocks;
+	rt_tick_t	read_ticks;		/* the total latency of read requests */
+	rt_tick_t	read_max_ticks;
+	rt_uint32_t	write_reqs;		/* the write requests sent to card */
+	rt_uint32_t	write_blocks;
+	rt_tick_t	write_ticks;		/* the total latency of write requests */
+	rt_tick_t	write_max_ticks;
+	rt_uint32_t	merged;			/* the writes merged into the pending request */
+};
+
 int rt_mmcsd_blk_init(void);
 rt_int32_t rt_mmcsd_blk_probe(struct rt_mmcsd_card *card);
 void rt_mmcsd_blk_remove(struct rt_mmcsd_card *card);
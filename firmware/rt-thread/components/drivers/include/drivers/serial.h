@@ -9,6 +9,8 @@
  * 2012-05-28     bernard      change interfaces
  * 2013-02-20     bernard      use RT_SERIAL_RB_BUFSZ to define
  *                             the size of ring buffer.
+ * 2020-11-17     luhuadong    add writev and interrupt tx ring buffer
+ * 2020-11-18     luhuadong    add rx peek/consume, rx notify threshold and rx statistics
  */
 
 #ifndef __SERIAL_H__
@@ -62,7 +64,7 @@
 #define RT_SERIAL_EVENT_TX_DONE         0x02    /* Tx complete   */
 #define RT_SERIAL_EVENT_RX_DMADONE      0x03    /* Rx DMA transfer done */
 #define RT_SERIAL_EVENT_TX_DMADONE      0x04    /* Tx DMA transfer done */
-#define RT_SERIAL_EVENT_RX_TIMEOUT      0x05    /* Rx timeout    */
+#define RT_SERIAL_EVENT_RX_TIMEOUT      0x05    /* Rx timeout, the line is idle. In DMA rx mode, the new received length is in bit 8~31 as Rx DMA done */
 
 #define RT_SERIAL_DMA_RX                0x01
 #define RT_SERIAL_DMA_TX                0x02
@@ -70,6 +72,9 @@
 #define RT_SERIAL_RX_INT                0x01
 #define RT_SERIAL_TX_INT                0x02
 
+#define RT_SERIAL_CTRL_SET_RX_NOTIFY    0x20    /* set the rx notify threshold, the arg is the bytes */
+#define RT_SERIAL_CTRL_GET_RX_STATS     0x21    /* get rx statistics, the arg is struct rt_serial_rx_stats * */
+
 #define RT_SERIAL_ERR_OVERRUN           0x01
 #define RT_SERIAL_ERR_FRAMING           0x02
 #define RT_SERIAL_ERR_PARITY            0x03
@@ -77,6 +82,15 @@
 #define RT_SERIAL_TX_DATAQUEUE_SIZE     2048
 #define RT_SERIAL_TX_DATAQUEUE_LWM      30
 
+/* the max number of pending segments in DMA tx mode */
+#define RT_SERIAL_TX_DMA_SEGMENTS       8
+/* every pending writev pushing data has one segment in queue at least, except the one is pushing */
+#define RT_SERIAL_TX_NOTIFY_NUM         (RT_SERIAL_TX_DMA_SEGMENTS + 2)
+
+#ifndef RT_SERIAL_TX_RB_BUFSZ
+#define RT_SERIAL_TX_RB_BUFSZ           128
+#endif
+
 /* Default config for serial_configure structure */
 #define RT_SERIAL_CONFIG_DEFAULT           \
 {                                          \
@@ -119,6 +133,10 @@ struct rt_serial_rx_fifo
 struct rt_serial_tx_fifo
 {
     struct rt_completion completion;
+#ifdef RT_SERIAL_USING_TX_RB
+    /* software fifo, it's drained by the tx done interrupt */
+    struct rt_ringbuffer rb;
+#endif
 };
 
 /* 
@@ -129,10 +147,46 @@ struct rt_serial_rx_dma
     rt_bool_t activated;
 };
 
+struct rt_serial_tx_notify
+{
+    void (*tx_done)(rt_device_t dev, void *user_data);
+    void *user_data;
+    /* it's invoked when the number of transmitted segments reaches this */
+    rt_uint32_t segment;
+    /* the times to invoke, the same callback of the writes pushing nothing is merged */
+    rt_uint32_t count;
+};
+
 struct rt_serial_tx_dma
 {
     rt_bool_t activated;
     struct rt_data_queue data_queue;
+
+    /* keep the segments of one write in order */
+    struct rt_mutex lock;
+    rt_uint32_t push_count;
+    rt_uint32_t done_count;
+
+    /* the callbacks of writev */
+    struct rt_serial_tx_notify notify[RT_SERIAL_TX_NOTIFY_NUM];
+    rt_uint8_t notify_get;
+    rt_uint8_t notify_put;
+};
+
+/* the segment of rt_serial_writev */
+struct rt_serial_iovec
+{
+    const void *buf;
+    rt_size_t len;
+};
+
+struct rt_serial_rx_stats
+{
+    rt_uint32_t rx_bytes;       /* received bytes */
+    rt_uint32_t rx_events;      /* rx interrupt events */
+    rt_uint32_t rx_notify;      /* times of rx_indicate */
+    rt_uint32_t rx_overrun;     /* times of rx fifo overrun */
+    rt_uint32_t rx_dropped;     /* bytes dropped by rx fifo overrun */
 };
 
 struct rt_serial_device
@@ -144,6 +198,13 @@ struct rt_serial_device
 
     void *serial_rx;
     void *serial_tx;
+
+    /*
+     * rx_indicate is invoked when the received data reaches this, or the line
+     * is idle (RT_SERIAL_EVENT_RX_TIMEOUT). It's 1 by default.
+     */
+    rt_uint16_t rx_notify_threshold;
+    struct rt_serial_rx_stats rx_stats;
 };
 typedef struct rt_serial_device rt_serial_t;
 
@@ -163,6 +224,11 @@ struct rt_uart_ops
 
 void rt_hw_serial_isr(struct rt_serial_device *serial, int event);
 
+rt_size_t rt_serial_rx_peek(rt_device_t dev, rt_uint8_t **ptr);
+rt_size_t rt_serial_rx_consume(rt_device_t dev, rt_size_t length);
+rt_size_t rt_serial_writev(rt_device_t dev, const struct rt_serial_iovec *iov, int iovcnt,
+                           void (*tx_done)(rt_device_t dev, void *user_data), void *user_data);
+
 rt_err_t rt_hw_serial_register(struct rt_serial_device *serial,
                                const char              *name,
                                rt_uint32_t              flag,
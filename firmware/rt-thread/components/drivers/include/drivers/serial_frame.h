@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-19     luhuadong    the first version
+ */
+
+#ifndef __SERIAL_FRAME_H__
+#define __SERIAL_FRAME_H__
+
+#include <rtthread.h>
+#include <rtdevice.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The format of frame, such as the PMS series particle sensors:
+ *
+ *     static const rt_uint8_t pms_header[] = {0x42, 0x4D};
+ *     static const struct rt_serial_frame_desc pms_desc =
+ *     {
+ *         pms_header, 2,      header
+ *         2, 2, 4,            16 bits length at offset 2, frame length = length + 4
+ *         8, 64,              the range of frame length
+ *         rt_serial_frame_check_sum16,
+ *     };
+ */
+struct rt_serial_frame_desc
+{
+    const rt_uint8_t *header;   /* the sync header */
+    rt_uint8_t header_len;
+
+    rt_uint8_t len_offset;      /* the offset of length field */
+    rt_uint8_t len_size;        /* the size of big-endian length field: 0, 1 or 2, 0 for fixed length frame */
+    rt_int8_t  len_adjust;      /* the frame length = the value of length field + len_adjust */
+
+    rt_uint16_t frame_min;      /* the min frame length */
+    rt_uint16_t frame_max;      /* the max frame length, it's the frame length of fixed length frame */
+
+    /* check the whole frame, such as the checksum, RT_NULL if it's not needed */
+    rt_bool_t (*check)(const rt_uint8_t *frame, rt_size_t length);
+};
+
+struct rt_serial_frame
+{
+    const struct rt_serial_frame_desc *desc;
+
+    rt_uint8_t *buf;            /* frame_max bytes */
+    rt_uint16_t pos;            /* the received bytes of current frame */
+    rt_uint16_t frame_len;      /* the length of current frame, 0 if it's unknown */
+
+    /* invoked with the validated frame, it's in ISR when the frame is attached to a serial device */
+    void (*frame_ind)(struct rt_serial_frame *frame, const rt_uint8_t *data, rt_size_t length);
+    void *user_data;
+
+    rt_device_t serial;         /* the attached serial device */
+    rt_slist_t list;
+    /* the rx_indicate of serial device before attaching */
+    rt_err_t (*rx_indicate)(rt_device_t dev, rt_size_t size);
+
+    /* statistics */
+    rt_uint32_t frames;         /* validated frames */
+    rt_uint32_t check_errors;   /* frames which failed to check */
+    rt_uint32_t skipped;        /* bytes which are skipped to resync */
+};
+typedef struct rt_serial_frame *rt_serial_frame_t;
+
+void rt_serial_frame_init(rt_serial_frame_t frame, const struct rt_serial_frame_desc *desc, rt_uint8_t *buf,
+                          void (*frame_ind)(rt_serial_frame_t frame, const rt_uint8_t *data, rt_size_t length),
+                          void *user_data);
+void rt_serial_frame_reset(rt_serial_frame_t frame);
+void rt_serial_frame_feed(rt_serial_frame_t frame, const rt_uint8_t *data, rt_size_t length);
+
+rt_err_t rt_serial_frame_attach(rt_serial_frame_t frame, rt_device_t serial);
+rt_err_t rt_serial_frame_detach(rt_serial_frame_t frame);
+
+rt_bool_t rt_serial_frame_check_sum16(const rt_uint8_t *frame, rt_size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SERIAL_FRAME_H__ */
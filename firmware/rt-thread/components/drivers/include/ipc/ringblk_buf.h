@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-08-25     armink       the first version
+ * 2020-11-17     luhuadong    add free block list, block alignment and batch get/free
  */
 
 #ifndef _RINGBLK_BUF_H_
@@ -51,6 +52,7 @@ typedef struct rt_rbb_blk *rt_rbb_blk_t;
 
 /**
  * Rbb block queue: the blocks (from block1->buf to blockn->buf) memory which on this queue is continuous.
+ * The blocks are linked by the list node, from the first block.
  */
 struct rt_rbb_blk_queue
 {
@@ -71,6 +73,12 @@ struct rt_rbb
     rt_size_t blk_max_num;
     /* saved the initialized and put status blocks */
     rt_slist_t blk_list;
+    /* the last block on blk_list */
+    rt_rbb_blk_t blk_tail;
+    /* saved the unused status blocks */
+    rt_slist_t free_list;
+    /* the alignment of block buffer address, such as the cache line size for DMA */
+    rt_size_t blk_align;
 };
 typedef struct rt_rbb *rt_rbb_t;
 
@@ -79,6 +87,7 @@ void rt_rbb_init(rt_rbb_t rbb, rt_uint8_t *buf, rt_size_t buf_size, rt_rbb_blk_t
 rt_rbb_t rt_rbb_create(rt_size_t buf_size, rt_size_t blk_max_num);
 void rt_rbb_destroy(rt_rbb_t rbb);
 rt_size_t rt_rbb_get_buf_size(rt_rbb_t rbb);
+void rt_rbb_set_blk_align(rt_rbb_t rbb, rt_size_t align);
 
 /* rbb block API */
 rt_rbb_blk_t rt_rbb_blk_alloc(rt_rbb_t rbb, rt_size_t blk_size);
@@ -87,6 +96,8 @@ rt_rbb_blk_t rt_rbb_blk_get(rt_rbb_t rbb);
 rt_size_t rt_rbb_blk_size(rt_rbb_blk_t block);
 rt_uint8_t *rt_rbb_blk_buf(rt_rbb_blk_t block);
 void rt_rbb_blk_free(rt_rbb_t rbb, rt_rbb_blk_t block);
+rt_size_t rt_rbb_blk_get_batch(rt_rbb_t rbb, rt_rbb_blk_t *blocks, rt_size_t num);
+void rt_rbb_blk_free_batch(rt_rbb_t rbb, rt_rbb_blk_t *blocks, rt_size_t num);
 
 /* rbb block queue API */
 rt_size_t rt_rbb_blk_queue_get(rt_rbb_t rbb, rt_size_t queue_data_len, rt_rbb_blk_queue_t blk_queue);
@@ -5,6 +5,7 @@
  *
  * Change Logs:
  * Date           Author       Notes
+ * 2020-11-16     luhuadong    add peek/consume and the lock-free multi-producer ringbuffer
  */
 #ifndef RINGBUFFER_H__
 #define RINGBUFFER_H__
@@ -50,6 +51,31 @@ struct rt_ringbuffer
     rt_int16_t buffer_size;
 };
 
+/*
+ * Lock-free multi-producer ring buffer
+ *
+ * The data is stored as records, every record has a 4 bytes header and is
+ * contiguous in the buffer. The producers (threads or ISRs) reserve the space
+ * by a CAS on write_index, fill it in place and commit it. The records could be
+ * committed out of order, the consumer stops at the first uncommitted record,
+ * so an ISR never waits for the thread which is preempted by it.
+ *
+ * There is only one consumer at the same time, the multiple consumers should
+ * be serialized by the caller.
+ */
+struct rt_ringbuffer_mp
+{
+    rt_uint8_t *buffer_ptr;
+    rt_uint32_t buffer_mask;            /* buffer size - 1, the size is power of two */
+
+    /* free running index */
+    volatile rt_uint32_t write_index;   /* the end of reserved records */
+    volatile rt_uint32_t read_index;    /* the end of released records */
+};
+
+/* the max length of one record */
+#define RT_RINGBUFFER_MP_RECORD_MAX     0x7FFF
+
 enum rt_ringbuffer_state
 {
     RT_RINGBUFFER_EMPTY,
@@ -74,11 +100,31 @@ rt_size_t rt_ringbuffer_get(struct rt_ringbuffer *rb, rt_uint8_t *ptr, rt_uint16
 rt_size_t rt_ringbuffer_getchar(struct rt_ringbuffer *rb, rt_uint8_t *ch);
 rt_size_t rt_ringbuffer_data_len(struct rt_ringbuffer *rb);
 
+rt_size_t rt_ringbuffer_peek(struct rt_ringbuffer *rb, rt_uint8_t **ptr);
+rt_size_t rt_ringbuffer_consume(struct rt_ringbuffer *rb, rt_uint16_t length);
+
 #ifdef RT_USING_HEAP
 struct rt_ringbuffer* rt_ringbuffer_create(rt_uint16_t length);
 void rt_ringbuffer_destroy(struct rt_ringbuffer *rb);
 #endif
 
+void rt_ringbuffer_mp_init(struct rt_ringbuffer_mp *rb, rt_uint8_t *pool, rt_uint32_t size);
+void rt_ringbuffer_mp_reset(struct rt_ringbuffer_mp *rb);
+void *rt_ringbuffer_mp_reserve(struct rt_ringbuffer_mp *rb, rt_uint16_t length);
+void rt_ringbuffer_mp_commit(struct rt_ringbuffer_mp *rb, void *ptr, rt_uint16_t length);
+void *rt_ringbuffer_mp_peek(struct rt_ringbuffer_mp *rb, rt_uint16_t *length);
+void rt_ringbuffer_mp_release(struct rt_ringbuffer_mp *rb, void *ptr);
+rt_size_t rt_ringbuffer_mp_put(struct rt_ringbuffer_mp *rb, const rt_uint8_t *ptr, rt_uint16_t length);
+rt_size_t rt_ringbuffer_mp_get(struct rt_ringbuffer_mp *rb, rt_uint8_t *ptr, rt_uint16_t length);
+
+#ifdef RT_USING_HEAP
+struct rt_ringbuffer_mp *rt_ringbuffer_mp_create(rt_uint32_t size);
+void rt_ringbuffer_mp_destroy(struct rt_ringbuffer_mp *rb);
+#endif
+
+/** return the size of reserved space in rb, it includes the record headers */
+#define rt_ringbuffer_mp_data_len(rb) ((rt_size_t)((rb)->write_index - (rb)->read_index))
+
 rt_inline rt_uint16_t rt_ringbuffer_get_size(struct rt_ringbuffer *rb)
 {
     RT_ASSERT(rb != RT_NULL);
@@ -5,6 +5,8 @@
  *
  * Change Logs:
  * Date           Author       Notes
+ * 2020-11-16     luhuadong    add worker pool, work priority and batched
+ *                             timer for delayed work
  */
 #ifndef WORKQUEUE_H__
 #define WORKQUEUE_H__
@@ -25,14 +27,42 @@ enum
     RT_WORK_TYPE_DELAYED     = 0x0001,
 };
 
+/* the priority of work, the smaller value has the higher priority */
+#define RT_WORK_PRIORITY_HIGHEST    0
+#define RT_WORK_PRIORITY_DEFAULT    128
+
 /* workqueue implementation */
+struct rt_workqueue_worker
+{
+    rt_list_t      work_list;       /* works of this worker, sorted by priority */
+    struct rt_work *work_current;   /* current work */
+
+    rt_thread_t    work_thread;
+};
+
 struct rt_workqueue
 {
-    rt_list_t      work_list;
-    struct rt_work *work_current; /* current work */
+    char           name[RT_NAME_MAX];
+    rt_list_t      list;            /* node on the workqueue list */
+
+    struct rt_workqueue_worker *workers;
+    rt_uint8_t     worker_num;
+    rt_uint8_t     worker_next;     /* the next worker to put work on when all are busy */
+
+    rt_list_t      delayed_list;    /* delayed works, sorted by timeout tick */
+    struct rt_timer delayed_timer;  /* one timer for all delayed works */
 
     struct rt_semaphore sem;
-    rt_thread_t    work_thread;
+
+    /* statistics */
+    rt_uint32_t    submitted;
+    rt_uint32_t    completed;
+    rt_uint32_t    stolen;          /* works which are taken from the other worker */
+    rt_uint16_t    depth;           /* number of pending works */
+    rt_uint16_t    depth_max;
+    rt_tick_t      latency_max;     /* ticks from submitted to started */
+    rt_uint32_t    latency_total;
+    rt_tick_t      exec_max;        /* ticks of work function */
 };
 
 struct rt_work
@@ -43,7 +73,9 @@ struct rt_work
     void *work_data;
     rt_uint16_t flags;
     rt_uint16_t type;
-    struct rt_timer timer;
+    rt_uint8_t  priority;
+    rt_tick_t   timeout_tick;       /* for delayed work */
+    rt_tick_t   submit_tick;
     struct rt_workqueue *workqueue;
 };
 
@@ -57,6 +89,8 @@ struct rt_delayed_work
  * WorkQueue for DeviceDriver
  */
 struct rt_workqueue *rt_workqueue_create(const char *name, rt_uint16_t stack_size, rt_uint8_t priority);
+struct rt_workqueue *rt_workqueue_create_pool(const char *name, rt_uint16_t stack_size, rt_uint8_t priority,
+                                              rt_uint8_t worker_num);
 rt_err_t rt_workqueue_destroy(struct rt_workqueue *queue);
 rt_err_t rt_workqueue_dowork(struct rt_workqueue *queue, struct rt_work *work);
 rt_err_t rt_workqueue_submit_work(struct rt_workqueue *queue, struct rt_work *work, rt_tick_t time);
@@ -77,6 +111,13 @@ rt_inline void rt_work_init(struct rt_work *work, void (*work_func)(struct rt_wo
     work->workqueue = RT_NULL;
     work->flags = 0;
     work->type = 0;
+    work->priority = RT_WORK_PRIORITY_DEFAULT;
+}
+
+/* set the priority of work, it takes effect on the next submitting */
+rt_inline void rt_work_set_priority(struct rt_work *work, rt_uint8_t priority)
+{
+    work->priority = priority;
 }
 
 void rt_delayed_work_init(struct rt_delayed_work *work, void (*work_func)(struct rt_work *work,
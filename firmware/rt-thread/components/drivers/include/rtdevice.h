@@ -58,6 +58,9 @@ extern "C" {
 
 #ifdef RT_USING_SERIAL
 #include "drivers/serial.h"
+#ifdef RT_SERIAL_USING_FRAME
+#include "drivers/serial_frame.h"
+#endif /* RT_SERIAL_USING_FRAME */
 #endif /* RT_USING_SERIAL */
 
 #ifdef RT_USING_I2C
@@ -138,6 +141,10 @@ extern "C" {
 #include "drivers/rt_inputcapture.h"
 #endif
 
+#ifdef RT_USING_BLK_CACHE
+#include "drivers/blk_cache.h"
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,682 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <drivers/blk_cache.h>
+
+#define DBG_TAG    "blk.cache"
+#define DBG_LVL    DBG_INFO
+#include <rtdbg.h>
+
+#ifndef RT_BLK_CACHE_READ_AHEAD
+#define RT_BLK_CACHE_READ_AHEAD     8
+#endif
+
+#ifndef RT_BLK_CACHE_FLUSH_PERIOD
+#define RT_BLK_CACHE_FLUSH_PERIOD   1000
+#endif
+
+#if defined(RT_USING_SYSTEM_WORKQUEUE) && (RT_BLK_CACHE_FLUSH_PERIOD > 0)
+#define BLK_CACHE_USING_FLUSH_WORK
+#endif
+
+/* the sectors which are read ahead or written back at once */
+#define BLK_CACHE_BATCH             (RT_BLK_CACHE_READ_AHEAD > 0 ? RT_BLK_CACHE_READ_AHEAD : 1)
+
+#define BLK_CACHE_VALID             0x01
+#define BLK_CACHE_DIRTY             0x02
+
+struct blk_cache_entry
+{
+    rt_uint32_t sector;
+    rt_uint32_t flags;
+    rt_uint8_t *data;
+
+    rt_list_t lru;
+    struct blk_cache_entry *hash_next;
+};
+
+struct rt_blk_cache
+{
+    struct rt_device parent;
+
+    rt_device_t blk;                            /* the cached block device */
+    struct rt_device_blk_geometry geometry;
+    struct rt_mutex lock;
+
+    struct blk_cache_entry *entries;
+    struct blk_cache_entry **hash;
+    rt_uint32_t hash_mask;
+    rt_list_t lru;                              /* the most recently used entry is the first */
+    rt_uint8_t *pool;                           /* the data of entries */
+    rt_uint8_t *batch;                          /* BLK_CACHE_BATCH sectors */
+
+    rt_uint32_t next_sector;                    /* the next sector of sequential read */
+
+#ifdef BLK_CACHE_USING_FLUSH_WORK
+    struct rt_work flush_work;
+#endif
+
+    struct rt_blk_cache_stat stat;
+};
+
+static struct blk_cache_entry *_cache_lookup(struct rt_blk_cache *cache, rt_uint32_t sector)
+{
+    struct blk_cache_entry *entry;
+
+    for (entry = cache->hash[sector & cache->hash_mask]; entry != RT_NULL; entry = entry->hash_next)
+    {
+        if (entry->sector == sector)
+        {
+            return entry;
+        }
+    }
+
+    return RT_NULL;
+}
+
+static void _cache_hash_remove(struct rt_blk_cache *cache, struct blk_cache_entry *entry)
+{
+    struct blk_cache_entry **prev = &cache->hash[entry->sector & cache->hash_mask];
+
+    while (*prev != entry)
+    {
+        prev = &((*prev)->hash_next);
+    }
+    *prev = entry->hash_next;
+    entry->hash_next = RT_NULL;
+}
+
+static void _cache_touch(struct rt_blk_cache *cache, struct blk_cache_entry *entry)
+{
+    rt_list_remove(&(entry->lru));
+    rt_list_insert_after(&(cache->lru), &(entry->lru));
+}
+
+static void _cache_clean(struct rt_blk_cache *cache, struct blk_cache_entry *entry)
+{
+    if (entry->flags & BLK_CACHE_DIRTY)
+    {
+        entry->flags &= ~BLK_CACHE_DIRTY;
+        cache->stat.dirty--;
+    }
+}
+
+static void _cache_invalidate(struct rt_blk_cache *cache, struct blk_cache_entry *entry)
+{
+    _cache_clean(cache, entry);
+    _cache_hash_remove(cache, entry);
+    entry->flags = 0;
+
+    /* reuse it firstly */
+    rt_list_remove(&(entry->lru));
+    rt_list_insert_before(&(cache->lru), &(entry->lru));
+}
+
+/*
+ * write back the dirty sector with the continuous dirty sectors around it at
+ * once, BLK_CACHE_BATCH sectors at most.
+ */
+static rt_err_t _cache_write_back(struct rt_blk_cache *cache, struct blk_cache_entry *first)
+{
+    struct blk_cache_entry *entry;
+    rt_uint32_t index, count;
+
+    /* go back to the first one of the continuous dirty sectors */
+    for (count = 1; count < BLK_CACHE_BATCH && first->sector > 0; count++)
+    {
+        entry = _cache_lookup(cache, first->sector - 1);
+        if (entry == RT_NULL || !(entry->flags & BLK_CACHE_DIRTY))
+        {
+            break;
+        }
+        first = entry;
+    }
+
+    count = 1;
+    entry = _cache_lookup(cache, first->sector + count);
+    if (BLK_CACHE_BATCH == 1 || entry == RT_NULL || !(entry->flags & BLK_CACHE_DIRTY))
+    {
+        if (rt_device_write(cache->blk, first->sector, first->data, 1) != 1)
+        {
+            return -RT_EIO;
+        }
+    }
+    else
+    {
+        rt_memcpy(cache->batch, first->data, cache->geometry.bytes_per_sector);
+        while (count < BLK_CACHE_BATCH && entry != RT_NULL && (entry->flags & BLK_CACHE_DIRTY))
+        {
+            rt_memcpy(cache->batch + count * cache->geometry.bytes_per_sector, entry->data,
+                      cache->geometry.bytes_per_sector);
+            count++;
+            entry = _cache_lookup(cache, first->sector + count);
+        }
+
+        if (rt_device_write(cache->blk, first->sector, cache->batch, count) != count)
+        {
+            return -RT_EIO;
+        }
+    }
+
+    for (index = 0; index < count; index++)
+    {
+        _cache_clean(cache, _cache_lookup(cache, first->sector + index));
+    }
+    cache->stat.write_back += count;
+
+    return RT_EOK;
+}
+
+/* allocate the least recently used entry for the sector */
+static struct blk_cache_entry *_cache_alloc(struct rt_blk_cache *cache, rt_uint32_t sector)
+{
+    struct blk_cache_entry *entry;
+
+    entry = rt_list_entry(cache->lru.prev, struct blk_cache_entry, lru);
+    if (entry->flags & BLK_CACHE_DIRTY)
+    {
+        if (_cache_write_back(cache, entry) != RT_EOK)
+        {
+            LOG_E("write back sector %d failed", entry->sector);
+            return RT_NULL;
+        }
+    }
+
+    if (entry->flags & BLK_CACHE_VALID)
+    {
+        _cache_invalidate(cache, entry);
+    }
+
+    entry->sector = sector;
+    entry->flags = BLK_CACHE_VALID;
+    entry->hash_next = cache->hash[sector & cache->hash_mask];
+    cache->hash[sector & cache->hash_mask] = entry;
+    _cache_touch(cache, entry);
+
+    return entry;
+}
+
+/* insert the sectors which are read from device */
+static void _cache_fill(struct rt_blk_cache *cache, rt_uint32_t sector, const rt_uint8_t *data, rt_size_t count)
+{
+    struct blk_cache_entry *entry;
+    rt_size_t index;
+
+    for (index = 0; index < count; index++)
+    {
+        entry = _cache_alloc(cache, sector + index);
+        if (entry == RT_NULL)
+        {
+            break;
+        }
+        rt_memcpy(entry->data, data + index * cache->geometry.bytes_per_sector, cache->geometry.bytes_per_sector);
+    }
+}
+
+static void _cache_read_ahead(struct rt_blk_cache *cache, rt_uint32_t sector)
+{
+    rt_size_t count;
+
+    /* the missed sectors following the sequential read */
+    for (count = 0; count < RT_BLK_CACHE_READ_AHEAD && sector + count < cache->geometry.sector_count; count++)
+    {
+        if (_cache_lookup(cache, sector + count) != RT_NULL)
+        {
+            break;
+        }
+    }
+
+    if (count > 0 && rt_device_read(cache->blk, sector, cache->batch, count) == count)
+    {
+        _cache_fill(cache, sector, cache->batch, count);
+        cache->stat.read_ahead += count;
+    }
+}
+
+/* write back the dirty sectors by order, the continuous sectors are written at once */
+static rt_err_t _cache_flush(struct rt_blk_cache *cache)
+{
+    struct blk_cache_entry *first, *entry;
+    rt_uint32_t index;
+
+    while (cache->stat.dirty > 0)
+    {
+        first = RT_NULL;
+        for (index = 0; index < cache->stat.blocks; index++)
+        {
+            entry = &cache->entries[index];
+            if ((entry->flags & BLK_CACHE_DIRTY) && (first == RT_NULL || entry->sector < first->sector))
+            {
+                first = entry;
+            }
+        }
+
+        if (_cache_write_back(cache, first) != RT_EOK)
+        {
+            return -RT_EIO;
+        }
+    }
+
+    return RT_EOK;
+}
+
+#ifdef BLK_CACHE_USING_FLUSH_WORK
+static void _cache_flush_work(struct rt_work *work, void *work_data)
+{
+    struct rt_blk_cache *cache = (struct rt_blk_cache *)work_data;
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    if (_cache_flush(cache) != RT_EOK)
+    {
+        LOG_W("%s flush failed", cache->parent.parent.name);
+    }
+    rt_mutex_release(&cache->lock);
+}
+#endif
+
+static rt_err_t _blk_cache_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    struct rt_blk_cache *cache = (struct rt_blk_cache *)dev;
+
+    cache->next_sector = 0;
+
+    return rt_device_open(cache->blk, oflag);
+}
+
+static rt_err_t _blk_cache_close(rt_device_t dev)
+{
+    struct rt_blk_cache *cache = (struct rt_blk_cache *)dev;
+
+    rt_blk_cache_flush(dev);
+
+    return rt_device_close(cache->blk);
+}
+
+static rt_size_t _blk_cache_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t count)
+{
+    struct rt_blk_cache *cache = (struct rt_blk_cache *)dev;
+    rt_uint32_t ss = cache->geometry.bytes_per_sector;
+    rt_uint8_t *buf = (rt_uint8_t *)buffer;
+    struct blk_cache_entry *entry;
+    rt_size_t index = 0, run;
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+
+    while (index < count)
+    {
+        entry = _cache_lookup(cache, pos + index);
+        if (entry != RT_NULL)
+        {
+            rt_memcpy(buf + index * ss, entry->data, ss);
+            _cache_touch(cache, entry);
+            cache->stat.hits++;
+            index++;
+            continue;
+        }
+
+        /* read the continuous missed sectors at once */
+        for (run = 1; index + run < count && _cache_lookup(cache, pos + index + run) == RT_NULL; run++);
+
+        if (rt_device_read(cache->blk, pos + index, buf + index * ss, run) != run)
+        {
+            break;
+        }
+        cache->stat.misses += run;
+
+        /* the large read would flush the whole cache */
+        if (run < cache->stat.blocks / 2)
+        {
+            _cache_fill(cache, pos + index, buf + index * ss, run);
+        }
+        index += run;
+    }
+
+    if (RT_BLK_CACHE_READ_AHEAD > 0 && index == count && pos == cache->next_sector)
+    {
+        _cache_read_ahead(cache, pos + count);
+    }
+    cache->next_sector = pos + index;
+
+    rt_mutex_release(&cache->lock);
+
+    return index;
+}
+
+static rt_size_t _blk_cache_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t count)
+{
+    struct rt_blk_cache *cache = (struct rt_blk_cache *)dev;
+    rt_uint32_t ss = cache->geometry.bytes_per_sector;
+    const rt_uint8_t *buf = (const rt_uint8_t *)buffer;
+    struct blk_cache_entry *entry;
+    rt_size_t index;
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+
+    if (count >= cache->stat.blocks / 2)
+    {
+        /* write the large data to device directly, and update the cached sectors */
+        count = rt_device_write(cache->blk, pos, buffer, count);
+        for (index = 0; index < count; index++)
+        {
+            entry = _cache_lookup(cache, pos + index);
+            if (entry != RT_NULL)
+            {
+                rt_memcpy(entry->data, buf + index * ss, ss);
+                _cache_clean(cache, entry);
+            }
+        }
+        cache->stat.write_through += count;
+    }
+    else
+    {
+        for (index = 0; index < count; index++)
+        {
+            entry = _cache_lookup(cache, pos + index);
+            if (entry != RT_NULL)
+            {
+                _cache_touch(cache, entry);
+                cache->stat.hits++;
+            }
+            else if ((entry = _cache_alloc(cache, pos + index)) == RT_NULL)
+            {
+                break;
+            }
+
+            rt_memcpy(entry->data, buf + index * ss, ss);
+            if (!(entry->flags & BLK_CACHE_DIRTY))
+            {
+                entry->flags |= BLK_CACHE_DIRTY;
+                cache->stat.dirty++;
+            }
+        }
+        count = index;
+    }
+
+#ifdef BLK_CACHE_USING_FLUSH_WORK
+    /*
+     * submitting a delayed work again re-arms its timeout, so only submit it
+     * when it's not scheduled, or the writing stream keeps delaying the flush.
+     */
+    if (cache->stat.dirty > 0 &&
+            !(cache->flush_work.flags & (RT_WORK_STATE_PENDING | RT_WORK_STATE_SUBMITTING)))
+    {
+        rt_work_submit(&cache->flush_work, rt_tick_from_millisecond(RT_BLK_CACHE_FLUSH_PERIOD));
+    }
+#endif
+
+    rt_mutex_release(&cache->lock);
+
+    return count;
+}
+
+static rt_err_t _blk_cache_control(rt_device_t dev, int cmd, void *args)
+{
+    struct rt_blk_cache *cache = (struct rt_blk_cache *)dev;
+    struct rt_device_blk_sectors *sectors;
+    rt_uint32_t index;
+    rt_err_t result;
+
+    switch (cmd)
+    {
+    case RT_DEVICE_CTRL_BLK_GETGEOME:
+        if (args == RT_NULL)
+        {
+            return -RT_EINVAL;
+        }
+        rt_memcpy(args, &cache->geometry, sizeof(struct rt_device_blk_geometry));
+        return RT_EOK;
+
+    case RT_DEVICE_CTRL_BLK_SYNC:
+        result = rt_blk_cache_flush(dev);
+        if (result == RT_EOK)
+        {
+            /* the device may have its own cache */
+            rt_device_control(cache->blk, cmd, args);
+        }
+        return result;
+
+    case RT_DEVICE_CTRL_BLK_ERASE:
+        sectors = (struct rt_device_blk_sectors *)args;
+        if (sectors == RT_NULL)
+        {
+            return -RT_EINVAL;
+        }
+        /* drop the erased sectors, even if they are dirty */
+        rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+        for (index = 0; index < cache->stat.blocks; index++)
+        {
+            if ((cache->entries[index].flags & BLK_CACHE_VALID) &&
+                cache->entries[index].sector >= sectors->sector_begin &&
+                cache->entries[index].sector <= sectors->sector_end)
+            {
+                _cache_invalidate(cache, &cache->entries[index]);
+            }
+        }
+        rt_mutex_release(&cache->lock);
+        return rt_device_control(cache->blk, cmd, args);
+
+    case RT_DEVICE_CTRL_BLK_CACHE_STAT:
+        if (args == RT_NULL)
+        {
+            return -RT_EINVAL;
+        }
+        rt_memcpy(args, &cache->stat, sizeof(struct rt_blk_cache_stat));
+        return RT_EOK;
+
+    default:
+        return rt_device_control(cache->blk, cmd, args);
+    }
+}
+
+#ifdef RT_USING_DEVICE_OPS
+const static struct rt_device_ops blk_cache_ops =
+{
+    RT_NULL,
+    _blk_cache_open,
+    _blk_cache_close,
+    _blk_cache_read,
+    _blk_cache_write,
+    _blk_cache_control
+};
+#endif
+
+/**
+ * This function creates a block cache device over the block device.
+ *
+ * @param name the name of block cache device
+ * @param blk_name the name of block device
+ * @param blocks the number of cached sectors
+ *
+ * @return the block cache device, RT_NULL on failed.
+ */
+rt_device_t rt_blk_cache_create(const char *name, const char *blk_name, rt_uint32_t blocks)
+{
+    struct rt_blk_cache *cache;
+    rt_device_t blk;
+    rt_uint32_t index;
+
+    RT_ASSERT(name != RT_NULL);
+    RT_ASSERT(blk_name != RT_NULL);
+    RT_ASSERT(blocks >= 2);
+
+    blk = rt_device_find(blk_name);
+    if (blk == RT_NULL || blk->type != RT_Device_Class_Block)
+    {
+        LOG_E("block device %s is not found", blk_name);
+        return RT_NULL;
+    }
+
+    cache = (struct rt_blk_cache *)rt_calloc(1, sizeof(struct rt_blk_cache));
+    if (cache == RT_NULL)
+    {
+        return RT_NULL;
+    }
+
+    if (rt_device_control(blk, RT_DEVICE_CTRL_BLK_GETGEOME, &cache->geometry) != RT_EOK ||
+        cache->geometry.bytes_per_sector == 0)
+    {
+        LOG_E("get geometry of %s failed", blk_name);
+        rt_free(cache);
+        return RT_NULL;
+    }
+
+    for (cache->hash_mask = 1; cache->hash_mask < blocks; cache->hash_mask <<= 1);
+    cache->hash_mask -= 1;
+
+    cache->entries = (struct blk_cache_entry *)rt_calloc(blocks, sizeof(struct blk_cache_entry));
+    cache->hash = (struct blk_cache_entry **)rt_calloc(cache->hash_mask + 1, sizeof(struct blk_cache_entry *));
+    cache->pool = (rt_uint8_t *)rt_malloc(blocks * cache->geometry.bytes_per_sector);
+    cache->batch = (rt_uint8_t *)rt_malloc(BLK_CACHE_BATCH * cache->geometry.bytes_per_sector);
+    if (cache->entries == RT_NULL || cache->hash == RT_NULL || cache->pool == RT_NULL || cache->batch == RT_NULL)
+    {
+        goto __exit;
+    }
+
+    rt_list_init(&(cache->lru));
+    for (index = 0; index < blocks; index++)
+    {
+        cache->entries[index].data = cache->pool + index * cache->geometry.bytes_per_sector;
+        rt_list_insert_before(&(cache->lru), &(cache->entries[index].lru));
+    }
+    cache->blk = blk;
+    cache->stat.blocks = blocks;
+    rt_mutex_init(&cache->lock, name, RT_IPC_FLAG_FIFO);
+#ifdef BLK_CACHE_USING_FLUSH_WORK
+    rt_work_init(&cache->flush_work, _cache_flush_work, cache);
+#endif
+
+#ifdef RT_USING_DEVICE_OPS
+    cache->parent.ops     = &blk_cache_ops;
+#else
+    cache->parent.init    = RT_NULL;
+    cache->parent.open    = _blk_cache_open;
+    cache->parent.close   = _blk_cache_close;
+    cache->parent.read    = _blk_cache_read;
+    cache->parent.write   = _blk_cache_write;
+    cache->parent.control = _blk_cache_control;
+#endif
+    cache->parent.type    = RT_Device_Class_Block;
+
+    if (rt_device_register(&cache->parent, name, RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_STANDALONE) == RT_EOK)
+    {
+        LOG_I("%s: %d sectors cache over %s", name, blocks, blk_name);
+        return &cache->parent;
+    }
+    rt_mutex_detach(&cache->lock);
+
+__exit:
+    rt_free(cache->batch);
+    rt_free(cache->pool);
+    rt_free(cache->hash);
+    rt_free(cache->entries);
+    rt_free(cache);
+
+    return RT_NULL;
+}
+RTM_EXPORT(rt_blk_cache_create);
+
+/**
+ * This function destroys the block cache device, it should be closed firstly.
+ *
+ * @param dev the block cache device
+ *
+ * @return the error code, RT_EOK on successfully.
+ */
+rt_err_t rt_blk_cache_destroy(rt_device_t dev)
+{
+    struct rt_blk_cache *cache = (struct rt_blk_cache *)dev;
+
+    RT_ASSERT(dev != RT_NULL);
+
+    if (dev->ref_count > 0)
+    {
+        return -RT_EBUSY;
+    }
+
+#ifdef BLK_CACHE_USING_FLUSH_WORK
+    if (cache->flush_work.workqueue != RT_NULL)
+    {
+        rt_workqueue_cancel_work_sync(cache->flush_work.workqueue, &cache->flush_work);
+    }
+#endif
+
+    rt_device_unregister(dev);
+    rt_mutex_detach(&cache->lock);
+
+    rt_free(cache->batch);
+    rt_free(cache->pool);
+    rt_free(cache->hash);
+    rt_free(cache->entries);
+    rt_free(cache);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_blk_cache_destroy);
+
+/**
+ * This function writes back the dirty sectors to block device.
+ *
+ * @param dev the block cache device
+ *
+ * @return the error code, RT_EOK on successfully.
+ */
+rt_err_t rt_blk_cache_flush(rt_device_t dev)
+{
+    struct rt_blk_cache *cache = (struct rt_blk_cache *)dev;
+    rt_err_t result;
+
+    RT_ASSERT(dev != RT_NULL);
+
+    rt_mutex_take(&cache->lock, RT_WAITING_FOREVER);
+    result = _cache_flush(cache);
+    rt_mutex_release(&cache->lock);
+
+    return result;
+}
+RTM_EXPORT(rt_blk_cache_flush);
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+
+static void blk_cache(int argc, char **argv)
+{
+    struct rt_blk_cache_stat stat;
+    rt_device_t dev;
+
+    if (argc != 2)
+    {
+        rt_kprintf("Usage: blk_cache <device>\n");
+        return;
+    }
+
+    dev = rt_device_find(argv[1]);
+#ifdef RT_USING_DEVICE_OPS
+    if (dev == RT_NULL || dev->ops != &blk_cache_ops)
+#else
+    if (dev == RT_NULL || dev->control != _blk_cache_control)
+#endif
+    {
+        rt_kprintf("%s is not a block cache device\n", argv[1]);
+        return;
+    }
+    rt_device_control(dev, RT_DEVICE_CTRL_BLK_CACHE_STAT, &stat);
+
+    rt_kprintf("blocks        : %d\n", stat.blocks);
+    rt_kprintf("dirty         : %d\n", stat.dirty);
+    rt_kprintf("hits          : %d\n", stat.hits);
+    rt_kprintf("misses        : %d\n", stat.misses);
+    rt_kprintf("read ahead    : %d\n", stat.read_ahead);
+    rt_kprintf("write back    : %d\n", stat.write_back);
+    rt_kprintf("write through : %d\n", stat.write_through);
+}
+MSH_CMD_EXPORT(blk_cache, show the statistics of block cache device);
+#endif
@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * blk_cache_sim runs the block cache on the host over a block device which
+ * is backed by a file, and prints the requests sent to the device and their
+ * time for some workloads of FAT on SD card, with and without the cache.
+ *
+ * The data is really read from and written to the file, the time of each
+ * request is added up by the typical timing of SD card: 250us to read and
+ * 1.5ms to write a request, and the data is transferred at 12.5MB/s (4-bit
+ * bus at 25MHz). The time of the host file is not counted.
+ *
+ * A copy of the disk is kept in memory. After each workload the cache is
+ * synced, and the file must be the same as the copy.
+ *
+ * The block cache is built into this program with the configuration in
+ * rtconfig.h:
+ *
+ *   gcc -O2 -std=gnu99 -I. -I../../../../include -I../../include blk_cache_sim.c -o blk_cache_sim
+ *
+ * usage: blk_cache_sim [image file] [cache sectors]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../blk_cache.c"
+
+#define SIM_SECTOR_SIZE     512
+#define SIM_SECTORS         8192    /* 4MB */
+#define SIM_READ_US         250     /* read request */
+#define SIM_WRITE_US        1500    /* write request */
+#define SIM_SECTOR_US       41      /* transfer one sector at 12.5MB/s */
+
+struct sim_disk
+{
+    struct rt_device parent;
+    int fd;
+
+    rt_uint64_t time_us;            /* the time of all requests */
+    unsigned long reads;            /* the read requests */
+    unsigned long read_sectors;
+    unsigned long writes;           /* the write requests */
+    unsigned long write_sectors;
+};
+
+static struct sim_disk disk;
+static rt_uint8_t shadow[SIM_SECTORS * SIM_SECTOR_SIZE];
+static rt_device_t devices[2];
+static int failed;
+
+/* the stubs of kernel for the block cache */
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void *rt_calloc(rt_size_t count, rt_size_t size) { return calloc(count, size); }
+void rt_free(void *ptr) { free(ptr); }
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count) { return count ? memcpy(dst, src, count) : dst; }
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag) { return RT_EOK; }
+rt_err_t rt_mutex_detach(rt_mutex_t mutex) { return RT_EOK; }
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time) { return RT_EOK; }
+rt_err_t rt_mutex_release(rt_mutex_t mutex) { return RT_EOK; }
+
+void rt_assert_handler(const char *ex, const char *func, rt_size_t line)
+{
+    fprintf(stderr, "(%s) assertion failed at function:%s, line number:%d\n", ex, func, (int)line);
+    abort();
+}
+
+rt_err_t rt_device_register(rt_device_t dev, const char *name, rt_uint16_t flags)
+{
+    strncpy(dev->parent.name, name, RT_NAME_MAX - 1);
+    dev->flag = flags;
+    devices[dev == &disk.parent ? 0 : 1] = dev;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_device_unregister(rt_device_t dev)
+{
+    devices[dev == &disk.parent ? 0 : 1] = RT_NULL;
+
+    return RT_EOK;
+}
+
+rt_device_t rt_device_find(const char *name)
+{
+    int index;
+
+    for (index = 0; index < 2; index++)
+    {
+        if (devices[index] != RT_NULL && strncmp(devices[index]->parent.name, name, RT_NAME_MAX) == 0)
+            return devices[index];
+    }
+
+    return RT_NULL;
+}
+
+rt_err_t rt_device_open(rt_device_t dev, rt_uint16_t oflag)
+{
+    dev->ref_count++;
+
+    return dev->open ? dev->open(dev, oflag) : RT_EOK;
+}
+
+rt_err_t rt_device_close(rt_device_t dev)
+{
+    dev->ref_count--;
+
+    return dev->close ? dev->close(dev) : RT_EOK;
+}
+
+rt_size_t rt_device_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    return dev->read(dev, pos, buffer, size);
+}
+
+rt_size_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    return dev->write(dev, pos, buffer, size);
+}
+
+rt_err_t rt_device_control(rt_device_t dev, int cmd, void *arg)
+{
+    return dev->control(dev, cmd, arg);
+}
+
+/* the block device over the file */
+static rt_size_t sim_disk_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t count)
+{
+    if (pread(disk.fd, buffer, count * SIM_SECTOR_SIZE, (off_t)pos * SIM_SECTOR_SIZE) != count * SIM_SECTOR_SIZE)
+        return 0;
+
+    disk.reads++;
+    disk.read_sectors += count;
+    disk.time_us += SIM_READ_US + count * SIM_SECTOR_US;
+
+    return count;
+}
+
+static rt_size_t sim_disk_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t count)
+{
+    if (pwrite(disk.fd, buffer, count * SIM_SECTOR_SIZE, (off_t)pos * SIM_SECTOR_SIZE) != count * SIM_SECTOR_SIZE)
+        return 0;
+
+    disk.writes++;
+    disk.write_sectors += count;
+    disk.time_us += SIM_WRITE_US + count * SIM_SECTOR_US;
+
+    return count;
+}
+
+static rt_err_t sim_disk_control(rt_device_t dev, int cmd, void *args)
+{
+    struct rt_device_blk_geometry *geometry;
+
+    switch (cmd)
+    {
+    case RT_DEVICE_CTRL_BLK_GETGEOME:
+        geometry = (struct rt_device_blk_geometry *)args;
+        geometry->sector_count = SIM_SECTORS;
+        geometry->bytes_per_sector = SIM_SECTOR_SIZE;
+        geometry->block_size = SIM_SECTOR_SIZE;
+        return RT_EOK;
+    case RT_DEVICE_CTRL_BLK_SYNC:
+        return fsync(disk.fd) == 0 ? RT_EOK : -RT_EIO;
+    default:
+        return -RT_ENOSYS;
+    }
+}
+
+static void sim_disk_init(const char *path)
+{
+    disk.fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (disk.fd < 0 || ftruncate(disk.fd, sizeof(shadow)) != 0)
+    {
+        perror(path);
+        exit(1);
+    }
+    memset(shadow, 0, sizeof(shadow));
+
+    disk.parent.type = RT_Device_Class_Block;
+    disk.parent.read = sim_disk_read;
+    disk.parent.write = sim_disk_write;
+    disk.parent.control = sim_disk_control;
+    rt_device_register(&disk.parent, "sd0", RT_DEVICE_FLAG_RDWR);
+}
+
+/* the workloads, they read or write through the device and check the read data */
+static void sim_read(rt_device_t dev, rt_uint32_t sector, rt_uint32_t count)
+{
+    static rt_uint8_t buf[64 * SIM_SECTOR_SIZE];
+
+    if (rt_device_read(dev, sector, buf, count) != count
+            || memcmp(buf, shadow + sector * SIM_SECTOR_SIZE, count * SIM_SECTOR_SIZE) != 0)
+    {
+        printf("FAIL: read %u sectors at %u\n", count, sector);
+        failed = 1;
+    }
+}
+
+static void sim_write(rt_device_t dev, rt_uint32_t sector, rt_uint32_t count)
+{
+    static rt_uint32_t seq;
+    rt_uint8_t *data = shadow + sector * SIM_SECTOR_SIZE;
+    rt_uint32_t index;
+
+    for (index = 0; index < count * SIM_SECTOR_SIZE; index++)
+        data[index] = (rt_uint8_t)(seq * 131 + index);
+    seq++;
+
+    if (rt_device_write(dev, sector, data, count) != count)
+    {
+        printf("FAIL: write %u sectors at %u\n", count, sector);
+        failed = 1;
+    }
+}
+
+static void sim_sync(rt_device_t dev)
+{
+    rt_device_control(dev, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+}
+
+/* the FAT12/16 layout: FAT at 32, root directory at 64, data from 128 */
+#define SIM_FAT             32
+#define SIM_DIR             64
+#define SIM_DATA            128
+
+/* read a file of 1MB sector by sector, as f_read() of a small buffer */
+static void load_seq_read(rt_device_t dev)
+{
+    rt_uint32_t index;
+
+    for (index = 0; index < 2048; index++)
+    {
+        if (index % 64 == 0)
+            sim_read(dev, SIM_FAT + index / 256, 1);
+        sim_read(dev, SIM_DATA + index, 1);
+    }
+}
+
+/* append 64 bytes records to a log file, synced every 16 records */
+static void load_log_append(rt_device_t dev)
+{
+    rt_uint32_t index, sector;
+
+    for (index = 0; index < 1024; index++)
+    {
+        sector = SIM_DATA + 4096 + index / 8;
+        /* the partial sector is read, modified and written */
+        sim_read(dev, sector, 1);
+        sim_write(dev, sector, 1);
+        if (index % 16 == 15)
+        {
+            /* f_sync() updates the FAT and the directory entry */
+            sim_read(dev, SIM_FAT + 16, 1);
+            sim_write(dev, SIM_FAT + 16, 1);
+            sim_read(dev, SIM_DIR, 1);
+            sim_write(dev, SIM_DIR, 1);
+            sim_sync(dev);
+        }
+    }
+}
+
+/* open and stat the files in some directories, 80% of the lookups are in the hot 32 sectors */
+static void load_lookup(rt_device_t dev)
+{
+    rt_uint32_t index;
+
+    srand(1);
+    for (index = 0; index < 4096; index++)
+    {
+        if (rand() % 5)
+            sim_read(dev, SIM_FAT + rand() % 32, 1);
+        else
+            sim_read(dev, SIM_DATA + rand() % 4096, 1);
+    }
+}
+
+/* write 1MB by clusters of 8 sectors, as copying a file */
+static void load_seq_write(rt_device_t dev)
+{
+    rt_uint32_t index;
+
+    for (index = 0; index < 256; index++)
+    {
+        sim_write(dev, SIM_DATA + 2048 + index * 8, 8);
+        if (index % 16 == 15)
+        {
+            sim_read(dev, SIM_FAT + 8 + index / 64, 1);
+            sim_write(dev, SIM_FAT + 8 + index / 64, 1);
+        }
+    }
+    sim_sync(dev);
+}
+
+/* single sectors all over the disk, the cache doesn't help */
+static void load_random(rt_device_t dev)
+{
+    rt_uint32_t index, sector;
+
+    srand(2);
+    for (index = 0; index < 2048; index++)
+    {
+        sector = rand() % SIM_SECTORS;
+        if (rand() % 2)
+            sim_read(dev, sector, 1);
+        else
+            sim_write(dev, sector, 1);
+    }
+    sim_sync(dev);
+}
+
+/* random reads, writes and syncs of 1-16 sectors, every read is checked */
+static void load_check(rt_device_t dev)
+{
+    rt_uint32_t index, sector, count;
+
+    srand(3);
+    for (index = 0; index < 20000; index++)
+    {
+        count = 1 + (rand() % 4 ? 0 : rand() % 16);
+        sector = (rand() % 4 ? rand() % 256 : rand() % SIM_SECTORS);
+        if (sector + count > SIM_SECTORS)
+            sector = SIM_SECTORS - count;
+
+        switch (rand() % 8)
+        {
+        case 0:
+            sim_sync(dev);
+            break;
+        case 1:
+        case 2:
+        case 3:
+            sim_write(dev, sector, count);
+            break;
+        default:
+            sim_read(dev, sector, count);
+            break;
+        }
+    }
+    sim_sync(dev);
+}
+
+static void sim_verify(const char *name)
+{
+    static rt_uint8_t data[sizeof(shadow)];
+
+    if (pread(disk.fd, data, sizeof(data), 0) != sizeof(data) || memcmp(data, shadow, sizeof(data)) != 0)
+    {
+        printf("%s: FAIL, the image is different from the written data\n", name);
+        failed = 1;
+    }
+}
+
+static void bench(const char *name, void (*load)(rt_device_t dev), rt_uint32_t blocks)
+{
+    struct sim_disk result[2];
+    struct rt_blk_cache_stat stat;
+    rt_device_t dev;
+    int with_cache;
+
+    for (with_cache = 0; with_cache < 2; with_cache++)
+    {
+        disk.time_us = 0;
+        disk.reads = disk.read_sectors = disk.writes = disk.write_sectors = 0;
+
+        if (with_cache)
+        {
+            dev = rt_blk_cache_create("sd0c", "sd0", blocks);
+            if (dev == RT_NULL)
+            {
+                printf("FAIL: create the block cache\n");
+                exit(1);
+            }
+            rt_device_open(dev, RT_DEVICE_OFLAG_RDWR);
+            load(dev);
+            rt_device_control(dev, RT_DEVICE_CTRL_BLK_CACHE_STAT, &stat);
+            rt_device_close(dev);
+            rt_blk_cache_destroy(dev);
+        }
+        else
+        {
+            dev = &disk.parent;
+            load(dev);
+        }
+        sim_verify(name);
+        result[with_cache] = disk;
+    }
+
+    printf("%-14s %6lu %6lu %6lu %6lu %8.1f | %6lu %6lu %6lu %6lu %8.1f %5.1f%% %5.1fx\n", name,
+           result[0].reads, result[0].read_sectors, result[0].writes, result[0].write_sectors,
+           result[0].time_us / 1000.0,
+           result[1].reads, result[1].read_sectors, result[1].writes, result[1].write_sectors,
+           result[1].time_us / 1000.0,
+           stat.hits + stat.misses ? stat.hits * 100.0 / (stat.hits + stat.misses) : 0,
+           result[1].time_us ? (double)result[0].time_us / result[1].time_us : 0);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = argc > 1 ? argv[1] : "blk_cache_sim.img";
+    rt_uint32_t blocks = argc > 2 ? strtoul(argv[2], NULL, 0) : 64;
+
+    sim_disk_init(path);
+
+    printf("%u sectors of %s, %u sectors cache, read ahead %d\n\n", SIM_SECTORS, path, blocks,
+           RT_BLK_CACHE_READ_AHEAD);
+    printf("%-14s %34s | %48s\n", "", "without cache", "with cache");
+    printf("%-14s %6s %6s %6s %6s %8s | %6s %6s %6s %6s %8s %6s %6s\n", "workload",
+           "reads", "sect", "writes", "sect", "ms", "reads", "sect", "writes", "sect", "ms", "hits", "speed");
+    bench("seq read", load_seq_read, blocks);
+    bench("log append", load_log_append, blocks);
+    bench("lookup", load_lookup, blocks);
+    bench("seq write", load_seq_write, blocks);
+    bench("random", load_random, blocks);
+    bench("check", load_check, blocks);
+
+    close(disk.fd);
+    unlink(path);
+    printf("\n%s\n", failed ? "FAIL" : "PASS");
+
+    return failed;
+}
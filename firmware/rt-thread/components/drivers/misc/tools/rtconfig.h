@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/* the configuration of blk_cache_sim, the block cache is built for the host */
+
+#ifndef RT_CONFIG_H__
+#define RT_CONFIG_H__
+
+#define RT_NAME_MAX 8
+#define RT_ALIGN_SIZE 4
+#define RT_THREAD_PRIORITY_32
+#define RT_THREAD_PRIORITY_MAX 32
+#define RT_TICK_PER_SECOND 1000
+#define RT_DEBUG
+#define RT_USING_SEMAPHORE
+#define RT_USING_MUTEX
+#define RT_USING_HEAP
+#define RT_USING_DEVICE
+
+/* the libc and the signals are from the host */
+#define RT_USING_NEWLIB
+#define LIBC_SIGNAL_H__
+#include <signal.h>
+
+#define RT_USING_BLK_CACHE
+#define RT_BLK_CACHE_READ_AHEAD 8
+
+#endif
@@ -6,9 +6,11 @@
  * Change Logs:
  * Date           Author        Notes
  * 2011-07-25     weety     first version
+ * 2020-11-20     luhuadong merge the adjacent writes, pre-erase and statistics
  */
 
 #include <rtthread.h>
+#include <rtdevice.h>
 #include <dfs_fs.h>
 
 #include <drivers/mmcsd_core.h>
@@ -33,12 +35,35 @@ struct mmcsd_blk_device
     struct dfs_partition part;
     struct rt_device_blk_geometry geometry;
     rt_size_t max_req_size;
+    struct rt_mmcsd_blk_stat stat;
+
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+    /* the pending write request of adjacent sectors */
+    rt_uint8_t *merge_buf;
+    rt_uint32_t merge_sector;
+    rt_size_t merge_count;
+    rt_err_t merge_err;             /* the failure of flush work, reported by the next write or sync */
+    struct rt_work flush_work;
+#endif
 };
 
 #ifndef RT_MMCSD_MAX_PARTITION
 #define RT_MMCSD_MAX_PARTITION 16
 #endif
 
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+#ifndef RT_MMCSD_MERGE_SECTORS
+#define RT_MMCSD_MERGE_SECTORS 32
+#endif
+
+#ifndef RT_MMCSD_MERGE_FLUSH_PERIOD
+#define RT_MMCSD_MERGE_FLUSH_PERIOD 100
+#endif
+
+/* the merge buffer is aligned to cache line for DMA */
+#define MMCSD_MERGE_BUF_ALIGN 32
+#endif
+
 rt_int32_t mmcsd_num_wr_blocks(struct rt_mmcsd_card *card)
 {
     rt_int32_t err;
@@ -100,6 +125,41 @@ rt_int32_t mmcsd_num_wr_blocks(struct rt_mmcsd_card *card)
     return blocks;
 }
 
+/*
+ * Set the number of blocks to be pre-erased before the multiple block write,
+ * it's a hint for the card to speed up the write.
+ */
+static rt_int32_t mmcsd_set_wr_blk_erase_count(struct rt_mmcsd_card *card,
+                                               rt_uint32_t           blks)
+{
+    rt_int32_t err;
+    struct rt_mmcsd_cmd cmd;
+
+    rt_memset(&cmd, 0, sizeof(struct rt_mmcsd_cmd));
+
+    cmd.cmd_code = APP_CMD;
+    cmd.arg = card->rca << 16;
+    cmd.flags = RESP_SPI_R1 | RESP_R1 | CMD_AC;
+
+    err = mmcsd_send_cmd(card->host, &cmd, 0);
+    if (err)
+        return -RT_ERROR;
+    if (!controller_is_spi(card->host) && !(cmd.resp[0] & R1_APP_CMD))
+        return -RT_ERROR;
+
+    rt_memset(&cmd, 0, sizeof(struct rt_mmcsd_cmd));
+
+    cmd.cmd_code = SD_APP_SET_WR_BLK_ERASE_COUNT;
+    cmd.arg = blks & 0x7FFFFF;
+    cmd.flags = RESP_SPI_R1 | RESP_R1 | CMD_AC;
+
+    err = mmcsd_send_cmd(card->host, &cmd, 0);
+    if (err)
+        return -RT_ERROR;
+
+    return RT_EOK;
+}
+
 static rt_err_t rt_mmcsd_req_blk(struct rt_mmcsd_card *card,
                                  rt_uint32_t           sector,
                                  void                 *buf,
@@ -113,6 +173,14 @@ static rt_err_t rt_mmcsd_req_blk(struct rt_mmcsd_card *card,
     rt_uint32_t r_cmd, w_cmd;
 
     mmcsd_host_lock(host);
+    if (dir && blks > 1 && card->card_type == CARD_TYPE_SD)
+    {
+        if (mmcsd_set_wr_blk_erase_count(card, blks) != RT_EOK)
+        {
+            LOG_D("set write block erase count failed");
+        }
+    }
+
     rt_memset(&req, 0, sizeof(struct rt_mmcsd_req));
     rt_memset(&cmd, 0, sizeof(struct rt_mmcsd_cmd));
     rt_memset(&stop, 0, sizeof(struct rt_mmcsd_cmd));
@@ -202,6 +270,172 @@ static rt_err_t rt_mmcsd_req_blk(struct rt_mmcsd_card *card,
     return RT_EOK;
 }
 
+/*
+ * Transfer the blocks by the requests of max_req_size, the latency of each
+ * request is counted in the statistics.
+ */
+static rt_err_t mmcsd_blk_transfer(struct mmcsd_blk_device *blk_dev,
+                                   rt_uint32_t              sector,
+                                   void                    *buf,
+                                   rt_size_t                blks,
+                                   rt_uint8_t               dir)
+{
+    rt_err_t err = RT_EOK;
+    rt_size_t req_size;
+    rt_tick_t tick;
+
+    while (blks)
+    {
+        req_size = BLK_MIN(blks, blk_dev->max_req_size);
+
+        tick = rt_tick_get();
+        err = rt_mmcsd_req_blk(blk_dev->card, sector, buf, req_size, dir);
+        if (err)
+            break;
+        tick = rt_tick_get() - tick;
+
+        if (dir)
+        {
+            blk_dev->stat.write_reqs ++;
+            blk_dev->stat.write_blocks += req_size;
+            blk_dev->stat.write_ticks += tick;
+            if (tick > blk_dev->stat.write_max_ticks)
+                blk_dev->stat.write_max_ticks = tick;
+        }
+        else
+        {
+            blk_dev->stat.read_reqs ++;
+            blk_dev->stat.read_blocks += req_size;
+            blk_dev->stat.read_ticks += tick;
+            if (tick > blk_dev->stat.read_max_ticks)
+                blk_dev->stat.read_max_ticks = tick;
+        }
+
+        sector += req_size;
+        buf = (void *)((rt_uint8_t *)buf + (req_size << 9));
+        blks -= req_size;
+    }
+
+    return err;
+}
+
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+/*
+ * send the pending write request, the partition lock must be taken. The
+ * request is kept to be sent again if it fails.
+ */
+static rt_err_t mmcsd_blk_flush(struct mmcsd_blk_device *blk_dev)
+{
+    rt_err_t err;
+
+    if (blk_dev->merge_count == 0)
+        return RT_EOK;
+
+    err = mmcsd_blk_transfer(blk_dev, blk_dev->merge_sector,
+                             blk_dev->merge_buf, blk_dev->merge_count, 1);
+    if (err == RT_EOK)
+        blk_dev->merge_count = 0;
+
+    return err;
+}
+
+/* send the pending write request for sync, and report the failure of flush work */
+static rt_err_t mmcsd_blk_sync(struct mmcsd_blk_device *blk_dev)
+{
+    rt_err_t err;
+
+    err = mmcsd_blk_flush(blk_dev);
+    if (err == RT_EOK)
+        err = blk_dev->merge_err;
+    blk_dev->merge_err = RT_EOK;
+
+    return err;
+}
+
+static void mmcsd_blk_flush_work(struct rt_work *work, void *work_data)
+{
+    struct mmcsd_blk_device *blk_dev = (struct mmcsd_blk_device *)work_data;
+    rt_err_t err;
+
+    rt_sem_take(blk_dev->part.lock, RT_WAITING_FOREVER);
+    err = mmcsd_blk_flush(blk_dev);
+    if (err != RT_EOK)
+    {
+        LOG_E("%s send pending write failed", blk_dev->dev.parent.name);
+        blk_dev->merge_err = err;
+    }
+    rt_sem_release(blk_dev->part.lock);
+}
+
+/*
+ * Merge the write into the pending request when it's adjacent to or within
+ * it, otherwise the pending request is sent first. The partition lock must
+ * be taken.
+ */
+static rt_err_t mmcsd_blk_write_merge(struct mmcsd_blk_device *blk_dev,
+                                      rt_uint32_t              sector,
+                                      const void              *buf,
+                                      rt_size_t                blks)
+{
+    rt_err_t err;
+    rt_size_t offset;
+
+    /* the failure of flush work is reported once, the request is kept to be sent again */
+    if (blk_dev->merge_err != RT_EOK)
+    {
+        err = blk_dev->merge_err;
+        blk_dev->merge_err = RT_EOK;
+        return err;
+    }
+
+    if (blk_dev->merge_count > 0 &&
+        (sector < blk_dev->merge_sector ||
+         sector > blk_dev->merge_sector + blk_dev->merge_count ||
+         sector + blks > blk_dev->merge_sector + RT_MMCSD_MERGE_SECTORS))
+    {
+        err = mmcsd_blk_flush(blk_dev);
+        if (err)
+            return err;
+    }
+
+    if (blk_dev->merge_buf == RT_NULL && blks < RT_MMCSD_MERGE_SECTORS)
+    {
+        blk_dev->merge_buf = (rt_uint8_t *)rt_malloc_align(RT_MMCSD_MERGE_SECTORS << 9,
+                                                           MMCSD_MERGE_BUF_ALIGN);
+    }
+
+    /* the large write is sent directly */
+    if (blk_dev->merge_buf == RT_NULL || blks >= RT_MMCSD_MERGE_SECTORS)
+    {
+        return mmcsd_blk_transfer(blk_dev, sector, (void *)buf, blks, 1);
+    }
+
+    if (blk_dev->merge_count == 0)
+        blk_dev->merge_sector = sector;
+    else
+        blk_dev->stat.merged ++;
+
+    offset = sector - blk_dev->merge_sector;
+    rt_memcpy(blk_dev->merge_buf + (offset << 9), buf, blks << 9);
+    if (offset + blks > blk_dev->merge_count)
+        blk_dev->merge_count = offset + blks;
+
+    if (blk_dev->merge_count == RT_MMCSD_MERGE_SECTORS)
+        return mmcsd_blk_flush(blk_dev);
+
+    /*
+     * submitting a delayed work again re-arms its timeout, so only submit it
+     * when it's not scheduled, or the adjacent writes keep delaying the flush.
+     */
+    if (!(blk_dev->flush_work.flags & (RT_WORK_STATE_PENDING | RT_WORK_STATE_SUBMITTING)))
+    {
+        rt_work_submit(&blk_dev->flush_work, rt_tick_from_millisecond(RT_MMCSD_MERGE_FLUSH_PERIOD));
+    }
+
+    return RT_EOK;
+}
+#endif /* RT_MMCSD_USING_WRITE_MERGE */
+
 static rt_err_t rt_mmcsd_init(rt_device_t dev)
 {
     return RT_EOK;
@@ -214,21 +448,46 @@ static rt_err_t rt_mmcsd_open(rt_device_t dev, rt_uint16_t oflag)
 
 static rt_err_t rt_mmcsd_close(rt_device_t dev)
 {
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+    struct mmcsd_blk_device *blk_dev = (struct mmcsd_blk_device *)dev->user_data;
+    rt_err_t err;
+
+    rt_sem_take(blk_dev->part.lock, RT_WAITING_FOREVER);
+    err = mmcsd_blk_sync(blk_dev);
+    rt_sem_release(blk_dev->part.lock);
+
+    return err;
+#else
     return RT_EOK;
+#endif
 }
 
 static rt_err_t rt_mmcsd_control(rt_device_t dev, int cmd, void *args)
 {
     struct mmcsd_blk_device *blk_dev = (struct mmcsd_blk_device *)dev->user_data;
+    rt_err_t err = RT_EOK;
+
     switch (cmd)
     {
     case RT_DEVICE_CTRL_BLK_GETGEOME:
         rt_memcpy(args, &blk_dev->geometry, sizeof(struct rt_device_blk_geometry));
         break;
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+    case RT_DEVICE_CTRL_BLK_SYNC:
+        rt_sem_take(blk_dev->part.lock, RT_WAITING_FOREVER);
+        err = mmcsd_blk_sync(blk_dev);
+        rt_sem_release(blk_dev->part.lock);
+        break;
+#endif
+    case RT_DEVICE_CTRL_BLK_MMCSD_STAT:
+        rt_sem_take(blk_dev->part.lock, RT_WAITING_FOREVER);
+        rt_memcpy(args, &blk_dev->stat, sizeof(struct rt_mmcsd_blk_stat));
+        rt_sem_release(blk_dev->part.lock);
+        break;
     default:
         break;
     }
-    return RT_EOK;
+    return err;
 }
 
 static rt_size_t rt_mmcsd_read(rt_device_t dev,
@@ -237,10 +496,7 @@ static rt_size_t rt_mmcsd_read(rt_device_t dev,
                                rt_size_t   size)
 {
     rt_err_t err = 0;
-    rt_size_t offset = 0;
-    rt_size_t req_size = 0;
-    rt_size_t remain_size = size;
-    void *rd_ptr = (void *)buffer;
+    rt_uint32_t sector;
     struct mmcsd_blk_device *blk_dev = (struct mmcsd_blk_device *)dev->user_data;
     struct dfs_partition *part = &blk_dev->part;
 
@@ -250,17 +506,20 @@ static rt_size_t rt_mmcsd_read(rt_device_t dev,
         return 0;
     }
 
+    sector = part->offset + pos;
+
     rt_sem_take(part->lock, RT_WAITING_FOREVER);
-    while (remain_size)
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+    /* the pending write is sent before reading the same sectors */
+    if (blk_dev->merge_count > 0 &&
+        sector < blk_dev->merge_sector + blk_dev->merge_count &&
+        sector + size > blk_dev->merge_sector)
     {
-        req_size = (remain_size > blk_dev->max_req_size) ? blk_dev->max_req_size : remain_size;
-        err = rt_mmcsd_req_blk(blk_dev->card, part->offset + pos + offset, rd_ptr, req_size, 0);
-        if (err)
-            break;
-        offset += req_size;
-        rd_ptr = (void *)((rt_uint8_t *)rd_ptr + (req_size << 9));
-        remain_size -= req_size;
+        err = mmcsd_blk_flush(blk_dev);
     }
+    if (!err)
+#endif
+        err = mmcsd_blk_transfer(blk_dev, sector, buffer, size, 0);
     rt_sem_release(part->lock);
 
     /* the length of reading must align to SECTOR SIZE */
@@ -269,7 +528,7 @@ static rt_size_t rt_mmcsd_read(rt_device_t dev,
         rt_set_errno(-EIO);
         return 0;
     }
-    return size - remain_size;
+    return size;
 }
 
 static rt_size_t rt_mmcsd_write(rt_device_t dev,
@@ -278,10 +537,7 @@ static rt_size_t rt_mmcsd_write(rt_device_t dev,
                                 rt_size_t   size)
 {
     rt_err_t err = 0;
-    rt_size_t offset = 0;
-    rt_size_t req_size = 0;
-    rt_size_t remain_size = size;
-    void *wr_ptr = (void *)buffer;
+    rt_uint32_t sector;
     struct mmcsd_blk_device *blk_dev = (struct mmcsd_blk_device *)dev->user_data;
     struct dfs_partition *part = &blk_dev->part;
 
@@ -291,17 +547,14 @@ static rt_size_t rt_mmcsd_write(rt_device_t dev,
         return 0;
     }
 
+    sector = part->offset + pos;
+
     rt_sem_take(part->lock, RT_WAITING_FOREVER);
-    while (remain_size)
-    {
-        req_size = (remain_size > blk_dev->max_req_size) ? blk_dev->max_req_size : remain_size;
-        err = rt_mmcsd_req_blk(blk_dev->card, part->offset + pos + offset, wr_ptr, req_size, 1);
-        if (err)
-            break;
-        offset += req_size;
-        wr_ptr = (void *)((rt_uint8_t *)wr_ptr + (req_size << 9));
-        remain_size -= req_size;
-    }
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+    err = mmcsd_blk_write_merge(blk_dev, sector, buffer, size);
+#else
+    err = mmcsd_blk_transfer(blk_dev, sector, (void *)buffer, size, 1);
+#endif
     rt_sem_release(part->lock);
 
     /* the length of reading must align to SECTOR SIZE */
@@ -311,7 +564,7 @@ static rt_size_t rt_mmcsd_write(rt_device_t dev,
 
         return 0;
     }
-    return size - remain_size;
+    return size;
 }
 
 static rt_int32_t mmcsd_set_blksize(struct rt_mmcsd_card *card)
@@ -389,6 +642,9 @@ rt_int32_t rt_mmcsd_blk_probe(struct rt_mmcsd_card *card)
                 LOG_E("mmcsd:malloc memory failed!");
                 break;
             }
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+            rt_work_init(&blk_dev->flush_work, mmcsd_blk_flush_work, blk_dev);
+#endif
 
             blk_dev->max_req_size = BLK_MIN((card->host->max_dma_segs * 
                                              card->host->max_seg_size) >> 9, 
@@ -508,6 +764,17 @@ void rt_mmcsd_blk_remove(struct rt_mmcsd_card *card)
                   dfs_unmount(mounted_path);
                   LOG_D("unmount file system %s for device %s.\r\n", mounted_path, blk_dev->dev.parent.name);
         	}
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+            /* the card is removed, the pending write is dropped */
+            if (blk_dev->flush_work.workqueue != RT_NULL)
+            {
+                rt_workqueue_cancel_work_sync(blk_dev->flush_work.workqueue, &blk_dev->flush_work);
+            }
+            if (blk_dev->merge_buf != RT_NULL)
+            {
+                rt_free_align(blk_dev->merge_buf);
+            }
+#endif
             rt_sem_delete(blk_dev->part.lock);
             rt_device_unregister(&blk_dev->dev);
             rt_list_remove(&blk_dev->list);
@@ -516,6 +783,34 @@ void rt_mmcsd_blk_remove(struct rt_mmcsd_card *card)
     }
 }
 
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+
+static void mmcsd_stat(void)
+{
+    rt_list_t *l;
+    struct mmcsd_blk_device *blk_dev;
+    struct rt_mmcsd_blk_stat stat;
+
+    for (l = blk_devices.next; l != &blk_devices; l = l->next)
+    {
+        blk_dev = (struct mmcsd_blk_device *)rt_list_entry(l, struct mmcsd_blk_device, list);
+        rt_device_control(&blk_dev->dev, RT_DEVICE_CTRL_BLK_MMCSD_STAT, &stat);
+
+        rt_kprintf("%s:\n", blk_dev->dev.parent.name);
+        rt_kprintf("  read  requests %d, blocks %d, avg %d ms, max %d ms\n",
+                   stat.read_reqs, stat.read_blocks,
+                   stat.read_reqs ? stat.read_ticks * 1000 / RT_TICK_PER_SECOND / stat.read_reqs : 0,
+                   stat.read_max_ticks * 1000 / RT_TICK_PER_SECOND);
+        rt_kprintf("  write requests %d, blocks %d, avg %d ms, max %d ms, merged %d\n",
+                   stat.write_reqs, stat.write_blocks,
+                   stat.write_reqs ? stat.write_ticks * 1000 / RT_TICK_PER_SECOND / stat.write_reqs : 0,
+                   stat.write_max_ticks * 1000 / RT_TICK_PER_SECOND, stat.merged);
+    }
+}
+MSH_CMD_EXPORT(mmcsd_stat, show the request statistics of mmcsd block device);
+#endif
+
 /*
  * This function will initialize block device on the mmc/sd.
  *
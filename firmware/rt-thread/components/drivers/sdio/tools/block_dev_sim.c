@@ -0,0 +1,623 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * block_dev_sim runs the block device of mmcsd on the host over a modeled SD
+ * card, and prints the requests sent to the card and their time for some
+ * workloads of FAT, with the write merging or without it.
+ *
+ * The card is SDHC in memory on a 4-bit host. The commands are handled by
+ * mmcsd_send_cmd() and mmcsd_send_request() of this program, the time is
+ * simulated: 20us for a command, 250us to read and 1.5ms to write a request,
+ * and 41us to transfer one sector (12.5MB/s). The workloads also wait some
+ * time between the writes, and the delayed work of the system workqueue is
+ * run when its time is up, before the next call of device.
+ *
+ * The device is probed by rt_mmcsd_blk_probe(), it checks that:
+ * - the data read back and the card after sync are the same as written;
+ * - the statistics are the same as the requests seen by the card;
+ * - ACMD23 is sent before each multiple block write;
+ * - a pending write is sent within the flush period, while the adjacent
+ *   writes keep coming;
+ * - a failed flush keeps the pending write, the failure is reported by the
+ *   sync or the next write once, and the data is sent by the next sync;
+ * - close sends the pending write.
+ *
+ * block_dev.c is built into this program with the configuration in
+ * rtconfig.h, it merges the writes unless SIM_NO_WRITE_MERGE is defined:
+ *
+ *   gcc -O2 -std=gnu99 -I. -I../../../../include -I../../include -I../../../dfs/include block_dev_sim.c -o block_dev_sim
+ *   gcc -O2 -std=gnu99 -DSIM_NO_WRITE_MERGE -I. -I../../../../include -I../../include -I../../../dfs/include block_dev_sim.c -o block_dev_sim_nomerge
+ *
+ * usage: block_dev_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "../block_dev.c"
+
+#define SIM_SECTOR_SIZE     512
+#define SIM_SECTORS         16384   /* 8MB */
+#define SIM_CMD_US          20      /* command and response */
+#define SIM_READ_US         250     /* read request */
+#define SIM_WRITE_US        1500    /* write request */
+#define SIM_SECTOR_US       41      /* transfer one sector at 12.5MB/s */
+
+struct sim_card
+{
+    rt_uint64_t time_us;            /* the time of all commands and requests */
+    unsigned long reads;            /* the read requests */
+    unsigned long read_sectors;
+    unsigned long writes;           /* the write requests */
+    unsigned long write_sectors;
+    unsigned long multi_writes;     /* the write requests of multiple blocks */
+    unsigned long erase_counts;     /* ACMD23 */
+    unsigned long write_calls;      /* the writes to the device */
+};
+
+static struct sim_card sim;
+static struct rt_mmcsd_host host;
+static struct rt_mmcsd_card card;
+static rt_uint8_t card_data[SIM_SECTORS * SIM_SECTOR_SIZE];
+static rt_uint8_t shadow[SIM_SECTORS * SIM_SECTOR_SIZE];
+static rt_uint64_t written_us[SIM_SECTORS];
+static rt_uint64_t max_age_us;      /* the longest time from the write to the card */
+static rt_uint64_t sim_us;
+static rt_uint32_t erase_count;     /* the argument of the last ACMD23 */
+static int app_cmd;
+static int fail_writes;             /* the next write requests fail */
+static rt_device_t device;
+static struct rt_workqueue sys_workqueue;
+static struct rt_work *delayed_work;
+static int failed;
+
+/* the stubs of kernel, DFS and mmcsd core for the block device */
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void *rt_calloc(rt_size_t count, rt_size_t size) { return calloc(count, size); }
+void rt_free(void *ptr) { free(ptr); }
+void rt_free_align(void *ptr) { free(ptr); }
+void *rt_memset(void *s, int c, rt_ubase_t count) { return memset(s, c, count); }
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count) { return count ? memcpy(dst, src, count) : dst; }
+void rt_set_errno(rt_err_t no) { }
+rt_tick_t rt_tick_get(void) { return (rt_tick_t)(sim_us / 1000); }
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms) { return ms * RT_TICK_PER_SECOND / 1000; }
+
+void *rt_malloc_align(rt_size_t size, rt_size_t align)
+{
+    void *ptr;
+
+    return posix_memalign(&ptr, align, size) == 0 ? ptr : RT_NULL;
+}
+
+void rt_kprintf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+rt_int32_t rt_snprintf(char *buf, rt_size_t size, const char *fmt, ...)
+{
+    va_list args;
+    int length;
+
+    va_start(args, fmt);
+    length = vsnprintf(buf, size, fmt, args);
+    va_end(args);
+
+    return length;
+}
+
+void rt_assert_handler(const char *ex, const char *func, rt_size_t line)
+{
+    fprintf(stderr, "(%s) assertion failed at function:%s, line number:%d\n", ex, func, (int)line);
+    abort();
+}
+
+/* there is one thread, the lock must not be taken twice */
+rt_sem_t rt_sem_create(const char *name, rt_uint32_t value, rt_uint8_t flag)
+{
+    rt_sem_t sem = calloc(1, sizeof(struct rt_semaphore));
+
+    sem->value = value;
+
+    return sem;
+}
+
+rt_err_t rt_sem_delete(rt_sem_t sem) { free(sem); return RT_EOK; }
+
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
+{
+    RT_ASSERT(sem->value > 0);
+    sem->value--;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_release(rt_sem_t sem)
+{
+    sem->value++;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_device_register(rt_device_t dev, const char *name, rt_uint16_t flags)
+{
+    strncpy(dev->parent.name, name, RT_NAME_MAX - 1);
+    dev->flag = flags;
+    device = dev;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_device_unregister(rt_device_t dev)
+{
+    device = RT_NULL;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_device_control(rt_device_t dev, int cmd, void *arg)
+{
+    return dev->control(dev, cmd, arg);
+}
+
+int dfs_filesystem_get_partition(struct dfs_partition *part, uint8_t *buf, uint32_t pindex)
+{
+    /* the card has no partition table */
+    return -RT_ERROR;
+}
+
+const char *dfs_filesystem_get_mounted_path(struct rt_device *device) { return RT_NULL; }
+int dfs_unmount(const char *specialfile) { return 0; }
+
+/* the delayed work of system workqueue, submitting again re-arms it as the workqueue does */
+rt_err_t rt_work_submit(struct rt_work *work, rt_tick_t time)
+{
+    work->workqueue = &sys_workqueue;
+    work->flags = RT_WORK_STATE_SUBMITTING;
+    work->timeout_tick = rt_tick_get() + time;
+    delayed_work = work;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_workqueue_cancel_work_sync(struct rt_workqueue *queue, struct rt_work *work)
+{
+    work->flags = 0;
+    if (delayed_work == work)
+        delayed_work = RT_NULL;
+
+    return RT_EOK;
+}
+
+static void sim_run_work(void)
+{
+    struct rt_work *work = delayed_work;
+
+    if (work != RT_NULL && (rt_int32_t)(rt_tick_get() - work->timeout_tick) >= 0)
+    {
+        delayed_work = RT_NULL;
+        work->flags = 0;
+        work->work_func(work, work->work_data);
+    }
+}
+
+void mmcsd_host_lock(struct rt_mmcsd_host *host) { }
+void mmcsd_host_unlock(struct rt_mmcsd_host *host) { }
+void mmcsd_set_data_timeout(struct rt_mmcsd_data *data, const struct rt_mmcsd_card *card) { }
+
+static void sim_fail(const char *msg)
+{
+    printf("FAIL: %s\n", msg);
+    failed = 1;
+}
+
+/* the card */
+rt_int32_t mmcsd_send_cmd(struct rt_mmcsd_host *host, struct rt_mmcsd_cmd *cmd, int retries)
+{
+    int is_app = app_cmd;
+
+    sim_us += SIM_CMD_US;
+    sim.time_us += SIM_CMD_US;
+    app_cmd = 0;
+    cmd->err = 0;
+
+    switch (cmd->cmd_code)
+    {
+    case APP_CMD:
+        cmd->resp[0] = R1_APP_CMD;
+        app_cmd = 1;
+        break;
+    case SD_APP_SET_WR_BLK_ERASE_COUNT:
+        if (!is_app)
+            sim_fail("ACMD23 without APP_CMD");
+        erase_count = cmd->arg;
+        sim.erase_counts++;
+        cmd->resp[0] = 0;
+        break;
+    case SEND_STATUS:
+        /* ready for data, in the transfer state */
+        cmd->resp[0] = R1_READY_FOR_DATA | (4 << 9);
+        break;
+    case SET_BLOCKLEN:
+        cmd->resp[0] = 0;
+        break;
+    default:
+        cmd->err = -RT_ERROR;
+        break;
+    }
+
+    return cmd->err;
+}
+
+void mmcsd_send_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *req)
+{
+    struct rt_mmcsd_cmd *cmd = req->cmd;
+    struct rt_mmcsd_data *data = req->data;
+    rt_uint32_t sector = cmd->arg, index;
+    rt_uint32_t blks = data->blks;
+    int multi = (cmd->cmd_code == READ_MULTIPLE_BLOCK || cmd->cmd_code == WRITE_MULTIPLE_BLOCK);
+
+    app_cmd = 0;
+    cmd->err = data->err = 0;
+    if ((multi && (blks < 2 || req->stop == RT_NULL)) || (!multi && blks != 1)
+            || sector + blks > SIM_SECTORS)
+    {
+        sim_fail("bad request");
+        cmd->err = -RT_ERROR;
+        return;
+    }
+
+    switch (cmd->cmd_code)
+    {
+    case READ_SINGLE_BLOCK:
+    case READ_MULTIPLE_BLOCK:
+        memcpy(data->buf, card_data + sector * SIM_SECTOR_SIZE, blks * SIM_SECTOR_SIZE);
+        sim_us += SIM_READ_US + blks * SIM_SECTOR_US;
+        sim.time_us += SIM_READ_US + blks * SIM_SECTOR_US;
+        sim.reads++;
+        sim.read_sectors += blks;
+        break;
+    case WRITE_BLOCK:
+    case WRITE_MULTIPLE_BLOCK:
+        sim_us += SIM_WRITE_US + blks * SIM_SECTOR_US;
+        sim.time_us += SIM_WRITE_US + blks * SIM_SECTOR_US;
+        if (fail_writes > 0)
+        {
+            fail_writes--;
+            data->err = -RT_ERROR;
+            break;
+        }
+        if (multi)
+        {
+            if (erase_count != blks)
+                sim_fail("no ACMD23 of the blocks before multiple block write");
+            sim.multi_writes++;
+        }
+        erase_count = 0;
+        memcpy(card_data + sector * SIM_SECTOR_SIZE, data->buf, blks * SIM_SECTOR_SIZE);
+        for (index = sector; index < sector + blks; index++)
+        {
+            if (sim_us - written_us[index] > max_age_us)
+                max_age_us = sim_us - written_us[index];
+        }
+        sim.writes++;
+        sim.write_sectors += blks;
+        break;
+    default:
+        cmd->err = -RT_ERROR;
+        break;
+    }
+}
+
+/* the workloads, they read or write through the device and check the read data */
+static void sim_idle(rt_uint32_t us)
+{
+    sim_us += us;
+    sim_run_work();
+}
+
+static void sim_read(rt_uint32_t sector, rt_uint32_t count)
+{
+    static rt_uint8_t buf[64 * SIM_SECTOR_SIZE];
+
+    sim_run_work();
+    if (device->read(device, sector, buf, count) != count
+            || memcmp(buf, shadow + sector * SIM_SECTOR_SIZE, count * SIM_SECTOR_SIZE) != 0)
+    {
+        printf("FAIL: read %u sectors at %u\n", count, sector);
+        failed = 1;
+    }
+}
+
+/* write new data, it's kept in the shadow when the write succeeds */
+static rt_size_t sim_write(rt_uint32_t sector, rt_uint32_t count)
+{
+    static rt_uint8_t buf[64 * SIM_SECTOR_SIZE];
+    static rt_uint32_t seq;
+    rt_uint32_t index;
+    rt_size_t written;
+
+    for (index = 0; index < count * SIM_SECTOR_SIZE; index++)
+        buf[index] = (rt_uint8_t)(seq * 131 + index);
+    seq++;
+
+    sim_run_work();
+    for (index = sector; index < sector + count; index++)
+        written_us[index] = sim_us;
+    sim.write_calls++;
+    written = device->write(device, sector, buf, count);
+    if (written == count)
+        memcpy(shadow + sector * SIM_SECTOR_SIZE, buf, count * SIM_SECTOR_SIZE);
+
+    return written;
+}
+
+static void sim_write_ok(rt_uint32_t sector, rt_uint32_t count)
+{
+    if (sim_write(sector, count) != count)
+    {
+        printf("FAIL: write %u sectors at %u\n", count, sector);
+        failed = 1;
+    }
+}
+
+static rt_err_t sim_sync(void)
+{
+    sim_run_work();
+
+    return rt_device_control(device, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+}
+
+static void sim_verify(const char *name)
+{
+    if (memcmp(card_data, shadow, sizeof(shadow)) != 0)
+    {
+        printf("%s: FAIL, the card is different from the written data\n", name);
+        failed = 1;
+    }
+}
+
+/* the FAT32 layout: FAT at 32, directory at 2048, data from 4096 */
+#define SIM_FAT             32
+#define SIM_DIR             2048
+#define SIM_DATA            4096
+
+/* append a record to a log file every 2ms, one sector is filled by 8 records, f_sync every 64 sectors */
+static void load_log(void)
+{
+    rt_uint32_t index, sector;
+
+    for (index = 0; index < 4096; index++)
+    {
+        sector = SIM_DATA + index / 8;
+        sim_write_ok(sector, 1);
+        if (index % 512 == 511)
+        {
+            sim_write_ok(SIM_FAT + index / 512, 1);
+            sim_write_ok(SIM_DIR, 1);
+            if (sim_sync() != RT_EOK)
+                sim_fail("sync");
+        }
+        sim_idle(2000);
+    }
+}
+
+/* write 1MB by clusters of 8 sectors as copying a file, the FAT is updated every 16 clusters */
+static void load_copy(void)
+{
+    rt_uint32_t index;
+
+    for (index = 0; index < 256; index++)
+    {
+        sim_write_ok(SIM_DATA + 1024 + index * 8, 8);
+        if (index % 16 == 15)
+        {
+            sim_read(SIM_FAT + 8 + index / 128, 1);
+            sim_write_ok(SIM_FAT + 8 + index / 128, 1);
+        }
+    }
+    if (sim_sync() != RT_EOK)
+        sim_fail("sync");
+}
+
+/* large writes of 64 sectors, they are not merged */
+static void load_large(void)
+{
+    rt_uint32_t index;
+
+    for (index = 0; index < 32; index++)
+        sim_write_ok(SIM_DATA + 4096 + index * 64, 64);
+    if (sim_sync() != RT_EOK)
+        sim_fail("sync");
+}
+
+/* reads, writes and syncs of 1-16 sectors around, every read is checked */
+static void load_check(void)
+{
+    rt_uint32_t index, sector, count;
+
+    srand(3);
+    for (index = 0; index < 20000; index++)
+    {
+        count = 1 + (rand() % 4 ? 0 : rand() % 16);
+        sector = (rand() % 4 ? rand() % 256 : rand() % SIM_SECTORS);
+        if (sector + count > SIM_SECTORS)
+            sector = SIM_SECTORS - count;
+
+        switch (rand() % 8)
+        {
+        case 0:
+            if (sim_sync() != RT_EOK)
+                sim_fail("sync");
+            break;
+        case 1:
+        case 2:
+        case 3:
+            sim_write_ok(sector, count);
+            break;
+        default:
+            sim_read(sector, count);
+            break;
+        }
+        sim_idle(rand() % 4 ? 0 : 10000);
+    }
+    if (sim_sync() != RT_EOK)
+        sim_fail("sync");
+}
+
+static void bench(const char *name, void (*load)(void))
+{
+    struct rt_mmcsd_blk_stat before, stat;
+
+    rt_device_control(device, RT_DEVICE_CTRL_BLK_MMCSD_STAT, &before);
+    memset(&sim, 0, sizeof(sim));
+    load();
+    sim_verify(name);
+    rt_device_control(device, RT_DEVICE_CTRL_BLK_MMCSD_STAT, &stat);
+
+    if (stat.write_reqs - before.write_reqs != sim.writes
+            || stat.write_blocks - before.write_blocks != sim.write_sectors
+            || stat.read_reqs - before.read_reqs != sim.reads
+            || stat.read_blocks - before.read_blocks != sim.read_sectors)
+    {
+        printf("%s: FAIL, the statistics are different from the requests\n", name);
+        failed = 1;
+    }
+    if (sim.erase_counts != sim.multi_writes)
+    {
+        printf("%s: FAIL, %lu ACMD23 for %lu multiple block writes\n", name,
+               sim.erase_counts, sim.multi_writes);
+        failed = 1;
+    }
+
+    printf("%-10s %7lu %7lu %7lu %7lu %7lu %9.1f %8.2f %6lu\n", name,
+           sim.write_calls, sim.writes, sim.write_sectors, sim.reads, sim.erase_counts,
+           sim.time_us / 1000.0,
+           stat.write_reqs - before.write_reqs ?
+           (double)(stat.write_ticks - before.write_ticks) * 1000 / RT_TICK_PER_SECOND
+           / (stat.write_reqs - before.write_reqs) : 0,
+           (unsigned long)(stat.merged - before.merged));
+}
+
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+/* adjacent writes every 5ms for 150ms, the first one must not wait much longer than the period */
+static void check_flush_period(void)
+{
+    rt_uint32_t index;
+
+    max_age_us = 0;
+    for (index = 0; index < 30; index++)
+    {
+        sim_write_ok(SIM_DATA + 8192 + index, 1);
+        sim_idle(5000);
+    }
+    if (sim_sync() != RT_EOK)
+        sim_fail("sync");
+    sim_verify("flush");
+
+    printf("flush period: the oldest write waits %.1f ms, the period is %d ms\n",
+           max_age_us / 1000.0, RT_MMCSD_MERGE_FLUSH_PERIOD);
+    if (max_age_us > (RT_MMCSD_MERGE_FLUSH_PERIOD + 5 + 5) * 1000)
+        sim_fail("the pending write is delayed by the adjacent writes");
+}
+
+static void check_failure(void)
+{
+    rt_uint32_t index;
+
+    /* sync fails, the pending write is kept and sent by the next sync */
+    for (index = 0; index < 4; index++)
+        sim_write_ok(SIM_DATA + 8448 + index, 1);
+    fail_writes = 1;
+    if (sim_sync() == RT_EOK)
+        sim_fail("the failed sync returns ok");
+    if (sim_sync() != RT_EOK)
+        sim_fail("the pending write isn't sent again");
+    sim_verify("sync failure");
+
+    /* the flush work fails, the next write reports it once and isn't written */
+    for (index = 0; index < 4; index++)
+        sim_write_ok(SIM_DATA + 8456 + index, 1);
+    fail_writes = 1;
+    sim_idle((RT_MMCSD_MERGE_FLUSH_PERIOD + 1) * 1000);
+    if (sim_write(SIM_DATA + 8460, 1) != 0)
+        sim_fail("the failure of flush work isn't reported");
+    if (sim_sync() != RT_EOK)
+        sim_fail("the failure of flush work is reported twice");
+    sim_verify("work failure");
+
+    /* the pending write is sent by the read of same sectors */
+    sim_write_ok(SIM_DATA + 8464, 2);
+    sim_read(SIM_DATA + 8465, 1);
+    if (memcmp(card_data, shadow, sizeof(shadow)) != 0)
+        sim_fail("the overlapped read doesn't send the pending write");
+
+    /* close sends the pending write */
+    sim_write_ok(SIM_DATA + 8472, 2);
+    if (device->close(device) != RT_EOK)
+        sim_fail("close");
+    sim_verify("close");
+
+    printf("failure: %s\n", failed ? "FAIL" : "ok");
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    host.flags = MMCSD_BUSWIDTH_4 | MMCSD_MUTBLKWRITE;
+    host.max_seg_size = 65536;
+    host.max_dma_segs = 1;
+    host.max_blk_size = 512;
+    host.max_blk_count = 128;
+    card.host = &host;
+    card.rca = 1;
+    card.card_type = CARD_TYPE_SD;
+    card.flags = CARD_FLAG_SDHC;
+    card.card_capacity = SIM_SECTORS / 2;
+    card.card_blksize = 512;
+    host.card = &card;
+
+    if (rt_mmcsd_blk_probe(&card) != RT_EOK || device == RT_NULL)
+    {
+        printf("FAIL: probe\n");
+        return 1;
+    }
+
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+    printf("write merge of %d sectors, flush period %d ms\n\n", RT_MMCSD_MERGE_SECTORS,
+           RT_MMCSD_MERGE_FLUSH_PERIOD);
+#else
+    printf("no write merge\n\n");
+#endif
+    printf("%-10s %7s %7s %7s %7s %7s %9s %8s %6s\n", "workload",
+           "writes", "w reqs", "w sect", "r reqs", "ACMD23", "card ms", "avg ms", "merged");
+    bench("log", load_log);
+    bench("copy", load_copy);
+    bench("large", load_large);
+    bench("check", load_check);
+    printf("\n");
+
+#ifdef RT_MMCSD_USING_WRITE_MERGE
+    check_flush_period();
+    check_failure();
+#endif
+    rt_mmcsd_blk_remove(&card);
+
+    printf("\n%s\n", failed ? "FAIL" : "PASS");
+
+    return failed;
+}
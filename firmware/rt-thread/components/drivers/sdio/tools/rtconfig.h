@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/* the configuration of block_dev_sim, the block device of mmcsd is built for the host */
+
+#ifndef RT_CONFIG_H__
+#define RT_CONFIG_H__
+
+#define RT_NAME_MAX 8
+#define RT_ALIGN_SIZE 4
+#define RT_THREAD_PRIORITY_32
+#define RT_THREAD_PRIORITY_MAX 32
+#define RT_TICK_PER_SECOND 1000
+#define RT_DEBUG
+#define RT_USING_SEMAPHORE
+#define RT_USING_MUTEX
+#define RT_USING_HEAP
+#define RT_USING_DEVICE
+#define RT_USING_CONSOLE
+#define RT_USING_SYSTEM_WORKQUEUE
+
+/* the libc and the signals are from the host */
+#define RT_USING_NEWLIB
+#define LIBC_SIGNAL_H__
+#include <signal.h>
+
+#define RT_USING_DFS
+#define RT_USING_SDIO
+#define RT_MMCSD_MAX_PARTITION 16
+#ifndef SIM_NO_WRITE_MERGE
+#define RT_MMCSD_USING_WRITE_MERGE
+#define RT_MMCSD_MERGE_SECTORS 32
+#define RT_MMCSD_MERGE_FLUSH_PERIOD 100
+#endif
+
+#endif
@@ -7,6 +7,7 @@
  * Date           Author       Notes
  * 2019-01-31     flybreak     first version
  * 2020-02-22     luhuadong    support custom commands
+ * 2020-11-20     luhuadong    add sample fifo for interrupt and fifo mode
  */
 
 #include "sensor.h"
@@ -39,11 +40,207 @@ static char *const sensor_name_str[] =
 };
 
 /* Sensor interrupt correlation function */
+#ifdef RT_SENSOR_USING_FIFO
+/* The number of records expected on each interrupt */
+#define SENSOR_FIFO_FETCH_NUM(sen) \
+    (((sen)->config.mode == RT_SENSOR_MODE_FIFO && (sen)->info.fifo_max > 0) ? (sen)->info.fifo_max : 1)
+
+static rt_size_t sensor_fifo_len(rt_sensor_t sen)
+{
+    return (rt_uint16_t)(sen->fifo.put_index - sen->fifo.get_index);
+}
+
+/* The samples of hardware fifo are output at odr, the last one is the latest */
+static void sensor_fifo_stamp(rt_sensor_t sen, struct rt_sensor_data *data, rt_size_t len, rt_uint32_t ts)
+{
+    rt_size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+#ifndef RT_USING_RTC
+        if (sen->config.odr > 0)
+        {
+            data[i].timestamp = ts - (len - 1 - i) * RT_TICK_PER_SECOND / sen->config.odr;
+            continue;
+        }
+#endif
+        data[i].timestamp = ts;
+    }
+}
+
+/* Fetch the data into fifo, the bus of sensor can't be accessed in ISR */
+static void sensor_fifo_work(struct rt_work *work, void *work_data)
+{
+    rt_sensor_t sen = (rt_sensor_t)work_data;
+    struct rt_sensor_fifo *fifo = &sen->fifo;
+    struct rt_sensor_data *data;
+    rt_size_t free, index, len, first;
+    rt_uint32_t ts;
+
+    if (sen->module)
+    {
+        rt_mutex_take(sen->module->lock, RT_WAITING_FOREVER);
+    }
+
+    /* the interrupt may come again while fetching the data */
+    while (fifo->irq_pending)
+    {
+        fifo->irq_pending = 0;
+        ts = fifo->irq_ts;
+
+        free = fifo->size - sensor_fifo_len(sen);
+        index = fifo->put_index & (fifo->size - 1);
+        /* the records over the end of fifo are fetched into the tail of buffer */
+        data = (free >= SENSOR_FIFO_FETCH_NUM(sen)) ? &fifo->buf[index] : &fifo->buf[fifo->size];
+
+        len = sen->ops->fetch_data(sen, data, SENSOR_FIFO_FETCH_NUM(sen));
+        if (len == 0)
+        {
+            continue;
+        }
+        sensor_fifo_stamp(sen, data, len, ts);
+
+        if (len > free)
+        {
+            /* fetch all of data to clear the interrupt, but the newest are dropped */
+            fifo->overrun += len - free;
+            len = free;
+        }
+
+        first = fifo->size - index;
+        if (first > len)
+        {
+            first = len;
+        }
+        if (data != &fifo->buf[index])
+        {
+            rt_memcpy(&fifo->buf[index], data, first * sizeof(struct rt_sensor_data));
+        }
+        if (len > first)
+        {
+            rt_memcpy(&fifo->buf[0], data + first, (len - first) * sizeof(struct rt_sensor_data));
+        }
+        fifo->put_index += len;
+    }
+
+    if (sen->module)
+    {
+        rt_mutex_release(sen->module->lock);
+    }
+
+    if (sen->parent.rx_indicate != RT_NULL && sensor_fifo_len(sen) > 0)
+    {
+        sen->parent.rx_indicate(&sen->parent, sensor_fifo_len(sen));
+    }
+}
+
+static rt_err_t sensor_fifo_init(rt_sensor_t sen)
+{
+    struct rt_sensor_fifo *fifo = &sen->fifo;
+    rt_uint16_t size = 1;
+
+    if (fifo->buf != RT_NULL)
+    {
+        return RT_EOK;
+    }
+
+    /* The fifo saves RT_SENSOR_FIFO_SIZE records or the hardware fifo at least */
+    while (size < RT_SENSOR_FIFO_SIZE || size < sen->info.fifo_max)
+    {
+        size <<= 1;
+    }
+
+    fifo->buf = rt_malloc((size + SENSOR_FIFO_FETCH_NUM(sen)) * sizeof(struct rt_sensor_data));
+    if (fifo->buf == RT_NULL)
+    {
+        return -RT_ENOMEM;
+    }
+    fifo->size = size;
+    fifo->put_index = 0;
+    fifo->get_index = 0;
+    fifo->irq_pending = 0;
+    fifo->overrun = 0;
+    rt_work_init(&fifo->work, sensor_fifo_work, sen);
+
+    return RT_EOK;
+}
+
+static void sensor_fifo_deinit(rt_sensor_t sen)
+{
+    struct rt_sensor_fifo *fifo = &sen->fifo;
+
+    if (fifo->buf == RT_NULL)
+    {
+        return;
+    }
+
+    /* The interrupt is disabled, wait for the fetching work */
+    fifo->irq_pending = 0;
+    if (fifo->work.workqueue != RT_NULL)
+    {
+        rt_workqueue_cancel_work_sync(fifo->work.workqueue, &fifo->work);
+    }
+    rt_free(fifo->buf);
+    fifo->buf = RT_NULL;
+}
+
+static rt_size_t sensor_fifo_read(rt_sensor_t sen, struct rt_sensor_data *data, rt_size_t len)
+{
+    struct rt_sensor_fifo *fifo = &sen->fifo;
+    rt_size_t index, first;
+
+    if (len > sensor_fifo_len(sen))
+    {
+        len = sensor_fifo_len(sen);
+    }
+
+    /* Copy the records in batch, at most twice for the wrapped records */
+    index = fifo->get_index & (fifo->size - 1);
+    first = fifo->size - index;
+    if (first > len)
+    {
+        first = len;
+    }
+    rt_memcpy(data, &fifo->buf[index], first * sizeof(struct rt_sensor_data));
+    rt_memcpy(data + first, &fifo->buf[0], (len - first) * sizeof(struct rt_sensor_data));
+    fifo->get_index += len;
+
+    return len;
+}
+#endif
+
 /*
  * Sensor interrupt handler function
  */
 void rt_sensor_cb(rt_sensor_t sen)
 {
+#ifdef RT_SENSOR_USING_FIFO
+    if (sen->fifo.buf != RT_NULL)
+    {
+        if (sen->irq_handle != RT_NULL)
+        {
+            sen->irq_handle(sen);
+        }
+
+        if (sen->data_len == 0)
+        {
+            /* Timestamp on interrupt, the data is fetched into fifo by the system workqueue */
+            sen->fifo.irq_ts = rt_sensor_get_ts();
+            sen->fifo.irq_pending = 1;
+            if (rt_work_submit(&sen->fifo.work, 0) == -RT_EBUSY &&
+                    !(sen->fifo.work.flags & RT_WORK_STATE_PENDING))
+            {
+                /*
+                 * The work is running, it may have finished fetching and miss
+                 * this interrupt. Submit it again after the running one is done.
+                 */
+                rt_work_submit(&sen->fifo.work, 1);
+            }
+            return;
+        }
+    }
+#endif
+
     if (sen->parent.rx_indicate == RT_NULL)
     {
         return;
@@ -160,9 +357,16 @@ static rt_err_t rt_sensor_open(rt_device_t dev, rt_uint16_t oflag)
             /* If interrupt mode is supported, configure it to interrupt mode */
             sensor->ops->control(sensor, RT_SENSOR_CTRL_SET_MODE, (void *)RT_SENSOR_MODE_INT);
         }
+        sensor->config.mode = RT_SENSOR_MODE_INT;
+#ifdef RT_SENSOR_USING_FIFO
+        if (sensor->config.irq_pin.pin != RT_PIN_NONE && sensor_fifo_init(sensor) != RT_EOK)
+        {
+            res = -RT_ENOMEM;
+            goto __exit;
+        }
+#endif
         /* Initialization sensor interrupt */
         rt_sensor_irq_init(sensor);
-        sensor->config.mode = RT_SENSOR_MODE_INT;
     }
     else if (oflag & RT_DEVICE_FLAG_FIFO_RX && dev->flag & RT_DEVICE_FLAG_FIFO_RX)
     {
@@ -171,9 +375,16 @@ static rt_err_t rt_sensor_open(rt_device_t dev, rt_uint16_t oflag)
             /* If fifo mode is supported, configure it to fifo mode */
             sensor->ops->control(sensor, RT_SENSOR_CTRL_SET_MODE, (void *)RT_SENSOR_MODE_FIFO);
         }
+        sensor->config.mode = RT_SENSOR_MODE_FIFO;
+#ifdef RT_SENSOR_USING_FIFO
+        if (sensor->config.irq_pin.pin != RT_PIN_NONE && sensor_fifo_init(sensor) != RT_EOK)
+        {
+            res = -RT_ENOMEM;
+            goto __exit;
+        }
+#endif
         /* Initialization sensor interrupt */
         rt_sensor_irq_init(sensor);
-        sensor->config.mode = RT_SENSOR_MODE_FIFO;
     }
     else
     {
@@ -246,6 +457,11 @@ __exit:
         rt_mutex_release(sensor->module->lock);
     }
 
+#ifdef RT_SENSOR_USING_FIFO
+    /* The fetching work takes the module lock */
+    sensor_fifo_deinit(sensor);
+#endif
+
     return RT_EOK;
 }
 
@@ -265,6 +481,14 @@ static rt_size_t rt_sensor_read(rt_device_t dev, rt_off_t pos, void *buf, rt_siz
         rt_mutex_take(sensor->module->lock, RT_WAITING_FOREVER);
     }
 
+#ifdef RT_SENSOR_USING_FIFO
+    if (sensor->fifo.buf != RT_NULL && sensor->data_len == 0)
+    {
+        /* Read the samples fetched on interrupt */
+        result = sensor_fifo_read(sensor, (struct rt_sensor_data *)buf, len);
+    }
+    else
+#endif
     /* The buffer is not empty. Read the data in the buffer first */
     if (sensor->data_len > 0)
     {
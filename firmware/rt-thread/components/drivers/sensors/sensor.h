@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2019-01-31     flybreak     first version
+ * 2020-11-20     luhuadong    add sample fifo for interrupt and fifo mode
  */
 
 #ifndef __SENSOR_H__
@@ -108,8 +109,8 @@ extern "C" {
 
 #define  RT_SENSOR_MODE_NONE           (0)
 #define  RT_SENSOR_MODE_POLLING        (1)  /* One shot only read a data */
-#define  RT_SENSOR_MODE_INT            (2)  /* TODO: One shot interrupt only read a data */
-#define  RT_SENSOR_MODE_FIFO           (3)  /* TODO: One shot interrupt read all fifo data */
+#define  RT_SENSOR_MODE_INT            (2)  /* One shot interrupt only read a data */
+#define  RT_SENSOR_MODE_FIFO           (3)  /* One shot interrupt read all fifo data */
 
 /* Sensor control cmd types */
 
@@ -155,6 +156,21 @@ struct rt_sensor_config
 
 typedef struct rt_sensor_device *rt_sensor_t;
 
+#ifdef RT_SENSOR_USING_FIFO
+/* The samples fetched on interrupt, single producer (the fetch work) and single consumer (the reader) */
+struct rt_sensor_fifo
+{
+    struct rt_sensor_data       *buf;       /* size + fifo_max records, the tail is used to fetch the wrapped data */
+    rt_uint16_t                  size;      /* The number of records, power of 2 */
+    volatile rt_uint16_t         put_index; /* Free running index, updated by the producer only */
+    volatile rt_uint16_t         get_index; /* Free running index, updated by the consumer only */
+    volatile rt_uint8_t          irq_pending;
+    rt_uint32_t                  irq_ts;    /* The timestamp of the latest interrupt */
+    rt_uint32_t                  overrun;   /* The samples dropped since the fifo is full */
+    struct rt_work               work;      /* Fetch the data in the system workqueue */
+};
+#endif
+
 struct rt_sensor_device
 {
     struct rt_device             parent;    /* The standard device */
@@ -168,7 +184,11 @@ struct rt_sensor_device
     const struct rt_sensor_ops  *ops;       /* The sensor ops */
 
     struct rt_sensor_module     *module;    /* The sensor module */
-    
+
+#ifdef RT_SENSOR_USING_FIFO
+    struct rt_sensor_fifo        fifo;      /* The samples of interrupt and fifo mode */
+#endif
+
     rt_err_t (*irq_handle)(rt_sensor_t sensor);             /* Called when an interrupt is generated, registered by the driver */
 };
 
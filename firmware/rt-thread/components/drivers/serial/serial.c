@@ -24,6 +24,8 @@
  * 2018-12-08     Ernest Chen  add DMA choice
  * 2020-09-14     WillianChan  add a line feed to the carriage return character
  *                             when using interrupt tx
+ * 2020-11-17     luhuadong    add writev and interrupt tx ring buffer
+ * 2020-11-18     luhuadong    add rx peek/consume, rx notify threshold and rx statistics
  */
 
 #include <rthw.h>
@@ -304,6 +306,32 @@ rt_inline int _serial_int_rx(struct rt_serial_device *serial, rt_uint8_t *data,
     return size - length;
 }
 
+#ifdef RT_SERIAL_USING_TX_RB
+/* send the data of tx ring buffer until the hardware is busy */
+static void _serial_int_tx_drain(struct rt_serial_device *serial, struct rt_serial_tx_fifo *tx)
+{
+    rt_base_t level;
+    rt_uint8_t *ptr;
+    rt_size_t length, count;
+
+    level = rt_hw_interrupt_disable();
+    while ((length = rt_ringbuffer_peek(&(tx->rb), &ptr)) > 0)
+    {
+        for (count = 0; count < length; count++)
+        {
+            if (serial->ops->putc(serial, ptr[count]) == -1)
+                break;
+        }
+        rt_ringbuffer_consume(&(tx->rb), count);
+
+        /* the hardware is busy, the rest is sent in tx done interrupt */
+        if (count < length)
+            break;
+    }
+    rt_hw_interrupt_enable(level);
+}
+#endif /* RT_SERIAL_USING_TX_RB */
+
 rt_inline int _serial_int_tx(struct rt_serial_device *serial, const rt_uint8_t *data, int length)
 {
     int size;
@@ -315,6 +343,42 @@ rt_inline int _serial_int_tx(struct rt_serial_device *serial, const rt_uint8_t *
     tx = (struct rt_serial_tx_fifo*) serial->serial_tx;
     RT_ASSERT(tx != RT_NULL);
 
+#ifdef RT_SERIAL_USING_TX_RB
+    while (length)
+    {
+        rt_base_t level;
+
+        /* copy data to tx ring buffer as much as possible */
+        level = rt_hw_interrupt_disable();
+        while (length)
+        {
+            /*
+             * to be polite with serial console add a line feed
+             * to the carriage return character
+             */
+            if (*data == '\n' && (serial->parent.open_flag & RT_DEVICE_FLAG_STREAM))
+            {
+                if (rt_ringbuffer_space_len(&(tx->rb)) < 2)
+                    break;
+                rt_ringbuffer_putchar(&(tx->rb), '\r');
+            }
+
+            if (rt_ringbuffer_putchar(&(tx->rb), *data) == 0)
+                break;
+
+            data ++; length --;
+        }
+        rt_hw_interrupt_enable(level);
+
+        _serial_int_tx_drain(serial, tx);
+
+        /* the buffer is full, wait for tx done interrupt */
+        if (length)
+        {
+            rt_completion_wait(&(tx->completion), RT_WAITING_FOREVER);
+        }
+    }
+#else
     while (length)
     {
         /*
@@ -338,6 +402,7 @@ rt_inline int _serial_int_tx(struct rt_serial_device *serial, const rt_uint8_t *
 
         data ++; length --;
     }
+#endif /* RT_SERIAL_USING_TX_RB */
 
     return size - length;
 }
@@ -356,7 +421,6 @@ static void _serial_check_buffer_size(void)
     }
 }
 
-#if defined(RT_USING_POSIX) || defined(RT_SERIAL_USING_DMA)
 static rt_size_t _serial_fifo_calc_recved_len(struct rt_serial_device *serial)
 {
     struct rt_serial_rx_fifo *rx_fifo = (struct rt_serial_rx_fifo *) serial->serial_rx;
@@ -379,7 +443,123 @@ static rt_size_t _serial_fifo_calc_recved_len(struct rt_serial_device *serial)
         }
     }
 }
-#endif /* RT_USING_POSIX || RT_SERIAL_USING_DMA */
+
+/* whether the rx data is saved in rx fifo */
+rt_inline rt_bool_t _serial_rx_fifo_mode(struct rt_serial_device *serial)
+{
+    if (serial->serial_rx == RT_NULL)
+        return RT_FALSE;
+
+    if (serial->parent.open_flag & RT_DEVICE_FLAG_INT_RX)
+        return RT_TRUE;
+
+#ifdef RT_SERIAL_USING_DMA
+    if ((serial->parent.open_flag & RT_DEVICE_FLAG_DMA_RX) && serial->config.bufsz != 0)
+        return RT_TRUE;
+#endif
+
+    return RT_FALSE;
+}
+
+/* invoke rx_indicate when the received data reaches the threshold or the line is idle */
+static void _serial_rx_notify(struct rt_serial_device *serial, rt_size_t length, rt_bool_t idle)
+{
+    if (serial->parent.rx_indicate == RT_NULL || length == 0)
+        return;
+
+    if (serial->rx_notify_threshold > 1 && !idle && length < serial->rx_notify_threshold)
+        return;
+
+    serial->rx_stats.rx_notify++;
+    serial->parent.rx_indicate(&(serial->parent), length);
+}
+
+/**
+ * This function gets the received data in rx fifo without copying, it's
+ * available in interrupt rx mode and DMA rx mode with rx fifo.
+ *
+ * @param dev the serial device
+ * @param ptr the received data
+ *
+ * @return the length of contiguous data at ptr, the rest is at the beginning
+ *         of fifo when the data is wrapped around
+ *
+ * @note The data may be overwritten by DMA when the fifo is overrun, so it
+ *       should be consumed in time.
+ */
+rt_size_t rt_serial_rx_peek(rt_device_t dev, rt_uint8_t **ptr)
+{
+    rt_base_t level;
+    rt_size_t length;
+    struct rt_serial_device *serial;
+    struct rt_serial_rx_fifo *rx_fifo;
+
+    RT_ASSERT(dev != RT_NULL);
+    RT_ASSERT(ptr != RT_NULL);
+
+    serial = (struct rt_serial_device *)dev;
+    *ptr = RT_NULL;
+    if (!_serial_rx_fifo_mode(serial))
+        return 0;
+
+    rx_fifo = (struct rt_serial_rx_fifo *) serial->serial_rx;
+
+    level = rt_hw_interrupt_disable();
+    length = _serial_fifo_calc_recved_len(serial);
+    if (rx_fifo->get_index + length > serial->config.bufsz)
+    {
+        length = serial->config.bufsz - rx_fifo->get_index;
+    }
+    *ptr = &(rx_fifo->buffer[rx_fifo->get_index]);
+    rt_hw_interrupt_enable(level);
+
+    return length;
+}
+RTM_EXPORT(rt_serial_rx_peek);
+
+/**
+ * This function removes the data which has been handled through rt_serial_rx_peek.
+ *
+ * @param dev the serial device
+ * @param length the length of data
+ *
+ * @return the length of removed data
+ */
+rt_size_t rt_serial_rx_consume(rt_device_t dev, rt_size_t length)
+{
+    rt_base_t level;
+    rt_size_t recved;
+    struct rt_serial_device *serial;
+    struct rt_serial_rx_fifo *rx_fifo;
+
+    RT_ASSERT(dev != RT_NULL);
+
+    serial = (struct rt_serial_device *)dev;
+    if (!_serial_rx_fifo_mode(serial))
+        return 0;
+
+    rx_fifo = (struct rt_serial_rx_fifo *) serial->serial_rx;
+
+    level = rt_hw_interrupt_disable();
+    recved = _serial_fifo_calc_recved_len(serial);
+    if (length > recved)
+    {
+        length = recved;
+    }
+    if (length)
+    {
+        rx_fifo->is_full = RT_FALSE;
+        rx_fifo->get_index += length;
+        if (rx_fifo->get_index >= serial->config.bufsz)
+        {
+            rx_fifo->get_index -= serial->config.bufsz;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    return length;
+}
+RTM_EXPORT(rt_serial_rx_consume);
 
 #ifdef RT_SERIAL_USING_DMA
 /**
@@ -464,6 +644,40 @@ static void rt_dma_recv_update_put_index(struct rt_serial_device *serial, rt_siz
     }
 }
 
+/**
+ * DMA received some data, it's invoked on DMA half/full transfer or idle line.
+ *
+ * @param serial serial device
+ * @param len received length for this event
+ * @param idle whether the line is idle
+ */
+static void _serial_dma_rx_done(struct rt_serial_device *serial, rt_size_t len, rt_bool_t idle)
+{
+    rt_base_t level;
+    rt_size_t space;
+
+    /* disable interrupt */
+    level = rt_hw_interrupt_disable();
+    serial->rx_stats.rx_events++;
+    serial->rx_stats.rx_bytes += len;
+    space = serial->config.bufsz - rt_dma_calc_recved_len(serial);
+    if (len > space)
+    {
+        /* the old data is overwritten */
+        serial->rx_stats.rx_overrun++;
+        serial->rx_stats.rx_dropped += len - space;
+    }
+    /* update fifo put index */
+    rt_dma_recv_update_put_index(serial, len);
+    /* calculate received total length */
+    len = rt_dma_calc_recved_len(serial);
+    /* enable interrupt */
+    rt_hw_interrupt_enable(level);
+
+    /* invoke callback */
+    _serial_rx_notify(serial, len, idle);
+}
+
 /*
  * Serial DMA routines
  */
@@ -524,7 +738,8 @@ rt_inline int _serial_dma_rx(struct rt_serial_device *serial, rt_uint8_t *data,
     }
 }
 
-rt_inline int _serial_dma_tx(struct rt_serial_device *serial, const rt_uint8_t *data, int length)
+/* push a segment to DMA tx queue, the tx_dma->lock must be taken */
+static rt_err_t _serial_dma_tx_push(struct rt_serial_device *serial, const rt_uint8_t *data, int length)
 {
     rt_base_t level;
     rt_err_t result;
@@ -535,6 +750,8 @@ rt_inline int _serial_dma_tx(struct rt_serial_device *serial, const rt_uint8_t *
     result = rt_data_queue_push(&(tx_dma->data_queue), data, length, RT_WAITING_FOREVER);
     if (result == RT_EOK)
     {
+        tx_dma->push_count++;
+
         level = rt_hw_interrupt_disable();
         if (tx_dma->activated != RT_TRUE)
         {
@@ -548,7 +765,24 @@ rt_inline int _serial_dma_tx(struct rt_serial_device *serial, const rt_uint8_t *
         {
             rt_hw_interrupt_enable(level);
         }
+    }
+
+    return result;
+}
 
+rt_inline int _serial_dma_tx(struct rt_serial_device *serial, const rt_uint8_t *data, int length)
+{
+    rt_err_t result;
+    struct rt_serial_tx_dma *tx_dma;
+
+    tx_dma = (struct rt_serial_tx_dma*)(serial->serial_tx);
+
+    rt_mutex_take(&(tx_dma->lock), RT_WAITING_FOREVER);
+    result = _serial_dma_tx_push(serial, data, length);
+    rt_mutex_release(&(tx_dma->lock));
+
+    if (result == RT_EOK)
+    {
         return length;
     }
     else
@@ -609,6 +843,11 @@ static rt_err_t rt_serial_open(struct rt_device *dev, rt_uint16_t oflag)
     /* get open flags */
     dev->open_flag = oflag & 0xff;
 
+    if (dev->ref_count == 0)
+    {
+        rt_memset(&(serial->rx_stats), 0, sizeof(serial->rx_stats));
+    }
+
     /* initialize the Rx/Tx structure according to open flag */
     if (serial->serial_rx == RT_NULL)
     { 
@@ -680,8 +919,15 @@ static rt_err_t rt_serial_open(struct rt_device *dev, rt_uint16_t oflag)
         {
             struct rt_serial_tx_fifo *tx_fifo;
 
+#ifdef RT_SERIAL_USING_TX_RB
+            tx_fifo = (struct rt_serial_tx_fifo*) rt_malloc(sizeof(struct rt_serial_tx_fifo) +
+                RT_SERIAL_TX_RB_BUFSZ);
+            RT_ASSERT(tx_fifo != RT_NULL);
+            rt_ringbuffer_init(&(tx_fifo->rb), (rt_uint8_t *)(tx_fifo + 1), RT_SERIAL_TX_RB_BUFSZ);
+#else
             tx_fifo = (struct rt_serial_tx_fifo*) rt_malloc(sizeof(struct rt_serial_tx_fifo));
             RT_ASSERT(tx_fifo != RT_NULL);
+#endif
 
             rt_completion_init(&(tx_fifo->completion));
             serial->serial_tx = tx_fifo;
@@ -698,8 +944,13 @@ static rt_err_t rt_serial_open(struct rt_device *dev, rt_uint16_t oflag)
             tx_dma = (struct rt_serial_tx_dma*) rt_malloc (sizeof(struct rt_serial_tx_dma));
             RT_ASSERT(tx_dma != RT_NULL);
             tx_dma->activated = RT_FALSE;
+            tx_dma->push_count = 0;
+            tx_dma->done_count = 0;
+            tx_dma->notify_get = 0;
+            tx_dma->notify_put = 0;
 
-            rt_data_queue_init(&(tx_dma->data_queue), 8, 4, RT_NULL);
+            rt_data_queue_init(&(tx_dma->data_queue), RT_SERIAL_TX_DMA_SEGMENTS, 4, RT_NULL);
+            rt_mutex_init(&(tx_dma->lock), dev->parent.name, RT_IPC_FLAG_FIFO);
             serial->serial_tx = tx_dma;
 
             dev->open_flag |= RT_DEVICE_FLAG_DMA_TX;
@@ -801,6 +1052,7 @@ static rt_err_t rt_serial_close(struct rt_device *dev)
         RT_ASSERT(tx_dma != RT_NULL);
 
         rt_data_queue_deinit(&(tx_dma->data_queue));
+        rt_mutex_detach(&(tx_dma->lock));
 
         rt_free(tx_dma);
         serial->serial_tx = RT_NULL;
@@ -871,6 +1123,177 @@ static rt_size_t rt_serial_write(struct rt_device *dev,
     }
 }
 
+#ifdef RT_SERIAL_USING_DMA
+static void _serial_dma_tx_notify(struct rt_serial_device *serial)
+{
+    struct rt_serial_tx_dma *tx_dma;
+    struct rt_serial_tx_notify notify;
+
+    tx_dma = (struct rt_serial_tx_dma*) serial->serial_tx;
+
+    while (tx_dma->notify_get != tx_dma->notify_put)
+    {
+        if ((rt_int32_t)(tx_dma->done_count - tx_dma->notify[tx_dma->notify_get].segment) < 0)
+            break;
+
+        /* the slot may be reused by writev once it's released */
+        notify = tx_dma->notify[tx_dma->notify_get];
+        tx_dma->notify_get = (tx_dma->notify_get + 1) % RT_SERIAL_TX_NOTIFY_NUM;
+        while (notify.count--)
+        {
+            notify.tx_done(&(serial->parent), notify.user_data);
+        }
+    }
+}
+
+/* register the callback of writev, it's invoked after the pushed segments and the earlier callbacks */
+static void _serial_dma_tx_notify_add(struct rt_serial_device *serial, rt_bool_t pushed,
+                                      void (*tx_done)(rt_device_t dev, void *user_data), void *user_data)
+{
+    rt_base_t level;
+    struct rt_serial_tx_dma *tx_dma;
+    struct rt_serial_tx_notify *notify, *last;
+
+    tx_dma = (struct rt_serial_tx_dma*) serial->serial_tx;
+
+    level = rt_hw_interrupt_disable();
+    if (!pushed)
+    {
+        if (tx_dma->notify_get == tx_dma->notify_put)
+        {
+            /* nothing to wait for */
+            rt_hw_interrupt_enable(level);
+            tx_done(&(serial->parent), user_data);
+            return;
+        }
+
+        /* it's due with the last pending one, merge the same callback into it */
+        last = &(tx_dma->notify[(tx_dma->notify_put + RT_SERIAL_TX_NOTIFY_NUM - 1) % RT_SERIAL_TX_NOTIFY_NUM]);
+        if (last->tx_done == tx_done && last->user_data == user_data)
+        {
+            last->count++;
+            rt_hw_interrupt_enable(level);
+            return;
+        }
+    }
+
+    /*
+     * the queue is only full with the different callbacks of the writes
+     * pushing nothing, wait for the DMA done interrupt to release one.
+     */
+    while ((tx_dma->notify_put + 1) % RT_SERIAL_TX_NOTIFY_NUM == tx_dma->notify_get)
+    {
+        rt_hw_interrupt_enable(level);
+        rt_thread_delay(1);
+        level = rt_hw_interrupt_disable();
+    }
+
+    notify = &(tx_dma->notify[tx_dma->notify_put]);
+    notify->tx_done = tx_done;
+    notify->user_data = user_data;
+    notify->count = 1;
+    if (pushed || tx_dma->notify_get == tx_dma->notify_put)
+    {
+        notify->segment = tx_dma->push_count;
+    }
+    else
+    {
+        notify->segment = tx_dma->notify[(tx_dma->notify_put + RT_SERIAL_TX_NOTIFY_NUM - 1) %
+                                         RT_SERIAL_TX_NOTIFY_NUM].segment;
+    }
+    tx_dma->notify_put = (tx_dma->notify_put + 1) % RT_SERIAL_TX_NOTIFY_NUM;
+    /* the last segment may be done before registering, invoke it as the DMA done interrupt does */
+    _serial_dma_tx_notify(serial);
+    rt_hw_interrupt_enable(level);
+}
+#endif /* RT_SERIAL_USING_DMA */
+
+/**
+ * This function writes some segments to serial device as a whole.
+ *
+ * In DMA tx mode, all of segments are queued and transmitted one by one in
+ * the DMA done interrupt, the data can't be changed until the tx_done
+ * callback is invoked from interrupt. The segments are queued under the tx
+ * lock, so they are never interleaved with the other writes.
+ *
+ * In the other modes the segments are written in turn and tx_done is invoked
+ * before return. There is no tx lock in these modes, the segments may be
+ * interleaved with the data written by the other threads or interrupts at
+ * the same time, the caller should serialize the writes if it matters.
+ *
+ * @param dev the serial device
+ * @param iov the segments
+ * @param iovcnt the number of segments
+ * @param tx_done the callback when all of segments are transmitted, it could be RT_NULL
+ * @param user_data the parameter of callback
+ *
+ * @return the total length of written data
+ */
+rt_size_t rt_serial_writev(rt_device_t dev, const struct rt_serial_iovec *iov, int iovcnt,
+                           void (*tx_done)(rt_device_t dev, void *user_data), void *user_data)
+{
+    struct rt_serial_device *serial;
+    rt_size_t total = 0;
+    int index;
+
+    RT_ASSERT(dev != RT_NULL);
+    RT_ASSERT(iov != RT_NULL || iovcnt == 0);
+
+    serial = (struct rt_serial_device *)dev;
+
+#ifdef RT_SERIAL_USING_DMA
+    if (dev->open_flag & RT_DEVICE_FLAG_DMA_TX)
+    {
+        struct rt_serial_tx_dma *tx_dma;
+        rt_uint32_t push_count;
+
+        tx_dma = (struct rt_serial_tx_dma*) serial->serial_tx;
+
+        rt_mutex_take(&(tx_dma->lock), RT_WAITING_FOREVER);
+
+        push_count = tx_dma->push_count;
+        for (index = 0; index < iovcnt; index++)
+        {
+            if (iov[index].len == 0)
+                continue;
+
+            if (_serial_dma_tx_push(serial, (const rt_uint8_t *)iov[index].buf, iov[index].len) != RT_EOK)
+                break;
+            total += iov[index].len;
+        }
+
+        /*
+         * the callback is registered after pushing with the number of really
+         * pushed segments, so a failed push never leaves a notify behind.
+         */
+        if (tx_done != RT_NULL)
+        {
+            _serial_dma_tx_notify_add(serial, tx_dma->push_count != push_count, tx_done, user_data);
+        }
+
+        rt_mutex_release(&(tx_dma->lock));
+
+        return total;
+    }
+#endif /* RT_SERIAL_USING_DMA */
+
+    for (index = 0; index < iovcnt; index++)
+    {
+        if (iov[index].len == 0)
+            continue;
+
+        total += rt_serial_write(dev, 0, iov[index].buf, iov[index].len);
+    }
+
+    if (tx_done != RT_NULL)
+    {
+        tx_done(dev, user_data);
+    }
+
+    return total;
+}
+RTM_EXPORT(rt_serial_writev);
+
 #ifdef RT_USING_POSIX_TERMIOS
 struct speed_baudrate_item
 {
@@ -1102,6 +1525,23 @@ static rt_err_t rt_serial_control(struct rt_device *dev,
         case TCXONC:
             break;
 #endif
+        case RT_SERIAL_CTRL_SET_RX_NOTIFY:
+            serial->rx_notify_threshold = (rt_uint16_t)(rt_ubase_t)args;
+            break;
+
+        case RT_SERIAL_CTRL_GET_RX_STATS:
+            {
+                rt_base_t level;
+
+                if (args == RT_NULL)
+                    return -RT_EINVAL;
+
+                level = rt_hw_interrupt_disable();
+                rt_memcpy(args, &(serial->rx_stats), sizeof(serial->rx_stats));
+                rt_hw_interrupt_enable(level);
+            }
+            break;
+
 #ifdef RT_USING_POSIX
         case FIONREAD:
             {
@@ -1155,6 +1595,9 @@ rt_err_t rt_hw_serial_register(struct rt_serial_device *serial,
     device->rx_indicate = RT_NULL;
     device->tx_complete = RT_NULL;
 
+    serial->rx_notify_threshold = 1;
+    rt_memset(&(serial->rx_stats), 0, sizeof(serial->rx_stats));
+
 #ifdef RT_USING_DEVICE_OPS
     device->ops         = &serial_ops;
 #else
@@ -1189,10 +1632,13 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
             rt_base_t level;
             struct rt_serial_rx_fifo* rx_fifo;
 
+            rt_bool_t overrun = RT_FALSE;
+
             /* interrupt mode receive */
             rx_fifo = (struct rt_serial_rx_fifo*)serial->serial_rx;
             RT_ASSERT(rx_fifo != RT_NULL);
 
+            serial->rx_stats.rx_events++;
             while (1)
             {
                 ch = serial->ops->getc(serial);
@@ -1205,6 +1651,7 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
                 rx_fifo->buffer[rx_fifo->put_index] = ch;
                 rx_fifo->put_index += 1;
                 if (rx_fifo->put_index >= serial->config.bufsz) rx_fifo->put_index = 0;
+                serial->rx_stats.rx_bytes++;
 
                 /* if the next position is read index, discard this 'read char' */
                 if (rx_fifo->put_index == rx_fifo->get_index)
@@ -1212,6 +1659,8 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
                     rx_fifo->get_index += 1;
                     rx_fifo->is_full = RT_TRUE;
                     if (rx_fifo->get_index >= serial->config.bufsz) rx_fifo->get_index = 0;
+                    serial->rx_stats.rx_dropped++;
+                    overrun = RT_TRUE;
 
                     _serial_check_buffer_size();
                 }
@@ -1220,6 +1669,8 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
                 rt_hw_interrupt_enable(level);
             }
 
+            if (overrun) serial->rx_stats.rx_overrun++;
+
             /* invoke callback */
             if (serial->parent.rx_indicate != RT_NULL)
             {
@@ -1233,16 +1684,63 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
 
                 if (rx_length)
                 {
-                    serial->parent.rx_indicate(&serial->parent, rx_length);
+                    _serial_rx_notify(serial, rx_length, RT_FALSE);
                 }
             }
             break;
         }
+        case RT_SERIAL_EVENT_RX_TIMEOUT:
+        {
+            rt_base_t level;
+            rt_size_t rx_length;
+
+#ifdef RT_SERIAL_USING_DMA
+            /* the DMA rx without fifo has no threshold, it's the same as DMA done */
+            if ((serial->parent.open_flag & RT_DEVICE_FLAG_DMA_RX) && serial->config.bufsz == 0)
+            {
+                if ((event & (~0xff)) >> 8)
+                {
+                    rt_hw_serial_isr(serial, RT_SERIAL_EVENT_RX_DMADONE | (event & (~0xff)));
+                }
+                break;
+            }
+#endif /* RT_SERIAL_USING_DMA */
+
+            /* the line is idle, notify the received data at once */
+            if (!_serial_rx_fifo_mode(serial))
+                break;
+
+#ifdef RT_SERIAL_USING_DMA
+            if (serial->parent.open_flag & RT_DEVICE_FLAG_DMA_RX)
+            {
+                /* the event carries the data received by DMA since the last event, maybe 0 */
+                _serial_dma_rx_done(serial, (event & (~0xff)) >> 8, RT_TRUE);
+                break;
+            }
+#endif /* RT_SERIAL_USING_DMA */
+
+            level = rt_hw_interrupt_disable();
+            rx_length = _serial_fifo_calc_recved_len(serial);
+            rt_hw_interrupt_enable(level);
+
+            if (rx_length)
+            {
+                _serial_rx_notify(serial, rx_length, RT_TRUE);
+            }
+            break;
+        }
         case RT_SERIAL_EVENT_TX_DONE:
         {
             struct rt_serial_tx_fifo* tx_fifo;
 
             tx_fifo = (struct rt_serial_tx_fifo*)serial->serial_tx;
+#ifdef RT_SERIAL_USING_TX_RB
+            /* send the rest of data */
+            _serial_int_tx_drain(serial, tx_fifo);
+            /* wake up the writer when half of ring buffer is free, not for every byte */
+            if (rt_ringbuffer_space_len(&(tx_fifo->rb)) < RT_SERIAL_TX_RB_BUFSZ / 2)
+                break;
+#endif
             rt_completion_done(&(tx_fifo->completion));
             break;
         }
@@ -1257,6 +1755,7 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
             tx_dma = (struct rt_serial_tx_dma*) serial->serial_tx;
 
             rt_data_queue_pop(&(tx_dma->data_queue), &last_data_ptr, &data_size, 0);
+            tx_dma->done_count++;
             if (rt_data_queue_peak(&(tx_dma->data_queue), &data_ptr, &data_size) == RT_EOK)
             {
                 /* transmit next data node */
@@ -1273,12 +1772,12 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
             {
                 serial->parent.tx_complete(&serial->parent, (void*)last_data_ptr);
             }
+            _serial_dma_tx_notify(serial);
             break;
         }
         case RT_SERIAL_EVENT_RX_DMADONE:
         {
             int length;
-            rt_base_t level;
 
             /* get DMA rx length */
             length = (event & (~0xff)) >> 8;
@@ -1296,19 +1795,7 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
             }
             else
             {
-                /* disable interrupt */
-                level = rt_hw_interrupt_disable();
-                /* update fifo put index */
-                rt_dma_recv_update_put_index(serial, length);
-                /* calculate received total length */
-                length = rt_dma_calc_recved_len(serial);
-                /* enable interrupt */
-                rt_hw_interrupt_enable(level);
-                /* invoke callback */
-                if (serial->parent.rx_indicate != RT_NULL)
-                {
-                    serial->parent.rx_indicate(&(serial->parent), length);
-                }
+                _serial_dma_rx_done(serial, length, RT_FALSE);
             }
             break;
         }
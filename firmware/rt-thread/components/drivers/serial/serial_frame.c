@@ -0,0 +1,339 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-19     luhuadong    the first version
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <drivers/serial_frame.h>
+
+#define DBG_TAG    "serial.frame"
+#define DBG_LVL    DBG_INFO
+#include <rtdbg.h>
+
+enum
+{
+    FRAME_MORE,     /* need more data */
+    FRAME_DONE,     /* the frame is completed */
+    FRAME_ERROR,    /* it's not a frame */
+};
+
+/* the frames which are attached to serial device */
+static rt_slist_t _frame_list = RT_SLIST_OBJECT_INIT(_frame_list);
+
+/**
+ * This function initializes the frame parser.
+ *
+ * @param frame the frame parser
+ * @param desc the format of frame
+ * @param buf the buffer of frame, it's desc->frame_max bytes at least
+ * @param frame_ind the callback of validated frame
+ * @param user_data the user data
+ */
+void rt_serial_frame_init(rt_serial_frame_t frame, const struct rt_serial_frame_desc *desc, rt_uint8_t *buf,
+                          void (*frame_ind)(rt_serial_frame_t frame, const rt_uint8_t *data, rt_size_t length),
+                          void *user_data)
+{
+    RT_ASSERT(frame != RT_NULL);
+    RT_ASSERT(desc != RT_NULL && desc->header != RT_NULL && desc->header_len > 0);
+    RT_ASSERT(desc->len_size <= 2);
+    RT_ASSERT(desc->frame_min >= desc->header_len && desc->frame_min >= desc->len_offset + desc->len_size);
+    RT_ASSERT(desc->frame_max >= desc->frame_min);
+    RT_ASSERT(buf != RT_NULL);
+
+    rt_memset(frame, 0, sizeof(struct rt_serial_frame));
+    frame->desc = desc;
+    frame->buf = buf;
+    frame->frame_ind = frame_ind;
+    frame->user_data = user_data;
+    rt_slist_init(&(frame->list));
+}
+RTM_EXPORT(rt_serial_frame_init);
+
+/**
+ * This function drops the received data of current frame.
+ *
+ * @param frame the frame parser
+ */
+void rt_serial_frame_reset(rt_serial_frame_t frame)
+{
+    rt_base_t level;
+
+    RT_ASSERT(frame != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    frame->pos = 0;
+    frame->frame_len = 0;
+    rt_hw_interrupt_enable(level);
+}
+RTM_EXPORT(rt_serial_frame_reset);
+
+static int _frame_validate(rt_serial_frame_t frame)
+{
+    const struct rt_serial_frame_desc *desc = frame->desc;
+    rt_int32_t value;
+
+    if (frame->frame_len == 0)
+    {
+        /* match the header */
+        if (rt_memcmp(frame->buf, desc->header, frame->pos < desc->header_len ? frame->pos : desc->header_len))
+        {
+            return FRAME_ERROR;
+        }
+        /* the length is known after the whole header is matched */
+        if (frame->pos < desc->header_len)
+        {
+            return FRAME_MORE;
+        }
+
+        if (desc->len_size == 0)
+        {
+            frame->frame_len = desc->frame_max;
+        }
+        else
+        {
+            if (frame->pos < desc->len_offset + desc->len_size)
+            {
+                return FRAME_MORE;
+            }
+
+            value = frame->buf[desc->len_offset];
+            if (desc->len_size == 2)
+            {
+                value = (value << 8) | frame->buf[desc->len_offset + 1];
+            }
+            value += desc->len_adjust;
+            if (value < desc->frame_min || value > desc->frame_max)
+            {
+                return FRAME_ERROR;
+            }
+            frame->frame_len = value;
+        }
+    }
+
+    return frame->pos < frame->frame_len ? FRAME_MORE : FRAME_DONE;
+}
+
+/* skip the first byte, and search the next header from the received data */
+static void _frame_skip(rt_serial_frame_t frame)
+{
+    rt_uint16_t index;
+
+    for (index = 1; index < frame->pos; index++)
+    {
+        if (frame->buf[index] == frame->desc->header[0])
+        {
+            break;
+        }
+    }
+
+    rt_memmove(frame->buf, frame->buf + index, frame->pos - index);
+    frame->pos -= index;
+    frame->frame_len = 0;
+    frame->skipped += index;
+}
+
+static void _frame_process(rt_serial_frame_t frame)
+{
+    const struct rt_serial_frame_desc *desc = frame->desc;
+
+    while (frame->pos > 0)
+    {
+        switch (_frame_validate(frame))
+        {
+        case FRAME_MORE:
+            return;
+
+        case FRAME_DONE:
+            if (desc->check == RT_NULL || desc->check(frame->buf, frame->frame_len))
+            {
+                frame->frames++;
+                if (frame->frame_ind != RT_NULL)
+                {
+                    frame->frame_ind(frame, frame->buf, frame->frame_len);
+                }
+                /* keep the data after the frame, it may be the next frame after resyncing */
+                rt_memmove(frame->buf, frame->buf + frame->frame_len, frame->pos - frame->frame_len);
+                frame->pos -= frame->frame_len;
+                frame->frame_len = 0;
+            }
+            else
+            {
+                LOG_D("%d bytes frame check failed", frame->frame_len);
+                frame->check_errors++;
+                _frame_skip(frame);
+            }
+            break;
+
+        default:
+            _frame_skip(frame);
+            break;
+        }
+    }
+}
+
+/**
+ * This function feeds the received data to frame parser, the frame_ind is
+ * invoked when a frame is validated.
+ *
+ * @param frame the frame parser
+ * @param data the received data
+ * @param length the length of data
+ */
+void rt_serial_frame_feed(rt_serial_frame_t frame, const rt_uint8_t *data, rt_size_t length)
+{
+    rt_size_t size;
+
+    RT_ASSERT(frame != RT_NULL);
+    RT_ASSERT(data != RT_NULL || length == 0);
+
+    while (length)
+    {
+        /* copy the rest of frame at once when the frame length is known */
+        size = 1;
+        if (frame->frame_len)
+        {
+            size = frame->frame_len - frame->pos;
+            if (size > length)
+            {
+                size = length;
+            }
+        }
+
+        rt_memcpy(frame->buf + frame->pos, data, size);
+        frame->pos += size;
+        data += size;
+        length -= size;
+
+        _frame_process(frame);
+    }
+}
+RTM_EXPORT(rt_serial_frame_feed);
+
+static rt_err_t _serial_frame_rx_ind(rt_device_t dev, rt_size_t size)
+{
+    rt_serial_frame_t frame = RT_NULL;
+    rt_slist_t *node;
+    rt_uint8_t *ptr;
+    rt_size_t length;
+
+    rt_slist_for_each(node, &_frame_list)
+    {
+        if (rt_slist_entry(node, struct rt_serial_frame, list)->serial == dev)
+        {
+            frame = rt_slist_entry(node, struct rt_serial_frame, list);
+            break;
+        }
+    }
+
+    if (frame == RT_NULL)
+    {
+        return -RT_ERROR;
+    }
+
+    /* parse the data in rx fifo directly */
+    while ((length = rt_serial_rx_peek(dev, &ptr)) > 0)
+    {
+        rt_serial_frame_feed(frame, ptr, length);
+        rt_serial_rx_consume(dev, length);
+    }
+
+    return RT_EOK;
+}
+
+/**
+ * This function attaches the frame parser to a serial device, the received
+ * data is parsed in the rx interrupt. The serial device must be opened with
+ * RT_DEVICE_FLAG_INT_RX or RT_DEVICE_FLAG_DMA_RX (with rx fifo), and the
+ * rx_indicate of it is taken over.
+ *
+ * @param frame the frame parser
+ * @param serial the serial device
+ *
+ * @return the error code, RT_EOK on successfully.
+ */
+rt_err_t rt_serial_frame_attach(rt_serial_frame_t frame, rt_device_t serial)
+{
+    rt_base_t level;
+
+    RT_ASSERT(frame != RT_NULL);
+    RT_ASSERT(serial != RT_NULL);
+
+    if (frame->serial != RT_NULL)
+    {
+        return -RT_EBUSY;
+    }
+
+    rt_serial_frame_reset(frame);
+
+    level = rt_hw_interrupt_disable();
+    frame->serial = serial;
+    frame->rx_indicate = serial->rx_indicate;
+    rt_slist_append(&_frame_list, &(frame->list));
+    rt_hw_interrupt_enable(level);
+
+    rt_device_set_rx_indicate(serial, _serial_frame_rx_ind);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_serial_frame_attach);
+
+/**
+ * This function detaches the frame parser from serial device, the rx_indicate
+ * before attaching is restored.
+ *
+ * @param frame the frame parser
+ *
+ * @return the error code, RT_EOK on successfully.
+ */
+rt_err_t rt_serial_frame_detach(rt_serial_frame_t frame)
+{
+    rt_base_t level;
+
+    RT_ASSERT(frame != RT_NULL);
+
+    if (frame->serial == RT_NULL)
+    {
+        return -RT_ERROR;
+    }
+
+    rt_device_set_rx_indicate(frame->serial, frame->rx_indicate);
+
+    level = rt_hw_interrupt_disable();
+    rt_slist_remove(&_frame_list, &(frame->list));
+    frame->serial = RT_NULL;
+    frame->rx_indicate = RT_NULL;
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_serial_frame_detach);
+
+/**
+ * The 16 bits checksum: the sum of bytes is saved in the last 2 bytes of
+ * frame by big-endian, such as the PMS series sensors.
+ */
+rt_bool_t rt_serial_frame_check_sum16(const rt_uint8_t *frame, rt_size_t length)
+{
+    rt_uint16_t sum = 0;
+    rt_size_t index;
+
+    if (length < 2)
+    {
+        return RT_FALSE;
+    }
+
+    for (index = 0; index < length - 2; index++)
+    {
+        sum += frame[index];
+    }
+
+    return sum == ((frame[length - 2] << 8) | frame[length - 1]);
+}
+RTM_EXPORT(rt_serial_frame_check_sum16);
@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * serial_sim runs the serial framework on the host with a simulated UART,
+ * checks rt_serial_writev() in DMA tx mode, and prints the cost of the
+ * interrupt tx with or without the tx ring buffer.
+ *
+ * The UART sends one byte in 86.8us (115200 baud, 8N1). In interrupt tx
+ * mode it has one byte of tx register, putc returns -1 while it's busy and
+ * the tx done interrupt comes when it's empty. In DMA tx mode one transfer
+ * is sent at a time and the DMA done interrupt comes at its end.
+ *
+ * There is no thread. The time only goes on when the writer waits, for a
+ * full data queue, the tx completion or a delay, and then the interrupts
+ * which are due are raised from the waiting point. The interrupt is never
+ * raised while it's disabled, this is checked.
+ *
+ * The serial framework is built into this program with the configuration
+ * in rtconfig.h, add -DSIM_NO_TX_RB to build it without the tx ring buffer:
+ *
+ *   gcc -O2 -std=gnu99 -I. -I../../../../include -I../../include serial_sim.c -o serial_sim
+ *
+ * usage: serial_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../serial.c"
+#include "../../src/ringbuffer.c"
+
+#define SIM_BYTE_NS         86806   /* one byte at 115200 baud */
+#define SIM_TICK_NS         1000000 /* the OS tick */
+#define SIM_OUT_SIZE        (64 * 1024)
+
+struct sim_uart
+{
+    struct rt_serial_device serial;
+
+    rt_uint64_t now;                /* the time of simulation */
+    int irq_disabled;
+
+    /* interrupt tx */
+    int tx_busy;
+    rt_uint8_t tx_byte;
+    rt_uint64_t tx_done_at;
+
+    /* DMA tx */
+    int dma_busy;
+    const rt_uint8_t *dma_buf;
+    rt_size_t dma_size;
+    rt_uint64_t dma_done_at;
+    rt_uint64_t dma_idle_ns;        /* the line is idle between the queued transfers */
+    rt_uint64_t dma_idle_from;
+
+    rt_uint8_t out[SIM_OUT_SIZE];   /* the data on the line */
+    rt_size_t out_len;
+
+    unsigned long irqs;
+    unsigned long waits;            /* the writer waits for the tx completion */
+};
+
+static struct sim_uart uart;
+static int failed;
+
+#define SIM_CHECK(cond, ...)                                \
+    do                                                      \
+    {                                                       \
+        if (!(cond))                                        \
+        {                                                   \
+            printf("FAIL at line %d: ", __LINE__);          \
+            printf(__VA_ARGS__);                            \
+            printf("\n");                                   \
+            failed = 1;                                     \
+        }                                                   \
+    } while (0)
+
+/* the stubs of kernel for the serial framework */
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void rt_free(void *ptr) { free(ptr); }
+void *rt_memset(void *s, int c, rt_ubase_t count) { return memset(s, c, count); }
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count) { return count ? memcpy(dst, src, count) : dst; }
+void rt_set_errno(rt_err_t no) { }
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag) { return RT_EOK; }
+rt_err_t rt_mutex_detach(rt_mutex_t mutex) { return RT_EOK; }
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time) { return RT_EOK; }
+rt_err_t rt_mutex_release(rt_mutex_t mutex) { return RT_EOK; }
+rt_err_t rt_device_register(rt_device_t dev, const char *name, rt_uint16_t flags)
+{
+    dev->flag = flags;
+    return RT_EOK;
+}
+
+void rt_assert_handler(const char *ex, const char *func, rt_size_t line)
+{
+    fprintf(stderr, "(%s) assertion failed at function:%s, line number:%d\n", ex, func, (int)line);
+    abort();
+}
+
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    return uart.irq_disabled++;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+    uart.irq_disabled = level;
+}
+
+/* raise the next interrupt, 0 if there is nothing in progress */
+static int sim_step(void)
+{
+    if (uart.irq_disabled)
+    {
+        printf("FAIL: the writer waits with the interrupt disabled\n");
+        exit(1);
+    }
+
+    if (uart.tx_busy && (!uart.dma_busy || uart.tx_done_at <= uart.dma_done_at))
+    {
+        uart.now = uart.tx_done_at;
+        uart.tx_busy = 0;
+        uart.out[uart.out_len++] = uart.tx_byte;
+        uart.irqs++;
+        rt_hw_serial_isr(&uart.serial, RT_SERIAL_EVENT_TX_DONE);
+        return 1;
+    }
+    if (uart.dma_busy)
+    {
+        uart.now = uart.dma_done_at;
+        uart.dma_busy = 0;
+        uart.dma_idle_from = uart.now;
+        memcpy(uart.out + uart.out_len, uart.dma_buf, uart.dma_size);
+        uart.out_len += uart.dma_size;
+        uart.irqs++;
+        rt_hw_serial_isr(&uart.serial, RT_SERIAL_EVENT_TX_DMADONE);
+        return 1;
+    }
+
+    return 0;
+}
+
+static void sim_run(void)
+{
+    while (sim_step());
+}
+
+void rt_completion_init(struct rt_completion *completion)
+{
+    completion->flag = 0;
+}
+
+rt_err_t rt_completion_wait(struct rt_completion *completion, rt_int32_t timeout)
+{
+    uart.waits++;
+    while (!completion->flag)
+    {
+        if (!sim_step())
+        {
+            printf("FAIL: the writer waits for the tx completion forever\n");
+            exit(1);
+        }
+    }
+    completion->flag = 0;
+
+    return RT_EOK;
+}
+
+void rt_completion_done(struct rt_completion *completion)
+{
+    completion->flag = 1;
+}
+
+rt_err_t rt_thread_delay(rt_tick_t tick)
+{
+    rt_uint64_t until = uart.now + (rt_uint64_t)tick * SIM_TICK_NS;
+
+    while ((uart.tx_busy && uart.tx_done_at <= until) || (uart.dma_busy && uart.dma_done_at <= until))
+        sim_step();
+    uart.now = until;
+
+    return RT_EOK;
+}
+
+/* the data queue of DMA tx, the writer waits for the DMA done interrupt if it's full */
+struct rt_data_item
+{
+    const void *data_ptr;
+    rt_size_t data_size;
+};
+
+rt_err_t rt_data_queue_init(struct rt_data_queue *queue, rt_uint16_t size, rt_uint16_t lwm,
+                            void (*evt_notify)(struct rt_data_queue *queue, rt_uint32_t event))
+{
+    memset(queue, 0, sizeof(*queue));
+    queue->size = size;
+    queue->queue = calloc(size, sizeof(struct rt_data_item));
+
+    return RT_EOK;
+}
+
+rt_err_t rt_data_queue_push(struct rt_data_queue *queue, const void *data_ptr, rt_size_t data_size,
+                            rt_int32_t timeout)
+{
+    while (RT_DATAQUEUE_SIZE(queue) == queue->size)
+    {
+        if (timeout == 0 || !sim_step())
+            return -RT_ETIMEOUT;
+    }
+
+    queue->queue[queue->put_index % queue->size].data_ptr = data_ptr;
+    queue->queue[queue->put_index % queue->size].data_size = data_size;
+    queue->put_index++;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_data_queue_pop(struct rt_data_queue *queue, const void **data_ptr, rt_size_t *size,
+                           rt_int32_t timeout)
+{
+    if (RT_DATAQUEUE_SIZE(queue) == 0)
+        return -RT_ETIMEOUT;
+
+    *data_ptr = queue->queue[queue->get_index % queue->size].data_ptr;
+    *size = queue->queue[queue->get_index % queue->size].data_size;
+    queue->get_index++;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_data_queue_peak(struct rt_data_queue *queue, const void **data_ptr, rt_size_t *size)
+{
+    if (RT_DATAQUEUE_SIZE(queue) == 0)
+        return -RT_EEMPTY;
+
+    *data_ptr = queue->queue[queue->get_index % queue->size].data_ptr;
+    *size = queue->queue[queue->get_index % queue->size].data_size;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_data_queue_deinit(struct rt_data_queue *queue)
+{
+    free(queue->queue);
+
+    return RT_EOK;
+}
+
+/* the simulated UART */
+static rt_err_t sim_configure(struct rt_serial_device *serial, struct serial_configure *cfg)
+{
+    return RT_EOK;
+}
+
+static rt_err_t sim_control(struct rt_serial_device *serial, int cmd, void *arg)
+{
+    return RT_EOK;
+}
+
+static int sim_putc(struct rt_serial_device *serial, char c)
+{
+    if (uart.tx_busy)
+        return -1;
+
+    uart.tx_busy = 1;
+    uart.tx_byte = (rt_uint8_t)c;
+    uart.tx_done_at = uart.now + SIM_BYTE_NS;
+
+    return 1;
+}
+
+static int sim_getc(struct rt_serial_device *serial)
+{
+    return -1;
+}
+
+static rt_size_t sim_dma_transmit(struct rt_serial_device *serial, rt_uint8_t *buf, rt_size_t size, int direction)
+{
+    if (uart.dma_busy)
+    {
+        printf("FAIL: the DMA is started while it's busy\n");
+        exit(1);
+    }
+
+    if (uart.out_len)
+        uart.dma_idle_ns += uart.now - uart.dma_idle_from;
+    uart.dma_busy = 1;
+    uart.dma_buf = buf;
+    uart.dma_size = size;
+    uart.dma_done_at = uart.now + size * SIM_BYTE_NS;
+
+    return size;
+}
+
+static const struct rt_uart_ops sim_ops =
+{
+    sim_configure,
+    sim_control,
+    sim_putc,
+    sim_getc,
+    sim_dma_transmit,
+};
+
+static rt_device_t sim_open(rt_uint16_t oflag)
+{
+    struct serial_configure config = RT_SERIAL_CONFIG_DEFAULT;
+    rt_device_t dev = &uart.serial.parent;
+
+    memset(&uart, 0, sizeof(uart));
+    uart.serial.ops = &sim_ops;
+    uart.serial.config = config;
+    rt_hw_serial_register(&uart.serial, "uart", RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_INT_TX |
+                          RT_DEVICE_FLAG_DMA_TX, RT_NULL);
+    rt_serial_init(dev);
+    if (rt_serial_open(dev, oflag) != RT_EOK)
+    {
+        printf("FAIL: open\n");
+        exit(1);
+    }
+
+    return dev;
+}
+
+/* the callback of writev records when it's invoked */
+struct sim_notify
+{
+    int calls;
+    rt_size_t out_len;              /* the data on the line when it's invoked the last time */
+    int early;                      /* it's invoked before its data is sent */
+    rt_size_t expect;               /* the data on the line when it should be invoked */
+};
+
+static void sim_tx_done(rt_device_t dev, void *user_data)
+{
+    struct sim_notify *notify = (struct sim_notify *)user_data;
+
+    notify->calls++;
+    notify->out_len = uart.out_len;
+    if (uart.out_len < notify->expect)
+        notify->early++;
+}
+
+/* an AT command with header, payload and trailer is sent as one unit */
+static void test_writev(void)
+{
+    static const char header[] = "AT+SEND=0,16\r\n";
+    static const char payload[] = "0123456789abcdef";
+    static const char trailer[] = "\x1a";
+    struct rt_serial_iovec iov[3] =
+    {
+        {header, sizeof(header) - 1},
+        {payload, sizeof(payload) - 1},
+        {trailer, sizeof(trailer) - 1},
+    };
+    struct sim_notify notify = {0};
+    rt_device_t dev;
+    rt_size_t total = sizeof(header) + sizeof(payload) + sizeof(trailer) - 3;
+
+    dev = sim_open(RT_DEVICE_FLAG_DMA_TX);
+    notify.expect = total;
+    SIM_CHECK(rt_serial_writev(dev, iov, 3, sim_tx_done, &notify) == total, "writev returns the length");
+    SIM_CHECK(notify.calls == 0, "tx_done is invoked before the data is sent");
+    sim_run();
+
+    SIM_CHECK(uart.out_len == total && memcmp(uart.out, header, sizeof(header) - 1) == 0
+              && memcmp(uart.out + sizeof(header) - 1, payload, sizeof(payload) - 1) == 0
+              && uart.out[total - 1] == 0x1a, "the data on the line is wrong");
+    SIM_CHECK(notify.calls == 1 && notify.early == 0, "tx_done is invoked %d times", notify.calls);
+    SIM_CHECK(uart.dma_idle_ns == 0, "the line is idle for %lluns between the segments",
+              (unsigned long long)uart.dma_idle_ns);
+    printf("%-40s %3d bytes, %lu interrupts, %.2fms, idle between segments %lluns\n",
+           "writev 3 segments", (int)total, uart.irqs, uart.now / 1e6, (unsigned long long)uart.dma_idle_ns);
+    rt_serial_close(dev);
+}
+
+/* the writes are queued in order, every tx_done comes after its own data */
+static void test_writev_order(void)
+{
+    static char data[16][32];
+    struct rt_serial_iovec iov[2];
+    struct sim_notify notify[8];
+    rt_device_t dev;
+    rt_size_t total = 0;
+    int index;
+
+    dev = sim_open(RT_DEVICE_FLAG_DMA_TX);
+    memset(notify, 0, sizeof(notify));
+    for (index = 0; index < 8; index++)
+    {
+        memset(data[index * 2], 'a' + index, sizeof(data[0]));
+        memset(data[index * 2 + 1], 'A' + index, sizeof(data[0]));
+        iov[0].buf = data[index * 2];
+        iov[0].len = sizeof(data[0]);
+        iov[1].buf = data[index * 2 + 1];
+        iov[1].len = sizeof(data[0]);
+
+        /* a plain write in the middle */
+        if (index == 4)
+        {
+            total += rt_serial_write(dev, 0, "plain", 5);
+        }
+        total += sizeof(data[0]) * 2;
+        notify[index].expect = total;
+        rt_serial_writev(dev, iov, 2, sim_tx_done, &notify[index]);
+    }
+    sim_run();
+
+    SIM_CHECK(uart.out_len == total, "%d bytes are sent, %d expected", (int)uart.out_len, (int)total);
+    for (index = 0; index < 8; index++)
+    {
+        SIM_CHECK(notify[index].calls == 1 && notify[index].early == 0 && notify[index].out_len == notify[index].expect,
+                  "tx_done %d is invoked %d times at %d bytes, %d expected", index, notify[index].calls,
+                  (int)notify[index].out_len, (int)notify[index].expect);
+    }
+    printf("%-40s %3d bytes, %lu interrupts, %.2fms, the queue waits for the DMA\n",
+           "8 writev and a write, queue of 8", (int)total, uart.irqs, uart.now / 1e6);
+    rt_serial_close(dev);
+}
+
+/*
+ * the writes pushing nothing: the callback is invoked at once without any
+ * pending one, otherwise it's invoked after the pending ones, the same
+ * callback is merged and the different ones wait for the free slot.
+ */
+static void test_writev_empty(void)
+{
+    static const char data[] = "0123456789";
+    struct rt_serial_iovec iov[2] = {{data, 0}, {RT_NULL, 0}};
+    struct sim_notify first = {0}, same = {0}, other = {0}, direct = {0};
+    rt_device_t dev;
+    int index, count = RT_SERIAL_TX_NOTIFY_NUM * 3;
+
+    dev = sim_open(RT_DEVICE_FLAG_DMA_TX);
+
+    /* nothing is pending */
+    rt_serial_writev(dev, iov, 2, sim_tx_done, &direct);
+    rt_serial_writev(dev, RT_NULL, 0, sim_tx_done, &direct);
+    SIM_CHECK(direct.calls == 2 && uart.now == 0, "tx_done without data is invoked %d times", direct.calls);
+
+    /* a plain write is on the line, but no tx_done is pending */
+    rt_serial_write(dev, 0, data, sizeof(data) - 1);
+    rt_serial_writev(dev, iov, 2, sim_tx_done, &direct);
+    SIM_CHECK(direct.calls == 3 && uart.out_len == 0, "tx_done without data waits for a plain write");
+
+    /* the callbacks of the empty writes wait for the pending one */
+    iov[0].len = sizeof(data) - 1;
+    first.expect = same.expect = other.expect = (sizeof(data) - 1) * 2;
+    rt_serial_writev(dev, iov, 2, sim_tx_done, &first);
+    iov[0].len = 0;
+    for (index = 0; index < count; index++)
+    {
+        rt_serial_writev(dev, iov, 2, sim_tx_done, &same);
+    }
+    for (index = 0; index < count; index++)
+    {
+        rt_serial_writev(dev, iov, 2, sim_tx_done, index & 1 ? &same : &other);
+    }
+    sim_run();
+
+    SIM_CHECK(first.calls == 1 && first.early == 0, "the first tx_done is invoked %d times", first.calls);
+    SIM_CHECK(same.calls == count + count / 2 && same.early == 0, "the merged tx_done is invoked %d times, %d expected",
+              same.calls, count + count / 2);
+    SIM_CHECK(other.calls == count / 2 && other.early == 0, "the other tx_done is invoked %d times, %d expected",
+              other.calls, count / 2);
+    printf("%-40s %3d writev, %d callbacks, no duplicate\n", "writev pushing nothing",
+           count * 2 + 4, direct.calls + first.calls + same.calls + other.calls);
+    rt_serial_close(dev);
+}
+
+/* the interrupt tx: when the writer returns, how often it waits and the interrupts */
+static void test_int_tx(const char *name, rt_size_t size, int times)
+{
+    static rt_uint8_t data[4096];
+    rt_uint64_t returned = 0;
+    rt_device_t dev;
+    rt_size_t index;
+    int count;
+
+    dev = sim_open(RT_DEVICE_FLAG_INT_TX);
+    for (index = 0; index < sizeof(data); index++)
+        data[index] = (rt_uint8_t)(index * 7 + 1);
+
+    for (count = 0; count < times; count++)
+    {
+        /* the writer writes again after the last write is sent */
+        sim_run();
+        uart.now += SIM_TICK_NS;
+        returned = uart.now;
+        SIM_CHECK(rt_serial_write(dev, 0, data, size) == size, "write returns the length");
+        returned = uart.now - returned;
+    }
+    sim_run();
+
+    SIM_CHECK(uart.out_len == size * times, "%d bytes are sent", (int)uart.out_len);
+    for (count = 0; count < times; count++)
+        SIM_CHECK(memcmp(uart.out + size * count, data, size) == 0, "the data on the line is wrong");
+
+    printf("%-40s %4d bytes x %d, write returns in %6.2fms, %4lu waits, %5lu interrupts\n",
+           name, (int)size, times, returned / 1e6, uart.waits, uart.irqs);
+    rt_serial_close(dev);
+}
+
+int main(int argc, char *argv[])
+{
+    printf("serial on the host, 115200 baud, %d segments of DMA tx queue\n\n", RT_SERIAL_TX_DMA_SEGMENTS);
+
+    test_writev();
+    test_writev_order();
+    test_writev_empty();
+
+#ifdef RT_SERIAL_USING_TX_RB
+    printf("\ninterrupt tx with %d bytes of tx ring buffer\n", RT_SERIAL_TX_RB_BUFSZ);
+#else
+    printf("\ninterrupt tx without tx ring buffer\n");
+#endif
+    test_int_tx("AT command", 32, 16);
+    test_int_tx("log line", 100, 16);
+    test_int_tx("bulk", 4096, 1);
+
+    printf("\n%s\n", failed ? "FAIL" : "PASS");
+
+    return failed;
+}
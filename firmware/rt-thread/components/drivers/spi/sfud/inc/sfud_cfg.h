@@ -71,6 +71,13 @@ extern void rt_kprintf(const char *fmt, ...);
 #define SFUD_USING_FLASH_INFO_TABLE
 #endif
 
+/**
+ * The times of reading status without delay before the retry delay when waiting for busy.
+ */
+#ifdef RT_SFUD_BUSY_POLL_TIMES
+#define SFUD_BUSY_POLL_TIMES RT_SFUD_BUSY_POLL_TIMES
+#endif
+
 #define SFUD_FLASH_DEVICE_TABLE {{0}}
 
 #endif /* _SFUD_CFG_H_ */
@@ -98,6 +98,10 @@ if (!(EXPR))                                                                   \
 #define SFUD_VOLATILE_SR_WRITE_ENABLE                  0x50
 #endif
 
+#ifndef SFUD_CMD_READ_STATUS_REGISTER2
+#define SFUD_CMD_READ_STATUS_REGISTER2                 0x35
+#endif
+
 #ifndef SFUD_CMD_WRITE_STATUS_REGISTER
 #define SFUD_CMD_WRITE_STATUS_REGISTER                 0x01
 #endif
@@ -106,6 +110,10 @@ if (!(EXPR))                                                                   \
 #define SFUD_CMD_PAGE_PROGRAM                          0x02
 #endif
 
+#ifndef SFUD_CMD_QUAD_PAGE_PROGRAM
+#define SFUD_CMD_QUAD_PAGE_PROGRAM                     0x32
+#endif
+
 #ifndef SFUD_CMD_AAI_WORD_PROGRAM
 #define SFUD_CMD_AAI_WORD_PROGRAM                      0xAD
 #endif
@@ -170,6 +178,11 @@ if (!(EXPR))                                                                   \
 #define SFUD_WRITE_MAX_PAGE_SIZE                        256
 #endif
 
+/* the times of reading status without retry delay when waiting for busy */
+#ifndef SFUD_BUSY_POLL_TIMES
+#define SFUD_BUSY_POLL_TIMES                            0
+#endif
+
 /* send dummy data for read data */
 #ifndef SFUD_DUMMY_DATA
 #define SFUD_DUMMY_DATA                                0xFF
@@ -187,6 +200,13 @@ enum {
     SFUD_STATUS_REGISTER_SRP = (1 << 7),                   /**< status register protect */
 };
 
+/**
+ * status register 2 bits
+ */
+enum {
+    SFUD_STATUS_REGISTER2_QE = (1 << 1),                   /**< quad enable */
+};
+
 /**
  * error code
  */
@@ -212,6 +232,11 @@ typedef struct {
     uint8_t dummy_cycles;
     uint8_t data_lines;
 } sfud_qspi_read_cmd_format;
+
+/**
+ * QSPI flash page program cmd format, the alternate bytes and dummy cycles are not used
+ */
+typedef sfud_qspi_read_cmd_format sfud_qspi_write_cmd_format;
 #endif /* SFUD_USING_QSPI */
 
 /* SPI bus write read data function type */
@@ -250,10 +275,17 @@ typedef struct __sfud_spi {
     /* SPI bus write read data function */
     sfud_err (*wr)(const struct __sfud_spi *spi, const uint8_t *write_buf, size_t write_size, uint8_t *read_buf,
                    size_t read_size);
+    /* SPI bus write command then data function, the data is sent without copy. It's optional. */
+    sfud_err (*write_data)(const struct __sfud_spi *spi, const uint8_t *cmd_buf, size_t cmd_size, const uint8_t *data,
+                           size_t data_size);
 #ifdef SFUD_USING_QSPI
     /* QSPI fast read function */
     sfud_err (*qspi_read)(const struct __sfud_spi *spi, uint32_t addr, sfud_qspi_read_cmd_format *qspi_read_cmd_format,
                           uint8_t *read_buf, size_t read_size);
+    /* QSPI page program function. It's optional. */
+    sfud_err (*qspi_write)(const struct __sfud_spi *spi, uint32_t addr,
+                           sfud_qspi_write_cmd_format *qspi_write_cmd_format, const uint8_t *write_buf,
+                           size_t write_size);
 #endif
     /* lock SPI bus */
     void (*lock)(const struct __sfud_spi *spi);
@@ -281,6 +313,7 @@ typedef struct {
 
 #ifdef SFUD_USING_QSPI
     sfud_qspi_read_cmd_format read_cmd_format;   /**< fast read cmd format */
+    sfud_qspi_write_cmd_format write_cmd_format; /**< page program cmd format */
 #endif
 
 #ifdef SFUD_USING_SFDP
@@ -145,7 +145,8 @@ typedef struct {
 
 #ifdef SFUD_USING_QSPI
 /* This table saves flash read-fast instructions in QSPI mode,
- * SFUD can use this table to select the most appropriate read instruction for flash.
+ * SFUD can use this table to select the most appropriate read instruction for flash,
+ * and the quad input page program instruction if the flash supports it.
  * | mf_id | type_id | capacity_id | qspi_read_mode |
  */
 #define SFUD_FLASH_EXT_INFO_TABLE                                                                  \
@@ -157,13 +158,13 @@ typedef struct {
     /* W25Q16BV */                                                                                 \
     {SFUD_MF_ID_WINBOND, 0x40, 0x15, NORMAL_SPI_READ|DUAL_OUTPUT},                                 \
     /* W25Q32BV */                                                                                 \
-    {SFUD_MF_ID_WINBOND, 0x40, 0x16, NORMAL_SPI_READ|DUAL_OUTPUT|QUAD_OUTPUT|QUAD_IO},             \
+    {SFUD_MF_ID_WINBOND, 0x40, 0x16, NORMAL_SPI_READ|DUAL_OUTPUT|QUAD_OUTPUT|QUAD_IO|QUAD_PAGE_PROGRAM}, \
     /* W25Q64JV */                                                                                 \
-    {SFUD_MF_ID_WINBOND, 0x40, 0x17, NORMAL_SPI_READ|DUAL_OUTPUT|DUAL_IO|QUAD_OUTPUT|QUAD_IO},     \
+    {SFUD_MF_ID_WINBOND, 0x40, 0x17, NORMAL_SPI_READ|DUAL_OUTPUT|DUAL_IO|QUAD_OUTPUT|QUAD_IO|QUAD_PAGE_PROGRAM}, \
     /* W25Q128JV */                                                                                \
-    {SFUD_MF_ID_WINBOND, 0x40, 0x18, NORMAL_SPI_READ|DUAL_OUTPUT|DUAL_IO|QUAD_OUTPUT|QUAD_IO},     \
+    {SFUD_MF_ID_WINBOND, 0x40, 0x18, NORMAL_SPI_READ|DUAL_OUTPUT|DUAL_IO|QUAD_OUTPUT|QUAD_IO|QUAD_PAGE_PROGRAM}, \
     /* W25Q256FV */                                                                                \
-    {SFUD_MF_ID_WINBOND, 0x40, 0x19, NORMAL_SPI_READ|DUAL_OUTPUT|DUAL_IO|QUAD_OUTPUT|QUAD_IO},     \
+    {SFUD_MF_ID_WINBOND, 0x40, 0x19, NORMAL_SPI_READ|DUAL_OUTPUT|DUAL_IO|QUAD_OUTPUT|QUAD_IO|QUAD_PAGE_PROGRAM}, \
     /* EN25Q32B */                                                                                 \
     {SFUD_MF_ID_EON, 0x30, 0x16, NORMAL_SPI_READ|DUAL_OUTPUT|QUAD_IO},                             \
     /* S25FL216K */                                                                                \
@@ -56,6 +56,7 @@ enum sfud_qspi_read_mode {
     DUAL_IO = 1 << 2,                       /**< qspi fast read dual input/output */
     QUAD_OUTPUT = 1 << 3,                   /**< qspi fast read quad output */
     QUAD_IO = 1 << 4,                       /**< qspi fast read quad input/output */
+    QUAD_PAGE_PROGRAM = 1 << 5,             /**< qspi quad input page program */
 };
 
 /* QSPI flash chip's extended information table */
@@ -181,12 +182,40 @@ static void qspi_set_read_cmd_format(sfud_flash *flash, uint8_t ins, uint8_t ins
     flash->read_cmd_format.data_lines = data_lines;
 }
 
+static void qspi_set_write_cmd_format(sfud_flash *flash, uint8_t ins, uint8_t data_lines) {
+    /* the 4-Byte address mode is entered when medium size greater than 16Mb */
+    flash->write_cmd_format.instruction = ins;
+    flash->write_cmd_format.address_size = flash->addr_in_4_byte ? 32 : 24;
+    flash->write_cmd_format.instruction_lines = 1;
+    flash->write_cmd_format.address_lines = 1;
+    flash->write_cmd_format.alternate_bytes_lines = 0;
+    flash->write_cmd_format.dummy_cycles = 0;
+    flash->write_cmd_format.data_lines = data_lines;
+}
+
+/**
+ * The quad input page program is ignored by the flash when the QE bit of status register 2 is clear.
+ */
+static bool qspi_quad_enabled(const sfud_flash *flash) {
+    uint8_t cmd = SFUD_CMD_READ_STATUS_REGISTER2;
+    uint8_t status;
+
+    if (flash->spi.wr(&flash->spi, &cmd, 1, &status, 1) != SFUD_SUCCESS) {
+        return false;
+    }
+
+    return (status & SFUD_STATUS_REGISTER2_QE) != 0;
+}
+
 /**
  * Enbale the fast read mode in QSPI flash mode. Default read mode is normal SPI mode.
  *
  * it will find the appropriate fast-read instruction to replace the read instruction(0x03)
  * fast-read instruction @see SFUD_FLASH_EXT_INFO_TABLE
  *
+ * The page program is sent by QSPI too, it uses the quad input page program instruction(0x32)
+ * when the data lines is 4, the flash supports it and its QE bit is set. Otherwise it uses 0x02.
+ *
  * @note When Flash is in QSPI mode, the method must be called after sfud_device_init().
  *
  * @param flash flash device
@@ -236,6 +265,12 @@ sfud_err sfud_qspi_fast_read_enable(sfud_flash *flash, uint8_t data_line_width)
         break;
     }
 
+    if (data_line_width == 4 && (read_mode & QUAD_PAGE_PROGRAM) && qspi_quad_enabled(flash)) {
+        qspi_set_write_cmd_format(flash, SFUD_CMD_QUAD_PAGE_PROGRAM, 4);
+    } else {
+        qspi_set_write_cmd_format(flash, SFUD_CMD_PAGE_PROGRAM, 1);
+    }
+
     return result;
 }
 #endif /* SFUD_USING_QSPI */
@@ -647,12 +682,19 @@ static sfud_err page256_or_1_byte_write(const sfud_flash *flash, uint32_t addr,
                 data_size = size;
             }
         }
-        size -= data_size;
-        addr += data_size;
 
-        memcpy(&cmd_data[cmd_size], data, data_size);
-
-        result = spi->wr(spi, cmd_data, cmd_size + data_size, NULL, 0);
+#ifdef SFUD_USING_QSPI
+        if (spi->qspi_write && flash->write_cmd_format.instruction) {
+            result = spi->qspi_write(spi, addr, (sfud_qspi_write_cmd_format *)&flash->write_cmd_format, data,
+                    data_size);
+        } else
+#endif
+        if (spi->write_data) {
+            result = spi->write_data(spi, cmd_data, cmd_size, data, data_size);
+        } else {
+            memcpy(&cmd_data[cmd_size], data, data_size);
+            result = spi->wr(spi, cmd_data, cmd_size + data_size, NULL, 0);
+        }
         if (result != SFUD_SUCCESS) {
             SFUD_INFO("Error: Flash write SPI communicate error.");
             goto __exit;
@@ -661,6 +703,8 @@ static sfud_err page256_or_1_byte_write(const sfud_flash *flash, uint32_t addr,
         if (result != SFUD_SUCCESS) {
             goto __exit;
         }
+        size -= data_size;
+        addr += data_size;
         data += data_size;
     }
 
@@ -967,6 +1011,7 @@ static sfud_err wait_busy(const sfud_flash *flash) {
     sfud_err result = SFUD_SUCCESS;
     uint8_t status;
     size_t retry_times = flash->retry.times;
+    size_t poll_times = SFUD_BUSY_POLL_TIMES;
 
     SFUD_ASSERT(flash);
 
@@ -975,6 +1020,11 @@ static sfud_err wait_busy(const sfud_flash *flash) {
         if (result == SFUD_SUCCESS && ((status & SFUD_STATUS_REGISTER_BUSY)) == 0) {
             break;
         }
+        /* the page program is finished in less than one retry delay usually, so poll it first */
+        if (result == SFUD_SUCCESS && poll_times) {
+            poll_times --;
+            continue;
+        }
         /* retry counts */
         SFUD_RETRY_PROCESS(flash->retry.delay, retry_times, result);
     }
@@ -6,6 +6,9 @@
  * Change Logs:
  * Date           Author       Notes
  * 2016-09-28     armink       first version.
+ * 2020-11-20     luhuadong    add MTD NOR device for the flash file systems
+ * 2020-11-20     luhuadong    send the page program data without copy, support
+ *                             QSPI page program
  */
 
 #include <stdint.h>
@@ -176,6 +179,59 @@ static sfud_err spi_write_read(const sfud_spi *spi, const uint8_t *write_buf, si
     return result;
 }
 
+/**
+ * SPI write command then data, the data is sent from the buffer of caller, so the DMA of bus can use it directly
+ */
+static sfud_err spi_write_data(const sfud_spi *spi, const uint8_t *cmd_buf, size_t cmd_size, const uint8_t *data,
+        size_t data_size) {
+    sfud_err result = SFUD_SUCCESS;
+    sfud_flash *sfud_dev = (sfud_flash *) (spi->user_data);
+    struct spi_flash_device *rtt_dev = (struct spi_flash_device *) (sfud_dev->user_data);
+
+    RT_ASSERT(spi);
+    RT_ASSERT(sfud_dev);
+    RT_ASSERT(rtt_dev);
+    RT_ASSERT(cmd_buf);
+#ifdef SFUD_USING_QSPI
+    if(rtt_dev->rt_spi_device->bus->mode & RT_SPI_BUS_MODE_QSPI) {
+        struct rt_qspi_device *qspi_dev = (struct rt_qspi_device *) (rtt_dev->rt_spi_device);
+        struct rt_qspi_message message;
+        size_t i;
+
+        RT_ASSERT(cmd_size == 4 || cmd_size == 5);
+
+        /* the command is made of instruction and address */
+        rt_memset(&message, 0, sizeof(message));
+        message.instruction.content = cmd_buf[0];
+        message.instruction.qspi_lines = 1;
+        for (i = 1; i < cmd_size; i++) {
+            message.address.content = (message.address.content << 8) | cmd_buf[i];
+        }
+        message.address.size = (cmd_size - 1) * 8;
+        message.address.qspi_lines = 1;
+
+        message.parent.send_buf = data;
+        message.parent.recv_buf = RT_NULL;
+        message.parent.length = data_size;
+        message.parent.cs_take = 1;
+        message.parent.cs_release = 1;
+        message.qspi_data_lines = 1;
+
+        if (rt_qspi_transfer_message(qspi_dev, &message) != data_size) {
+            result = SFUD_ERR_TIMEOUT;
+        }
+    }
+    else
+#endif
+    {
+        if (rt_spi_send_then_send(rtt_dev->rt_spi_device, cmd_buf, cmd_size, data, data_size) != RT_EOK) {
+            result = SFUD_ERR_TIMEOUT;
+        }
+    }
+
+    return result;
+}
+
 #ifdef SFUD_USING_QSPI
 /**
  * QSPI fast read data
@@ -220,6 +276,51 @@ static sfud_err qspi_read(const struct __sfud_spi *spi, uint32_t addr, sfud_qspi
 
     return result;
 }
+
+/**
+ * QSPI page program, the data is sent by quad lines when the flash supports it
+ */
+static sfud_err qspi_write(const struct __sfud_spi *spi, uint32_t addr, sfud_qspi_write_cmd_format *qspi_write_cmd_format,
+        const uint8_t *write_buf, size_t write_size) {
+    struct rt_qspi_message message;
+    sfud_err result = SFUD_SUCCESS;
+
+    sfud_flash *sfud_dev = (sfud_flash *) (spi->user_data);
+    struct spi_flash_device *rtt_dev = (struct spi_flash_device *) (sfud_dev->user_data);
+    struct rt_qspi_device *qspi_dev = (struct rt_qspi_device *) (rtt_dev->rt_spi_device);
+
+    RT_ASSERT(spi);
+    RT_ASSERT(sfud_dev);
+    RT_ASSERT(rtt_dev);
+    RT_ASSERT(qspi_dev);
+
+    /* set message struct */
+    message.instruction.content = qspi_write_cmd_format->instruction;
+    message.instruction.qspi_lines = qspi_write_cmd_format->instruction_lines;
+
+    message.address.content = addr;
+    message.address.size = qspi_write_cmd_format->address_size;
+    message.address.qspi_lines = qspi_write_cmd_format->address_lines;
+
+    message.alternate_bytes.content = 0;
+    message.alternate_bytes.size = 0;
+    message.alternate_bytes.qspi_lines = 0;
+
+    message.dummy_cycles = qspi_write_cmd_format->dummy_cycles;
+
+    message.parent.send_buf = write_buf;
+    message.parent.recv_buf = RT_NULL;
+    message.parent.length = write_size;
+    message.parent.cs_release = 1;
+    message.parent.cs_take = 1;
+    message.qspi_data_lines = qspi_write_cmd_format->data_lines;
+
+    if (rt_qspi_transfer_message(qspi_dev, &message) != write_size) {
+        result = SFUD_ERR_TIMEOUT;
+    }
+
+    return result;
+}
 #endif
 
 static void spi_lock(const sfud_spi *spi) {
@@ -256,8 +357,10 @@ sfud_err sfud_spi_port_init(sfud_flash *flash) {
 
     /* port SPI device interface */
     flash->spi.wr = spi_write_read;
+    flash->spi.write_data = spi_write_data;
 #ifdef SFUD_USING_QSPI
     flash->spi.qspi_read = qspi_read;
+    flash->spi.qspi_write = qspi_write;
 #endif
     flash->spi.lock = spi_lock;
     flash->spi.unlock = spi_unlock;
@@ -508,6 +611,94 @@ __error:
     return RT_NULL;
 }
 
+#ifdef RT_USING_MTD_NOR
+static rt_err_t rt_sfud_mtd_read_id(struct rt_mtd_nor_device *device) {
+    sfud_flash *sfud_dev = (sfud_flash *) (((struct spi_flash_mtd *) device)->user_data);
+
+    return (sfud_dev->chip.mf_id << 16) | (sfud_dev->chip.type_id << 8) | sfud_dev->chip.capacity_id;
+}
+
+static rt_size_t rt_sfud_mtd_read(struct rt_mtd_nor_device *device, rt_off_t offset, rt_uint8_t *data, rt_uint32_t length) {
+    sfud_flash *sfud_dev = (sfud_flash *) (((struct spi_flash_mtd *) device)->user_data);
+
+    if (sfud_read(sfud_dev, offset, length, data) != SFUD_SUCCESS) {
+        return 0;
+    } else {
+        return length;
+    }
+}
+
+static rt_size_t rt_sfud_mtd_write(struct rt_mtd_nor_device *device, rt_off_t offset, const rt_uint8_t *data, rt_uint32_t length) {
+    sfud_flash *sfud_dev = (sfud_flash *) (((struct spi_flash_mtd *) device)->user_data);
+
+    /* the flash file system erases the block before programming */
+    if (sfud_write(sfud_dev, offset, length, data) != SFUD_SUCCESS) {
+        return 0;
+    } else {
+        return length;
+    }
+}
+
+static rt_err_t rt_sfud_mtd_erase_block(struct rt_mtd_nor_device *device, rt_off_t offset, rt_uint32_t length) {
+    sfud_flash *sfud_dev = (sfud_flash *) (((struct spi_flash_mtd *) device)->user_data);
+
+    if (sfud_erase(sfud_dev, offset, length) != SFUD_SUCCESS) {
+        return -RT_ERROR;
+    } else {
+        return RT_EOK;
+    }
+}
+
+static const struct rt_mtd_nor_driver_ops sfud_mtd_ops = {
+    rt_sfud_mtd_read_id,
+    rt_sfud_mtd_read,
+    rt_sfud_mtd_write,
+    rt_sfud_mtd_erase_block,
+};
+
+/**
+ * Register the probed SFUD flash as MTD NOR device, which is used by the flash file systems, such as logfs.
+ *
+ * @param mtd_name the name which will create MTD NOR device
+ * @param flash_dev_name the probed flash device name
+ *
+ * @return the operation status, RT_EOK on successful
+ */
+rt_err_t rt_sfud_flash_mtd_register(const char *mtd_name, const char *flash_dev_name) {
+    struct spi_flash_mtd *mtd_dev;
+    rt_spi_flash_device_t rtt_dev;
+    sfud_flash_t sfud_dev;
+    rt_err_t result;
+
+    sfud_dev = rt_sfud_flash_find_by_dev_name(flash_dev_name);
+    if (sfud_dev == RT_NULL) {
+        return -RT_ERROR;
+    }
+    rtt_dev = (rt_spi_flash_device_t) rt_device_find(flash_dev_name);
+
+    mtd_dev = (struct spi_flash_mtd *) rt_malloc(sizeof(struct spi_flash_mtd));
+    if (mtd_dev == RT_NULL) {
+        LOG_E("ERROR: Low memory.");
+        return -RT_ENOMEM;
+    }
+    rt_memset(mtd_dev, 0, sizeof(struct spi_flash_mtd));
+
+    mtd_dev->rt_spi_device = rtt_dev->rt_spi_device;
+    mtd_dev->user_data = sfud_dev;
+    mtd_dev->mtd_device.block_size = sfud_dev->chip.erase_gran;
+    mtd_dev->mtd_device.block_start = 0;
+    mtd_dev->mtd_device.block_end = sfud_dev->chip.capacity / sfud_dev->chip.erase_gran;
+    mtd_dev->mtd_device.ops = &sfud_mtd_ops;
+
+    result = rt_mtd_nor_register_device(mtd_name, &(mtd_dev->mtd_device));
+    if (result != RT_EOK) {
+        rt_free(mtd_dev);
+    }
+
+    return result;
+}
+#endif /* RT_USING_MTD_NOR */
+
 #if defined(RT_USING_FINSH) && defined(FINSH_USING_MSH)
 
 #include <finsh.h>
@@ -66,4 +66,16 @@ sfud_flash_t rt_sfud_flash_find(const char *spi_dev_name);
  */
 sfud_flash_t rt_sfud_flash_find_by_dev_name(const char *flash_dev_name);
 
+#ifdef RT_USING_MTD_NOR
+/**
+ * Register the probed SFUD flash as MTD NOR device, which is used by the flash file systems, such as logfs.
+ *
+ * @param mtd_name the name which will create MTD NOR device
+ * @param flash_dev_name the probed flash device name
+ *
+ * @return the operation status, RT_EOK on successful
+ */
+rt_err_t rt_sfud_flash_mtd_register(const char *mtd_name, const char *flash_dev_name);
+#endif
+
 #endif /* _SPI_FLASH_SFUD_H_ */
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/* the configuration of sfud_sim, SFUD is built for the host */
+
+#ifndef RT_CONFIG_H__
+#define RT_CONFIG_H__
+
+#define RT_TICK_PER_SECOND 1000
+
+#define RT_USING_SPI
+#define RT_USING_SFUD
+#define RT_SFUD_USING_FLASH_INFO_TABLE
+#define RT_SFUD_USING_QSPI
+
+/* the status polling is changed by sfud_sim at runtime */
+extern unsigned int sim_busy_poll_times;
+#define RT_SFUD_BUSY_POLL_TIMES sim_busy_poll_times
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * sfud_sim runs SFUD on the host with a simulated W25Q64 SPI flash, and
+ * prints the page program throughput of the ways to send the page and to
+ * wait for busy. It also checks that the quad input page program (0x32)
+ * is only used when the QE bit is set.
+ *
+ * The time of each operation is added up by a timing model: 2us to start
+ * a transfer, the data is transferred at 50MHz on each line, the flash
+ * programs one page in 0.7ms and erases 4KB in 45ms. The retry delay of
+ * SFUD is one OS tick of 1ms, it sleeps until the next tick. The CPU time
+ * of copying the page isn't counted.
+ *
+ * SFUD is built into this program with the configuration in rtconfig.h:
+ *
+ *   gcc -O2 -I. -I../sfud/inc -I../../../../include sfud_sim.c ../sfud/src/sfud.c -o sfud_sim
+ *
+ * usage: sfud_sim [write size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include <sfud.h>
+
+#define SIM_XFER_NS         2000    /* start a transfer */
+#define SIM_BYTE_NS         160     /* transfer one byte at 50MHz on one line */
+#define SIM_PROG_NS         700000  /* program one page */
+#define SIM_ERASE_NS        45000000 /* erase 4KB */
+#define SIM_TICK_NS         1000000 /* the OS tick */
+
+#define SIM_SIZE            (8 * 1024 * 1024)
+#define SIM_PAGE_SIZE       256
+
+struct sim_flash
+{
+    uint8_t data[SIM_SIZE];
+    uint8_t sr1;
+    uint8_t sr2;
+    uint64_t busy_until;
+
+    uint64_t time_ns;               /* the time of all operations */
+    unsigned long pages;            /* the pages programmed */
+    unsigned long ignored;          /* the commands ignored by the flash */
+};
+
+static struct sim_flash flash;
+static sfud_flash sfud;
+unsigned int sim_busy_poll_times;
+
+/* the stubs of kernel for SFUD */
+void rt_kprintf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    vprintf(fmt, args);
+    va_end(args);
+}
+
+static int sim_busy(void)
+{
+    return flash.time_ns < flash.busy_until;
+}
+
+static uint32_t sim_addr(const uint8_t *cmd)
+{
+    return (cmd[1] << 16) | (cmd[2] << 8) | cmd[3];
+}
+
+static void sim_program(uint32_t addr, const uint8_t *data, size_t size, uint8_t data_lines, uint8_t ins)
+{
+    uint32_t page = addr & ~(SIM_PAGE_SIZE - 1);
+    size_t i;
+
+    /* the quad input page program is ignored without the QE bit */
+    if (sim_busy() || !(flash.sr1 & SFUD_STATUS_REGISTER_WEL) || data_lines != (ins == 0x32 ? 4 : 1)
+            || (ins == 0x32 && !(flash.sr2 & SFUD_STATUS_REGISTER2_QE)))
+    {
+        flash.ignored++;
+        return;
+    }
+
+    /* the address wraps in the page */
+    for (i = 0; i < size; i++)
+        flash.data[page + (addr + i) % SIM_PAGE_SIZE] &= data[i];
+
+    flash.sr1 &= ~SFUD_STATUS_REGISTER_WEL;
+    flash.busy_until = flash.time_ns + SIM_PROG_NS;
+    flash.pages++;
+}
+
+static sfud_err sim_wr(const sfud_spi *spi, const uint8_t *write_buf, size_t write_size, uint8_t *read_buf,
+        size_t read_size)
+{
+    static const uint8_t jedec_id[] = {SFUD_MF_ID_WINBOND, 0x40, 0x17};
+    uint32_t addr;
+    size_t i;
+
+    flash.time_ns += SIM_XFER_NS + (uint64_t)(write_size + read_size) * SIM_BYTE_NS;
+
+    switch (write_buf[0])
+    {
+    case SFUD_CMD_JEDEC_ID:
+        for (i = 0; i < read_size; i++)
+            read_buf[i] = i < sizeof(jedec_id) ? jedec_id[i] : 0;
+        break;
+    case SFUD_CMD_READ_STATUS_REGISTER:
+        for (i = 0; i < read_size; i++)
+            read_buf[i] = flash.sr1 | (sim_busy() ? SFUD_STATUS_REGISTER_BUSY : 0);
+        break;
+    case SFUD_CMD_READ_STATUS_REGISTER2:
+        for (i = 0; i < read_size; i++)
+            read_buf[i] = flash.sr2;
+        break;
+    case SFUD_CMD_WRITE_ENABLE:
+        if (!sim_busy())
+            flash.sr1 |= SFUD_STATUS_REGISTER_WEL;
+        break;
+    case SFUD_CMD_WRITE_DISABLE:
+        if (!sim_busy())
+            flash.sr1 &= ~SFUD_STATUS_REGISTER_WEL;
+        break;
+    case SFUD_CMD_ENABLE_RESET:
+    case SFUD_CMD_RESET:
+        break;
+    case SFUD_CMD_PAGE_PROGRAM:
+        sim_program(sim_addr(write_buf), write_buf + 4, write_size - 4, 1, SFUD_CMD_PAGE_PROGRAM);
+        break;
+    case SFUD_CMD_READ_DATA:
+        addr = sim_addr(write_buf);
+        if (sim_busy())
+            flash.ignored++;
+        memcpy(read_buf, flash.data + addr, read_size);
+        break;
+    default:
+        printf("unknown command 0x%02X\n", write_buf[0]);
+        flash.ignored++;
+        break;
+    }
+
+    return SFUD_SUCCESS;
+}
+
+/* the port of RT-Thread sends the command then the page by one transfer */
+static sfud_err sim_write_data(const sfud_spi *spi, const uint8_t *cmd_buf, size_t cmd_size, const uint8_t *data,
+        size_t data_size)
+{
+    flash.time_ns += SIM_XFER_NS + (uint64_t)(cmd_size + data_size) * SIM_BYTE_NS;
+    sim_program(sim_addr(cmd_buf), data, data_size, 1, cmd_buf[0]);
+
+    return SFUD_SUCCESS;
+}
+
+static sfud_err sim_qspi_read(const sfud_spi *spi, uint32_t addr, sfud_qspi_read_cmd_format *format,
+        uint8_t *read_buf, size_t read_size)
+{
+    flash.time_ns += SIM_XFER_NS + (uint64_t)(1 + format->address_size / 8) * SIM_BYTE_NS
+            + (uint64_t)read_size * SIM_BYTE_NS / format->data_lines;
+    memcpy(read_buf, flash.data + addr, read_size);
+
+    return SFUD_SUCCESS;
+}
+
+static sfud_err sim_qspi_write(const sfud_spi *spi, uint32_t addr, sfud_qspi_write_cmd_format *format,
+        const uint8_t *write_buf, size_t write_size)
+{
+    flash.time_ns += SIM_XFER_NS + (uint64_t)(1 + format->address_size / 8) * SIM_BYTE_NS
+            + (uint64_t)write_size * SIM_BYTE_NS / format->data_lines;
+    sim_program(addr, write_buf, write_size, format->data_lines, format->instruction);
+
+    return SFUD_SUCCESS;
+}
+
+/* rt_thread_delay(1) sleeps until the next tick */
+static void sim_tick_delay(void)
+{
+    flash.time_ns = (flash.time_ns / SIM_TICK_NS + 1) * SIM_TICK_NS;
+}
+
+sfud_err sfud_spi_port_init(sfud_flash *flash)
+{
+    flash->spi.wr = sim_wr;
+    flash->spi.write_data = sim_write_data;
+    flash->spi.qspi_read = sim_qspi_read;
+    flash->spi.qspi_write = sim_qspi_write;
+    flash->retry.delay = sim_tick_delay;
+    flash->retry.times = 60 * 1000;
+
+    return SFUD_SUCCESS;
+}
+
+static void sim_init(int quad_enabled)
+{
+    memset(&flash, 0, sizeof(flash));
+    memset(flash.data, 0xFF, sizeof(flash.data));
+    flash.sr2 = quad_enabled ? SFUD_STATUS_REGISTER2_QE : 0;
+
+    memset(&sfud, 0, sizeof(sfud));
+    sfud.name = (char *)"sim";
+    if (sfud_device_init(&sfud) != SFUD_SUCCESS)
+    {
+        fprintf(stderr, "init failed\n");
+        exit(1);
+    }
+}
+
+/* returns the throughput of writing, 0 if the data is wrong */
+static double sim_write(size_t size)
+{
+    uint8_t *buf = malloc(size);
+    uint32_t addr = 0x10000;
+    size_t i;
+    int ok;
+
+    for (i = 0; i < size; i++)
+        buf[i] = (uint8_t)(i * 31 + (i >> 8));
+
+    flash.time_ns = 0;
+    flash.busy_until = 0;
+    if (sfud_write(&sfud, addr, size, buf) != SFUD_SUCCESS)
+    {
+        fprintf(stderr, "write failed\n");
+        exit(1);
+    }
+    ok = memcmp(flash.data + addr, buf, size) == 0 && flash.ignored == 0;
+    free(buf);
+
+    return ok ? size / 1024.0 / (flash.time_ns / 1e9) : 0;
+}
+
+static void bench(const char *name, int write_data, unsigned int poll_times, int data_lines, int quad_enabled,
+        size_t size)
+{
+    double kbps;
+
+    sim_init(quad_enabled);
+    if (!write_data)
+        sfud.spi.write_data = NULL;
+    if (data_lines)
+        sfud_qspi_fast_read_enable(&sfud, data_lines);
+    else
+        sfud.spi.qspi_write = NULL;
+    sim_busy_poll_times = poll_times;
+
+    kbps = sim_write(size);
+    printf("%-32s %6s %6.0f %8.1f\n", name,
+           data_lines && sfud.write_cmd_format.instruction == SFUD_CMD_QUAD_PAGE_PROGRAM ? "0x32" : "0x02",
+           kbps, flash.time_ns / 1e6);
+    if (kbps == 0)
+    {
+        printf("%s: FAIL, the data is wrong, %lu commands are ignored\n", name, flash.ignored);
+        exit(1);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t size = 64 * 1024;
+
+    if (argc > 1)
+        size = strtoul(argv[1], NULL, 0);
+
+    printf("write %u bytes to W25Q64, 1ms tick\n\n", (unsigned)size);
+    printf("%-32s %6s %6s %8s\n", "workload", "cmd", "KB/s", "ms");
+    bench("SPI, copy, tick delay", 0, 0, 0, 0, size);
+    bench("SPI, no copy, tick delay", 1, 0, 0, 0, size);
+    bench("SPI, no copy, poll 200", 1, 200, 0, 0, size);
+    bench("SPI, no copy, poll 1000", 1, 1000, 0, 0, size);
+    bench("QSPI x4, QE clear, poll 1000", 1, 1000, 4, 0, size);
+    bench("QSPI x4, QE set, poll 1000", 1, 1000, 4, 1, size);
+
+    return 0;
+}
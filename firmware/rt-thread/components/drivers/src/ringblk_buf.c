@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-08-25     armink       the first version
+ * 2020-11-17     luhuadong    add free block list, block alignment and batch get/free
  */
 
 #include <rthw.h>
@@ -35,11 +36,15 @@ void rt_rbb_init(rt_rbb_t rbb, rt_uint8_t *buf, rt_size_t buf_size, rt_rbb_blk_t
     rbb->buf_size = buf_size;
     rbb->blk_set = block_set;
     rbb->blk_max_num = blk_max_num;
+    rbb->blk_tail = RT_NULL;
+    rbb->blk_align = 1;
     rt_slist_init(&rbb->blk_list);
-    /* initialize block status */
-    for (i = 0; i < blk_max_num; i++)
+    rt_slist_init(&rbb->free_list);
+    /* initialize block status, and put them on free list by order */
+    for (i = blk_max_num; i > 0; i--)
     {
-        block_set[i].status = RT_RBB_BLK_UNUSED;
+        block_set[i - 1].status = RT_RBB_BLK_UNUSED;
+        rt_slist_insert(&rbb->free_list, &block_set[i - 1].list);
     }
 }
 RTM_EXPORT(rt_rbb_init);
@@ -102,21 +107,71 @@ void rt_rbb_destroy(rt_rbb_t rbb)
 }
 RTM_EXPORT(rt_rbb_destroy);
 
-static rt_rbb_blk_t find_empty_blk_in_set(rt_rbb_t rbb)
+/**
+ * set the alignment of block buffer address, such as the D-Cache line size
+ * when the blocks are transferred by DMA. It must be called before allocating.
+ *
+ * @param rbb ring block buffer object
+ * @param align the alignment, it must be power of two
+ *
+ * @note The buffer size should be aligned too, so the last block will not
+ *       share the cache line with the other memory.
+ */
+void rt_rbb_set_blk_align(rt_rbb_t rbb, rt_size_t align)
 {
-    rt_size_t i;
-
     RT_ASSERT(rbb);
+    RT_ASSERT(align > 0 && (align & (align - 1)) == 0);
+    RT_ASSERT(rt_slist_isempty(&rbb->blk_list));
+
+    rbb->blk_align = align;
+}
+RTM_EXPORT(rt_rbb_set_blk_align);
+
+rt_inline rt_uint8_t *blk_buf_align(rt_rbb_t rbb, rt_uint8_t *buf)
+{
+    return (rt_uint8_t *)RT_ALIGN((rt_ubase_t)buf, rbb->blk_align);
+}
+
+/* take an unused block from free list, the interrupt must be disabled */
+rt_inline rt_rbb_blk_t take_empty_blk(rt_rbb_t rbb)
+{
+    rt_slist_t *node = rt_slist_first(&rbb->free_list);
+
+    if (node == RT_NULL)
+    {
+        return RT_NULL;
+    }
+    rbb->free_list.next = node->next;
+
+    return rt_slist_entry(node, struct rt_rbb_blk, list);
+}
+
+/* put the block back to free list, the interrupt must be disabled */
+rt_inline void release_blk(rt_rbb_t rbb, rt_rbb_blk_t block)
+{
+    block->status = RT_RBB_BLK_UNUSED;
+    rt_slist_insert(&rbb->free_list, &block->list);
+}
+
+/* remove the block from blk_list, the interrupt must be disabled */
+static void remove_blk_from_list(rt_rbb_t rbb, rt_rbb_blk_t block)
+{
+    rt_slist_t *prev;
 
-    for (i = 0; i < rbb->blk_max_num; i ++)
+    /* the block is on the head of list in most of cases */
+    for (prev = &rbb->blk_list; prev->next; prev = prev->next)
     {
-        if (rbb->blk_set[i].status == RT_RBB_BLK_UNUSED)
+        if (prev->next == &block->list)
         {
-            return &rbb->blk_set[i];
+            prev->next = block->list.next;
+            block->list.next = RT_NULL;
+            if (rbb->blk_tail == block)
+            {
+                rbb->blk_tail = (prev == &rbb->blk_list) ? RT_NULL : rt_slist_entry(prev, struct rt_rbb_blk, list);
+            }
+            break;
         }
     }
-
-    return NULL;
 }
 
 /**
@@ -133,93 +188,95 @@ static rt_rbb_blk_t find_empty_blk_in_set(rt_rbb_t rbb)
 rt_rbb_blk_t rt_rbb_blk_alloc(rt_rbb_t rbb, rt_size_t blk_size)
 {
     rt_base_t level;
-    rt_size_t empty1 = 0, empty2 = 0;
+    rt_uint8_t *buf_end, *blk_buf = RT_NULL;
     rt_rbb_blk_t head, tail, new_rbb = NULL;
 
     RT_ASSERT(rbb);
     RT_ASSERT(blk_size < (1L << 24));
 
+    buf_end = rbb->buf + rbb->buf_size;
+
     level = rt_hw_interrupt_disable();
 
-    new_rbb = find_empty_blk_in_set(rbb);
+    if (rt_slist_isempty(&rbb->free_list))
+    {
+        /* all of blocks are used */
+        goto __exit;
+    }
 
-    if (rt_slist_len(&rbb->blk_list) < rbb->blk_max_num && new_rbb)
+    if (!rt_slist_isempty(&rbb->blk_list))
     {
-        if (rt_slist_len(&rbb->blk_list) > 0)
+        head = rt_slist_first_entry(&rbb->blk_list, struct rt_rbb_blk, list);
+        tail = rbb->blk_tail;
+        if (head->buf <= tail->buf)
         {
-            head = rt_slist_first_entry(&rbb->blk_list, struct rt_rbb_blk, list);
-            tail = rt_slist_tail_entry(&rbb->blk_list, struct rt_rbb_blk, list);
-            if (head->buf <= tail->buf)
-            {
-                /**
-                 *                      head                     tail
-                 * +--------------------------------------+-----------------+------------------+
-                 * |      empty2     | block1 |   block2  |      block3     |       empty1     |
-                 * +--------------------------------------+-----------------+------------------+
-                 *                            rbb->buf
-                 */
-                empty1 = (rbb->buf + rbb->buf_size) - (tail->buf + tail->size);
-                empty2 = head->buf - rbb->buf;
-
-                if (empty1 >= blk_size)
-                {
-                    rt_slist_append(&rbb->blk_list, &new_rbb->list);
-                    new_rbb->status = RT_RBB_BLK_INITED;
-                    new_rbb->buf = tail->buf + tail->size;
-                    new_rbb->size = blk_size;
-                }
-                else if (empty2 >= blk_size)
-                {
-                    rt_slist_append(&rbb->blk_list, &new_rbb->list);
-                    new_rbb->status = RT_RBB_BLK_INITED;
-                    new_rbb->buf = rbb->buf;
-                    new_rbb->size = blk_size;
-                }
-                else
-                {
-                    /* no space */
-                    new_rbb = NULL;
-                }
-            }
-            else
+            /**
+             *                      head                     tail
+             * +--------------------------------------+-----------------+------------------+
+             * |      empty2     | block1 |   block2  |      block3     |       empty1     |
+             * +--------------------------------------+-----------------+------------------+
+             *                            rbb->buf
+             */
+            blk_buf = blk_buf_align(rbb, tail->buf + tail->size);
+            if (blk_buf > buf_end || (rt_size_t)(buf_end - blk_buf) < blk_size)
             {
-                /**
-                 *        tail                                              head
-                 * +----------------+-------------------------------------+--------+-----------+
-                 * |     block3     |                empty1               | block1 |  block2   |
-                 * +----------------+-------------------------------------+--------+-----------+
-                 *                            rbb->buf
-                 */
-                empty1 = head->buf - (tail->buf + tail->size);
-
-                if (empty1 >= blk_size)
-                {
-                    rt_slist_append(&rbb->blk_list, &new_rbb->list);
-                    new_rbb->status = RT_RBB_BLK_INITED;
-                    new_rbb->buf = tail->buf + tail->size;
-                    new_rbb->size = blk_size;
-                }
-                else
+                /* no space on empty1, try empty2 */
+                blk_buf = blk_buf_align(rbb, rbb->buf);
+                if (blk_buf > head->buf || (rt_size_t)(head->buf - blk_buf) < blk_size)
                 {
                     /* no space */
-                    new_rbb = NULL;
+                    blk_buf = RT_NULL;
                 }
             }
         }
         else
         {
-            /* the list is empty */
-            rt_slist_append(&rbb->blk_list, &new_rbb->list);
-            new_rbb->status = RT_RBB_BLK_INITED;
-            new_rbb->buf = rbb->buf;
-            new_rbb->size = blk_size;
+            /**
+             *        tail                                              head
+             * +----------------+-------------------------------------+--------+-----------+
+             * |     block3     |                empty1               | block1 |  block2   |
+             * +----------------+-------------------------------------+--------+-----------+
+             *                            rbb->buf
+             */
+            blk_buf = blk_buf_align(rbb, tail->buf + tail->size);
+            if (blk_buf > head->buf || (rt_size_t)(head->buf - blk_buf) < blk_size)
+            {
+                /* no space */
+                blk_buf = RT_NULL;
+            }
         }
     }
     else
     {
-        new_rbb = NULL;
+        /* the list is empty */
+        blk_buf = blk_buf_align(rbb, rbb->buf);
+        if (blk_buf > buf_end || (rt_size_t)(buf_end - blk_buf) < blk_size)
+        {
+            /* no space */
+            blk_buf = RT_NULL;
+        }
+    }
+
+    if (blk_buf)
+    {
+        new_rbb = take_empty_blk(rbb);
+        new_rbb->status = RT_RBB_BLK_INITED;
+        new_rbb->buf = blk_buf;
+        new_rbb->size = blk_size;
+        /* append it to the tail of blk_list */
+        new_rbb->list.next = RT_NULL;
+        if (rbb->blk_tail)
+        {
+            rbb->blk_tail->list.next = &new_rbb->list;
+        }
+        else
+        {
+            rbb->blk_list.next = &new_rbb->list;
+        }
+        rbb->blk_tail = new_rbb;
     }
 
+__exit:
     rt_hw_interrupt_enable(level);
 
     return new_rbb;
@@ -311,6 +368,46 @@ rt_uint8_t *rt_rbb_blk_buf(rt_rbb_blk_t block)
 }
 RTM_EXPORT(rt_rbb_blk_buf);
 
+/**
+ * get some put status blocks from the ring block buffer object by order
+ *
+ * @param rbb ring block buffer object
+ * @param blocks the array to save the blocks
+ * @param num the max number of blocks
+ *
+ * @return the number of got blocks
+ */
+rt_size_t rt_rbb_blk_get_batch(rt_rbb_t rbb, rt_rbb_blk_t *blocks, rt_size_t num)
+{
+    rt_base_t level;
+    rt_rbb_blk_t block;
+    rt_slist_t *node;
+    rt_size_t count = 0;
+
+    RT_ASSERT(rbb);
+    RT_ASSERT(blocks);
+
+    if (rt_slist_isempty(&rbb->blk_list))
+        return 0;
+
+    level = rt_hw_interrupt_disable();
+
+    for (node = rt_slist_first(&rbb->blk_list); node && count < num; node = rt_slist_next(node))
+    {
+        block = rt_slist_entry(node, struct rt_rbb_blk, list);
+        if (block->status == RT_RBB_BLK_PUT)
+        {
+            block->status = RT_RBB_BLK_GET;
+            blocks[count++] = block;
+        }
+    }
+
+    rt_hw_interrupt_enable(level);
+
+    return count;
+}
+RTM_EXPORT(rt_rbb_blk_get_batch);
+
 /**
  * free the block
  *
@@ -328,14 +425,42 @@ void rt_rbb_blk_free(rt_rbb_t rbb, rt_rbb_blk_t block)
     level = rt_hw_interrupt_disable();
 
     /* remove it on rbb block list */
-    rt_slist_remove(&rbb->blk_list, &block->list);
-
-    block->status = RT_RBB_BLK_UNUSED;
+    remove_blk_from_list(rbb, block);
+    release_blk(rbb, block);
 
     rt_hw_interrupt_enable(level);
 }
 RTM_EXPORT(rt_rbb_blk_free);
 
+/**
+ * free some blocks at once
+ *
+ * @param rbb ring block buffer object
+ * @param blocks the blocks, such as which are got by rt_rbb_blk_get_batch
+ * @param num the number of blocks
+ */
+void rt_rbb_blk_free_batch(rt_rbb_t rbb, rt_rbb_blk_t *blocks, rt_size_t num)
+{
+    rt_base_t level;
+    rt_size_t i;
+
+    RT_ASSERT(rbb);
+    RT_ASSERT(blocks);
+
+    level = rt_hw_interrupt_disable();
+
+    for (i = 0; i < num; i++)
+    {
+        RT_ASSERT(blocks[i]->status != RT_RBB_BLK_UNUSED);
+
+        remove_blk_from_list(rbb, blocks[i]);
+        release_blk(rbb, blocks[i]);
+    }
+
+    rt_hw_interrupt_enable(level);
+}
+RTM_EXPORT(rt_rbb_blk_free_batch);
+
 /**
  * get a continuous block to queue by given size
  *
@@ -363,7 +488,7 @@ rt_size_t rt_rbb_blk_queue_get(rt_rbb_t rbb, rt_size_t queue_data_len, rt_rbb_bl
 {
     rt_base_t level;
     rt_size_t data_total_size = 0;
-    rt_slist_t *node;
+    rt_slist_t *node, *prev, *queue_prev = RT_NULL;
     rt_rbb_blk_t last_block = NULL, block;
 
     RT_ASSERT(rbb);
@@ -374,27 +499,23 @@ rt_size_t rt_rbb_blk_queue_get(rt_rbb_t rbb, rt_size_t queue_data_len, rt_rbb_bl
 
     level = rt_hw_interrupt_disable();
 
-    for (node = rt_slist_first(&rbb->blk_list); node; node = rt_slist_next(node))
+    for (prev = &rbb->blk_list, node = rt_slist_first(&rbb->blk_list); node; prev = node, node = rt_slist_next(node))
     {
+        block = rt_slist_entry(node, struct rt_rbb_blk, list);
         if (!last_block)
         {
-            last_block = rt_slist_entry(node, struct rt_rbb_blk, list);
-            if (last_block->status == RT_RBB_BLK_PUT)
-            {
-                /* save the first put status block to queue */
-                blk_queue->blocks = last_block;
-                blk_queue->blk_num = 0;
-            }
-            else
+            if (block->status != RT_RBB_BLK_PUT)
             {
                 /* the first block must be put status */
-                last_block = NULL;
                 continue;
             }
+            /* save the first put status block to queue */
+            blk_queue->blocks = block;
+            blk_queue->blk_num = 0;
+            queue_prev = prev;
         }
         else
         {
-            block = rt_slist_entry(node, struct rt_rbb_blk, list);
             /*
              * these following conditions will break the loop:
              * 1. the current block is not put status
@@ -402,21 +523,30 @@ rt_size_t rt_rbb_blk_queue_get(rt_rbb_t rbb, rt_size_t queue_data_len, rt_rbb_bl
              * 3. the data_total_size will out of range
              */
             if (block->status != RT_RBB_BLK_PUT ||
-                last_block->buf > block->buf ||
+                last_block->buf + last_block->size != block->buf ||
                 data_total_size + block->size > queue_data_len)
             {
                 break;
             }
-            /* backup last block */
-            last_block = block;
         }
-        /* remove current block */
-        rt_slist_remove(&rbb->blk_list, &last_block->list);
+        /* backup last block */
+        last_block = block;
         data_total_size += last_block->size;
         last_block->status = RT_RBB_BLK_GET;
         blk_queue->blk_num++;
     }
 
+    if (last_block)
+    {
+        /* remove the blocks of queue, they are still linked */
+        queue_prev->next = last_block->list.next;
+        last_block->list.next = RT_NULL;
+        if (rbb->blk_tail == last_block)
+        {
+            rbb->blk_tail = (queue_prev == &rbb->blk_list) ? RT_NULL : rt_slist_entry(queue_prev, struct rt_rbb_blk, list);
+        }
+    }
+
     rt_hw_interrupt_enable(level);
 
     return data_total_size;
@@ -433,12 +563,14 @@ RTM_EXPORT(rt_rbb_blk_queue_get);
 rt_size_t rt_rbb_blk_queue_len(rt_rbb_blk_queue_t blk_queue)
 {
     rt_size_t i, data_total_size = 0;
+    rt_rbb_blk_t block;
 
     RT_ASSERT(blk_queue);
 
-    for (i = 0; i < blk_queue->blk_num; i++)
+    for (i = 0, block = blk_queue->blocks; i < blk_queue->blk_num; i++)
     {
-        data_total_size += blk_queue->blocks[i].size;
+        data_total_size += block->size;
+        block = rt_slist_entry(block->list.next, struct rt_rbb_blk, list);
     }
 
     return data_total_size;
@@ -456,7 +588,7 @@ rt_uint8_t *rt_rbb_blk_queue_buf(rt_rbb_blk_queue_t blk_queue)
 {
     RT_ASSERT(blk_queue);
 
-    return blk_queue->blocks[0].buf;
+    return blk_queue->blocks->buf;
 }
 RTM_EXPORT(rt_rbb_blk_queue_buf);
 
@@ -468,15 +600,25 @@ RTM_EXPORT(rt_rbb_blk_queue_buf);
  */
 void rt_rbb_blk_queue_free(rt_rbb_t rbb, rt_rbb_blk_queue_t blk_queue)
 {
+    rt_base_t level;
     rt_size_t i;
+    rt_rbb_blk_t block, next;
 
     RT_ASSERT(rbb);
     RT_ASSERT(blk_queue);
 
-    for (i = 0; i < blk_queue->blk_num; i++)
+    level = rt_hw_interrupt_disable();
+
+    /* the blocks have been removed from blk_list */
+    for (i = 0, block = blk_queue->blocks; i < blk_queue->blk_num; i++, block = next)
     {
-        rt_rbb_blk_free(rbb, &blk_queue->blocks[i]);
+        RT_ASSERT(block->status == RT_RBB_BLK_GET);
+
+        next = rt_slist_entry(block->list.next, struct rt_rbb_blk, list);
+        release_blk(rbb, block);
     }
+
+    rt_hw_interrupt_enable(level);
 }
 RTM_EXPORT(rt_rbb_blk_queue_free);
 
@@ -522,7 +664,7 @@ rt_size_t rt_rbb_next_blk_queue_len(rt_rbb_t rbb)
              * 1. the current block is not put status
              * 2. the last block and current block is not continuous
              */
-            if (block->status != RT_RBB_BLK_PUT || last_block->buf > block->buf)
+            if (block->status != RT_RBB_BLK_PUT || last_block->buf + last_block->size != block->buf)
             {
                 break;
             }
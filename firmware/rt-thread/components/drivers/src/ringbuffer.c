@@ -8,8 +8,10 @@
  * 2012-09-30     Bernard      first version.
  * 2013-05-08     Grissiom     reimplement
  * 2016-08-18     heyuanjie    add interface
+ * 2020-11-16     luhuadong    add peek/consume and the lock-free multi-producer ringbuffer
  */
 
+#include <rthw.h>
 #include <rtthread.h>
 #include <rtdevice.h>
 #include <string.h>
@@ -286,6 +288,70 @@ rt_size_t rt_ringbuffer_getchar(struct rt_ringbuffer *rb, rt_uint8_t *ch)
 }
 RTM_EXPORT(rt_ringbuffer_getchar);
 
+/**
+ * peek the contiguous data in ring buffer, the data is not removed
+ *
+ * @param rb the ring buffer
+ * @param ptr the pointer of data
+ *
+ * @return the length of contiguous data at ptr, the rest is at the beginning
+ *         of buffer when the data is wrapped around
+ */
+rt_size_t rt_ringbuffer_peek(struct rt_ringbuffer *rb, rt_uint8_t **ptr)
+{
+    rt_size_t size;
+
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(ptr != RT_NULL);
+
+    *ptr = RT_NULL;
+
+    /* whether has enough data  */
+    size = rt_ringbuffer_data_len(rb);
+
+    /* no data */
+    if (size == 0)
+        return 0;
+
+    *ptr = &rb->buffer_ptr[rb->read_index];
+
+    if (rb->buffer_size - rb->read_index > size)
+        return size;
+
+    return rb->buffer_size - rb->read_index;
+}
+RTM_EXPORT(rt_ringbuffer_peek);
+
+/**
+ * remove the data which has been handled through rt_ringbuffer_peek
+ */
+rt_size_t rt_ringbuffer_consume(struct rt_ringbuffer *rb, rt_uint16_t length)
+{
+    rt_size_t size;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    /* whether has enough data  */
+    size = rt_ringbuffer_data_len(rb);
+
+    /* less data */
+    if (size < length)
+        length = size;
+
+    if (rb->buffer_size - rb->read_index > length)
+    {
+        rb->read_index += length;
+        return length;
+    }
+
+    /* we are going into the other side of the mirror */
+    rb->read_mirror = ~rb->read_mirror;
+    rb->read_index = length - (rb->buffer_size - rb->read_index);
+
+    return length;
+}
+RTM_EXPORT(rt_ringbuffer_consume);
+
 /** 
  * get the size of data in rb 
  */
@@ -360,3 +426,327 @@ void rt_ringbuffer_destroy(struct rt_ringbuffer *rb)
 RTM_EXPORT(rt_ringbuffer_destroy);
 
 #endif
+
+/*
+ * The record header of multi-producer ringbuffer:
+ *
+ * bit 31    : committed
+ * bit 30    : padding, the rest of buffer is skipped
+ * bit 29-15 : the length of committed data
+ * bit 14-0  : the length of reserved data
+ *
+ * The header is 0 before the record is reserved, the consumer clears the
+ * released records, so the producer could reserve the space without touching
+ * the memory which may be read by the consumer.
+ */
+#define RB_MP_HDR_COMMIT        0x80000000UL
+#define RB_MP_HDR_PAD           0x40000000UL
+#define RB_MP_HDR_SIZE          sizeof(rt_uint32_t)
+#define RB_MP_HDR_RESERVED(hdr) ((hdr) & RT_RINGBUFFER_MP_RECORD_MAX)
+#define RB_MP_HDR_LENGTH(hdr)   (((hdr) >> 15) & RT_RINGBUFFER_MP_RECORD_MAX)
+#define RB_MP_RECORD_SPAN(len)  (RB_MP_HDR_SIZE + RT_ALIGN((len), RB_MP_HDR_SIZE))
+
+/* the data must be visible before the header and the index */
+#if defined(__CC_ARM)
+#define RB_MP_BARRIER()         __dmb(0xF)
+#elif defined(__IAR_SYSTEMS_ICC__)
+#include <intrinsics.h>
+#define RB_MP_BARRIER()         __DMB()
+#else
+#define RB_MP_BARRIER()         __sync_synchronize()
+#endif
+
+rt_inline rt_bool_t _ringbuffer_mp_cas(volatile rt_uint32_t *addr, rt_uint32_t old_value, rt_uint32_t new_value)
+{
+#if defined(RT_USING_CPU_EXCLUSIVE) && !defined(RT_USING_SMP)
+    if (rt_hw_exclusive_load32(addr) != old_value)
+    {
+        rt_hw_exclusive_clear();
+        return RT_FALSE;
+    }
+    return rt_hw_exclusive_store32(addr, new_value) == 0;
+#else
+    rt_base_t level;
+    rt_bool_t result = RT_FALSE;
+
+    level = rt_hw_interrupt_disable();
+    if (*addr == old_value)
+    {
+        *addr = new_value;
+        result = RT_TRUE;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return result;
+#endif
+}
+
+rt_inline volatile rt_uint32_t *_ringbuffer_mp_header(struct rt_ringbuffer_mp *rb, rt_uint32_t index)
+{
+    return (volatile rt_uint32_t *)&rb->buffer_ptr[index & rb->buffer_mask];
+}
+
+/**
+ * initialize the multi-producer ringbuffer
+ *
+ * @param rb the ring buffer
+ * @param pool the buffer, it must be aligned to 4 bytes
+ * @param size the size of buffer, it will be aligned down to power of two
+ */
+void rt_ringbuffer_mp_init(struct rt_ringbuffer_mp *rb, rt_uint8_t *pool, rt_uint32_t size)
+{
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(((rt_ubase_t)pool & (RB_MP_HDR_SIZE - 1)) == 0);
+    RT_ASSERT(size >= RB_MP_HDR_SIZE * 2);
+
+    /* align down to power of two */
+    while (size & (size - 1))
+    {
+        size &= size - 1;
+    }
+
+    rb->buffer_ptr = pool;
+    rb->buffer_mask = size - 1;
+    rt_ringbuffer_mp_reset(rb);
+}
+RTM_EXPORT(rt_ringbuffer_mp_init);
+
+/**
+ * empty the multi-producer ringbuffer, it should not be used at the same time
+ */
+void rt_ringbuffer_mp_reset(struct rt_ringbuffer_mp *rb)
+{
+    RT_ASSERT(rb != RT_NULL);
+
+    memset(rb->buffer_ptr, 0, rb->buffer_mask + 1);
+    rb->write_index = 0;
+    rb->read_index = 0;
+}
+RTM_EXPORT(rt_ringbuffer_mp_reset);
+
+/**
+ * reserve the contiguous space for a record, it could be called in ISR.
+ *
+ * @param rb the ring buffer
+ * @param length the length of record
+ *
+ * @return the space to fill, RT_NULL if there is no enough space
+ */
+void *rt_ringbuffer_mp_reserve(struct rt_ringbuffer_mp *rb, rt_uint16_t length)
+{
+    rt_uint32_t write_index, offset, span, total;
+    rt_uint32_t size;
+
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(length <= RT_RINGBUFFER_MP_RECORD_MAX);
+
+    size = rb->buffer_mask + 1;
+    span = RB_MP_RECORD_SPAN(length);
+    if (span > size)
+        return RT_NULL;
+
+    while (1)
+    {
+        write_index = rb->write_index;
+        offset = write_index & rb->buffer_mask;
+
+        /* the record can't be wrapped around, skip the rest of buffer */
+        total = span;
+        if (offset + span > size)
+            total += size - offset;
+
+        if (write_index + total - rb->read_index > size)
+        {
+            /* try again if the write_index is changed, otherwise it's full */
+            if (write_index != rb->write_index)
+                continue;
+            return RT_NULL;
+        }
+
+        if (_ringbuffer_mp_cas(&rb->write_index, write_index, write_index + total))
+            break;
+    }
+
+    if (total != span)
+    {
+        /* the padding is committed at once */
+        *_ringbuffer_mp_header(rb, write_index) = RB_MP_HDR_COMMIT | RB_MP_HDR_PAD;
+        write_index += total - span;
+    }
+    *_ringbuffer_mp_header(rb, write_index) = length;
+
+    return &rb->buffer_ptr[(write_index & rb->buffer_mask) + RB_MP_HDR_SIZE];
+}
+RTM_EXPORT(rt_ringbuffer_mp_reserve);
+
+/**
+ * commit the reserved record, then it could be read by the consumer.
+ *
+ * @param rb the ring buffer
+ * @param ptr the space which is returned by rt_ringbuffer_mp_reserve
+ * @param length the length of data, it could be less than the reserved length
+ */
+void rt_ringbuffer_mp_commit(struct rt_ringbuffer_mp *rb, void *ptr, rt_uint16_t length)
+{
+    volatile rt_uint32_t *header;
+
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(ptr != RT_NULL);
+
+    header = (volatile rt_uint32_t *)((rt_uint8_t *)ptr - RB_MP_HDR_SIZE);
+    RT_ASSERT(length <= RB_MP_HDR_RESERVED(*header));
+
+    RB_MP_BARRIER();
+    *header = RB_MP_HDR_COMMIT | ((rt_uint32_t)length << 15) | RB_MP_HDR_RESERVED(*header);
+}
+RTM_EXPORT(rt_ringbuffer_mp_commit);
+
+/**
+ * peek the first committed record, the record is not removed.
+ *
+ * @param rb the ring buffer
+ * @param length the length of record
+ *
+ * @return the data of record, RT_NULL if there is no committed record
+ */
+void *rt_ringbuffer_mp_peek(struct rt_ringbuffer_mp *rb, rt_uint16_t *length)
+{
+    rt_uint32_t read_index, offset, header;
+
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(length != RT_NULL);
+
+    while (1)
+    {
+        read_index = rb->read_index;
+        if (read_index == rb->write_index)
+            return RT_NULL;
+
+        header = *_ringbuffer_mp_header(rb, read_index);
+        if (!(header & RB_MP_HDR_COMMIT))
+            return RT_NULL;
+        RB_MP_BARRIER();
+
+        offset = read_index & rb->buffer_mask;
+        if (header & RB_MP_HDR_PAD)
+        {
+            /* release the padding and go to the beginning of buffer */
+            memset(&rb->buffer_ptr[offset], 0, rb->buffer_mask + 1 - offset);
+            RB_MP_BARRIER();
+            rb->read_index = read_index + (rb->buffer_mask + 1 - offset);
+            continue;
+        }
+
+        *length = RB_MP_HDR_LENGTH(header);
+        return &rb->buffer_ptr[offset + RB_MP_HDR_SIZE];
+    }
+}
+RTM_EXPORT(rt_ringbuffer_mp_peek);
+
+/**
+ * release the record which is returned by rt_ringbuffer_mp_peek
+ */
+void rt_ringbuffer_mp_release(struct rt_ringbuffer_mp *rb, void *ptr)
+{
+    rt_uint8_t *header;
+    rt_uint32_t span;
+
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(ptr != RT_NULL);
+
+    header = (rt_uint8_t *)ptr - RB_MP_HDR_SIZE;
+    RT_ASSERT(header == (rt_uint8_t *)_ringbuffer_mp_header(rb, rb->read_index));
+
+    span = RB_MP_RECORD_SPAN(RB_MP_HDR_RESERVED(*(rt_uint32_t *)header));
+    memset(header, 0, span);
+    RB_MP_BARRIER();
+    rb->read_index += span;
+}
+RTM_EXPORT(rt_ringbuffer_mp_release);
+
+/**
+ * put a record into multi-producer ringbuffer, it could be called in ISR.
+ *
+ * @return the length of data, 0 if there is no enough space
+ */
+rt_size_t rt_ringbuffer_mp_put(struct rt_ringbuffer_mp *rb, const rt_uint8_t *ptr, rt_uint16_t length)
+{
+    void *record;
+
+    record = rt_ringbuffer_mp_reserve(rb, length);
+    if (record == RT_NULL)
+        return 0;
+
+    memcpy(record, ptr, length);
+    rt_ringbuffer_mp_commit(rb, record, length);
+
+    return length;
+}
+RTM_EXPORT(rt_ringbuffer_mp_put);
+
+/**
+ * get a record from multi-producer ringbuffer, the data which exceeds the
+ * length is discarded.
+ *
+ * @return the length of data, 0 if there is no committed record
+ */
+rt_size_t rt_ringbuffer_mp_get(struct rt_ringbuffer_mp *rb, rt_uint8_t *ptr, rt_uint16_t length)
+{
+    void *record;
+    rt_uint16_t size;
+
+    record = rt_ringbuffer_mp_peek(rb, &size);
+    if (record == RT_NULL)
+        return 0;
+
+    if (size < length)
+        length = size;
+    memcpy(ptr, record, length);
+    rt_ringbuffer_mp_release(rb, record);
+
+    return length;
+}
+RTM_EXPORT(rt_ringbuffer_mp_get);
+
+#ifdef RT_USING_HEAP
+
+struct rt_ringbuffer_mp *rt_ringbuffer_mp_create(rt_uint32_t size)
+{
+    struct rt_ringbuffer_mp *rb;
+    rt_uint8_t *pool;
+
+    RT_ASSERT(size >= RB_MP_HDR_SIZE * 2);
+
+    rb = (struct rt_ringbuffer_mp *)rt_malloc(sizeof(struct rt_ringbuffer_mp));
+    if (rb == RT_NULL)
+        goto exit;
+
+    while (size & (size - 1))
+    {
+        size &= size - 1;
+    }
+
+    pool = (rt_uint8_t *)rt_malloc(size);
+    if (pool == RT_NULL)
+    {
+        rt_free(rb);
+        rb = RT_NULL;
+        goto exit;
+    }
+    rt_ringbuffer_mp_init(rb, pool, size);
+
+exit:
+    return rb;
+}
+RTM_EXPORT(rt_ringbuffer_mp_create);
+
+void rt_ringbuffer_mp_destroy(struct rt_ringbuffer_mp *rb)
+{
+    RT_ASSERT(rb != RT_NULL);
+
+    rt_free(rb->buffer_ptr);
+    rt_free(rb);
+}
+RTM_EXPORT(rt_ringbuffer_mp_destroy);
+
+#endif
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * rbb_sim runs the ring block buffer on the host, and prints the time of
+ * each block and the time with interrupt disabled for 16, 64 and 256 blocks,
+ * in two workloads:
+ *
+ *   fifo   half of the blocks are used, a block is allocated and put, then
+ *          the oldest one is got and freed, as the async output of ulog.
+ *   burst  the blocks are allocated and put until it's full, then all of
+ *          them are got and freed one by one, or by 16 blocks with the batch
+ *          get and free.
+ *
+ * The time of each block is measured without counting the interrupt
+ * disabling, then the workload is run again to measure the time of each
+ * section with interrupt disabled, the average and the 99.9th percentile
+ * are printed. The longest one is the preemption of the host, it isn't
+ * printed. Every block is filled with its sequence, it's checked when the
+ * block is got.
+ *
+ * The ring block buffer is built into this program with the configuration
+ * in rtconfig.h. SIM_RBB_C selects the source of another version to compare,
+ * e.g. the one before the free list which is saved by git show, and
+ * SIM_RBB_NO_BATCH is for the version without the batch get and free:
+ *
+ *   gcc -O2 -std=gnu99 -I. -I../../include -I../../../../include rbb_sim.c -o rbb_sim
+ *   gcc -O2 -std=gnu99 -DSIM_RBB_C='"ringblk_buf_old.c"' -DSIM_RBB_NO_BATCH -I. -I../../include \
+ *       -I../../../../include rbb_sim.c -o rbb_sim_old
+ *
+ * usage: rbb_sim [rounds]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef SIM_RBB_C
+#define SIM_RBB_C           "../ringblk_buf.c"
+#endif
+#include SIM_RBB_C
+
+#define SIM_BLK_SIZE        48
+#define SIM_BATCH           16
+#define SIM_IRQ_SLOTS       10000   /* the histogram of 10ns slots */
+
+static int measure_irq;
+static rt_uint64_t irq_start, irq_total;
+static unsigned long irq_sections, irq_hist[SIM_IRQ_SLOTS];
+static rt_uint32_t alloc_seq, get_seq;
+static int failed;
+
+/* the stubs of kernel for the ring block buffer */
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void rt_free(void *ptr) { free(ptr); }
+
+void rt_assert_handler(const char *ex, const char *func, rt_size_t line)
+{
+    fprintf(stderr, "(%s) assertion failed at function:%s, line number:%d\n", ex, func, (int)line);
+    abort();
+}
+
+static rt_uint64_t sim_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (rt_uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    if (measure_irq)
+        irq_start = sim_now_ns();
+
+    return 0;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+    rt_uint64_t ns;
+
+    if (measure_irq)
+    {
+        ns = sim_now_ns() - irq_start;
+        irq_total += ns;
+        irq_sections++;
+        irq_hist[ns / 10 < SIM_IRQ_SLOTS ? ns / 10 : SIM_IRQ_SLOTS - 1]++;
+    }
+}
+
+static int sim_alloc_put(rt_rbb_t rbb)
+{
+    rt_rbb_blk_t block;
+
+    block = rt_rbb_blk_alloc(rbb, SIM_BLK_SIZE);
+    if (block == RT_NULL)
+        return 0;
+
+    *(rt_uint32_t *)block->buf = alloc_seq++;
+    rt_rbb_blk_put(block);
+
+    return 1;
+}
+
+static void sim_check(rt_rbb_blk_t block)
+{
+    if (*(rt_uint32_t *)block->buf != get_seq++)
+    {
+        if (!failed)
+            printf("block %u is got, %u is expected\n", *(rt_uint32_t *)block->buf, get_seq - 1);
+        failed = 1;
+    }
+}
+
+static int sim_get_free(rt_rbb_t rbb)
+{
+    rt_rbb_blk_t block;
+
+    block = rt_rbb_blk_get(rbb);
+    if (block == RT_NULL)
+        return 0;
+
+    sim_check(block);
+    rt_rbb_blk_free(rbb, block);
+
+    return 1;
+}
+
+#ifndef SIM_RBB_NO_BATCH
+static int sim_get_free_batch(rt_rbb_t rbb)
+{
+    rt_rbb_blk_t blocks[SIM_BATCH];
+    rt_size_t num, i;
+
+    num = rt_rbb_blk_get_batch(rbb, blocks, SIM_BATCH);
+    for (i = 0; i < num; i++)
+        sim_check(blocks[i]);
+    rt_rbb_blk_free_batch(rbb, blocks, num);
+
+    return (int)num;
+}
+#endif
+
+static void sim_fail(const char *msg)
+{
+    printf("FAIL, %s\n", msg);
+    exit(1);
+}
+
+/* returns the blocks of the workload */
+static unsigned long sim_workload(rt_rbb_t rbb, rt_size_t blk_num, int burst, int batch, int rounds)
+{
+    unsigned long blocks = 0;
+    rt_size_t i;
+    int round, got;
+
+    alloc_seq = get_seq = 0;
+    if (!burst)
+    {
+        for (i = 0; i < blk_num / 2; i++)
+        {
+            if (!sim_alloc_put(rbb))
+                sim_fail("no block to prefill");
+        }
+    }
+
+    for (round = 0; round < rounds; round++)
+    {
+        if (!burst)
+        {
+            if (!sim_alloc_put(rbb) || !sim_get_free(rbb))
+                sim_fail("no block in fifo");
+            blocks++;
+            continue;
+        }
+
+        while (sim_alloc_put(rbb))
+            blocks++;
+        do
+        {
+#ifndef SIM_RBB_NO_BATCH
+            got = batch ? sim_get_free_batch(rbb) : sim_get_free(rbb);
+#else
+            got = sim_get_free(rbb);
+#endif
+        } while (got);
+    }
+
+    /* drain the fifo */
+    while (sim_get_free(rbb));
+    if (alloc_seq != get_seq)
+        sim_fail("some blocks are lost");
+
+    return blocks;
+}
+
+/* returns the time of the given percentile of the sections */
+static unsigned long sim_irq_percentile(double percentile)
+{
+    unsigned long count = 0;
+    int slot;
+
+    for (slot = 0; slot < SIM_IRQ_SLOTS - 1; slot++)
+    {
+        count += irq_hist[slot];
+        if (count >= irq_sections * percentile)
+            break;
+    }
+
+    return slot * 10;
+}
+
+static void sim_run(const char *name, rt_size_t blk_num, int burst, int batch, int rounds)
+{
+    rt_size_t buf_size = blk_num * SIM_BLK_SIZE;
+    rt_rbb_t rbb;
+    rt_uint64_t start, ns;
+    unsigned long blocks;
+
+    rbb = rt_rbb_create(buf_size, blk_num);
+    if (rbb == RT_NULL)
+        sim_fail("no memory");
+
+    measure_irq = 0;
+    start = sim_now_ns();
+    blocks = sim_workload(rbb, blk_num, burst, batch, rounds);
+    ns = sim_now_ns() - start;
+
+    measure_irq = 1;
+    irq_total = 0;
+    irq_sections = 0;
+    memset(irq_hist, 0, sizeof(irq_hist));
+    sim_workload(rbb, blk_num, burst, batch, rounds);
+    measure_irq = 0;
+
+    printf("%-12s %6u %10.1f %10.1f %10lu\n", name, (unsigned)blk_num, (double)ns / blocks,
+           (double)irq_total / irq_sections, sim_irq_percentile(0.999));
+    rt_rbb_destroy(rbb);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 1000000;
+    rt_size_t blk_num;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+
+    printf("%s, %d bytes blocks\n\n", SIM_RBB_C, SIM_BLK_SIZE);
+    printf("%-12s %6s %10s %10s %10s\n", "workload", "blocks", "ns/block", "irq avg", "irq 99.9%");
+    for (blk_num = 16; blk_num <= 256; blk_num *= 4)
+        sim_run("fifo", blk_num, 0, 0, rounds);
+    for (blk_num = 16; blk_num <= 256; blk_num *= 4)
+        sim_run("burst", blk_num, 1, 0, rounds / blk_num);
+#ifndef SIM_RBB_NO_BATCH
+    for (blk_num = 16; blk_num <= 256; blk_num *= 4)
+        sim_run("burst batch", blk_num, 1, 1, rounds / blk_num);
+#endif
+
+    printf("\n%s\n", failed ? "FAIL" : "PASS");
+
+    return failed;
+}
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * ringbuffer_sim runs the ring buffers on the host, 1, 2, 4 and 8 producer
+ * threads put the records of 16 bytes, and one consumer thread gets them.
+ * It prints the throughput of the multi-producer ringbuffer and of the byte
+ * ringbuffer which is put and got with interrupt disabled, as the drivers
+ * share it between producers.
+ *
+ * The interrupt disabling is a global mutex. The exclusive load and store
+ * are emulated by a CAS of the address which is loaded. When it's built with
+ * SIM_NO_EXCLUSIVE, the multi-producer ringbuffer updates the write index
+ * with interrupt disabled. A producer yields when the buffer is full, the
+ * consumer yields when it's empty.
+ *
+ * The consumer checks that the records of every producer are got in order
+ * and none is lost.
+ *
+ * The ring buffers are built into this program with the configuration in
+ * rtconfig.h:
+ *
+ *   gcc -O2 -std=gnu99 -I. -I../../include -I../../../../include ringbuffer_sim.c -o ringbuffer_sim -lpthread
+ *
+ * usage: ringbuffer_sim [records] [buffer size]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "../ringbuffer.c"
+
+#define SIM_PRODUCERS_MAX   8
+
+struct sim_record
+{
+    rt_uint32_t producer;
+    rt_uint32_t seq;
+    rt_uint32_t data[2];
+};
+
+struct sim_bench
+{
+    int mp;
+    int producers;
+    rt_uint32_t records;            /* the records of each producer */
+    struct rt_ringbuffer rb;
+    struct rt_ringbuffer_mp rb_mp;
+
+    unsigned long full[SIM_PRODUCERS_MAX];
+    unsigned long empty;
+    unsigned long bad;
+};
+
+static pthread_mutex_t irq_lock;
+static __thread volatile rt_uint32_t *exclusive_addr;
+static __thread rt_uint32_t exclusive_value;
+static int failed;
+
+/* the stubs of kernel for the ring buffers */
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void rt_free(void *ptr) { free(ptr); }
+
+void rt_assert_handler(const char *ex, const char *func, rt_size_t line)
+{
+    fprintf(stderr, "(%s) assertion failed at function:%s, line number:%d\n", ex, func, (int)line);
+    abort();
+}
+
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    pthread_mutex_lock(&irq_lock);
+
+    return 0;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+    pthread_mutex_unlock(&irq_lock);
+}
+
+rt_uint32_t rt_hw_exclusive_load32(volatile rt_uint32_t *addr)
+{
+    exclusive_addr = addr;
+    exclusive_value = __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+
+    return exclusive_value;
+}
+
+/* returns 0 if it's stored, the same as STREX */
+rt_uint32_t rt_hw_exclusive_store32(volatile rt_uint32_t *addr, rt_uint32_t value)
+{
+    rt_uint32_t expected = exclusive_value;
+    int stored;
+
+    stored = exclusive_addr == addr
+             && __atomic_compare_exchange_n(addr, &expected, value, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    exclusive_addr = RT_NULL;
+
+    return stored ? 0 : 1;
+}
+
+void rt_hw_exclusive_clear(void)
+{
+    exclusive_addr = RT_NULL;
+}
+
+static struct sim_bench bench;
+static int producer_index[SIM_PRODUCERS_MAX];
+
+static int sim_put(struct sim_record *record)
+{
+    rt_base_t level;
+    int put = 0;
+
+    if (bench.mp)
+        return rt_ringbuffer_mp_put(&bench.rb_mp, (rt_uint8_t *)record, sizeof(*record)) == sizeof(*record);
+
+    level = rt_hw_interrupt_disable();
+    if (rt_ringbuffer_space_len(&bench.rb) >= sizeof(*record))
+        put = rt_ringbuffer_put(&bench.rb, (rt_uint8_t *)record, sizeof(*record)) == sizeof(*record);
+    rt_hw_interrupt_enable(level);
+
+    return put;
+}
+
+static int sim_get(struct sim_record *record)
+{
+    rt_base_t level;
+    int got = 0;
+
+    if (bench.mp)
+        return rt_ringbuffer_mp_get(&bench.rb_mp, (rt_uint8_t *)record, sizeof(*record)) == sizeof(*record);
+
+    level = rt_hw_interrupt_disable();
+    if (rt_ringbuffer_data_len(&bench.rb) >= sizeof(*record))
+        got = rt_ringbuffer_get(&bench.rb, (rt_uint8_t *)record, sizeof(*record)) == sizeof(*record);
+    rt_hw_interrupt_enable(level);
+
+    return got;
+}
+
+static void *sim_producer(void *param)
+{
+    int index = *(int *)param;
+    struct sim_record record = { .producer = index };
+
+    for (record.seq = 0; record.seq < bench.records; record.seq++)
+    {
+        record.data[0] = record.seq * 31;
+        record.data[1] = ~record.seq;
+        while (!sim_put(&record))
+        {
+            bench.full[index]++;
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void *sim_consumer(void *param)
+{
+    rt_uint32_t next[SIM_PRODUCERS_MAX] = { 0 };
+    unsigned long total = (unsigned long)bench.records * bench.producers, got;
+    struct sim_record record;
+
+    for (got = 0; got < total; got++)
+    {
+        while (!sim_get(&record))
+        {
+            bench.empty++;
+            sched_yield();
+        }
+
+        if (record.producer >= (rt_uint32_t)bench.producers || record.seq != next[record.producer]
+                || record.data[0] != record.seq * 31 || record.data[1] != ~record.seq)
+        {
+            if (bench.bad++ == 0)
+                printf("bad record: producer %u seq %u\n", record.producer, record.seq);
+            if (record.producer < (rt_uint32_t)bench.producers)
+                next[record.producer] = record.seq + 1;
+            continue;
+        }
+        next[record.producer]++;
+    }
+
+    return NULL;
+}
+
+static double sim_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* returns the records got per second */
+static double sim_run(int mp, int producers, rt_uint32_t records, rt_uint8_t *pool, rt_uint32_t size)
+{
+    pthread_t tids[SIM_PRODUCERS_MAX], consumer;
+    double start, seconds;
+    int index;
+
+    memset(&bench, 0, sizeof(bench));
+    bench.mp = mp;
+    bench.producers = producers;
+    bench.records = records / producers;
+    if (mp)
+        rt_ringbuffer_mp_init(&bench.rb_mp, pool, size);
+    else
+        rt_ringbuffer_init(&bench.rb, pool, size);
+
+    start = sim_now();
+    pthread_create(&consumer, NULL, sim_consumer, NULL);
+    for (index = 0; index < producers; index++)
+    {
+        producer_index[index] = index;
+        pthread_create(&tids[index], NULL, sim_producer, &producer_index[index]);
+    }
+    for (index = 0; index < producers; index++)
+        pthread_join(tids[index], NULL);
+    pthread_join(consumer, NULL);
+    seconds = sim_now() - start;
+
+    if (bench.bad)
+    {
+        printf("%s, %d producers: FAIL, %lu records are wrong\n", mp ? "mp" : "locked", producers, bench.bad);
+        failed = 1;
+    }
+
+    return (double)bench.records * producers / seconds;
+}
+
+int main(int argc, char *argv[])
+{
+    rt_uint32_t records = 2 * 1024 * 1024, size = 4096;
+    unsigned long full;
+    cpu_set_t cpus;
+    rt_uint8_t *pool;
+    double locked, mp;
+    int producers, index;
+
+    if (argc > 1)
+        records = strtoul(argv[1], NULL, 0);
+    if (argc > 2)
+        size = strtoul(argv[2], NULL, 0);
+
+    pthread_mutex_init(&irq_lock, NULL);
+    pool = aligned_alloc(RT_ALIGN_SIZE, size);
+
+    sched_getaffinity(0, sizeof(cpus), &cpus);
+#ifdef RT_USING_CPU_EXCLUSIVE
+    printf("%u records of %u bytes, %u bytes buffer, exclusive CAS, %d CPU\n\n", (unsigned)records,
+           (unsigned)sizeof(struct sim_record), (unsigned)size, CPU_COUNT(&cpus));
+#else
+    printf("%u records of %u bytes, %u bytes buffer, CAS with interrupt disabled, %d CPU\n\n", (unsigned)records,
+           (unsigned)sizeof(struct sim_record), (unsigned)size, CPU_COUNT(&cpus));
+#endif
+    printf("%9s %12s %12s %8s %12s\n", "producers", "locked/s", "mp/s", "mp/lock", "mp full");
+    for (producers = 1; producers <= SIM_PRODUCERS_MAX; producers *= 2)
+    {
+        locked = sim_run(0, producers, records, pool, size);
+        mp = sim_run(1, producers, records, pool, size);
+        for (full = 0, index = 0; index < producers; index++)
+            full += bench.full[index];
+        printf("%9d %12.0f %12.0f %8.2f %12lu\n", producers, locked, mp, mp / locked, full);
+    }
+
+    free(pool);
+    printf("\n%s\n", failed ? "FAIL" : "PASS");
+
+    return failed;
+}
@@ -6,6 +6,8 @@
  * Change Logs:
  * Date           Author       Notes
  * 2017-02-27     bernard      fix the re-work issue.
+ * 2020-11-16     luhuadong    add worker pool with work stealing, work priority,
+ *                             batched timer for delayed work and statistics
  */
 
 #include <rthw.h>
@@ -16,6 +18,9 @@
 
 static void _delayed_work_timeout_handler(void *parameter);
 
+/* all of workqueues, for statistics */
+static rt_list_t _workqueue_list = RT_LIST_OBJECT_INIT(_workqueue_list);
+
 rt_inline rt_err_t _workqueue_work_completion(struct rt_workqueue *queue)
 {
     rt_err_t result;
@@ -47,38 +52,145 @@ rt_inline rt_err_t _workqueue_work_completion(struct rt_workqueue *queue)
     return result;
 }
 
+/* insert the work by priority, the works in same priority are FIFO */
+rt_inline void _workqueue_insert_work(rt_list_t *work_list, struct rt_work *work)
+{
+    rt_list_t *node;
+
+    for (node = work_list->prev; node != work_list; node = node->prev)
+    {
+        if (rt_list_entry(node, struct rt_work, list)->priority <= work->priority)
+        {
+            break;
+        }
+    }
+    rt_list_insert_after(node, &(work->list));
+}
+
+/* whether the work is running on one of workers, the interrupt must be disabled */
+static rt_bool_t _workqueue_work_running(struct rt_workqueue *queue, struct rt_work *work)
+{
+    int index;
+
+    for (index = 0; index < queue->worker_num; index++)
+    {
+        if (queue->workers[index].work_current == work)
+        {
+            return RT_TRUE;
+        }
+    }
+
+    return RT_FALSE;
+}
+
+/* select a worker for the new work, the interrupt must be disabled */
+static struct rt_workqueue_worker *_workqueue_select_worker(struct rt_workqueue *queue)
+{
+    struct rt_workqueue_worker *worker;
+    int index;
+
+    /* the idle worker first */
+    for (index = 0; index < queue->worker_num; index++)
+    {
+        worker = &(queue->workers[index]);
+        if (worker->work_current == RT_NULL && rt_list_isempty(&(worker->work_list)))
+        {
+            return worker;
+        }
+    }
+
+    /* all of workers are busy, the first done one will steal it if it's not its own */
+    worker = &(queue->workers[queue->worker_next]);
+    queue->worker_next = (queue->worker_next + 1) % queue->worker_num;
+
+    return worker;
+}
+
+/* fetch a work for the worker, steal it from the others when the own list is empty */
+static struct rt_work *_workqueue_fetch_work(struct rt_workqueue *queue, struct rt_workqueue_worker *worker)
+{
+    struct rt_work *work = RT_NULL, *head;
+    int index;
+
+    if (!rt_list_isempty(&(worker->work_list)))
+    {
+        return rt_list_entry(worker->work_list.next, struct rt_work, list);
+    }
+
+    /* take the highest priority work from the others */
+    for (index = 0; index < queue->worker_num; index++)
+    {
+        if (rt_list_isempty(&(queue->workers[index].work_list)))
+            continue;
+
+        head = rt_list_entry(queue->workers[index].work_list.next, struct rt_work, list);
+        if (work == RT_NULL || head->priority < work->priority)
+        {
+            work = head;
+        }
+    }
+
+    if (work != RT_NULL)
+    {
+        queue->stolen++;
+    }
+
+    return work;
+}
+
 static void _workqueue_thread_entry(void *parameter)
 {
     rt_base_t level;
+    rt_tick_t tick;
     struct rt_work *work;
     struct rt_workqueue *queue;
+    struct rt_workqueue_worker *worker;
 
-    queue = (struct rt_workqueue *) parameter;
-    RT_ASSERT(queue != RT_NULL);
+    worker = (struct rt_workqueue_worker *) parameter;
+    RT_ASSERT(worker != RT_NULL);
+    queue = (struct rt_workqueue *) worker->work_thread->user_data;
 
     while (1)
     {
-        if (rt_list_isempty(&(queue->work_list)))
+        level = rt_hw_interrupt_disable();
+        work = _workqueue_fetch_work(queue, worker);
+        if (work == RT_NULL)
         {
-            /* no software timer exist, suspend self. */
+            /* no work exist, suspend self. */
             rt_thread_suspend(rt_thread_self());
+            rt_hw_interrupt_enable(level);
             rt_schedule();
+            continue;
         }
 
         /* we have work to do with. */
-        level = rt_hw_interrupt_disable();
-        work = rt_list_entry(queue->work_list.next, struct rt_work, list);
         rt_list_remove(&(work->list));
-        queue->work_current = work;
+        worker->work_current = work;
         work->flags &= ~RT_WORK_STATE_PENDING;
         work->workqueue = RT_NULL;
+
+        tick = rt_tick_get() - work->submit_tick;
+        queue->depth--;
+        queue->latency_total += tick;
+        if (tick > queue->latency_max)
+        {
+            queue->latency_max = tick;
+        }
         rt_hw_interrupt_enable(level);
 
         /* do work */
+        tick = rt_tick_get();
         work->work_func(work, work->work_data);
+        tick = rt_tick_get() - tick;
+
         level = rt_hw_interrupt_disable();
         /* clean current work */
-        queue->work_current = RT_NULL;
+        worker->work_current = RT_NULL;
+        queue->completed++;
+        if (tick > queue->exec_max)
+        {
+            queue->exec_max = tick;
+        }
         rt_hw_interrupt_enable(level);
 
         /* ack work completion */
@@ -86,102 +198,166 @@ static void _workqueue_thread_entry(void *parameter)
     }
 }
 
-static rt_err_t _workqueue_submit_work(struct rt_workqueue *queue, struct rt_work *work)
+/* insert the work to a worker, the interrupt must be disabled */
+static rt_err_t _workqueue_queue_work(struct rt_workqueue *queue, struct rt_work *work,
+                                      struct rt_workqueue_worker **idle_worker)
 {
-    rt_base_t level;
+    struct rt_workqueue_worker *worker;
+
+    *idle_worker = RT_NULL;
 
-    level = rt_hw_interrupt_disable();
     if (work->flags & RT_WORK_STATE_PENDING)
     {
-        rt_hw_interrupt_enable(level);
         return -RT_EBUSY;
     }
 
-    if (queue->work_current == work)
+    if (_workqueue_work_running(queue, work))
     {
-        rt_hw_interrupt_enable(level);
         return -RT_EBUSY;
     }
 
     /* NOTE: the work MUST be initialized firstly */
     rt_list_remove(&(work->list));
 
-    rt_list_insert_after(queue->work_list.prev, &(work->list));
+    worker = _workqueue_select_worker(queue);
+    _workqueue_insert_work(&(worker->work_list), work);
     work->flags |= RT_WORK_STATE_PENDING;
+    work->workqueue = queue;
+    work->submit_tick = rt_tick_get();
 
-    /* whether the workqueue is doing work */
-    if (queue->work_current == RT_NULL)
+    queue->submitted++;
+    queue->depth++;
+    if (queue->depth > queue->depth_max)
     {
-        rt_hw_interrupt_enable(level);
-        /* resume work thread */
-        rt_thread_resume(queue->work_thread);
-        rt_schedule();
+        queue->depth_max = queue->depth;
     }
-    else
+
+    /* whether the worker is doing work */
+    if (worker->work_current == RT_NULL)
     {
-        rt_hw_interrupt_enable(level);
+        *idle_worker = worker;
     }
 
     return RT_EOK;
 }
 
+static rt_err_t _workqueue_submit_work(struct rt_workqueue *queue, struct rt_work *work)
+{
+    rt_base_t level;
+    rt_err_t ret;
+    struct rt_workqueue_worker *worker;
+
+    level = rt_hw_interrupt_disable();
+    ret = _workqueue_queue_work(queue, work, &worker);
+    rt_hw_interrupt_enable(level);
+
+    if (worker != RT_NULL)
+    {
+        /* resume work thread */
+        rt_thread_resume(worker->work_thread);
+        rt_schedule();
+    }
+
+    return ret;
+}
+
 static rt_err_t _workqueue_cancel_work(struct rt_workqueue *queue, struct rt_work *work)
 {
     rt_base_t level;
 
     level = rt_hw_interrupt_disable();
-    if (queue->work_current == work)
+    if (_workqueue_work_running(queue, work))
     {
         rt_hw_interrupt_enable(level);
         return -RT_EBUSY;
     }
-    rt_list_remove(&(work->list));
+    if (work->flags & RT_WORK_STATE_PENDING)
+    {
+        rt_list_remove(&(work->list));
+        queue->depth--;
+    }
     work->flags &= ~RT_WORK_STATE_PENDING;
     rt_hw_interrupt_enable(level);
 
     return RT_EOK;
 }
 
-static rt_err_t _workqueue_cancel_delayed_work(struct rt_work *work)
+/* restart the delayed timer by the earliest delayed work, the interrupt must be disabled */
+static void _workqueue_delayed_timer_update(struct rt_workqueue *queue)
 {
-    rt_base_t level;
-    int ret = RT_EOK;
+    struct rt_work *work;
+    rt_tick_t ticks;
 
-    if (!work->workqueue)
+    rt_timer_stop(&(queue->delayed_timer));
+    if (rt_list_isempty(&(queue->delayed_list)))
     {
-        ret = -EINVAL;
-        goto __exit;
+        return;
     }
 
-    if (work->flags & RT_WORK_STATE_PENDING)
+    work = rt_list_entry(queue->delayed_list.next, struct rt_work, list);
+    ticks = work->timeout_tick - rt_tick_get();
+    if (ticks == 0 || ticks >= RT_TICK_MAX / 2)
     {
-        /* Remove from the queue if already submitted */
-        ret = _workqueue_cancel_work(work->workqueue, work);
-        if (ret)
+        /* it's timeout already */
+        ticks = 1;
+    }
+    rt_timer_control(&(queue->delayed_timer), RT_TIMER_CTRL_SET_TIME, &ticks);
+    rt_timer_start(&(queue->delayed_timer));
+}
+
+/* insert the work to the delayed list by timeout tick, the interrupt must be disabled */
+static void _workqueue_delayed_insert(struct rt_workqueue *queue, struct rt_work *work)
+{
+    rt_list_t *node;
+
+    for (node = queue->delayed_list.prev; node != &(queue->delayed_list); node = node->prev)
+    {
+        if (work->timeout_tick - rt_list_entry(node, struct rt_work, list)->timeout_tick < RT_TICK_MAX / 2)
         {
-            goto __exit;
+            break;
         }
     }
-    else
+    rt_list_remove(&(work->list));
+    rt_list_insert_after(node, &(work->list));
+}
+
+static rt_err_t _workqueue_cancel_delayed_work(struct rt_work *work)
+{
+    rt_base_t level;
+    struct rt_workqueue *queue;
+
+    /* check and detach in one section, the delayed timer may move it to the work list */
+    level = rt_hw_interrupt_disable();
+    queue = work->workqueue;
+    if (!queue)
+    {
+        rt_hw_interrupt_enable(level);
+        return -EINVAL;
+    }
+
+    if (work->flags & RT_WORK_STATE_PENDING)
     {
-        if (work->flags & RT_WORK_STATE_SUBMITTING)
+        if (_workqueue_work_running(queue, work))
         {
-            level = rt_hw_interrupt_disable();
-            rt_timer_stop(&(work->timer));
-            rt_timer_detach(&(work->timer));
-            work->flags &= ~RT_WORK_STATE_SUBMITTING;
             rt_hw_interrupt_enable(level);
+            return -RT_EBUSY;
         }
+        /* Remove from the queue if already submitted */
+        rt_list_remove(&(work->list));
+        queue->depth--;
+    }
+    else if (work->flags & RT_WORK_STATE_SUBMITTING)
+    {
+        /* the delayed timer will be updated when it's timeout */
+        rt_list_remove(&(work->list));
     }
 
-    level = rt_hw_interrupt_disable();
     /* Detach from workqueue */
     work->workqueue = RT_NULL;
-    work->flags &= ~(RT_WORK_STATE_PENDING);
+    work->flags &= ~(RT_WORK_STATE_PENDING | RT_WORK_STATE_SUBMITTING);
     rt_hw_interrupt_enable(level);
 
-__exit:
-    return ret;
+    return RT_EOK;
 }
 
 static rt_err_t _workqueue_submit_delayed_work(struct rt_workqueue *queue,
@@ -220,12 +396,17 @@ static rt_err_t _workqueue_submit_delayed_work(struct rt_workqueue *queue,
     else
     {
         level = rt_hw_interrupt_disable();
-        /* Add timeout */
+        /* Add to the delayed list by timeout tick */
         work->flags |= RT_WORK_STATE_SUBMITTING;
-        rt_timer_init(&(work->timer), "work", _delayed_work_timeout_handler, work, ticks,
-                      RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_SOFT_TIMER);
+        work->timeout_tick = rt_tick_get() + ticks;
+        _workqueue_delayed_insert(queue, work);
+
+        /* it's the earliest one */
+        if (queue->delayed_list.next == &(work->list))
+        {
+            _workqueue_delayed_timer_update(queue);
+        }
         rt_hw_interrupt_enable(level);
-        rt_timer_start(&(work->timer));
     }
 
 __exit:
@@ -234,50 +415,170 @@ __exit:
 
 static void _delayed_work_timeout_handler(void *parameter)
 {
+    struct rt_workqueue *queue;
     struct rt_work *delayed_work;
+    struct rt_workqueue_worker *worker;
+    rt_bool_t resume = RT_FALSE;
     rt_base_t level;
+    rt_tick_t tick;
+    int index;
+
+    queue = (struct rt_workqueue *)parameter;
 
-    delayed_work = (struct rt_work *)parameter;
+    /*
+     * submit all of timeout works in one interrupt lock, so a work is always
+     * SUBMITTING or PENDING for the canceller until it's running
+     */
     level = rt_hw_interrupt_disable();
-    rt_timer_stop(&(delayed_work->timer));
-    rt_timer_detach(&(delayed_work->timer));
-    delayed_work->flags &= ~RT_WORK_STATE_SUBMITTING;
-    delayed_work->type &= ~RT_WORK_TYPE_DELAYED;
+    tick = rt_tick_get();
+    while (!rt_list_isempty(&(queue->delayed_list)))
+    {
+        delayed_work = rt_list_entry(queue->delayed_list.next, struct rt_work, list);
+        if (tick - delayed_work->timeout_tick >= RT_TICK_MAX / 2)
+        {
+            break;
+        }
+        if (_workqueue_work_running(queue, delayed_work))
+        {
+            /* it's submitted again while running, delay it until the running one is done */
+            delayed_work->timeout_tick = tick + 1;
+            _workqueue_delayed_insert(queue, delayed_work);
+            continue;
+        }
+        rt_list_remove(&(delayed_work->list));
+        delayed_work->flags &= ~RT_WORK_STATE_SUBMITTING;
+        delayed_work->type &= ~RT_WORK_TYPE_DELAYED;
+        if (_workqueue_queue_work(queue, delayed_work, &worker) == RT_EOK && worker != RT_NULL)
+        {
+            resume = RT_TRUE;
+        }
+    }
+    _workqueue_delayed_timer_update(queue);
+
+    if (resume)
+    {
+        /* wake up the idle workers which get the works */
+        for (index = 0; index < queue->worker_num; index++)
+        {
+            worker = &(queue->workers[index]);
+            if (worker->work_current == RT_NULL && !rt_list_isempty(&(worker->work_list)))
+            {
+                rt_thread_resume(worker->work_thread);
+            }
+        }
+    }
     rt_hw_interrupt_enable(level);
-    _workqueue_submit_work(delayed_work->workqueue, delayed_work);
+
+    if (resume)
+    {
+        rt_schedule();
+    }
 }
 
-struct rt_workqueue *rt_workqueue_create(const char *name, rt_uint16_t stack_size, rt_uint8_t priority)
+/**
+ * This function will create a workqueue with some worker threads, the works
+ * are done by the worker threads at the same time.
+ *
+ * @param name the name of workqueue
+ * @param stack_size the stack size of every worker thread
+ * @param priority the priority of worker threads
+ * @param worker_num the number of worker threads
+ *
+ * @return the created workqueue, RT_NULL on error
+ */
+struct rt_workqueue *rt_workqueue_create_pool(const char *name, rt_uint16_t stack_size, rt_uint8_t priority,
+                                              rt_uint8_t worker_num)
 {
     struct rt_workqueue *queue = RT_NULL;
+    struct rt_workqueue_worker *worker;
+    char thread_name[RT_NAME_MAX];
+    rt_base_t level;
+    int index;
+
+    RT_ASSERT(worker_num > 0);
+
+    queue = (struct rt_workqueue *)RT_KERNEL_MALLOC(sizeof(struct rt_workqueue) +
+            sizeof(struct rt_workqueue_worker) * worker_num);
+    if (queue == RT_NULL)
+    {
+        return RT_NULL;
+    }
+
+    rt_memset(queue, 0, sizeof(struct rt_workqueue));
+    rt_strncpy(queue->name, name, RT_NAME_MAX);
+    queue->workers = (struct rt_workqueue_worker *)(queue + 1);
+    queue->worker_num = worker_num;
+    rt_list_init(&(queue->delayed_list));
+    rt_timer_init(&(queue->delayed_timer), name, _delayed_work_timeout_handler, queue, 1,
+                  RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_SOFT_TIMER);
+    rt_sem_init(&(queue->sem), "wqueue", 0, RT_IPC_FLAG_FIFO);
 
-    queue = (struct rt_workqueue *)RT_KERNEL_MALLOC(sizeof(struct rt_workqueue));
-    if (queue != RT_NULL)
+    for (index = 0; index < worker_num; index++)
     {
+        worker = &(queue->workers[index]);
+
         /* initialize work list */
-        rt_list_init(&(queue->work_list));
-        queue->work_current = RT_NULL;
-        rt_sem_init(&(queue->sem), "wqueue", 0, RT_IPC_FLAG_FIFO);
+        rt_list_init(&(worker->work_list));
+        worker->work_current = RT_NULL;
 
         /* create the work thread */
-        queue->work_thread = rt_thread_create(name, _workqueue_thread_entry, queue, stack_size, priority, 10);
-        if (queue->work_thread == RT_NULL)
+        if (worker_num == 1)
+        {
+            rt_strncpy(thread_name, name, RT_NAME_MAX);
+        }
+        else
+        {
+            rt_snprintf(thread_name, RT_NAME_MAX, "%.*s%d", RT_NAME_MAX - 3, name, index);
+        }
+        worker->work_thread = rt_thread_create(thread_name, _workqueue_thread_entry, worker, stack_size, priority, 10);
+        if (worker->work_thread == RT_NULL)
         {
+            while (index--)
+            {
+                rt_thread_delete(queue->workers[index].work_thread);
+            }
+            rt_timer_detach(&(queue->delayed_timer));
+            rt_sem_detach(&(queue->sem));
             RT_KERNEL_FREE(queue);
             return RT_NULL;
         }
+        worker->work_thread->user_data = (rt_ubase_t)queue;
+    }
 
-        rt_thread_startup(queue->work_thread);
+    level = rt_hw_interrupt_disable();
+    rt_list_insert_before(&_workqueue_list, &(queue->list));
+    rt_hw_interrupt_enable(level);
+
+    for (index = 0; index < worker_num; index++)
+    {
+        rt_thread_startup(queue->workers[index].work_thread);
     }
 
     return queue;
 }
 
+struct rt_workqueue *rt_workqueue_create(const char *name, rt_uint16_t stack_size, rt_uint8_t priority)
+{
+    return rt_workqueue_create_pool(name, stack_size, priority, 1);
+}
+
 rt_err_t rt_workqueue_destroy(struct rt_workqueue *queue)
 {
+    rt_base_t level;
+    int index;
+
     RT_ASSERT(queue != RT_NULL);
 
-    rt_thread_delete(queue->work_thread);
+    level = rt_hw_interrupt_disable();
+    rt_list_remove(&(queue->list));
+    rt_hw_interrupt_enable(level);
+
+    rt_timer_detach(&(queue->delayed_timer));
+    for (index = 0; index < queue->worker_num; index++)
+    {
+        rt_thread_delete(queue->workers[index].work_thread);
+    }
+    rt_sem_detach(&(queue->sem));
     RT_KERNEL_FREE(queue);
 
     return RT_EOK;
@@ -314,25 +615,42 @@ rt_err_t rt_workqueue_submit_work(struct rt_workqueue *queue, struct rt_work *wo
 rt_err_t rt_workqueue_critical_work(struct rt_workqueue *queue, struct rt_work *work)
 {
     rt_base_t level;
+    struct rt_workqueue_worker *worker;
+
     RT_ASSERT(queue != RT_NULL);
     RT_ASSERT(work != RT_NULL);
 
     level = rt_hw_interrupt_disable();
-    if (queue->work_current == work)
+    if (_workqueue_work_running(queue, work))
     {
         rt_hw_interrupt_enable(level);
         return -RT_EBUSY;
     }
 
+    if (!(work->flags & RT_WORK_STATE_PENDING))
+    {
+        queue->submitted++;
+        queue->depth++;
+        if (queue->depth > queue->depth_max)
+        {
+            queue->depth_max = queue->depth;
+        }
+    }
+
     /* NOTE: the work MUST be initialized firstly */
     rt_list_remove(&(work->list));
 
-    rt_list_insert_after(queue->work_list.prev, &(work->list));
-    if (queue->work_current == RT_NULL)
+    /* put it on the head of list */
+    worker = _workqueue_select_worker(queue);
+    rt_list_insert_after(&(worker->work_list), &(work->list));
+    work->flags |= RT_WORK_STATE_PENDING;
+    work->workqueue = queue;
+    work->submit_tick = rt_tick_get();
+    if (worker->work_current == RT_NULL)
     {
         rt_hw_interrupt_enable(level);
         /* resume work thread */
-        rt_thread_resume(queue->work_thread);
+        rt_thread_resume(worker->work_thread);
         rt_schedule();
     }
     else rt_hw_interrupt_enable(level);
@@ -363,16 +681,24 @@ rt_err_t rt_workqueue_cancel_work_sync(struct rt_workqueue *queue, struct rt_wor
     RT_ASSERT(work != RT_NULL);
 
     level = rt_hw_interrupt_disable();
-    if (queue->work_current == work) /* it's current work in the queue */
+    /* it's current work in the queue, wait for work completion */
+    while (_workqueue_work_running(queue, work))
     {
-        /* wait for work completion */
+        rt_hw_interrupt_enable(level);
         rt_sem_take(&(queue->sem), RT_WAITING_FOREVER);
+        level = rt_hw_interrupt_disable();
     }
-    else
+    if (work->flags & RT_WORK_STATE_PENDING)
     {
         rt_list_remove(&(work->list));
+        queue->depth--;
     }
-    work->flags &= ~RT_WORK_STATE_PENDING;
+    if (work->flags & RT_WORK_STATE_SUBMITTING)
+    {
+        /* remove it from the delayed list, the delayed timer will be updated when it's timeout */
+        rt_list_remove(&(work->list));
+    }
+    work->flags &= ~(RT_WORK_STATE_PENDING | RT_WORK_STATE_SUBMITTING);
     rt_hw_interrupt_enable(level);
 
     return RT_EOK;
@@ -381,15 +707,25 @@ rt_err_t rt_workqueue_cancel_work_sync(struct rt_workqueue *queue, struct rt_wor
 rt_err_t rt_workqueue_cancel_all_work(struct rt_workqueue *queue)
 {
     struct rt_list_node *node, *next;
+    rt_base_t level;
+    int index;
+
     RT_ASSERT(queue != RT_NULL);
 
-    rt_enter_critical();
-    for (node = queue->work_list.next; node != &(queue->work_list); node = next)
+    level = rt_hw_interrupt_disable();
+    for (index = 0; index < queue->worker_num; index++)
     {
-        next = node->next;
-        rt_list_remove(node);
+        rt_list_t *work_list = &(queue->workers[index].work_list);
+
+        for (node = work_list->next; node != work_list; node = next)
+        {
+            next = node->next;
+            rt_list_remove(node);
+            rt_list_entry(node, struct rt_work, list)->flags &= ~RT_WORK_STATE_PENDING;
+        }
     }
-    rt_exit_critical();
+    queue->depth = 0;
+    rt_hw_interrupt_enable(level);
 
     return RT_EOK;
 }
@@ -401,6 +737,10 @@ void rt_delayed_work_init(struct rt_delayed_work *work, void (*work_func)(struct
 }
 
 #ifdef RT_USING_SYSTEM_WORKQUEUE
+#ifndef RT_SYSTEM_WORKQUEUE_WORKERS
+#define RT_SYSTEM_WORKQUEUE_WORKERS     1
+#endif
+
 static struct rt_workqueue *sys_workq;
 
 rt_err_t rt_work_submit(struct rt_work *work, rt_tick_t time)
@@ -418,12 +758,59 @@ int rt_work_sys_workqueue_init(void)
     if (sys_workq != RT_NULL)
         return 0;
 
-    sys_workq = rt_workqueue_create("sys_work", RT_SYSTEM_WORKQUEUE_STACKSIZE,
-                                    RT_SYSTEM_WORKQUEUE_PRIORITY);
+    sys_workq = rt_workqueue_create_pool("sys_work", RT_SYSTEM_WORKQUEUE_STACKSIZE,
+                                         RT_SYSTEM_WORKQUEUE_PRIORITY, RT_SYSTEM_WORKQUEUE_WORKERS);
 
     return RT_EOK;
 }
 
 INIT_DEVICE_EXPORT(rt_work_sys_workqueue_init);
 #endif
+
+#if defined(RT_USING_FINSH) && defined(FINSH_USING_MSH)
+#include <finsh.h>
+
+static void list_workqueue(void)
+{
+    struct rt_workqueue *queue;
+    struct rt_workqueue stats;
+    rt_list_t *node;
+    rt_base_t level;
+    int maxlen = RT_NAME_MAX;
+    int busy, index, count;
+
+    rt_kprintf("%-*.s workers busy depth max   submitted  completed  stolen   latency(avg/max) exec max\n",
+               maxlen, "workqueue");
+    rt_kprintf("%-*.s ------- ---- ----- ----- ---------- ---------- -------- ---------------- --------\n",
+               maxlen, "----------------------");
+
+    /* a workqueue may be destroyed while printing, find the next one from the head every time */
+    for (count = 0; ; count++)
+    {
+        level = rt_hw_interrupt_disable();
+        for (node = _workqueue_list.next, index = 0; node != &_workqueue_list && index < count;
+                node = node->next, index++);
+        if (node == &_workqueue_list)
+        {
+            rt_hw_interrupt_enable(level);
+            break;
+        }
+
+        queue = rt_list_entry(node, struct rt_workqueue, list);
+        for (index = 0, busy = 0; index < queue->worker_num; index++)
+        {
+            if (queue->workers[index].work_current != RT_NULL)
+                busy++;
+        }
+        rt_memcpy(&stats, queue, sizeof(stats));
+        rt_hw_interrupt_enable(level);
+
+        rt_kprintf("%-*.*s %7d %4d %5d %5d %10d %10d %8d %7d/%-8d %8d\n", maxlen, RT_NAME_MAX,
+                   stats.name, stats.worker_num, busy, stats.depth, stats.depth_max, stats.submitted,
+                   stats.completed, stats.stolen, stats.completed ? stats.latency_total / stats.completed : 0,
+                   stats.latency_max, stats.exec_max);
+    }
+}
+MSH_CMD_EXPORT(list_workqueue, list workqueue statistics);
+#endif /* defined(RT_USING_FINSH) && defined(FINSH_USING_MSH) */
 #endif
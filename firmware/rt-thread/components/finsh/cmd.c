@@ -30,6 +30,7 @@
  * 2018-12-27     Jesven       Fix the problem that disable interrupt too long in list_thread 
  *                             Provide protection for the "first layer of objects" when list_*
  * 2020-04-07     chenhui      add clear 
+ * 2020-11-05     luhuadong    add top
  */
 
 #include <rthw.h>
@@ -39,6 +40,11 @@
 
 #include "finsh.h"
 
+#ifdef RT_USING_THREAD_STATS
+#include <stdlib.h>
+#include <rtdevice.h>
+#endif
+
 #define LIST_FIND_OBJ_NR 8
 
 long hello(void)
@@ -259,6 +265,150 @@ long list_thread(void)
 FINSH_FUNCTION_EXPORT(list_thread, list thread);
 MSH_CMD_EXPORT(list_thread, list thread);
 
+#ifdef RT_USING_THREAD_STATS
+struct top_sample
+{
+    rt_thread_t thread;
+    char name[RT_NAME_MAX];
+    rt_uint8_t priority;
+    struct rt_thread_stats stats;
+};
+
+static int top_sample_take(struct top_sample *samples, rt_object_t *objects, int nr)
+{
+    int i;
+
+    nr = rt_object_get_pointers(RT_Object_Class_Thread, objects, nr);
+    for (i = 0; i < nr; i++)
+    {
+        samples[i].thread = (rt_thread_t)objects[i];
+        samples[i].priority = samples[i].thread->current_priority;
+        rt_strncpy(samples[i].name, samples[i].thread->name, RT_NAME_MAX);
+        rt_thread_stats_get(samples[i].thread, &samples[i].stats);
+    }
+
+    return nr;
+}
+
+static void top_usage(void)
+{
+    rt_kprintf("Usage: top [interval ms]  - show thread CPU usage in the interval, default 1000ms\n");
+    rt_kprintf("       top -r             - reset statistics of all threads\n");
+}
+
+static int top(int argc, char **argv)
+{
+    struct top_sample *first, *second;
+    rt_object_t *objects;
+    rt_int32_t interval = 1000;
+    rt_tick_t tick;
+    float res, elapsed;
+    int nr, first_nr, second_nr, i, j, n;
+
+    nr = rt_object_get_length(RT_Object_Class_Thread) + 4;
+
+    if (argc > 1)
+    {
+        if (!rt_strcmp(argv[1], "-r"))
+        {
+            objects = (rt_object_t *)rt_malloc(nr * sizeof(rt_object_t));
+            if (objects == RT_NULL) return -RT_ENOMEM;
+
+            rt_enter_critical();
+            nr = rt_object_get_pointers(RT_Object_Class_Thread, objects, nr);
+            for (i = 0; i < nr; i++)
+                rt_thread_stats_reset((rt_thread_t)objects[i]);
+            rt_exit_critical();
+
+            rt_free(objects);
+            return 0;
+        }
+
+        interval = atoi(argv[1]);
+        if (interval <= 0)
+        {
+            top_usage();
+            return -RT_EINVAL;
+        }
+    }
+
+    objects = (rt_object_t *)rt_malloc(nr * sizeof(rt_object_t));
+    first = (struct top_sample *)rt_malloc(2 * nr * sizeof(struct top_sample));
+    if (objects == RT_NULL || first == RT_NULL)
+    {
+        rt_free(objects);
+        rt_free(first);
+        return -RT_ENOMEM;
+    }
+    second = first + nr;
+
+    /* the thread may be deleted in the interval, so take and check samples in critical */
+    rt_enter_critical();
+    first_nr = top_sample_take(first, objects, nr);
+    rt_exit_critical();
+    tick = rt_tick_get();
+
+    rt_thread_mdelay(interval);
+
+    rt_enter_critical();
+    second_nr = top_sample_take(second, objects, nr);
+    rt_exit_critical();
+    tick = rt_tick_get() - tick;
+
+    /* the elapsed time in nanosecond and the time unit of cputime */
+    elapsed = (float)tick * (1000000000.0f / RT_TICK_PER_SECOND);
+#ifdef RT_USING_SMP
+    elapsed *= RT_CPUS_NR;
+#endif
+    res = clock_cpu_getres();
+
+    rt_kprintf("%-*.s pri  cpu%%   switch  lat max(us)  latency histogram (<", RT_NAME_MAX, "thread");
+    for (n = 0; n < RT_THREAD_STATS_HIST_NR - 1; n++)
+    {
+        rt_kprintf("%dus ", (int)(res * (1UL << (RT_THREAD_STATS_HIST_BASE + 2 * n)) / 1000));
+    }
+    rt_kprintf("rest)\n");
+    object_split(RT_NAME_MAX);
+    rt_kprintf(" ---  -----  ------  -----------  -----------------\n");
+
+    for (i = 0; i < second_nr; i++)
+    {
+        struct rt_thread_stats *cur = &second[i].stats;
+        rt_uint64_t run_time = cur->run_time;
+        rt_uint32_t switches = cur->switches;
+        int usage;
+
+        /* a thread created in the interval is counted from zero */
+        for (j = 0; j < first_nr; j++)
+        {
+            if (first[j].thread == second[i].thread)
+            {
+                run_time -= first[j].stats.run_time;
+                switches -= first[j].stats.switches;
+                break;
+            }
+        }
+
+        /* usage in permillage */
+        usage = (int)((float)run_time * res * 1000 / elapsed);
+        rt_kprintf("%-*.*s %3d  %3d.%d  %6d  %11d  ", RT_NAME_MAX, RT_NAME_MAX, second[i].name,
+                   second[i].priority, usage / 10, usage % 10, switches,
+                   (int)(cur->latency_max * res / 1000));
+        for (n = 0; n < RT_THREAD_STATS_HIST_NR; n++)
+        {
+            rt_kprintf("%d ", cur->latency_hist[n]);
+        }
+        rt_kprintf("\n");
+    }
+
+    rt_free(first);
+    rt_free(objects);
+
+    return 0;
+}
+MSH_CMD_EXPORT(top, show thread CPU usage and scheduling latency);
+#endif /* RT_USING_THREAD_STATS */
+
 static void show_wait_queue(struct rt_list_node *list)
 {
     struct rt_thread *thread;
@@ -421,8 +571,13 @@ long list_mutex(void)
 
     maxlen = RT_NAME_MAX;
 
+#ifdef RT_USING_MUTEX_STATS
+    rt_kprintf("%-*.s   owner  hold suspend thread    take   contend     spin  wait max\n", maxlen, item_title); object_split(maxlen);
+    rt_kprintf(     " -------- ---- -------------- --------- --------- -------- ---------\n");
+#else
     rt_kprintf("%-*.s   owner  hold suspend thread\n", maxlen, item_title); object_split(maxlen);
     rt_kprintf(     " -------- ---- --------------\n");
+#endif
 
     do
     {
@@ -445,6 +600,19 @@ long list_mutex(void)
                 rt_hw_interrupt_enable(level);
 
                 m = (struct rt_mutex *)obj;
+#ifdef RT_USING_MUTEX_STATS
+                rt_kprintf("%-*.*s %-8.*s %04d %-14d %9d %9d %8d %9d\n",
+                        maxlen, RT_NAME_MAX,
+                        m->parent.parent.name,
+                        RT_NAME_MAX,
+                        m->owner->name,
+                        m->hold,
+                        rt_list_len(&m->parent.suspend_thread),
+                        m->take_count,
+                        m->contended,
+                        m->spin_acquired,
+                        m->wait_max);
+#else
                 rt_kprintf("%-*.*s %-8.*s %04d %d\n",
                         maxlen, RT_NAME_MAX,
                         m->parent.parent.name,
@@ -452,6 +620,7 @@ long list_mutex(void)
                         m->owner->name,
                         m->hold,
                         rt_list_len(&m->parent.suspend_thread));
+#endif
 
             }
         }
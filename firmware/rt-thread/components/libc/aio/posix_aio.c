@@ -6,6 +6,8 @@
  * Change Logs:
  * Date           Author       Notes
  * 2017/12/30     Bernard      The first version.
+ * 2020-11-20     luhuadong    add AIO engine with worker pool and request
+ *                             coalescing, lio_listio and aio_suspend
  */
 
 #include <stdint.h>
@@ -19,7 +21,356 @@
 
 #include "posix_aio.h"
 
-struct rt_workqueue* aio_queue = NULL;
+#ifndef RT_AIO_WORKERS
+#define RT_AIO_WORKERS          2
+#endif
+
+#ifndef RT_AIO_STACKSIZE
+#define RT_AIO_STACKSIZE        2048
+#endif
+
+#ifndef RT_AIO_PRIORITY
+#define RT_AIO_PRIORITY         (RT_THREAD_PRIORITY_MAX / 2)
+#endif
+
+/* the buffer size of coalesced requests, 0 to disable coalescing */
+#ifndef RT_AIO_BATCH_SIZE
+#define RT_AIO_BATCH_SIZE       4096
+#endif
+
+/* the maximum number of requests in one batch */
+#define AIO_BATCH_MAX           8
+
+/* the operations of request */
+enum
+{
+    AIO_OP_READ,
+    AIO_OP_WRITE,
+    AIO_OP_APPEND,          /* write to the file opened with O_APPEND */
+    AIO_OP_FSYNC,
+};
+
+struct aio_worker
+{
+    rt_thread_t thread;
+    int fd;                 /* the file in processing, -1 for none */
+    rt_uint8_t *buf;        /* the buffer of coalesced requests */
+};
+
+/* the requests which are submitted by lio_listio() */
+struct aio_lio
+{
+    int pending;            /* the number of requests in processing */
+    rt_uint8_t wait;        /* LIO_WAIT mode, the caller is waiting on sem */
+    struct rt_semaphore sem;
+    struct sigevent sig;
+    rt_thread_t thread;
+};
+
+/* the thread in aio_suspend() */
+struct aio_waiter
+{
+    rt_list_t list;
+    struct rt_semaphore sem;
+};
+
+static struct aio_worker aio_workers[RT_AIO_WORKERS];
+static struct rt_semaphore aio_sem;     /* the number of submitted requests */
+static rt_list_t aio_pending = RT_LIST_OBJECT_INIT(aio_pending);
+static rt_list_t aio_waiters = RT_LIST_OBJECT_INIT(aio_waiters);
+static struct rt_mutex aio_lock;
+
+static void aio_notify(const struct sigevent *sig, rt_thread_t thread)
+{
+    switch (sig->sigev_notify)
+    {
+    case SIGEV_THREAD:
+        /* the notification function is invoked in the AIO worker thread */
+        if (sig->sigev_notify_function)
+            sig->sigev_notify_function(sig->sigev_value);
+        break;
+
+#ifdef RT_USING_SIGNALS
+    case SIGEV_SIGNAL:
+        rt_thread_kill(thread, sig->sigev_signo);
+        break;
+#endif
+
+    default:
+        break;
+    }
+}
+
+/* finish one request of lio_listio(), the lio is released when all are done */
+static void aio_lio_done(struct aio_lio *lio)
+{
+    int pending;
+
+    rt_mutex_take(&aio_lock, RT_WAITING_FOREVER);
+    pending = -- lio->pending;
+    rt_mutex_release(&aio_lock);
+
+    if (pending > 0) return;
+
+    if (lio->wait)
+    {
+        rt_sem_release(&(lio->sem));
+    }
+    else
+    {
+        aio_notify(&(lio->sig), lio->thread);
+        rt_free(lio);
+    }
+}
+
+static void aio_complete(struct aiocb *cb, int result, int err)
+{
+    struct sigevent sig;
+    rt_thread_t thread;
+    struct aio_lio *lio;
+    rt_list_t *node;
+
+    /* the aiocb may be reused once it's completed */
+    sig = cb->aio_sigevent;
+    thread = cb->aio_thread;
+    lio = cb->aio_lio;
+
+    rt_mutex_take(&aio_lock, RT_WAITING_FOREVER);
+    cb->aio_result = result;
+    cb->aio_errno = err;
+    rt_list_for_each(node, &aio_waiters)
+    {
+        rt_sem_release(&(rt_list_entry(node, struct aio_waiter, list)->sem));
+    }
+    rt_mutex_release(&aio_lock);
+
+    /* the request in lio_listio() is notified by the list */
+    if (lio == RT_NULL)
+        aio_notify(&sig, thread);
+    else
+        aio_lio_done(lio);
+}
+
+/* check whether the file is in processing by a worker, aio_lock is held */
+static rt_bool_t aio_file_busy(int fd)
+{
+    int index;
+
+    for (index = 0; index < RT_AIO_WORKERS; index ++)
+    {
+        if (aio_workers[index].fd == fd)
+            return RT_TRUE;
+    }
+
+    return RT_FALSE;
+}
+
+/*
+ * fetch the oldest request of a file which is not in processing, and the
+ * following requests to the adjacent range of same file, aio_lock is held.
+ */
+static int aio_fetch(struct aio_worker *worker, struct aiocb *batch[])
+{
+    struct aiocb *cb, *next;
+    rt_list_t *node;
+    rt_size_t total;
+    off_t end;
+    int count;
+
+    cb = RT_NULL;
+    rt_list_for_each(node, &aio_pending)
+    {
+        cb = rt_list_entry(node, struct aiocb, aio_node);
+        if (!aio_file_busy(cb->aio_fildes)) break;
+        cb = RT_NULL;
+    }
+    if (cb == RT_NULL) return 0;
+
+    worker->fd = cb->aio_fildes;
+    node = cb->aio_node.next;
+    rt_list_remove(&(cb->aio_node));
+    batch[0] = cb;
+    count = 1;
+
+    if (worker->buf == RT_NULL || cb->aio_op == AIO_OP_FSYNC)
+        return count;
+
+    total = cb->aio_nbytes;
+    end = cb->aio_offset + cb->aio_nbytes;
+    while (node != &aio_pending && count < AIO_BATCH_MAX)
+    {
+        next = rt_list_entry(node, struct aiocb, aio_node);
+        node = node->next;
+        if (next->aio_fildes != cb->aio_fildes) continue;
+
+        /* keep the order of requests to the file */
+        if (next->aio_op != cb->aio_op) break;
+        if (next->aio_op != AIO_OP_APPEND && next->aio_offset != end) break;
+        if (total + next->aio_nbytes > RT_AIO_BATCH_SIZE) break;
+
+        rt_list_remove(&(next->aio_node));
+        batch[count ++] = next;
+        total += next->aio_nbytes;
+        end += next->aio_nbytes;
+    }
+
+    return count;
+}
+
+/* the error status of request is positive, but the errno of DFS is negative */
+static int aio_get_error(void)
+{
+    int err = rt_get_errno();
+
+    return err < 0 ? -err : err;
+}
+
+static void aio_process(struct aio_worker *worker, struct aiocb *batch[], int count)
+{
+    struct aiocb *cb = batch[0];
+    rt_uint8_t *buf;
+    rt_size_t total, size;
+    int index, len, err;
+
+    if (cb->aio_op == AIO_OP_FSYNC)
+    {
+        len = fsync(cb->aio_fildes);
+        aio_complete(cb, len, len < 0 ? aio_get_error() : 0);
+        return;
+    }
+
+    /* the single request is transferred with the buffer of itself */
+    total = cb->aio_nbytes;
+    buf = (rt_uint8_t *)cb->aio_buf;
+    if (count > 1)
+    {
+        buf = worker->buf;
+        for (index = 1; index < count; index ++)
+        {
+            total += batch[index]->aio_nbytes;
+        }
+    }
+
+    len = 0;
+    if (cb->aio_op != AIO_OP_APPEND)
+    {
+        len = lseek(cb->aio_fildes, cb->aio_offset, SEEK_SET);
+    }
+
+    if (len >= 0)
+    {
+        if (cb->aio_op == AIO_OP_READ)
+        {
+            len = read(cb->aio_fildes, buf, total);
+        }
+        else
+        {
+            if (count > 1)
+            {
+                for (index = 0, size = 0; index < count; index ++)
+                {
+                    rt_memcpy(buf + size, (void *)batch[index]->aio_buf, batch[index]->aio_nbytes);
+                    size += batch[index]->aio_nbytes;
+                }
+            }
+            len = write(cb->aio_fildes, buf, total);
+        }
+    }
+    err = len < 0 ? aio_get_error() : 0;
+
+    /* split the result to requests */
+    for (index = 0; index < count; index ++)
+    {
+        cb = batch[index];
+        size = cb->aio_nbytes;
+        if (len < 0)
+        {
+            aio_complete(cb, -1, err);
+            continue;
+        }
+
+        if (size > (rt_size_t)len) size = len;
+        if (count > 1 && cb->aio_op == AIO_OP_READ)
+        {
+            rt_memcpy((void *)cb->aio_buf, buf, size);
+        }
+        buf += cb->aio_nbytes;
+        len -= size;
+        aio_complete(cb, size, 0);
+    }
+}
+
+static void aio_thread_entry(void *parameter)
+{
+    struct aio_worker *worker = (struct aio_worker *)parameter;
+    struct aiocb *batch[AIO_BATCH_MAX];
+    int count;
+
+    while (1)
+    {
+        rt_sem_take(&aio_sem, RT_WAITING_FOREVER);
+
+        /*
+         * the requests to the file in processing are left to the worker
+         * which is processing it, so fetch until there is nothing to do.
+         */
+        rt_mutex_take(&aio_lock, RT_WAITING_FOREVER);
+        while ((count = aio_fetch(worker, batch)) > 0)
+        {
+            rt_mutex_release(&aio_lock);
+            aio_process(worker, batch, count);
+            rt_mutex_take(&aio_lock, RT_WAITING_FOREVER);
+
+            worker->fd = -1;
+        }
+        rt_mutex_release(&aio_lock);
+    }
+}
+
+/* put the request on pending list, aio_lock is held */
+static void aio_enqueue(struct aiocb *cb, int op, struct aio_lio *lio)
+{
+    cb->aio_result = 0;
+    cb->aio_errno = EINPROGRESS;
+    cb->aio_op = op;
+    cb->aio_thread = rt_thread_self();
+    cb->aio_lio = lio;
+    rt_list_insert_before(&aio_pending, &(cb->aio_node));
+}
+
+static int aio_submit(struct aiocb *cb, int op)
+{
+    rt_mutex_take(&aio_lock, RT_WAITING_FOREVER);
+    aio_enqueue(cb, op, RT_NULL);
+    rt_mutex_release(&aio_lock);
+
+    rt_sem_release(&aio_sem);
+
+    return 0;
+}
+
+/* check the request and get the operation of it */
+static int aio_check(struct aiocb *cb, int opcode)
+{
+    int oflags;
+
+    if (cb->aio_offset < 0) return -EINVAL;
+    if (cb->aio_buf == NULL && cb->aio_nbytes > 0) return -EINVAL;
+
+    oflags = fcntl(cb->aio_fildes, F_GETFL, 0);
+    if (oflags < 0) return -EBADF;
+
+    if (opcode == LIO_READ)
+    {
+        if ((oflags & O_ACCMODE) == O_WRONLY) return -EBADF;
+        return AIO_OP_READ;
+    }
+
+    if ((oflags & O_ACCMODE) != O_WRONLY && (oflags & O_ACCMODE) != O_RDWR)
+        return -EBADF;
+
+    return (oflags & O_APPEND) ? AIO_OP_APPEND : AIO_OP_WRITE;
+}
 
 /**
  * The aio_cancel() function shall attempt to cancel one or more asynchronous I/O 
@@ -45,19 +396,55 @@ struct rt_workqueue* aio_queue = NULL;
  */
 int aio_cancel(int fd, struct aiocb *cb)
 {
-    rt_err_t ret;
+    struct aiocb *item;
+    rt_list_t canceled, *node, *next;
+    int result = AIO_ALLDONE;
 
-    if (!cb) return -EINVAL;
-    if (cb->aio_fildes != fd) return -EINVAL;
+    if (cb && cb->aio_fildes != fd) return -EINVAL;
 
-    ret = rt_workqueue_cancel_work_sync(aio_queue, &(cb->aio_work));
-    if (ret == RT_EOK)
+    rt_list_init(&canceled);
+    rt_mutex_take(&aio_lock, RT_WAITING_FOREVER);
+    if (cb)
+    {
+        if (cb->aio_errno == EINPROGRESS)
+        {
+            result = AIO_NOTCANCELED;
+            /* it's not in processing */
+            if (!rt_list_isempty(&(cb->aio_node)))
+            {
+                rt_list_remove(&(cb->aio_node));
+                rt_list_insert_before(&canceled, &(cb->aio_node));
+                result = AIO_CANCELED;
+            }
+        }
+    }
+    else
     {
-        errno = -ECANCELED;
-        return -1;
+        for (node = aio_pending.next; node != &aio_pending; node = next)
+        {
+            next = node->next;
+            item = rt_list_entry(node, struct aiocb, aio_node);
+            if (item->aio_fildes == fd)
+            {
+                rt_list_remove(node);
+                rt_list_insert_before(&canceled, node);
+                result = AIO_CANCELED;
+            }
+        }
+
+        if (aio_file_busy(fd))
+            result = AIO_NOTCANCELED;
     }
+    rt_mutex_release(&aio_lock);
 
-    return 0;
+    while (!rt_list_isempty(&canceled))
+    {
+        item = rt_list_entry(canceled.next, struct aiocb, aio_node);
+        rt_list_remove(&(item->aio_node));
+        aio_complete(item, -1, ECANCELED);
+    }
+
+    return result;
 }
 
 /**
@@ -70,7 +457,7 @@ int aio_error (const struct aiocb *cb)
 {
     if (cb)
     {
-        return cb->aio_result;
+        return cb->aio_errno;
     }
 
     return -EINVAL;
@@ -117,63 +504,12 @@ int aio_error (const struct aiocb *cb)
  * If the aio_fsync() function fails or aiocbp indicates an error condition, 
  * data is not guaranteed to have been successfully transferred.
  */
-static void aio_fync_work(struct rt_work* work, void* work_data)
-{
-    int result;
-    rt_ubase_t level;
-    struct aiocb *cb = (struct aiocb*)work_data;
-
-    RT_ASSERT(cb != RT_NULL);
-
-    result = fsync(cb->aio_fildes);
-    /* modify result */
-    level = rt_hw_interrupt_disable();
-    if (result < 0)
-        cb->aio_result = errno;
-    else
-        cb->aio_result = 0;
-    rt_hw_interrupt_enable(level);
-
-    return ;
-}
-
 int aio_fsync(int op, struct aiocb *cb)
 {
-    rt_ubase_t level;
     if (!cb) return -EINVAL;
+    if (fcntl(cb->aio_fildes, F_GETFL, 0) < 0) return -EBADF;
 
-    level = rt_hw_interrupt_disable();
-    cb->aio_result = -EINPROGRESS;
-    rt_hw_interrupt_enable(level);
-
-    rt_work_init(&(cb->aio_work), aio_fync_work, cb);
-    rt_workqueue_dowork(aio_queue, &(cb->aio_work));
-
-    return 0;
-}
-
-static void aio_read_work(struct rt_work* work, void* work_data)
-{
-    int len;
-    rt_ubase_t level;
-    uint8_t *buf_ptr;
-    struct aiocb *cb = (struct aiocb*)work_data;
-
-    buf_ptr = (uint8_t*)cb->aio_buf;
-
-    /* seek to offset */
-    lseek(cb->aio_fildes, cb->aio_offset, SEEK_SET);
-    len = read(cb->aio_fildes, &buf_ptr[cb->aio_offset], cb->aio_nbytes);
-
-    /* modify result */
-    level = rt_hw_interrupt_disable();
-    if (len <= 0)
-        cb->aio_result = errno;
-    else 
-        cb->aio_result = len;
-    rt_hw_interrupt_enable(level);
-
-    return ;
+    return aio_submit(cb, AIO_OP_FSYNC);
 }
 
 /**
@@ -225,20 +561,14 @@ static void aio_read_work(struct rt_work* work, void* work_data)
  */
 int aio_read(struct aiocb *cb)
 {
-    rt_ubase_t level;
+    int op;
 
     if (!cb) return -EINVAL;
-    if (cb->aio_offset < 0) return -EINVAL;
-
-    level = rt_hw_interrupt_disable();
-    cb->aio_result = -EINPROGRESS;
-    rt_hw_interrupt_enable(level);
 
-    /* en-queue read work */
-    rt_work_init(&(cb->aio_work), aio_read_work, cb);
-    rt_workqueue_dowork(aio_queue, &(cb->aio_work));
+    op = aio_check(cb, LIO_READ);
+    if (op < 0) return op;
 
-    return 0;
+    return aio_submit(cb, op);
 }
 
 /**
@@ -259,7 +589,7 @@ ssize_t  aio_return(struct aiocb *cb)
     if (cb)
     {
         if (cb->aio_result < 0)
-            rt_set_errno(cb->aio_result);
+            rt_set_errno(-cb->aio_errno);
 
         return cb->aio_result;
     }
@@ -290,36 +620,54 @@ ssize_t  aio_return(struct aiocb *cb)
 int aio_suspend(const struct aiocb *const list[], int nent,
              const struct timespec *timeout)
 {
-    return -ENOSYS;
-}
+    struct aio_waiter waiter;
+    rt_int32_t timeout_tick = RT_WAITING_FOREVER;
+    rt_tick_t tick = 0;
+    int index, result = -EAGAIN;
 
-static void aio_write_work(struct rt_work* work, void* work_data)
-{
-    int len, oflags, level;
-    uint8_t *buf_ptr;
-    struct aiocb *cb = (struct aiocb*)work_data;
+    if (!list || nent < 0) return -EINVAL;
 
-    buf_ptr = (uint8_t*)cb->aio_buf;
-
-    /* whether seek offset */
-    oflags = fcntl(cb->aio_fildes, F_GETFL, 0);
-    if ((oflags & O_APPEND) == 0)
+    if (timeout)
     {
-        lseek(cb->aio_fildes, SEEK_SET, cb->aio_offset);
+        timeout_tick = timeout->tv_sec * RT_TICK_PER_SECOND +
+            (rt_int64_t)timeout->tv_nsec * RT_TICK_PER_SECOND / 1000000000;
+        tick = rt_tick_get();
     }
 
-    /* write data */
-    len = write(cb->aio_fildes, buf_ptr, cb->aio_nbytes);
+    rt_sem_init(&(waiter.sem), "aio", 0, RT_IPC_FLAG_FIFO);
+    rt_mutex_take(&aio_lock, RT_WAITING_FOREVER);
+    rt_list_insert_before(&aio_waiters, &(waiter.list));
+    rt_mutex_release(&aio_lock);
+
+    while (1)
+    {
+        for (index = 0; index < nent; index ++)
+        {
+            if (list[index] && list[index]->aio_errno != EINPROGRESS)
+            {
+                result = 0;
+                break;
+            }
+        }
+        if (result == 0) break;
+
+        if (timeout)
+        {
+            /* the rest of timeout */
+            timeout_tick -= rt_tick_get() - tick;
+            tick = rt_tick_get();
+            if (timeout_tick <= 0) break;
+        }
+
+        if (rt_sem_take(&(waiter.sem), timeout_tick) != RT_EOK) break;
+    }
 
-    /* modify result */
-    level = rt_hw_interrupt_disable();
-    if (len <= 0)
-        cb->aio_result = errno;
-    else 
-        cb->aio_result = len;
-    rt_hw_interrupt_enable(level);
+    rt_mutex_take(&aio_lock, RT_WAITING_FOREVER);
+    rt_list_remove(&(waiter.list));
+    rt_mutex_release(&aio_lock);
+    rt_sem_detach(&(waiter.sem));
 
-    return;
+    return result;
 }
 
 /**
@@ -363,25 +711,14 @@ static void aio_write_work(struct rt_work* work, void* work_data)
  */
 int aio_write(struct aiocb *cb)
 {
-    int oflags;
-    rt_ubase_t level;
+    int op;
 
     if (!cb || (cb->aio_buf == NULL)) return -EINVAL;
 
-    /* check access mode */
-    oflags = fcntl(cb->aio_fildes, F_GETFL, 0);
-    if ((oflags & O_ACCMODE) != O_WRONLY ||
-        (oflags & O_ACCMODE) != O_RDWR)
-        return -EINVAL;
-
-    level = rt_hw_interrupt_disable();
-    cb->aio_result = -EINPROGRESS;
-    rt_hw_interrupt_enable(level);
+    op = aio_check(cb, LIO_WRITE);
+    if (op < 0) return op;
 
-    rt_work_init(&(cb->aio_work), aio_write_work, cb);
-    rt_workqueue_dowork(aio_queue, &(cb->aio_work));
-
-    return 0;
+    return aio_submit(cb, op);
 }
 
 /**
@@ -452,13 +789,113 @@ int aio_write(struct aiocb *cb)
 int lio_listio(int mode, struct aiocb * const list[], int nent,
             struct sigevent *sig)
 {
-    return -ENOSYS;
+    struct aio_lio lio_wait, *lio = RT_NULL;
+    struct aiocb *cb;
+    int index, op, count = 0, result = 0;
+
+    if (mode != LIO_WAIT && mode != LIO_NOWAIT) return -EINVAL;
+    if (!list || nent < 0) return -EINVAL;
+
+    if (mode == LIO_WAIT)
+    {
+        lio = &lio_wait;
+        lio->wait = 1;
+        rt_sem_init(&(lio->sem), "lio", 0, RT_IPC_FLAG_FIFO);
+    }
+    else if (sig && sig->sigev_notify != SIGEV_NONE)
+    {
+        lio = (struct aio_lio *)rt_malloc(sizeof(struct aio_lio));
+        if (lio == RT_NULL) return -EAGAIN;
+
+        lio->wait = 0;
+        lio->sig = *sig;
+        lio->thread = rt_thread_self();
+    }
+
+    /* check the requests before queuing, they are submitted at once */
+    for (index = 0; index < nent; index ++)
+    {
+        cb = list[index];
+        if (!cb || cb->aio_lio_opcode == LIO_NOP) continue;
+
+        op = -EINVAL;
+        if (cb->aio_lio_opcode == LIO_READ || cb->aio_lio_opcode == LIO_WRITE)
+        {
+            op = aio_check(cb, cb->aio_lio_opcode);
+        }
+
+        if (op < 0)
+        {
+            cb->aio_result = -1;
+            cb->aio_errno = -op;
+            cb->aio_op = -1;
+            result = -EIO;
+            continue;
+        }
+        cb->aio_op = op;
+    }
+
+    rt_mutex_take(&aio_lock, RT_WAITING_FOREVER);
+    /* hold the list until all of requests are queued */
+    if (lio) lio->pending = 1;
+    for (index = 0; index < nent; index ++)
+    {
+        cb = list[index];
+        if (!cb || cb->aio_lio_opcode == LIO_NOP || cb->aio_op < 0) continue;
+
+        aio_enqueue(cb, cb->aio_op, lio);
+        if (lio) lio->pending ++;
+        count ++;
+    }
+    rt_mutex_release(&aio_lock);
+
+    while (count --)
+    {
+        rt_sem_release(&aio_sem);
+    }
+
+    if (lio) aio_lio_done(lio);
+
+    if (mode == LIO_WAIT)
+    {
+        rt_sem_take(&(lio->sem), RT_WAITING_FOREVER);
+        rt_sem_detach(&(lio->sem));
+
+        for (index = 0; index < nent; index ++)
+        {
+            cb = list[index];
+            if (cb && cb->aio_lio_opcode != LIO_NOP && cb->aio_errno != 0)
+                result = -EIO;
+        }
+    }
+
+    return result;
 }
 
 int aio_system_init(void)
 {
-    aio_queue = rt_workqueue_create("aio", 2048, RT_THREAD_PRIORITY_MAX/2);
-    RT_ASSERT(aio_queue != NULL);
+    struct aio_worker *worker;
+    char name[RT_NAME_MAX];
+    int index;
+
+    rt_mutex_init(&aio_lock, "aio", RT_IPC_FLAG_FIFO);
+    rt_sem_init(&aio_sem, "aio", 0, RT_IPC_FLAG_FIFO);
+
+    for (index = 0; index < RT_AIO_WORKERS; index ++)
+    {
+        worker = &aio_workers[index];
+        worker->fd = -1;
+        worker->buf = RT_NULL;
+        /* the requests are not coalesced without buffer */
+        if (RT_AIO_BATCH_SIZE > 0)
+            worker->buf = (rt_uint8_t *)rt_malloc(RT_AIO_BATCH_SIZE);
+
+        rt_snprintf(name, sizeof(name), "aio%d", index);
+        worker->thread = rt_thread_create(name, aio_thread_entry, worker,
+                                          RT_AIO_STACKSIZE, RT_AIO_PRIORITY, 10);
+        RT_ASSERT(worker->thread != RT_NULL);
+        rt_thread_startup(worker->thread);
+    }
 
     return 0;
 }
@@ -6,11 +6,37 @@
  * Change Logs:
  * Date           Author       Notes
  * 2017/12/30     Bernard      The first version.
+ * 2020-11-20     luhuadong    add AIO engine with worker pool and request
+ *                             coalescing, lio_listio and aio_suspend
  */
 
 #ifndef POSIX_AIO_H__
 #define POSIX_AIO_H__
 
+#include <rtthread.h>
+
+/* the return values of aio_cancel() */
+#define AIO_CANCELED    0
+#define AIO_NOTCANCELED 1
+#define AIO_ALLDONE     2
+
+/* the operations of lio_listio() */
+#define LIO_READ        0
+#define LIO_WRITE       1
+#define LIO_NOP         2
+
+/* the modes of lio_listio() */
+#define LIO_WAIT        0
+#define LIO_NOWAIT      1
+
+#ifndef SIGEV_NONE
+#define SIGEV_NONE      1
+#define SIGEV_SIGNAL    2
+#define SIGEV_THREAD    3
+#endif
+
+struct aio_lio;
+
 struct aiocb
 {
     int aio_fildes;         /* File descriptor. */
@@ -22,8 +48,13 @@ struct aiocb
     struct sigevent aio_sigevent; /* Signal number and value. */
     int aio_lio_opcode;     /* Operation to be performed. */
 
-    int aio_result;
-    struct rt_work aio_work;
+    /* private members for AIO engine */
+    int aio_result;         /* the return status */
+    int aio_errno;          /* the error status, EINPROGRESS when it's pending */
+    int aio_op;             /* the operation of request */
+    rt_list_t aio_node;     /* node on the pending list */
+    rt_thread_t aio_thread; /* the thread which submits the request */
+    struct aio_lio *aio_lio;/* the list of lio_listio() */
 };
 
 int aio_cancel(int fd, struct aiocb *cb);
@@ -0,0 +1,659 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * aio_sim runs AIO on the host with the files of a simulated SD card, and
+ * prints the time and the device operations of some workloads:
+ *
+ *   append   64 aio_write of 256 bytes to a log opened with O_APPEND, then
+ *            aio_suspend until all of them are completed.
+ *   2 files  32 aio_write of 512 bytes at adjacent offsets to each of two
+ *            files, submitted alternately.
+ *   lio      one lio_listio(LIO_WAIT) of 16 aio_read of 512 bytes at
+ *            adjacent offsets.
+ *
+ * The device operations of the files take a sleep: 200us and 2us for each
+ * 512 bytes to read, 1ms and 4us for each 512 bytes to write, 2ms to sync.
+ * Every file has a lock, so the operations of a file are serialized as the
+ * ones of the file system.
+ *
+ * The data is checked after each workload. The order is checked by the
+ * SIGEV_THREAD notification: an aio_fsync completes after the writes which
+ * are queued before it. aio_cancel of a file is checked while a write of
+ * the file is in processing: the pending requests report ECANCELED and are
+ * not written.
+ *
+ * The file descriptors are a small table of this program instead of DFS,
+ * the POSIX API which is used by AIO is renamed to the one of this table.
+ * AIO is built into this program with the configuration in rtconfig.h, the
+ * number of workers and the size of coalescing buffer are given by the
+ * command line:
+ *
+ *   R=../../../..
+ *   gcc -O2 -std=gnu99 -DRT_AIO_WORKERS=2 -DRT_AIO_BATCH_SIZE=4096 -I. -I.. -I$R/include \
+ *       -I$R/components/drivers/include -I$R/components/dfs/include aio_sim.c -o aio_sim -lpthread
+ *
+ * usage: aio_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+/* the file API of AIO is the one of this program */
+#define read        sim_read
+#define write       sim_write
+#define lseek       sim_lseek
+#define fsync       sim_fsync
+#define fcntl       sim_fcntl
+#include "../posix_aio.c"
+#undef read
+#undef write
+#undef lseek
+#undef fsync
+#undef fcntl
+
+#define SIM_FILES           4
+#define SIM_FILE_SIZE       (64 * 1024)
+#define SIM_READ_US         200
+#define SIM_WRITE_US        1000
+#define SIM_SECTOR_READ_US  2
+#define SIM_SECTOR_WRITE_US 4
+#define SIM_SYNC_US         2000
+#define SIM_REQUESTS        64
+
+struct sim_file
+{
+    int used;
+    int flags;
+    off_t pos;
+    rt_size_t size;
+    rt_uint8_t data[SIM_FILE_SIZE];
+    pthread_mutex_t lock;
+};
+
+struct sim_sem
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    rt_uint32_t value;
+};
+
+struct sim_thread
+{
+    struct rt_thread parent;
+    pthread_t tid;
+};
+
+static struct sim_file files[SIM_FILES];
+static unsigned long dev_reads, dev_writes, dev_syncs;
+static __thread rt_thread_t thread_self;
+static __thread rt_err_t thread_errno;
+static struct rt_thread main_thread;
+static int failed;
+
+/* the stubs of kernel for AIO */
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void rt_free(void *ptr) { free(ptr); }
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count) { return memcpy(dst, src, count); }
+rt_err_t rt_get_errno(void) { return thread_errno; }
+void rt_set_errno(rt_err_t error) { thread_errno = error; }
+rt_thread_t rt_thread_self(void) { return thread_self; }
+
+rt_int32_t rt_snprintf(char *buf, rt_size_t size, const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    va_start(args, fmt);
+    n = vsnprintf(buf, size, fmt, args);
+    va_end(args);
+
+    return n;
+}
+
+void rt_assert_handler(const char *ex, const char *func, rt_size_t line)
+{
+    fprintf(stderr, "(%s) assertion failed at function:%s, line number:%d\n", ex, func, (int)line);
+    abort();
+}
+
+static rt_uint64_t sim_now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (rt_uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+rt_tick_t rt_tick_get(void) { return (rt_tick_t)(sim_now_us() / 1000); }
+
+static void sim_sleep_us(long us)
+{
+    struct timespec ts = { us / 1000000, us % 1000000 * 1000 };
+
+    nanosleep(&ts, NULL);
+}
+
+/* the pthread objects are kept in the name of object, it's as large as a pointer */
+static void *sim_object(struct rt_object *object)
+{
+    void *sim;
+
+    memcpy(&sim, object->name, sizeof(sim));
+
+    return sim;
+}
+
+static void sim_object_set(struct rt_object *object, void *sim)
+{
+    memcpy(object->name, &sim, sizeof(sim));
+}
+
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag)
+{
+    pthread_mutex_t *m = malloc(sizeof(*m));
+
+    pthread_mutex_init(m, NULL);
+    sim_object_set(&mutex->parent.parent, m);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
+{
+    pthread_mutex_lock(sim_object(&mutex->parent.parent));
+
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_release(rt_mutex_t mutex)
+{
+    pthread_mutex_unlock(sim_object(&mutex->parent.parent));
+
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag)
+{
+    struct sim_sem *s = malloc(sizeof(*s));
+
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->value = value;
+    sim_object_set(&sem->parent.parent, s);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_detach(rt_sem_t sem)
+{
+    struct sim_sem *s = sim_object(&sem->parent.parent);
+
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+    free(s);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
+{
+    struct sim_sem *s = sim_object(&sem->parent.parent);
+    struct timespec deadline;
+    rt_err_t result = RT_EOK;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (time > 0)
+    {
+        deadline.tv_sec += time / 1000;
+        deadline.tv_nsec += (long)(time % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    pthread_mutex_lock(&s->lock);
+    while (s->value == 0 && result == RT_EOK)
+    {
+        if (time == 0)
+            result = -RT_ETIMEOUT;
+        else if (time < 0)
+            pthread_cond_wait(&s->cond, &s->lock);
+        else if (pthread_cond_timedwait(&s->cond, &s->lock, &deadline) != 0)
+            result = -RT_ETIMEOUT;
+    }
+    if (result == RT_EOK)
+        s->value--;
+    pthread_mutex_unlock(&s->lock);
+
+    return result;
+}
+
+rt_err_t rt_sem_release(rt_sem_t sem)
+{
+    struct sim_sem *s = sim_object(&sem->parent.parent);
+
+    pthread_mutex_lock(&s->lock);
+    s->value++;
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+
+    return RT_EOK;
+}
+
+static void *sim_thread_entry(void *param)
+{
+    rt_thread_t thread = param;
+
+    thread_self = thread;
+    ((void (*)(void *))thread->entry)(thread->parameter);
+
+    return NULL;
+}
+
+rt_thread_t rt_thread_create(const char *name, void (*entry)(void *parameter), void *parameter,
+        rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick)
+{
+    struct sim_thread *thread = calloc(1, sizeof(struct sim_thread));
+
+    snprintf(thread->parent.name, RT_NAME_MAX, "%.*s", RT_NAME_MAX - 1, name);
+    thread->parent.entry = (void *)entry;
+    thread->parent.parameter = parameter;
+
+    return &thread->parent;
+}
+
+rt_err_t rt_thread_startup(rt_thread_t thread)
+{
+    pthread_create(&((struct sim_thread *)thread)->tid, NULL, sim_thread_entry, thread);
+    pthread_detach(((struct sim_thread *)thread)->tid);
+
+    return RT_EOK;
+}
+
+/* the files of SD card */
+static struct sim_file *sim_file_get(int fd)
+{
+    if (fd < 0 || fd >= SIM_FILES || !files[fd].used)
+    {
+        rt_set_errno(-EBADF);
+        return RT_NULL;
+    }
+
+    return &files[fd];
+}
+
+static int sim_open(int flags)
+{
+    int fd;
+
+    for (fd = 0; fd < SIM_FILES; fd++)
+    {
+        if (!files[fd].used)
+        {
+            files[fd].used = 1;
+            files[fd].flags = flags;
+            files[fd].pos = 0;
+            files[fd].size = 0;
+            pthread_mutex_init(&files[fd].lock, NULL);
+
+            return fd;
+        }
+    }
+
+    return -1;
+}
+
+static void sim_close(int fd)
+{
+    pthread_mutex_destroy(&files[fd].lock);
+    files[fd].used = 0;
+}
+
+int sim_read(int fd, void *buf, size_t len)
+{
+    struct sim_file *file = sim_file_get(fd);
+
+    if (file == RT_NULL)
+        return -1;
+
+    pthread_mutex_lock(&file->lock);
+    if (file->pos >= (off_t)file->size)
+        len = 0;
+    else if (len > file->size - file->pos)
+        len = file->size - file->pos;
+    memcpy(buf, file->data + file->pos, len);
+    file->pos += len;
+    sim_sleep_us(SIM_READ_US + SIM_SECTOR_READ_US * (len + 511) / 512);
+    dev_reads++;
+    pthread_mutex_unlock(&file->lock);
+
+    return (int)len;
+}
+
+int sim_write(int fd, const void *buf, size_t len)
+{
+    struct sim_file *file = sim_file_get(fd);
+
+    if (file == RT_NULL)
+        return -1;
+
+    pthread_mutex_lock(&file->lock);
+    if (file->flags & O_APPEND)
+        file->pos = file->size;
+    if (file->pos + len > SIM_FILE_SIZE)
+    {
+        pthread_mutex_unlock(&file->lock);
+        rt_set_errno(-ENOSPC);
+        return -1;
+    }
+    memcpy(file->data + file->pos, buf, len);
+    file->pos += len;
+    if (file->pos > (off_t)file->size)
+        file->size = file->pos;
+    sim_sleep_us(SIM_WRITE_US + SIM_SECTOR_WRITE_US * (len + 511) / 512);
+    dev_writes++;
+    pthread_mutex_unlock(&file->lock);
+
+    return (int)len;
+}
+
+off_t sim_lseek(int fd, off_t offset, int whence)
+{
+    struct sim_file *file = sim_file_get(fd);
+
+    if (file == RT_NULL)
+        return -1;
+    if (whence != SEEK_SET || offset < 0)
+    {
+        rt_set_errno(-EINVAL);
+        return -1;
+    }
+
+    pthread_mutex_lock(&file->lock);
+    file->pos = offset;
+    pthread_mutex_unlock(&file->lock);
+
+    return offset;
+}
+
+int sim_fsync(int fd)
+{
+    struct sim_file *file = sim_file_get(fd);
+
+    if (file == RT_NULL)
+        return -1;
+
+    pthread_mutex_lock(&file->lock);
+    sim_sleep_us(SIM_SYNC_US);
+    dev_syncs++;
+    pthread_mutex_unlock(&file->lock);
+
+    return 0;
+}
+
+int sim_fcntl(int fd, int cmd, ...)
+{
+    struct sim_file *file = sim_file_get(fd);
+
+    if (file == RT_NULL)
+        return -1;
+
+    return cmd == F_GETFL ? file->flags : 0;
+}
+
+/* the workloads */
+static struct aiocb cbs[SIM_REQUESTS];
+static const struct aiocb *cb_list[SIM_REQUESTS];
+static rt_uint8_t bufs[SIM_REQUESTS][512];
+static volatile int completions[SIM_REQUESTS + 1];
+static volatile int completed;
+static pthread_mutex_t notify_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define SIM_CHECK(cond)     sim_check((cond), #cond, __LINE__)
+
+static void sim_check(int cond, const char *expr, int line)
+{
+    if (!cond)
+    {
+        if (!failed)
+            printf("line %d: %s is false\n", line, expr);
+        failed = 1;
+    }
+}
+
+static void sim_fill(rt_uint8_t *buf, rt_size_t size, int seed)
+{
+    rt_size_t i;
+
+    for (i = 0; i < size; i++)
+        buf[i] = (rt_uint8_t)(seed * 31 + i);
+}
+
+/* the index of request is put in the order of completion */
+static void sim_notify(union sigval value)
+{
+    pthread_mutex_lock(&notify_lock);
+    completions[completed++] = value.sival_int;
+    pthread_mutex_unlock(&notify_lock);
+}
+
+static void sim_prepare(struct aiocb *cb, int fd, off_t offset, void *buf, size_t size, int index)
+{
+    memset(cb, 0, sizeof(*cb));
+    cb->aio_fildes = fd;
+    cb->aio_offset = offset;
+    cb->aio_buf = buf;
+    cb->aio_nbytes = size;
+    cb->aio_sigevent.sigev_notify = SIGEV_THREAD;
+    cb->aio_sigevent.sigev_notify_function = sim_notify;
+    cb->aio_sigevent.sigev_value.sival_int = index;
+}
+
+/* wait for all of requests by aio_suspend */
+static void sim_wait_all(int count)
+{
+    int index;
+
+    for (index = 0; index < count; index++)
+        cb_list[index] = &cbs[index];
+
+    for (index = 0; index < count; index++)
+    {
+        while (aio_error(&cbs[index]) == EINPROGRESS)
+            SIM_CHECK(aio_suspend(&cb_list[index], 1, RT_NULL) == 0);
+    }
+}
+
+static void sim_reset(void)
+{
+    completed = 0;
+    dev_reads = dev_writes = dev_syncs = 0;
+}
+
+static void sim_print(const char *name, int requests, rt_uint64_t start)
+{
+    printf("%-8s %8d %8lu %8lu %8lu %9.1f\n", name, requests, dev_reads, dev_writes, dev_syncs,
+           (sim_now_us() - start) / 1000.0);
+}
+
+static void sim_append(void)
+{
+    rt_uint64_t start;
+    int fd, index;
+
+    sim_reset();
+    fd = sim_open(O_WRONLY | O_APPEND);
+    start = sim_now_us();
+    for (index = 0; index < SIM_REQUESTS; index++)
+    {
+        sim_fill(bufs[index], 256, index);
+        sim_prepare(&cbs[index], fd, 0, bufs[index], 256, index);
+        SIM_CHECK(aio_write(&cbs[index]) == 0);
+    }
+    sim_wait_all(SIM_REQUESTS);
+    sim_print("append", SIM_REQUESTS, start);
+
+    /* the appends are in the order of submission */
+    SIM_CHECK(files[fd].size == SIM_REQUESTS * 256);
+    for (index = 0; index < SIM_REQUESTS; index++)
+    {
+        SIM_CHECK(aio_return(&cbs[index]) == 256);
+        SIM_CHECK(memcmp(files[fd].data + index * 256, bufs[index], 256) == 0);
+    }
+    sim_close(fd);
+}
+
+static void sim_two_files(void)
+{
+    rt_uint64_t start;
+    int fds[2], index, count = SIM_REQUESTS / 2;
+
+    sim_reset();
+    fds[0] = sim_open(O_WRONLY);
+    fds[1] = sim_open(O_WRONLY);
+    start = sim_now_us();
+    for (index = 0; index < SIM_REQUESTS; index++)
+    {
+        sim_fill(bufs[index], 512, index);
+        sim_prepare(&cbs[index], fds[index % 2], (index / 2) * 512, bufs[index], 512, index);
+        SIM_CHECK(aio_write(&cbs[index]) == 0);
+    }
+    sim_wait_all(SIM_REQUESTS);
+    sim_print("2 files", SIM_REQUESTS, start);
+
+    SIM_CHECK(files[fds[0]].size == (rt_size_t)count * 512 && files[fds[1]].size == (rt_size_t)count * 512);
+    for (index = 0; index < SIM_REQUESTS; index++)
+    {
+        SIM_CHECK(aio_return(&cbs[index]) == 512);
+        SIM_CHECK(memcmp(files[fds[index % 2]].data + (index / 2) * 512, bufs[index], 512) == 0);
+    }
+    sim_close(fds[0]);
+    sim_close(fds[1]);
+}
+
+static void sim_lio(void)
+{
+    struct aiocb *list[16];
+    rt_uint64_t start;
+    int fd, index;
+
+    sim_reset();
+    fd = sim_open(O_RDONLY);
+    sim_fill(files[fd].data, 16 * 512, 7);
+    files[fd].size = 16 * 512;
+    start = sim_now_us();
+    for (index = 0; index < 16; index++)
+    {
+        memset(bufs[index], 0, 512);
+        sim_prepare(&cbs[index], fd, index * 512, bufs[index], 512, index);
+        cbs[index].aio_lio_opcode = LIO_READ;
+        list[index] = &cbs[index];
+    }
+    SIM_CHECK(lio_listio(LIO_WAIT, list, 16, RT_NULL) == 0);
+    sim_print("lio", 16, start);
+
+    for (index = 0; index < 16; index++)
+    {
+        SIM_CHECK(aio_error(&cbs[index]) == 0 && aio_return(&cbs[index]) == 512);
+        SIM_CHECK(memcmp(files[fd].data + index * 512, bufs[index], 512) == 0);
+    }
+    sim_close(fd);
+}
+
+/* the fsync completes after the writes queued before it */
+static void sim_fsync_order(void)
+{
+    int fd, index, position;
+
+    sim_reset();
+    fd = sim_open(O_WRONLY);
+    for (index = 0; index < 8; index++)
+    {
+        sim_prepare(&cbs[index], fd, index * 512, bufs[index], 512, index);
+        SIM_CHECK(aio_write(&cbs[index]) == 0);
+    }
+    sim_prepare(&cbs[8], fd, 0, RT_NULL, 0, 8);
+    SIM_CHECK(aio_fsync(O_SYNC, &cbs[8]) == 0);
+    sim_wait_all(9);
+
+    while (completed < 9)
+        sim_sleep_us(100);
+    for (position = 0; position < 9; position++)
+    {
+        if (completions[position] == 8)
+            break;
+    }
+    SIM_CHECK(position == 8);
+    SIM_CHECK(aio_error(&cbs[8]) == 0 && dev_syncs == 1);
+    sim_close(fd);
+}
+
+/* the pending requests are canceled while the first one is in processing */
+static void sim_cancel(void)
+{
+    int fd, index, canceled = 0;
+
+    sim_reset();
+    fd = sim_open(O_WRONLY);
+    /* the writes are not adjacent, they are not coalesced */
+    for (index = 0; index < 8; index++)
+    {
+        sim_prepare(&cbs[index], fd, index * 1024, bufs[index], 512, index);
+        cbs[index].aio_sigevent.sigev_notify = SIGEV_NONE;
+        SIM_CHECK(aio_write(&cbs[index]) == 0);
+    }
+    /* the first write is being written by a worker */
+    sim_sleep_us(SIM_WRITE_US / 2);
+    SIM_CHECK(aio_cancel(fd, RT_NULL) == AIO_NOTCANCELED);
+    sim_wait_all(8);
+
+    for (index = 0; index < 8; index++)
+    {
+        if (aio_error(&cbs[index]) == ECANCELED)
+        {
+            SIM_CHECK(aio_return(&cbs[index]) == -1);
+            canceled++;
+        }
+        else
+        {
+            SIM_CHECK(aio_error(&cbs[index]) == 0 && aio_return(&cbs[index]) == 512);
+        }
+    }
+    SIM_CHECK(canceled == 7 && aio_error(&cbs[0]) == 0 && files[fd].size == 512);
+    printf("\ncancel: %d of 8 writes are canceled\n", canceled);
+    sim_close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+    thread_self = &main_thread;
+    aio_system_init();
+
+    printf("%d workers, %d bytes coalescing buffer\n\n", RT_AIO_WORKERS, RT_AIO_BATCH_SIZE);
+    printf("%-8s %8s %8s %8s %8s %9s\n", "workload", "requests", "reads", "writes", "syncs", "ms");
+    sim_append();
+    sim_two_files();
+    sim_lio();
+    sim_fsync_order();
+    sim_cancel();
+
+    printf("\n%s\n", failed ? "FAIL" : "PASS");
+
+    return failed;
+}
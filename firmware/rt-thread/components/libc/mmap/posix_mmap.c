@@ -6,62 +6,177 @@
  * Change Logs:
  * Date           Author       Notes
  * 2017/11/30     Bernard      The first version.
+ * 2020-11-20     luhuadong    map the file data in memory directly, such as
+ *                             romfs and ramfs
  */
 
 #include <stdint.h>
 #include <stdio.h>
 
+#include <rthw.h>
 #include <rtthread.h>
 #include <dfs_posix.h>
 
 #include <sys/mman.h>
 
+/* the mapping which is copied from file, the data follows it */
+struct mmap_region
+{
+    rt_slist_t list;
+    size_t length;
+};
+
+static rt_slist_t _mmap_regions = RT_SLIST_OBJECT_INIT(_mmap_regions);
+
+/* get the address of file data when the file system keeps it in memory */
+static void *mmap_direct(int fd, size_t length, off_t offset)
+{
+    struct dfs_fd *d;
+    uint8_t *data = RT_NULL;
+
+    d = fd_get(fd);
+    if (d == RT_NULL)
+        return RT_NULL;
+
+    fd_lock(d);
+    if (offset + length <= d->size &&
+        dfs_file_ioctl(d, RT_FIOGETADDR, &data) == 0 && data != RT_NULL)
+    {
+        data += offset;
+    }
+    else
+    {
+        data = RT_NULL;
+    }
+    fd_unlock(d);
+    fd_put(d);
+
+    return data;
+}
+
+/**
+ * The file of romfs and ramfs is mapped to the data of file directly, the
+ * other files are read into a buffer. The writable private mapping is
+ * always a copy, and the copy of shared mapping isn't written back to file.
+ *
+ * Only the ramfs file which fits in one data chunk is mapped directly, the
+ * mapping becomes invalid when the file is truncated or removed.
+ */
 void *mmap(void *addr, size_t length, int prot, int flags,
     int fd, off_t offset)
 {
+    struct mmap_region *region = RT_NULL;
+    rt_base_t level;
     uint8_t *mem;
+    int oflags, len;
+    off_t cur;
 
-    if (addr)
+    if (length == 0 || offset < 0)
     {
-        mem = addr;
+        rt_set_errno(-EINVAL);
+        return MAP_FAILED;
     }
-    else mem = (uint8_t *)malloc(length);
 
-    if (mem)
+    if (!(flags & MAP_ANONYMOUS))
     {
-        off_t cur;
-        size_t read_bytes;
+        oflags = fcntl(fd, F_GETFL, 0);
+        if (oflags < 0)
+        {
+            rt_set_errno(-EBADF);
+            return MAP_FAILED;
+        }
 
-        cur = lseek(fd, 0, SEEK_SET);
+        if ((prot & PROT_WRITE) && (flags & MAP_SHARED) &&
+            (oflags & O_ACCMODE) != O_RDWR)
+        {
+            rt_set_errno(-EACCES);
+            return MAP_FAILED;
+        }
 
-        lseek(fd, offset, SEEK_SET);
-        read_bytes = read(fd, mem, length);
-        if (read_bytes != length)
+        if (addr == RT_NULL && (!(prot & PROT_WRITE) || (flags & MAP_SHARED)))
         {
-            if (addr == RT_NULL)
-            {
-                /* read failed */
-                free(mem);
-                mem = RT_NULL;
-            }
+            mem = mmap_direct(fd, length, offset);
+            if (mem)
+                return mem;
         }
+    }
+
+    if (addr)
+    {
+        mem = addr;
+    }
+    else
+    {
+        region = (struct mmap_region *)malloc(sizeof(struct mmap_region) + length);
+        if (region == RT_NULL)
+        {
+            rt_set_errno(-ENOMEM);
+            return MAP_FAILED;
+        }
+
+        region->length = length;
+        mem = (uint8_t *)(region + 1);
+    }
+
+    len = 0;
+    if (!(flags & MAP_ANONYMOUS))
+    {
+        cur = lseek(fd, 0, SEEK_CUR);
+
+        lseek(fd, offset, SEEK_SET);
+        len = read(fd, mem, length);
         lseek(fd, cur, SEEK_SET);
 
-        return mem;
+        if (len < 0)
+        {
+            /* read failed */
+            if (region)
+                free(region);
+
+            return MAP_FAILED;
+        }
     }
 
-    errno = ENOMEM;
+    /* the bytes beyond the end of file are zero */
+    memset(mem + len, 0, length - len);
+
+    if (region)
+    {
+        level = rt_hw_interrupt_disable();
+        rt_slist_append(&_mmap_regions, &(region->list));
+        rt_hw_interrupt_enable(level);
+    }
 
-    return MAP_FAILED;
+    return mem;
 }
 
 int munmap(void *addr, size_t length)
 {
-    if (addr)
+    struct mmap_region *region = RT_NULL;
+    rt_slist_t *node;
+    rt_base_t level;
+
+    if (addr == RT_NULL)
     {
-        free(addr);
-        return 0;
+        rt_set_errno(-EINVAL);
+        return -1;
     }
 
-    return -1;
+    level = rt_hw_interrupt_disable();
+    rt_slist_for_each(node, &_mmap_regions)
+    {
+        if ((void *)(rt_slist_entry(node, struct mmap_region, list) + 1) == addr)
+        {
+            region = rt_slist_entry(node, struct mmap_region, list);
+            rt_slist_remove(&_mmap_regions, node);
+            break;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    /* the direct mapping doesn't hold any memory */
+    if (region)
+        free(region);
+
+    return 0;
 }
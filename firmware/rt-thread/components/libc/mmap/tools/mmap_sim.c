@@ -0,0 +1,439 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * mmap_sim runs mmap on the host with romfs and ramfs, maps some files read
+ * only, and prints the memory which is allocated for each mapping and the
+ * time to open, map, touch the last byte, unmap and close the file.
+ *
+ * The files are the same on both file systems: a font of 64KB, a certificate
+ * of 2KB and a table of 256 bytes. A ramfs file is in chunks of 512 bytes,
+ * only the file in one chunk can be mapped directly. The memory is counted
+ * by the malloc of mmap, the memory of file systems isn't counted.
+ *
+ * Every mapping is compared with the file, and the file offset must be kept
+ * (the version before the direct mapping fails it, the offset was reset to
+ * 0). A writable private mapping must be a copy, the file isn't changed by
+ * it.
+ *
+ * The file descriptors are a small table of this program instead of DFS,
+ * the POSIX API which is used by mmap is renamed to the one of this table.
+ * mmap, romfs and ramfs are built into this program with the configuration
+ * in rtconfig.h. SIM_MMAP_C selects the source of another version to
+ * compare, e.g. the one before the direct mapping which is saved by git show:
+ *
+ *   R=../../../..; D=$R/components/dfs
+ *   gcc -O2 -std=gnu99 -I. -I$R/include -I$R/components/drivers/include -I$D/include \
+ *       -I$D/filesystems/romfs -I$D/filesystems/ramfs mmap_sim.c -o mmap_sim
+ *   gcc -O2 -std=gnu99 -DSIM_MMAP_C='"posix_mmap_old.c"' -I. -I$R/include \
+ *       -I$R/components/drivers/include -I$D/include -I$D/filesystems/romfs \
+ *       -I$D/filesystems/ramfs mmap_sim.c -o mmap_sim_old
+ *
+ * usage: mmap_sim [rounds]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../../../dfs/filesystems/romfs/dfs_romfs.c"
+#include "../../../dfs/filesystems/ramfs/dfs_ramfs.c"
+
+/* the file API and the heap of mmap are the ones of this program */
+void *sim_malloc(size_t size);
+void sim_free(void *mem);
+
+#define close       sim_close
+#define read        sim_read
+#define write       sim_write
+#define lseek       sim_lseek
+#define fcntl       sim_fcntl
+#define mmap        sim_mmap
+#define munmap      sim_munmap
+#define malloc      sim_malloc
+#define free        sim_free
+
+#ifndef SIM_MMAP_C
+#define SIM_MMAP_C  "../posix_mmap.c"
+#endif
+#include SIM_MMAP_C
+
+#undef close
+#undef read
+#undef write
+#undef lseek
+#undef fcntl
+#undef mmap
+#undef munmap
+#undef malloc
+#undef free
+
+#define SIM_FILES           3
+#define SIM_RAMFS_SIZE      (256 * 1024)
+
+struct sim_file
+{
+    const char *name;
+    rt_size_t size;
+    rt_uint8_t *data;
+};
+
+static struct sim_file files[SIM_FILES] =
+{
+    {"font.bin", 64 * 1024},
+    {"cert.pem", 2 * 1024},
+    {"table.bin", 256},
+};
+
+static struct romfs_dirent rom_files[SIM_FILES];
+static struct romfs_dirent rom_root = {ROMFS_DIRENT_DIR, "/", (rt_uint8_t *)rom_files, SIM_FILES};
+static struct dfs_filesystem rom_fs = {RT_NULL, "/rom", &_romfs, &rom_root};
+static struct dfs_filesystem ram_fs = {RT_NULL, "/ram", &_ramfs};
+
+static struct dfs_fd fds[DFS_FD_MAX];
+static size_t heap_used, heap_peak;
+static int failed;
+
+/* the stubs of kernel */
+rt_size_t rt_strlen(const char *s) { return strlen(s); }
+rt_int32_t rt_strncmp(const char *cs, const char *ct, rt_ubase_t count) { return strncmp(cs, ct, count); }
+
+char *rt_strncpy(char *dst, const char *src, rt_ubase_t n)
+{
+    rt_ubase_t i;
+
+    for (i = 0; i < n && src[i] != '\0'; i++)
+        dst[i] = src[i];
+    for (; i < n; i++)
+        dst[i] = '\0';
+
+    return dst;
+}
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag) { return RT_EOK; }
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time) { return RT_EOK; }
+rt_err_t rt_mutex_release(rt_mutex_t mutex) { return RT_EOK; }
+void rt_object_detach(rt_object_t object) { }
+rt_base_t rt_hw_interrupt_disable(void) { return 0; }
+void rt_hw_interrupt_enable(rt_base_t level) { }
+int dfs_register(const struct dfs_filesystem_ops *ops) { return 0; }
+void rt_set_errno(rt_err_t no) { errno = -no; }
+
+void rt_assert_handler(const char *ex, const char *func, rt_size_t line)
+{
+    fprintf(stderr, "(%s) assertion failed at function:%s, line number:%d\n", ex, func, (int)line);
+    abort();
+}
+
+/* the memheap of ramfs is from the heap of host */
+rt_err_t rt_memheap_init(struct rt_memheap *memheap, const char *name, void *start_addr, rt_size_t size)
+{
+    memheap->pool_size = size;
+    memheap->available_size = size;
+
+    return RT_EOK;
+}
+
+void *rt_memheap_alloc(struct rt_memheap *heap, rt_size_t size)
+{
+    rt_size_t *ptr;
+
+    if (size + sizeof(rt_size_t) * 2 > heap->available_size)
+        return RT_NULL;
+
+    ptr = malloc(sizeof(rt_size_t) * 2 + size);
+    ptr[0] = (rt_size_t)heap;
+    ptr[1] = size;
+    heap->available_size -= size + sizeof(rt_size_t) * 2;
+
+    return ptr + 2;
+}
+
+void rt_memheap_free(void *rmem)
+{
+    rt_size_t *ptr = (rt_size_t *)rmem - 2;
+
+    ((struct rt_memheap *)ptr[0])->available_size += ptr[1] + sizeof(rt_size_t) * 2;
+    free(ptr);
+}
+
+/* the heap of mmap counts the memory in use */
+void *sim_malloc(size_t size)
+{
+    size_t *ptr = malloc(sizeof(size_t) * 2 + size);
+
+    ptr[0] = size;
+    heap_used += size;
+    if (heap_used > heap_peak)
+        heap_peak = heap_used;
+
+    return ptr + 2;
+}
+
+void sim_free(void *mem)
+{
+    size_t *ptr = (size_t *)mem - 2;
+
+    heap_used -= ptr[0];
+    free(ptr);
+}
+
+/* the file descriptors */
+struct dfs_fd *fd_get(int fd)
+{
+    fd -= DFS_FD_OFFSET;
+    if (fd < 0 || fd >= DFS_FD_MAX || fds[fd].magic != DFS_FD_MAGIC)
+        return RT_NULL;
+
+    fds[fd].ref_count++;
+
+    return &fds[fd];
+}
+
+void fd_put(struct dfs_fd *fd) { fd->ref_count--; }
+void fd_lock(struct dfs_fd *fd) { }
+void fd_unlock(struct dfs_fd *fd) { }
+
+int dfs_file_ioctl(struct dfs_fd *fd, int cmd, void *args)
+{
+    if (cmd == F_GETFL)
+        return fd->flags;
+
+    return fd->fops->ioctl ? fd->fops->ioctl(fd, cmd, args) : -ENOSYS;
+}
+
+static int sim_open_fs(struct dfs_filesystem *fs, const char *path, int flags)
+{
+    struct dfs_fd *d;
+    int index, result;
+
+    for (index = 0; index < DFS_FD_MAX && fds[index].magic == DFS_FD_MAGIC; index++);
+    if (index == DFS_FD_MAX)
+        return -1;
+
+    d = &fds[index];
+    memset(d, 0, sizeof(*d));
+    d->magic = DFS_FD_MAGIC;
+    d->type = FT_REGULAR;
+    d->ref_count = 1;
+    d->fs = fs;
+    d->fops = fs->ops->fops;
+    d->flags = flags;
+    d->path = (char *)path;
+    d->data = fs;
+
+    result = d->fops->open(d);
+    if (result < 0)
+    {
+        d->magic = 0;
+        errno = -result;
+        return -1;
+    }
+
+    return index + DFS_FD_OFFSET;
+}
+
+int sim_close(int fd)
+{
+    struct dfs_fd *d = fd_get(fd);
+
+    if (d == RT_NULL)
+        return -1;
+
+    d->fops->close(d);
+    d->magic = 0;
+
+    return 0;
+}
+
+int sim_read(int fd, void *buf, size_t len)
+{
+    struct dfs_fd *d = fd_get(fd);
+    int result;
+
+    if (d == RT_NULL)
+        return -1;
+
+    result = d->fops->read(d, buf, len);
+    fd_put(d);
+
+    return result;
+}
+
+int sim_write(int fd, const void *buf, size_t len)
+{
+    struct dfs_fd *d = fd_get(fd);
+    int result;
+
+    if (d == RT_NULL)
+        return -1;
+
+    result = d->fops->write ? d->fops->write(d, buf, len) : -EIO;
+    fd_put(d);
+
+    return result;
+}
+
+off_t sim_lseek(int fd, off_t offset, int whence)
+{
+    struct dfs_fd *d = fd_get(fd);
+    int result;
+
+    if (d == RT_NULL)
+        return -1;
+
+    if (whence == SEEK_CUR)
+        offset += d->pos;
+    else if (whence == SEEK_END)
+        offset += d->size;
+    result = d->fops->lseek(d, offset);
+    fd_put(d);
+
+    return result;
+}
+
+int sim_fcntl(int fd, int cmd, ...)
+{
+    struct dfs_fd *d = fd_get(fd);
+    int result;
+
+    if (d == RT_NULL)
+        return -1;
+
+    result = dfs_file_ioctl(d, cmd, RT_NULL);
+    fd_put(d);
+
+    return result;
+}
+
+static rt_uint64_t sim_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (rt_uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void sim_fail(const char *fs_name, const char *name, const char *msg)
+{
+    printf("%s/%s: FAIL, %s\n", fs_name, name, msg);
+    failed = 1;
+}
+
+static void sim_files_init(void)
+{
+    struct dfs_ramfs *ramfs;
+    rt_size_t i;
+    int index, fd;
+
+    ramfs = dfs_ramfs_create(malloc(SIM_RAMFS_SIZE), SIM_RAMFS_SIZE);
+    ram_fs.data = ramfs;
+
+    for (index = 0; index < SIM_FILES; index++)
+    {
+        files[index].data = malloc(files[index].size);
+        for (i = 0; i < files[index].size; i++)
+            files[index].data[i] = (rt_uint8_t)(i * 7 + index + (i >> 8));
+
+        rom_files[index].type = ROMFS_DIRENT_FILE;
+        rom_files[index].name = files[index].name;
+        rom_files[index].data = files[index].data;
+        rom_files[index].size = files[index].size;
+
+        fd = sim_open_fs(&ram_fs, files[index].name, O_WRONLY | O_CREAT | O_TRUNC);
+        if (fd < 0 || sim_write(fd, files[index].data, files[index].size) != (int)files[index].size)
+        {
+            printf("FAIL, can't create %s on ramfs\n", files[index].name);
+            exit(1);
+        }
+        sim_close(fd);
+    }
+}
+
+static void sim_run(const char *fs_name, struct dfs_filesystem *fs, struct sim_file *file, int rounds)
+{
+    rt_uint8_t *mem, byte;
+    rt_uint64_t start, ns;
+    size_t base, ram;
+    int fd, round;
+    volatile rt_uint8_t sink = 0;
+
+    /* the check of read only mapping */
+    fd = sim_open_fs(fs, file->name, O_RDONLY);
+    sim_lseek(fd, 10, SEEK_SET);
+    base = heap_peak = heap_used;
+    mem = sim_mmap(RT_NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ram = heap_peak - base;
+    if (mem == MAP_FAILED || memcmp(mem, file->data, file->size) != 0)
+        sim_fail(fs_name, file->name, "the mapping is wrong");
+    if (sim_lseek(fd, 0, SEEK_CUR) != 10)
+        sim_fail(fs_name, file->name, "the file offset is changed");
+    if (mem != MAP_FAILED)
+        sim_munmap(mem, file->size);
+    if (heap_used != base)
+        sim_fail(fs_name, file->name, "the mapping isn't freed");
+
+    /* the check of writable private mapping */
+    mem = sim_mmap(RT_NULL, file->size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (mem != MAP_FAILED)
+    {
+        mem[0] ^= 0xFF;
+        sim_lseek(fd, 0, SEEK_SET);
+        if (sim_read(fd, &byte, 1) != 1 || byte != file->data[0])
+            sim_fail(fs_name, file->name, "the file is changed by the private mapping");
+        sim_munmap(mem, file->size);
+    }
+    else
+    {
+        sim_fail(fs_name, file->name, "the private mapping is failed");
+    }
+    sim_close(fd);
+
+    start = sim_now_ns();
+    for (round = 0; round < rounds; round++)
+    {
+        fd = sim_open_fs(fs, file->name, O_RDONLY);
+        mem = sim_mmap(RT_NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        sink += mem[file->size - 1];
+        sim_munmap(mem, file->size);
+        sim_close(fd);
+    }
+    ns = (sim_now_ns() - start) / rounds;
+
+    printf("%-6s %-10s %8u %8u %10.2f\n", fs_name, file->name, (unsigned)file->size, (unsigned)ram, ns / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds = 20000, index;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+
+    sim_files_init();
+
+    printf("%s, read only private mapping of the whole file\n\n", SIM_MMAP_C);
+    printf("%-6s %-10s %8s %8s %10s\n", "fs", "file", "size", "RAM", "open us");
+    for (index = 0; index < SIM_FILES; index++)
+        sim_run("romfs", &rom_fs, &files[index], rounds);
+    for (index = 0; index < SIM_FILES; index++)
+        sim_run("ramfs", &ram_fs, &files[index], rounds);
+
+    printf("\n%s\n", failed ? "FAIL" : "PASS");
+
+    return failed;
+}
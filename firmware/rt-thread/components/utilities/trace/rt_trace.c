@@ -0,0 +1,545 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-02     luhuadong    the first version
+ * 2020-11-20     luhuadong    take the buffer lock when clearing and reading
+ */
+
+#include <rthw.h>
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <stdlib.h>
+
+#include "rt_trace.h"
+
+#define DBG_TAG "trace"
+#define DBG_LVL DBG_INFO
+#include <rtdbg.h>
+
+#ifndef RT_TRACE_BUF_EVENTS
+#define RT_TRACE_BUF_EVENTS         512
+#endif
+
+#if (RT_TRACE_BUF_EVENTS & (RT_TRACE_BUF_EVENTS - 1)) != 0
+#error "RT_TRACE_BUF_EVENTS must be a power of 2"
+#endif
+
+#define TRACE_BUF_MASK              (RT_TRACE_BUF_EVENTS - 1)
+
+#ifdef RT_USING_SMP
+#define TRACE_CPUS_NR               RT_CPUS_NR
+#define trace_cpu_id()              rt_hw_cpu_id()
+#else
+#define TRACE_CPUS_NR               1
+#define trace_cpu_id()              0
+#endif
+
+/*
+ * Each CPU only writes to its own buffer, so recording never takes a lock
+ * shared between CPUs. The buffer lock is held for a few cycles to make the
+ * slot reservation atomic against nested interrupts on this CPU, and against
+ * clearing or reading from another CPU.
+ */
+struct trace_buffer
+{
+#ifdef RT_USING_SMP
+    rt_hw_spinlock_t lock;
+#endif
+    rt_uint32_t head;                               /* total number of recorded events */
+    struct rt_trace_event events[RT_TRACE_BUF_EVENTS];
+};
+
+/* stream header, followed by the object table and per-CPU event blocks */
+struct trace_stream_header
+{
+    rt_uint32_t magic;
+    rt_uint16_t version;
+    rt_uint16_t cpus;
+    rt_uint32_t res_ps;                             /* picoseconds per cputime tick */
+    rt_uint16_t name_max;
+    rt_uint16_t event_size;
+};
+
+struct trace_object_entry
+{
+    rt_uint32_t id;
+    rt_uint8_t  type;
+    rt_uint8_t  reserved[3];
+    char        name[RT_NAME_MAX];
+};
+
+static struct trace_buffer trace_buf[TRACE_CPUS_NR];
+static volatile rt_uint32_t trace_mask = RT_TRACE_MASK_ALL;
+static volatile rt_bool_t trace_enabled = RT_FALSE;
+
+rt_inline rt_base_t trace_buf_lock(struct trace_buffer *buf)
+{
+    rt_base_t level;
+
+#ifdef RT_USING_SMP
+    level = rt_hw_local_irq_disable();
+    rt_hw_spin_lock(&buf->lock);
+#else
+    level = rt_hw_interrupt_disable();
+#endif
+
+    return level;
+}
+
+rt_inline void trace_buf_unlock(struct trace_buffer *buf, rt_base_t level)
+{
+#ifdef RT_USING_SMP
+    rt_hw_spin_unlock(&buf->lock);
+    rt_hw_local_irq_enable(level);
+#else
+    rt_hw_interrupt_enable(level);
+#endif
+}
+
+static void trace_record(rt_uint8_t type, rt_uint16_t arg16, rt_uint32_t arg0, rt_uint32_t arg1)
+{
+    rt_base_t level;
+    struct trace_buffer *buf;
+    struct rt_trace_event *ev;
+    int cpu;
+
+#ifdef RT_USING_SMP
+    /* pin this CPU before locking its buffer */
+    level = rt_hw_local_irq_disable();
+    cpu = trace_cpu_id();
+    buf = &trace_buf[cpu];
+    rt_hw_spin_lock(&buf->lock);
+#else
+    cpu = 0;
+    buf = &trace_buf[0];
+    level = trace_buf_lock(buf);
+#endif
+
+    ev  = &buf->events[buf->head & TRACE_BUF_MASK];
+    buf->head ++;
+
+    ev->timestamp = clock_cpu_gettime();
+    ev->type      = type;
+    ev->cpu       = (rt_uint8_t)cpu;
+    ev->arg16     = arg16;
+    ev->arg0      = arg0;
+    ev->arg1      = arg1;
+
+    trace_buf_unlock(buf, level);
+}
+
+#define TRACE_ENABLED(mask) (trace_enabled && (trace_mask & (mask)))
+#define TRACE_ID(ptr)       ((rt_uint32_t)(rt_ubase_t)(ptr))
+
+static void trace_scheduler_hook(struct rt_thread *from, struct rt_thread *to)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_SCHED))
+        trace_record(RT_TRACE_EV_SWITCH, to->current_priority, TRACE_ID(from), TRACE_ID(to));
+}
+
+static void trace_thread_resume_hook(rt_thread_t thread)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_SCHED))
+        trace_record(RT_TRACE_EV_RESUME, thread->current_priority, TRACE_ID(thread), 0);
+}
+
+static void trace_thread_suspend_hook(rt_thread_t thread)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_SCHED))
+        trace_record(RT_TRACE_EV_SUSPEND, thread->current_priority, TRACE_ID(thread), 0);
+}
+
+static void trace_object_trytake_hook(struct rt_object *object)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_IPC))
+        trace_record(RT_TRACE_EV_IPC_TRYTAKE, object->type, TRACE_ID(object), TRACE_ID(rt_thread_self()));
+}
+
+static void trace_object_take_hook(struct rt_object *object)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_IPC))
+        trace_record(RT_TRACE_EV_IPC_TAKE, object->type, TRACE_ID(object), TRACE_ID(rt_thread_self()));
+}
+
+static void trace_object_put_hook(struct rt_object *object)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_IPC))
+        trace_record(RT_TRACE_EV_IPC_PUT, object->type, TRACE_ID(object), TRACE_ID(rt_thread_self()));
+}
+
+static void trace_timer_enter_hook(struct rt_timer *timer)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_TIMER))
+        trace_record(RT_TRACE_EV_TIMER_ENTER, 0, TRACE_ID(timer), 0);
+}
+
+static void trace_timer_exit_hook(struct rt_timer *timer)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_TIMER))
+        trace_record(RT_TRACE_EV_TIMER_EXIT, 0, TRACE_ID(timer), 0);
+}
+
+static void trace_interrupt_enter_hook(void)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_ISR))
+        trace_record(RT_TRACE_EV_ISR_ENTER, 0, 0, 0);
+}
+
+static void trace_interrupt_leave_hook(void)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_ISR))
+        trace_record(RT_TRACE_EV_ISR_LEAVE, 0, 0, 0);
+}
+
+/**
+ * This function will install the trace hooks and start recording.
+ *
+ * @note the trace recorder takes over the scheduler, thread, object, timer
+ * and interrupt hooks, any hook installed before will be replaced.
+ */
+void rt_trace_start(void)
+{
+    rt_scheduler_sethook(trace_scheduler_hook);
+    rt_thread_resume_sethook(trace_thread_resume_hook);
+    rt_thread_suspend_sethook(trace_thread_suspend_hook);
+    rt_object_trytake_sethook(trace_object_trytake_hook);
+    rt_object_take_sethook(trace_object_take_hook);
+    rt_object_put_sethook(trace_object_put_hook);
+    rt_timer_enter_sethook(trace_timer_enter_hook);
+    rt_timer_exit_sethook(trace_timer_exit_hook);
+    rt_interrupt_enter_sethook(trace_interrupt_enter_hook);
+    rt_interrupt_leave_sethook(trace_interrupt_leave_hook);
+
+    trace_enabled = RT_TRUE;
+}
+RTM_EXPORT(rt_trace_start);
+
+/**
+ * This function will stop recording and remove the trace hooks. The recorded
+ * events are kept until rt_trace_clear() or the next start.
+ */
+void rt_trace_stop(void)
+{
+    trace_enabled = RT_FALSE;
+
+    rt_scheduler_sethook(RT_NULL);
+    rt_thread_resume_sethook(RT_NULL);
+    rt_thread_suspend_sethook(RT_NULL);
+    rt_object_trytake_sethook(RT_NULL);
+    rt_object_take_sethook(RT_NULL);
+    rt_object_put_sethook(RT_NULL);
+    rt_timer_enter_sethook(RT_NULL);
+    rt_timer_exit_sethook(RT_NULL);
+    rt_interrupt_enter_sethook(RT_NULL);
+    rt_interrupt_leave_sethook(RT_NULL);
+}
+RTM_EXPORT(rt_trace_stop);
+
+/**
+ * This function will drop all recorded events on all CPUs.
+ */
+void rt_trace_clear(void)
+{
+    int cpu;
+    rt_base_t level;
+
+    for (cpu = 0; cpu < TRACE_CPUS_NR; cpu ++)
+    {
+        level = trace_buf_lock(&trace_buf[cpu]);
+        trace_buf[cpu].head = 0;
+        trace_buf_unlock(&trace_buf[cpu], level);
+    }
+}
+RTM_EXPORT(rt_trace_clear);
+
+/**
+ * This function will set which kind of events are recorded.
+ *
+ * @param mask the event mask, RT_TRACE_MASK_xxx
+ */
+void rt_trace_set_mask(rt_uint32_t mask)
+{
+    trace_mask = mask;
+}
+RTM_EXPORT(rt_trace_set_mask);
+
+/**
+ * This function will record a user defined event, which is useful to mark
+ * the begin and end of an application level operation.
+ *
+ * @param id the user defined event id
+ * @param value the user defined value
+ */
+void rt_trace_mark(rt_uint16_t id, rt_uint32_t value)
+{
+    if (TRACE_ENABLED(RT_TRACE_MASK_MARK))
+        trace_record(RT_TRACE_EV_MARK, id, value, TRACE_ID(rt_thread_self()));
+}
+RTM_EXPORT(rt_trace_mark);
+
+/**
+ * This function will copy recorded events of one CPU, oldest first.
+ *
+ * @param cpu the CPU index
+ * @param index the index of the first event to copy, 0 is the oldest one
+ * @param events the buffer to save events
+ * @param count the maximal number of events to copy
+ *
+ * @return the number of copied events
+ */
+rt_size_t rt_trace_read(int cpu, rt_uint32_t index, struct rt_trace_event *events, rt_size_t count)
+{
+    struct trace_buffer *buf;
+    rt_uint32_t head, first, num;
+    rt_size_t copied = 0;
+    rt_base_t level;
+
+    if (cpu < 0 || cpu >= TRACE_CPUS_NR || events == RT_NULL)
+        return 0;
+
+    buf = &trace_buf[cpu];
+
+    level = trace_buf_lock(buf);
+    head  = buf->head;
+    num   = head > RT_TRACE_BUF_EVENTS ? RT_TRACE_BUF_EVENTS : head;
+    first = head - num;
+
+    while (index < num && copied < count)
+    {
+        events[copied ++] = buf->events[(first + index) & TRACE_BUF_MASK];
+        index ++;
+    }
+    trace_buf_unlock(buf, level);
+
+    return copied;
+}
+RTM_EXPORT(rt_trace_read);
+
+static const rt_uint8_t trace_object_types[] =
+{
+    RT_Object_Class_Thread,
+#ifdef RT_USING_SEMAPHORE
+    RT_Object_Class_Semaphore,
+#endif
+#ifdef RT_USING_MUTEX
+    RT_Object_Class_Mutex,
+#endif
+#ifdef RT_USING_EVENT
+    RT_Object_Class_Event,
+#endif
+#ifdef RT_USING_MAILBOX
+    RT_Object_Class_MailBox,
+#endif
+#ifdef RT_USING_MESSAGEQUEUE
+    RT_Object_Class_MessageQueue,
+#endif
+    RT_Object_Class_Timer,
+};
+
+static void trace_export_objects(rt_trace_output_t output, void *parameter)
+{
+    struct rt_object_information *info;
+    struct trace_object_entry *table;
+    struct rt_list_node *node;
+    rt_uint32_t total = 0, num;
+    rt_size_t i;
+    int len;
+
+    for (i = 0; i < sizeof(trace_object_types) / sizeof(trace_object_types[0]); i ++)
+    {
+        len = rt_object_get_length((enum rt_object_class_type)trace_object_types[i]);
+        table = RT_NULL;
+        num = 0;
+
+        if (len > 0)
+            table = (struct trace_object_entry *)rt_calloc(len, sizeof(struct trace_object_entry));
+
+        if (table != RT_NULL)
+        {
+            info = rt_object_get_information((enum rt_object_class_type)trace_object_types[i]);
+
+            /* copy the names while the object list can not change */
+            rt_enter_critical();
+            rt_list_for_each(node, &(info->object_list))
+            {
+                struct rt_object *object = rt_list_entry(node, struct rt_object, list);
+
+                if (num >= (rt_uint32_t)len) break;
+
+                table[num].id   = TRACE_ID(object);
+                table[num].type = trace_object_types[i];
+                rt_strncpy(table[num].name, object->name, RT_NAME_MAX);
+                num ++;
+            }
+            rt_exit_critical();
+        }
+
+        /* every class begins with the number of entries */
+        output(&num, sizeof(rt_uint32_t), parameter);
+        if (num > 0)
+            output(table, num * sizeof(struct trace_object_entry), parameter);
+        total += num;
+
+        if (table != RT_NULL)
+            rt_free(table);
+    }
+
+    LOG_D("exported %d object names", total);
+}
+
+/**
+ * This function will export all recorded events as a binary stream, which
+ * can be converted by trace2json.py on the host. The recording is
+ * stopped during exporting.
+ *
+ * @param output the output function
+ * @param parameter the parameter of output function
+ *
+ * @return RT_EOK
+ */
+rt_err_t rt_trace_export(rt_trace_output_t output, void *parameter)
+{
+    struct trace_stream_header header;
+    struct rt_trace_event events[16];
+    rt_uint32_t index, num;
+    rt_bool_t enabled;
+    rt_uint8_t classes;
+    rt_size_t count;
+    int cpu;
+
+    RT_ASSERT(output != RT_NULL);
+
+    enabled = trace_enabled;
+    trace_enabled = RT_FALSE;
+
+    header.magic      = RT_TRACE_MAGIC;
+    header.version    = RT_TRACE_VERSION;
+    header.cpus       = TRACE_CPUS_NR;
+    header.res_ps     = (rt_uint32_t)(clock_cpu_getres() * 1000);
+    header.name_max   = RT_NAME_MAX;
+    header.event_size = sizeof(struct rt_trace_event);
+    output(&header, sizeof(header), parameter);
+
+    classes = sizeof(trace_object_types) / sizeof(trace_object_types[0]);
+    output(&classes, sizeof(classes), parameter);
+    trace_export_objects(output, parameter);
+
+    for (cpu = 0; cpu < TRACE_CPUS_NR; cpu ++)
+    {
+        num = trace_buf[cpu].head > RT_TRACE_BUF_EVENTS ? RT_TRACE_BUF_EVENTS : trace_buf[cpu].head;
+        output(&num, sizeof(num), parameter);
+
+        for (index = 0; index < num; index += count)
+        {
+            count = rt_trace_read(cpu, index, events, sizeof(events) / sizeof(events[0]));
+            if (count == 0) break;
+            output(events, count * sizeof(struct rt_trace_event), parameter);
+        }
+    }
+
+    trace_enabled = enabled;
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_trace_export);
+
+#if defined(RT_USING_FINSH) && defined(FINSH_USING_MSH)
+#include <finsh.h>
+
+#ifdef RT_USING_DFS
+#include <dfs_posix.h>
+
+static void trace_file_output(const void *buf, rt_size_t size, void *parameter)
+{
+    write(*(int *)parameter, buf, size);
+}
+#endif
+
+static void trace_console_output(const void *buf, rt_size_t size, void *parameter)
+{
+    const rt_uint8_t *ptr = (const rt_uint8_t *)buf;
+    rt_size_t *column = (rt_size_t *)parameter;
+
+    while (size --)
+    {
+        if (*column == 0) rt_kprintf("TRACE ");
+        rt_kprintf("%02x", *ptr ++);
+        if (++ (*column) == 32)
+        {
+            rt_kprintf("\n");
+            *column = 0;
+        }
+    }
+}
+
+static void trace_usage(void)
+{
+    rt_kprintf("Usage:\n");
+    rt_kprintf("trace start [mask]  - start recording, mask default 0x%02x\n", RT_TRACE_MASK_ALL);
+    rt_kprintf("trace stop          - stop recording\n");
+    rt_kprintf("trace clear         - drop all recorded events\n");
+    rt_kprintf("trace dump [file]   - export events to file or console\n");
+}
+
+static int trace(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        trace_usage();
+        return -RT_EINVAL;
+    }
+
+    if (!rt_strcmp(argv[1], "start"))
+    {
+        if (argc > 2)
+            rt_trace_set_mask(strtoul(argv[2], RT_NULL, 0));
+        rt_trace_start();
+    }
+    else if (!rt_strcmp(argv[1], "stop"))
+    {
+        rt_trace_stop();
+    }
+    else if (!rt_strcmp(argv[1], "clear"))
+    {
+        rt_trace_clear();
+    }
+    else if (!rt_strcmp(argv[1], "dump"))
+    {
+        if (argc > 2)
+        {
+#ifdef RT_USING_DFS
+            int fd = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC, 0);
+            if (fd < 0)
+            {
+                rt_kprintf("open %s failed\n", argv[2]);
+                return -RT_ERROR;
+            }
+            rt_trace_export(trace_file_output, &fd);
+            close(fd);
+#else
+            rt_kprintf("file system is not enabled\n");
+            return -RT_ERROR;
+#endif
+        }
+        else
+        {
+            rt_size_t column = 0;
+
+            rt_trace_export(trace_console_output, &column);
+            if (column) rt_kprintf("\n");
+        }
+    }
+    else
+    {
+        trace_usage();
+        return -RT_EINVAL;
+    }
+
+    return RT_EOK;
+}
+MSH_CMD_EXPORT(trace, kernel trace recorder: trace <start|stop|clear|dump> [arg]);
+#endif /* defined(RT_USING_FINSH) && defined(FINSH_USING_MSH) */
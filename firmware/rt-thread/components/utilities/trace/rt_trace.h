@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-02     luhuadong    the first version
+ */
+
+#ifndef __RT_TRACE_H__
+#define __RT_TRACE_H__
+
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RT_TRACE_MAGIC              0x52545452      /* "RTTR" */
+#define RT_TRACE_VERSION            1
+
+/* trace event type */
+enum rt_trace_event_type
+{
+    RT_TRACE_EV_NONE = 0,
+    RT_TRACE_EV_SWITCH,                             /* arg0: from thread, arg1: to thread */
+    RT_TRACE_EV_RESUME,                             /* arg0: resumed thread */
+    RT_TRACE_EV_SUSPEND,                            /* arg0: suspended thread */
+    RT_TRACE_EV_IPC_TRYTAKE,                        /* arg0: object, arg1: current thread */
+    RT_TRACE_EV_IPC_TAKE,                           /* arg0: object, arg1: current thread */
+    RT_TRACE_EV_IPC_PUT,                            /* arg0: object, arg1: current thread */
+    RT_TRACE_EV_TIMER_ENTER,                        /* arg0: timer */
+    RT_TRACE_EV_TIMER_EXIT,                         /* arg0: timer */
+    RT_TRACE_EV_ISR_ENTER,
+    RT_TRACE_EV_ISR_LEAVE,
+    RT_TRACE_EV_MARK,                               /* arg0: user value, arg16: user id */
+};
+
+/* trace event mask, used by rt_trace_set_mask() */
+#define RT_TRACE_MASK_SCHED         (1 << 0)
+#define RT_TRACE_MASK_IPC           (1 << 1)
+#define RT_TRACE_MASK_TIMER         (1 << 2)
+#define RT_TRACE_MASK_ISR           (1 << 3)
+#define RT_TRACE_MASK_MARK          (1 << 4)
+#define RT_TRACE_MASK_ALL           0x1F
+
+/* one trace record, 16 bytes */
+struct rt_trace_event
+{
+    rt_uint32_t timestamp;                          /* cputime counter */
+    rt_uint8_t  type;                               /* @see enum rt_trace_event_type */
+    rt_uint8_t  cpu;
+    rt_uint16_t arg16;
+    rt_uint32_t arg0;
+    rt_uint32_t arg1;
+};
+
+/* the output function for exporting the trace stream */
+typedef void (*rt_trace_output_t)(const void *buf, rt_size_t size, void *parameter);
+
+void rt_trace_start(void);
+void rt_trace_stop(void);
+void rt_trace_clear(void);
+void rt_trace_set_mask(rt_uint32_t mask);
+void rt_trace_mark(rt_uint16_t id, rt_uint32_t value);
+
+rt_size_t rt_trace_read(int cpu, rt_uint32_t index, struct rt_trace_event *events, rt_size_t count);
+rt_err_t rt_trace_export(rt_trace_output_t output, void *parameter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __RT_TRACE_H__ */
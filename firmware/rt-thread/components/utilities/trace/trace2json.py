@@ -0,0 +1,150 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2006-2020, RT-Thread Development Team
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Change Logs:
+# Date           Author       Notes
+# 2020-11-02     luhuadong    the first version
+#
+# Convert the stream exported by `trace dump` to the Chrome/Perfetto JSON
+# trace format, which can be opened by https://ui.perfetto.dev or
+# chrome://tracing.
+#
+# usage: trace2json.py <trace.bin | console.log> [output.json]
+#
+
+import sys
+import json
+import struct
+import binascii
+
+TRACE_MAGIC = 0x52545452
+
+EV_SWITCH       = 1
+EV_RESUME       = 2
+EV_SUSPEND      = 3
+EV_IPC_TRYTAKE  = 4
+EV_IPC_TAKE     = 5
+EV_IPC_PUT      = 6
+EV_TIMER_ENTER  = 7
+EV_TIMER_EXIT   = 8
+EV_ISR_ENTER    = 9
+EV_ISR_LEAVE    = 10
+EV_MARK         = 11
+
+def load_stream(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    if len(data) >= 4 and struct.unpack_from('<I', data)[0] == TRACE_MAGIC:
+        return data
+
+    # the console dump: lines begin with "TRACE " and followed by hex bytes
+    hexs = []
+    for line in data.decode('ascii', 'ignore').splitlines():
+        pos = line.find('TRACE ')
+        if pos >= 0:
+            hexs.append(line[pos + 6:].strip())
+    return binascii.unhexlify(''.join(hexs))
+
+def parse_stream(data):
+    magic, version, cpus, res_ps, name_max, event_size = struct.unpack_from('<IHHIHH', data)
+    if magic != TRACE_MAGIC:
+        raise ValueError('bad trace magic')
+    off = 16
+
+    classes = struct.unpack_from('<B', data, off)[0]
+    off += 1
+
+    names = {}
+    entry_size = (8 + name_max + 3) & ~3
+    for _ in range(classes):
+        num = struct.unpack_from('<I', data, off)[0]
+        off += 4
+        for _ in range(num):
+            obj_id, obj_type = struct.unpack_from('<IB', data, off)
+            name = data[off + 8:off + entry_size].split(b'\0')[0].decode('ascii', 'ignore')
+            names[obj_id] = name
+            off += entry_size
+
+    events = []
+    for _ in range(cpus):
+        num = struct.unpack_from('<I', data, off)[0]
+        off += 4
+        for _ in range(num):
+            events.append(struct.unpack_from('<IBBHII', data, off))
+            off += event_size
+
+    return res_ps, names, events
+
+def convert(res_ps, names, events):
+    out = []
+    last_ts = {}
+    base_ts = {}
+    running = {}
+
+    def name_of(obj_id):
+        return names.get(obj_id, '0x%08x' % obj_id)
+
+    def to_us(cpu, ts):
+        # unwrap the 32 bits cputime counter per CPU
+        if cpu not in last_ts:
+            last_ts[cpu] = ts
+            base_ts[cpu] = 0
+        elif ts < last_ts[cpu]:
+            base_ts[cpu] += 1 << 32
+        last_ts[cpu] = ts
+        return (base_ts[cpu] + ts) * res_ps / 1000000.0
+
+    for ts, ev, cpu, arg16, arg0, arg1 in events:
+        us = to_us(cpu, ts)
+        item = {'ts': us, 'pid': cpu, 'tid': 0}
+
+        if ev == EV_SWITCH:
+            if cpu in running:
+                out.append(dict(item, ph='E', name=name_of(running[cpu])))
+            running[cpu] = arg1
+            out.append(dict(item, ph='B', name=name_of(arg1), args={'prio': arg16}))
+            continue
+        elif ev in (EV_RESUME, EV_SUSPEND):
+            item.update(ph='i', s='p', name=('resume ' if ev == EV_RESUME else 'suspend ') + name_of(arg0))
+        elif ev in (EV_IPC_TRYTAKE, EV_IPC_TAKE, EV_IPC_PUT):
+            op = {EV_IPC_TRYTAKE: 'trytake ', EV_IPC_TAKE: 'take ', EV_IPC_PUT: 'put '}[ev]
+            item.update(ph='i', s='t', tid=1, name=op + name_of(arg0), args={'thread': name_of(arg1)})
+        elif ev in (EV_TIMER_ENTER, EV_TIMER_EXIT):
+            item.update(ph='B' if ev == EV_TIMER_ENTER else 'E', tid=2, name='timer ' + name_of(arg0))
+        elif ev in (EV_ISR_ENTER, EV_ISR_LEAVE):
+            item.update(ph='B' if ev == EV_ISR_ENTER else 'E', tid=3, name='isr')
+        elif ev == EV_MARK:
+            item.update(ph='i', s='g', tid=4, name='mark %d' % arg16, args={'value': arg0, 'thread': name_of(arg1)})
+        else:
+            continue
+        out.append(item)
+
+    meta = []
+    for cpu in sorted(set(e[2] for e in events)):
+        meta.append({'ph': 'M', 'pid': cpu, 'name': 'process_name', 'args': {'name': 'cpu%d' % cpu}})
+        for tid, name in enumerate(['thread', 'ipc', 'timer', 'isr', 'mark']):
+            meta.append({'ph': 'M', 'pid': cpu, 'tid': tid, 'name': 'thread_name', 'args': {'name': name}})
+
+    return {'traceEvents': meta + out, 'displayTimeUnit': 'ns'}
+
+def main():
+    if len(sys.argv) < 2:
+        print('usage: %s <trace.bin | console.log> [output.json]' % sys.argv[0])
+        return 1
+
+    res_ps, names, events = parse_stream(load_stream(sys.argv[1]))
+    trace = convert(res_ps, names, events)
+
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], 'w') as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,518 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-13     luhuadong    the first version
+ * 2020-11-20     luhuadong    count and report the dropped and truncated logs
+ */
+
+#include <rthw.h>
+#include <ulog.h>
+
+#ifdef ULOG_BACKEND_USING_FILE
+
+#include <dfs_posix.h>
+
+#ifndef ULOG_USING_ASYNC_OUTPUT
+#error "The file backend must using async output (ULOG_USING_ASYNC_OUTPUT), so the log never blocks on file system"
+#endif
+
+#if ULOG_FILE_BE_BUF_SIZE < ULOG_LINE_BUF_SIZE || ULOG_FILE_BE_BUF_SIZE > 65535
+#error "The file backend buffer size must between ULOG_LINE_BUF_SIZE and 65535"
+#endif
+
+#if (ULOG_FILE_BE_ALIGN & (ULOG_FILE_BE_ALIGN - 1)) || ULOG_FILE_BE_ALIGN < 4
+#error "The file backend chunk align must be power of 2 and not less than 4"
+#endif
+
+/**
+ * The log file is composed by chunks, every chunk starts at the align offset:
+ *
+ * | chunk header | data (LZ4 block or raw) | padding to ULOG_FILE_BE_ALIGN |
+ *
+ * One chunk is written by one write() and synced, the torn chunk on power loss
+ * can be found by the crc, the reader skips it and searches the next align offset.
+ */
+#define ULOG_FILE_CHUNK_MAGIC          0x43464C55      /* "ULFC" */
+#define ULOG_FILE_CHUNK_LZ4            (1 << 0)        /* data is LZ4 block */
+#define ULOG_FILE_CHUNK_BIN            (1 << 1)        /* records are binary log frames */
+
+struct ulog_file_chunk
+{
+    rt_uint32_t magic;
+    rt_uint16_t flags;
+    rt_uint16_t raw_len;                               /* length of records before compressing */
+    rt_uint32_t data_len;                              /* length of data in this chunk */
+    rt_uint32_t crc;                                   /* crc32 of data */
+};
+
+/* the max length of LZ4 compressed block */
+#define LZ4_BOUND(len)                 ((len) + (len) / 255 + 16)
+#define LZ4_HASH_LOG                   10
+#define LZ4_MIN_MATCH                  4
+#define LZ4_LAST_LITERALS              5
+#define LZ4_MF_LIMIT                   12
+
+#define CHUNK_BUF_SIZE                 RT_ALIGN(sizeof(struct ulog_file_chunk) + LZ4_BOUND(ULOG_FILE_BE_BUF_SIZE), \
+                                                ULOG_FILE_BE_ALIGN)
+
+struct ulog_file_be
+{
+    struct ulog_backend parent;
+    int fd;
+    rt_size_t file_size;
+    /* the records are collected on it */
+    rt_uint8_t *raw_buf;
+    rt_size_t raw_len;
+    rt_uint16_t raw_flags;
+    rt_uint16_t raw_count;
+    /* the chunk is packed on it */
+    rt_uint8_t *chunk_buf;
+#ifdef ULOG_FILE_BE_USING_COMPRESS
+    rt_uint16_t *hash_table;
+#endif
+    struct ulog_file_be_stats stats;
+    /* the dropped and truncated logs which are already reported to file */
+    rt_uint32_t dropped_reported;
+    rt_uint32_t truncated_reported;
+    /* the async output thread and ulog_flush caller */
+    struct rt_mutex lock;
+};
+
+static struct ulog_file_be file_be;
+
+static rt_uint32_t ulog_file_crc32(const rt_uint8_t *buf, rt_size_t len)
+{
+    rt_uint32_t crc = 0xFFFFFFFF;
+    int i;
+
+    while (len--)
+    {
+        crc ^= *buf++;
+        for (i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+
+    return ~crc;
+}
+
+#ifdef ULOG_FILE_BE_USING_COMPRESS
+static rt_uint32_t lz4_read32(const rt_uint8_t *p)
+{
+    rt_uint32_t value;
+
+    rt_memcpy(&value, p, sizeof(value));
+
+    return value;
+}
+
+static rt_uint8_t *lz4_write_len(rt_uint8_t *op, rt_size_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (rt_uint8_t)len;
+
+    return op;
+}
+
+/**
+ * compress a block by LZ4 block format with greedy matching
+ *
+ * @param src the source data, the length must less than 64KB
+ * @param len the source length
+ * @param dst the destination buffer, it has LZ4_BOUND(len) bytes at least
+ * @param table the hash table, (1 << LZ4_HASH_LOG) entries
+ *
+ * @return the compressed length
+ */
+static rt_size_t lz4_compress(const rt_uint8_t *src, rt_size_t len, rt_uint8_t *dst, rt_uint16_t *table)
+{
+    const rt_uint8_t *ip = src, *anchor = src, *ref, *iend = src + len;
+    rt_uint8_t *op = dst, *token;
+    rt_uint32_t seq, hash;
+    rt_size_t lit_len, match_len;
+
+    rt_memset(table, 0, sizeof(rt_uint16_t) << LZ4_HASH_LOG);
+
+    if (len > LZ4_MF_LIMIT)
+    {
+        while (ip < iend - LZ4_MF_LIMIT)
+        {
+            seq = lz4_read32(ip);
+            hash = (seq * 2654435761U) >> (32 - LZ4_HASH_LOG);
+            ref = src + table[hash];
+            table[hash] = (rt_uint16_t)(ip - src);
+
+            if (ref >= ip || lz4_read32(ref) != seq)
+            {
+                ip++;
+                continue;
+            }
+
+            /* extend the match, the last literals must be kept */
+            match_len = LZ4_MIN_MATCH;
+            while (ip + match_len < iend - LZ4_LAST_LITERALS && ip[match_len] == ref[match_len])
+            {
+                match_len++;
+            }
+
+            /* literal length and literals */
+            lit_len = ip - anchor;
+            token = op++;
+            if (lit_len >= 15)
+            {
+                *token = 15 << 4;
+                op = lz4_write_len(op, lit_len - 15);
+            }
+            else
+            {
+                *token = (rt_uint8_t)(lit_len << 4);
+            }
+            rt_memcpy(op, anchor, lit_len);
+            op += lit_len;
+
+            /* offset and match length */
+            *op++ = (rt_uint8_t)(ip - ref);
+            *op++ = (rt_uint8_t)((ip - ref) >> 8);
+            if (match_len - LZ4_MIN_MATCH >= 15)
+            {
+                *token |= 15;
+                op = lz4_write_len(op, match_len - LZ4_MIN_MATCH - 15);
+            }
+            else
+            {
+                *token |= (rt_uint8_t)(match_len - LZ4_MIN_MATCH);
+            }
+
+            ip += match_len;
+            anchor = ip;
+        }
+    }
+
+    /* the last literals */
+    lit_len = iend - anchor;
+    token = op++;
+    if (lit_len >= 15)
+    {
+        *token = 15 << 4;
+        op = lz4_write_len(op, lit_len - 15);
+    }
+    else
+    {
+        *token = (rt_uint8_t)(lit_len << 4);
+    }
+    rt_memcpy(op, anchor, lit_len);
+    op += lit_len;
+
+    return op - dst;
+}
+#endif /* ULOG_FILE_BE_USING_COMPRESS */
+
+/* rotate the log files, the newest one is the ULOG_FILE_BE_FILE_NAME */
+static void ulog_file_rotate(struct ulog_file_be *be)
+{
+    char old_path[sizeof(ULOG_FILE_BE_DIR_PATH "/" ULOG_FILE_BE_FILE_NAME) + 4];
+    char new_path[sizeof(old_path)];
+    int i;
+
+    close(be->fd);
+    be->fd = -1;
+
+    rt_snprintf(new_path, sizeof(new_path), "%s/%s.%d", ULOG_FILE_BE_DIR_PATH, ULOG_FILE_BE_FILE_NAME,
+            ULOG_FILE_BE_MAX_FILES - 1);
+    unlink(new_path);
+
+    for (i = ULOG_FILE_BE_MAX_FILES - 1; i > 0; i--)
+    {
+        if (i > 1)
+        {
+            rt_snprintf(old_path, sizeof(old_path), "%s/%s.%d", ULOG_FILE_BE_DIR_PATH, ULOG_FILE_BE_FILE_NAME, i - 1);
+        }
+        else
+        {
+            rt_snprintf(old_path, sizeof(old_path), "%s/%s", ULOG_FILE_BE_DIR_PATH, ULOG_FILE_BE_FILE_NAME);
+        }
+        rt_snprintf(new_path, sizeof(new_path), "%s/%s.%d", ULOG_FILE_BE_DIR_PATH, ULOG_FILE_BE_FILE_NAME, i);
+        rename(old_path, new_path);
+    }
+
+#if ULOG_FILE_BE_MAX_FILES == 1
+    rt_snprintf(old_path, sizeof(old_path), "%s/%s", ULOG_FILE_BE_DIR_PATH, ULOG_FILE_BE_FILE_NAME);
+    unlink(old_path);
+#endif
+}
+
+/* open the log file, the file system maybe mounted after the backend is registered */
+static rt_err_t ulog_file_open(struct ulog_file_be *be)
+{
+    struct stat file_stat;
+
+    if (be->fd >= 0)
+        return RT_EOK;
+
+    if (stat(ULOG_FILE_BE_DIR_PATH, &file_stat) < 0 && mkdir(ULOG_FILE_BE_DIR_PATH, 0) < 0)
+        return -RT_ERROR;
+
+    be->fd = open(ULOG_FILE_BE_DIR_PATH "/" ULOG_FILE_BE_FILE_NAME, O_RDWR | O_CREAT, 0);
+    if (be->fd < 0)
+        return -RT_ERROR;
+
+    be->file_size = lseek(be->fd, 0, SEEK_END);
+    /* drop the torn tail, so the new chunk starts at the align offset */
+    if (be->file_size & (ULOG_FILE_BE_ALIGN - 1))
+    {
+        be->stats.torn_bytes += be->file_size & (ULOG_FILE_BE_ALIGN - 1);
+        be->file_size &= ~(ULOG_FILE_BE_ALIGN - 1);
+        ftruncate(be->fd, be->file_size);
+        lseek(be->fd, be->file_size, SEEK_SET);
+    }
+
+    return RT_EOK;
+}
+
+/* the records of the chunk are lost, count them */
+static void ulog_file_drop(rt_uint32_t *counter, rt_uint16_t count)
+{
+    static rt_bool_t already_output = RT_FALSE;
+
+    *counter += count;
+    if (already_output == RT_FALSE)
+    {
+        rt_kprintf("Warning: ulog file backend can not write %s, the logs are dropped until it's available.\n",
+                ULOG_FILE_BE_DIR_PATH "/" ULOG_FILE_BE_FILE_NAME);
+        already_output = RT_TRUE;
+    }
+}
+
+/* pack the collected records to a chunk and write it to file */
+static void ulog_file_commit(struct ulog_file_be *be)
+{
+    rt_uint16_t count = be->raw_count;
+    struct ulog_file_chunk *chunk = (struct ulog_file_chunk *)be->chunk_buf;
+    rt_uint8_t *data = be->chunk_buf + sizeof(struct ulog_file_chunk);
+    rt_size_t chunk_len;
+
+    if (be->raw_len == 0)
+        return;
+
+    chunk->magic = ULOG_FILE_CHUNK_MAGIC;
+    chunk->flags = be->raw_flags;
+    chunk->raw_len = (rt_uint16_t)be->raw_len;
+
+#ifdef ULOG_FILE_BE_USING_COMPRESS
+    chunk->data_len = lz4_compress(be->raw_buf, be->raw_len, data, be->hash_table);
+    if (chunk->data_len < be->raw_len)
+    {
+        chunk->flags |= ULOG_FILE_CHUNK_LZ4;
+    }
+    else
+#endif
+    {
+        /* not compressible, store the raw records */
+        chunk->data_len = be->raw_len;
+        rt_memcpy(data, be->raw_buf, be->raw_len);
+    }
+    chunk->crc = ulog_file_crc32(data, chunk->data_len);
+
+    /* fill the padding, it will be written as a part of chunk */
+    chunk_len = RT_ALIGN(sizeof(struct ulog_file_chunk) + chunk->data_len, ULOG_FILE_BE_ALIGN);
+    rt_memset(data + chunk->data_len, 0xFF, chunk_len - sizeof(struct ulog_file_chunk) - chunk->data_len);
+
+    be->raw_len = 0;
+    be->raw_count = 0;
+
+    /* the file system is not mounted yet or it's unmounted */
+    if (ulog_file_open(be) != RT_EOK)
+    {
+        ulog_file_drop(&be->stats.unavailable, count);
+        return;
+    }
+
+    if (be->file_size + chunk_len > ULOG_FILE_BE_MAX_SIZE && be->file_size > 0)
+    {
+        ulog_file_rotate(be);
+        if (ulog_file_open(be) != RT_EOK)
+        {
+            ulog_file_drop(&be->stats.unavailable, count);
+            return;
+        }
+    }
+
+    if (write(be->fd, be->chunk_buf, chunk_len) != (int)chunk_len)
+    {
+        /* the chunk is torn, it will be skipped by reader */
+        ulog_file_drop(&be->stats.write_failed, count);
+        close(be->fd);
+        be->fd = -1;
+        return;
+    }
+    /* only the complete chunk is committed */
+    fsync(be->fd);
+    be->file_size += chunk_len;
+}
+
+/* collect one record, commit the chunk when it's full */
+static void ulog_file_collect(struct ulog_file_be *be, rt_uint16_t flags, const void *rec, rt_size_t len)
+{
+    if (len > ULOG_FILE_BE_BUF_SIZE)
+    {
+        len = ULOG_FILE_BE_BUF_SIZE;
+        be->stats.truncated++;
+    }
+
+    /* the records in one chunk have the same type */
+    if (be->raw_len + len > ULOG_FILE_BE_BUF_SIZE || (be->raw_len && be->raw_flags != flags))
+    {
+        ulog_file_commit(be);
+    }
+
+    be->raw_flags = flags;
+    rt_memcpy(be->raw_buf + be->raw_len, rec, len);
+    be->raw_len += len;
+    be->raw_count++;
+}
+
+/* write a record about the lost logs into the file once it's available again */
+static void ulog_file_report(struct ulog_file_be *be)
+{
+    char log_buf[80];
+    rt_uint32_t dropped, truncated;
+    rt_size_t log_len;
+
+    dropped = be->stats.unavailable + be->stats.write_failed;
+    truncated = be->stats.truncated;
+    if (be->fd < 0 || (dropped == be->dropped_reported && truncated == be->truncated_reported))
+        return;
+
+    log_len = rt_snprintf(log_buf, sizeof(log_buf), "ulog file: %d logs are dropped, %d are truncated" ULOG_NEWLINE_SIGN,
+            dropped - be->dropped_reported, truncated - be->truncated_reported);
+    be->dropped_reported = dropped;
+    be->truncated_reported = truncated;
+    ulog_file_collect(be, 0, log_buf, log_len);
+}
+
+static void ulog_file_backend_output(struct ulog_backend *backend, rt_uint32_t level, const char *tag,
+        rt_bool_t is_raw, const char *log, size_t len)
+{
+    struct ulog_file_be *be = (struct ulog_file_be *)backend;
+
+    rt_mutex_take(&be->lock, RT_WAITING_FOREVER);
+    ulog_file_report(be);
+    ulog_file_collect(be, 0, log, len);
+    rt_mutex_release(&be->lock);
+}
+
+#ifdef ULOG_USING_BINARY
+static void ulog_file_backend_output_bin(struct ulog_backend *backend, const struct ulog_bin_frame *frame,
+        size_t len)
+{
+    struct ulog_file_be *be = (struct ulog_file_be *)backend;
+
+    rt_mutex_take(&be->lock, RT_WAITING_FOREVER);
+    ulog_file_report(be);
+    ulog_file_collect(be, ULOG_FILE_CHUNK_BIN, frame, len);
+    rt_mutex_release(&be->lock);
+}
+#endif
+
+static void ulog_file_backend_flush(struct ulog_backend *backend)
+{
+    struct ulog_file_be *be = (struct ulog_file_be *)backend;
+
+    rt_mutex_take(&be->lock, RT_WAITING_FOREVER);
+    ulog_file_commit(be);
+    rt_mutex_release(&be->lock);
+}
+
+static void ulog_file_backend_deinit(struct ulog_backend *backend)
+{
+    struct ulog_file_be *be = (struct ulog_file_be *)backend;
+
+    rt_mutex_take(&be->lock, RT_WAITING_FOREVER);
+    ulog_file_commit(be);
+    if (be->fd >= 0)
+    {
+        close(be->fd);
+        be->fd = -1;
+    }
+    rt_mutex_release(&be->lock);
+}
+
+/**
+ * get the statistics of the logs which are dropped or truncated by file backend
+ *
+ * @param stats the statistics buffer
+ */
+void ulog_file_backend_stats_get(struct ulog_file_be_stats *stats)
+{
+    RT_ASSERT(stats);
+
+    rt_mutex_take(&file_be.lock, RT_WAITING_FOREVER);
+    *stats = file_be.stats;
+    rt_mutex_release(&file_be.lock);
+}
+
+int ulog_file_backend_init(void)
+{
+    ulog_init();
+
+    file_be.fd = -1;
+    file_be.raw_buf = rt_malloc(ULOG_FILE_BE_BUF_SIZE);
+    file_be.chunk_buf = rt_malloc(CHUNK_BUF_SIZE);
+#ifdef ULOG_FILE_BE_USING_COMPRESS
+    file_be.hash_table = rt_malloc(sizeof(rt_uint16_t) << LZ4_HASH_LOG);
+    if (file_be.hash_table == RT_NULL)
+    {
+        rt_free(file_be.raw_buf);
+        file_be.raw_buf = RT_NULL;
+    }
+#endif
+    if (file_be.raw_buf == RT_NULL || file_be.chunk_buf == RT_NULL)
+    {
+        rt_kprintf("Error: ulog file backend init failed! No memory for buffer.\n");
+        rt_free(file_be.raw_buf);
+        rt_free(file_be.chunk_buf);
+        return -RT_ENOMEM;
+    }
+    rt_mutex_init(&file_be.lock, "ulog_fbe", RT_IPC_FLAG_FIFO);
+
+    file_be.parent.output = ulog_file_backend_output;
+#ifdef ULOG_USING_BINARY
+    file_be.parent.output_bin = ulog_file_backend_output_bin;
+#endif
+    file_be.parent.flush = ulog_file_backend_flush;
+    file_be.parent.deinit = ulog_file_backend_deinit;
+
+    ulog_backend_register(&file_be.parent, "file", RT_FALSE);
+
+    return 0;
+}
+INIT_PREV_EXPORT(ulog_file_backend_init);
+
+#if defined(RT_USING_FINSH) && defined(FINSH_USING_MSH)
+#include <finsh.h>
+
+static int ulog_file_stat(void)
+{
+    struct ulog_file_be_stats stats;
+
+    ulog_file_backend_stats_get(&stats);
+    rt_kprintf("dropped when file is unavailable: %d\n", stats.unavailable);
+    rt_kprintf("dropped by failed write         : %d\n", stats.write_failed);
+    rt_kprintf("truncated to buffer size        : %d\n", stats.truncated);
+    rt_kprintf("torn tail bytes dropped on open : %d\n", stats.torn_bytes);
+
+    return 0;
+}
+MSH_CMD_EXPORT(ulog_file_stat, show the dropped and truncated logs of ulog file backend);
+#endif /* defined(RT_USING_FINSH) && defined(FINSH_USING_MSH) */
+
+#endif /* ULOG_BACKEND_USING_FILE */
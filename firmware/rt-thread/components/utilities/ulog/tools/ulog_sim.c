@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * ulog_sim runs ulog with the async output on the host, some threads log as
+ * fast as they can, and a high priority thread logs one line every 1ms. It
+ * prints the throughput of the loggers and the time of each log call of the
+ * high priority thread, for 1, 2, 4 and 8 loggers.
+ *
+ * The kernel is modelled by POSIX threads: rt_mutex is a mutex with the
+ * priority inheritance, the interrupt disabling is a global mutex, the async
+ * output thread is a normal thread, and the high priority thread is a
+ * SCHED_FIFO thread when it is allowed. Run it on one CPU (e.g. taskset 1)
+ * to have the preemption of a single core MCU: the high priority thread
+ * preempts a logger which is formatting the log with the output locker.
+ *
+ * Every line is checked by the backend: the thread name must be the one of
+ * the logger in the line, and the sequence of each logger must be increasing.
+ *
+ * ulog is built into this program with the configuration in rtconfig.h, with
+ * and without the lockless output:
+ *
+ *   gcc -O2 -std=gnu99 -I. -I.. -I../../../../include -I../../../drivers/include ulog_sim.c -o ulog_sim_locked -lpthread
+ *   gcc -O2 -std=gnu99 -DULOG_USING_LOCKLESS -I. -I.. -I../../../../include -I../../../drivers/include ulog_sim.c -o ulog_sim -lpthread
+ *
+ * usage: ulog_sim [milliseconds of each run]
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "../ulog.c"
+#include "../../../drivers/src/ringblk_buf.c"
+
+#define SIM_LOGGERS_MAX     8
+#define SIM_HIGH_PERIOD_NS  1000000
+
+struct sim_sem
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    unsigned int value;
+};
+
+struct sim_thread
+{
+    struct rt_thread parent;
+    pthread_t tid;
+};
+
+static pthread_mutex_t irq_lock;
+static pthread_mutex_t output_mutex;
+static struct sim_sem async_sem;
+static __thread rt_thread_t thread_self;
+
+static volatile int stop;
+static unsigned long logged[SIM_LOGGERS_MAX];
+static unsigned int last_seq[SIM_LOGGERS_MAX + 1];
+static unsigned int logger_seq[SIM_LOGGERS_MAX + 1];
+static struct rt_thread logger_threads[SIM_LOGGERS_MAX + 1];
+static unsigned long received, bad_lines;
+static int failed;
+
+/* the stubs of kernel for ulog, there is only one mutex and one semaphore */
+void *rt_malloc(rt_size_t size) { return malloc(size); }
+void rt_free(void *ptr) { free(ptr); }
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count) { return memcpy(dst, src, count); }
+void *rt_memset(void *s, int c, rt_ubase_t count) { return memset(s, c, count); }
+rt_size_t rt_strlen(const char *s) { return strlen(s); }
+rt_size_t rt_strnlen(const char *s, rt_ubase_t maxlen) { return strnlen(s, maxlen); }
+char *rt_strncpy(char *dst, const char *src, rt_ubase_t n) { return strncpy(dst, src, n); }
+rt_int32_t rt_strncmp(const char *cs, const char *ct, rt_ubase_t count) { return strncmp(cs, ct, count); }
+char *rt_strstr(const char *s1, const char *s2) { return strstr(s1, s2); }
+rt_uint8_t rt_interrupt_get_nest(void) { return 0; }
+rt_thread_t rt_thread_self(void) { return thread_self; }
+
+rt_int32_t rt_vsnprintf(char *buf, rt_size_t size, const char *fmt, va_list args)
+{
+    return vsnprintf(buf, size, fmt, args);
+}
+
+rt_int32_t rt_snprintf(char *buf, rt_size_t size, const char *fmt, ...)
+{
+    va_list args;
+    rt_int32_t n;
+
+    va_start(args, fmt);
+    n = vsnprintf(buf, size, fmt, args);
+    va_end(args);
+
+    return n;
+}
+
+static rt_uint64_t sim_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (rt_uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+rt_tick_t rt_tick_get(void)
+{
+    return (rt_tick_t)(sim_now_ns() / 1000000);
+}
+
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    pthread_mutex_lock(&irq_lock);
+
+    return 0;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+    pthread_mutex_unlock(&irq_lock);
+}
+
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag) { return RT_EOK; }
+rt_err_t rt_mutex_detach(rt_mutex_t mutex) { return RT_EOK; }
+
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
+{
+    pthread_mutex_lock(&output_mutex);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_release(rt_mutex_t mutex)
+{
+    pthread_mutex_unlock(&output_mutex);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag)
+{
+    async_sem.value = value;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
+{
+    pthread_mutex_lock(&async_sem.lock);
+    while (async_sem.value == 0)
+        pthread_cond_wait(&async_sem.cond, &async_sem.lock);
+    async_sem.value--;
+    pthread_mutex_unlock(&async_sem.lock);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_release(rt_sem_t sem)
+{
+    pthread_mutex_lock(&async_sem.lock);
+    async_sem.value++;
+    pthread_cond_signal(&async_sem.cond);
+    pthread_mutex_unlock(&async_sem.lock);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_control(rt_sem_t sem, int cmd, void *arg)
+{
+    pthread_mutex_lock(&async_sem.lock);
+    async_sem.value = 0;
+    pthread_mutex_unlock(&async_sem.lock);
+
+    return RT_EOK;
+}
+
+static void *sim_thread_entry(void *param)
+{
+    rt_thread_t thread = param;
+
+    thread_self = thread;
+    ((void (*)(void *))thread->entry)(thread->parameter);
+
+    return NULL;
+}
+
+rt_thread_t rt_thread_create(const char *name, void (*entry)(void *parameter), void *parameter,
+        rt_uint32_t stack_size, rt_uint8_t priority, rt_uint32_t tick)
+{
+    struct sim_thread *thread = calloc(1, sizeof(struct sim_thread));
+
+    snprintf(thread->parent.name, RT_NAME_MAX, "%.*s", RT_NAME_MAX - 1, name);
+    thread->parent.entry = (void *)entry;
+    thread->parent.parameter = parameter;
+
+    return &thread->parent;
+}
+
+rt_err_t rt_thread_startup(rt_thread_t thread)
+{
+    pthread_create(&((struct sim_thread *)thread)->tid, NULL, sim_thread_entry, thread);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_delete(rt_thread_t thread)
+{
+    return RT_EOK;
+}
+
+/* the backend checks the thread name and the sequence of every line */
+static void sim_backend_output(struct ulog_backend *backend, rt_uint32_t level, const char *tag, rt_bool_t is_raw,
+        const char *log, size_t len)
+{
+    char line[ULOG_LINE_BUF_SIZE + 1];
+    const char *name;
+    int name_index, index;
+    unsigned int seq;
+
+    received++;
+    if (is_raw)
+        return;
+
+    memcpy(line, log, len);
+    line[len] = '\0';
+    name = strstr(line, " log");
+    if (name == NULL || sscanf(name, " log%d: logger %d seq %u", &name_index, &index, &seq) != 3
+            || name_index != index || index < 0 || index > SIM_LOGGERS_MAX || seq <= last_seq[index]
+            || strcmp(line + len - 2, ULOG_NEWLINE_SIGN) != 0)
+    {
+        if (bad_lines++ == 0)
+            printf("bad line: %s\n", line);
+        return;
+    }
+    last_seq[index] = seq;
+}
+
+static struct ulog_backend sim_backend = { .output = sim_backend_output };
+
+static void sim_thread_init(int index)
+{
+    snprintf(logger_threads[index].name, RT_NAME_MAX, "log%d", index);
+    thread_self = &logger_threads[index];
+}
+
+static void *sim_logger(void *param)
+{
+    int index = (int)(long)param;
+
+    sim_thread_init(index);
+    while (!stop)
+    {
+        ulog_output(LOG_LVL_INFO, "app", RT_TRUE, "logger %d seq %u", index, ++logger_seq[index]);
+        logged[index]++;
+    }
+
+    return NULL;
+}
+
+struct sim_high
+{
+    unsigned long calls;
+    rt_uint64_t total_ns;
+    rt_uint64_t max_ns;
+};
+
+/* logs one line every period, the time of each call is counted */
+static void *sim_high_logger(void *param)
+{
+    struct sim_high *high = param;
+    struct timespec next;
+    rt_uint64_t start, ns;
+
+    sim_thread_init(SIM_LOGGERS_MAX);
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!stop)
+    {
+        next.tv_nsec += SIM_HIGH_PERIOD_NS;
+        if (next.tv_nsec >= 1000000000)
+        {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+
+        start = sim_now_ns();
+        ulog_output(LOG_LVL_WARNING, "app", RT_TRUE, "logger %d seq %u", SIM_LOGGERS_MAX,
+                ++logger_seq[SIM_LOGGERS_MAX]);
+        ns = sim_now_ns() - start;
+
+        high->calls++;
+        high->total_ns += ns;
+        if (ns > high->max_ns)
+            high->max_ns = ns;
+    }
+
+    return NULL;
+}
+
+static void sim_run(int loggers, int run_ms, int *fifo)
+{
+    pthread_t tids[SIM_LOGGERS_MAX], high_tid;
+    pthread_attr_t attr;
+    struct sched_param sp = { .sched_priority = 10 };
+    struct sim_high high = { 0 };
+    rt_uint32_t dropped = ulog_async_dropped_get();
+    unsigned long total = 0, output = received;
+    int index;
+
+    stop = 0;
+    memset(logged, 0, sizeof(logged));
+    for (index = 0; index < loggers; index++)
+        pthread_create(&tids[index], NULL, sim_logger, (void *)(long)index);
+
+    /* the high priority thread is a normal thread if SCHED_FIFO isn't allowed */
+    pthread_attr_init(&attr);
+    if (*fifo)
+    {
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &sp);
+    }
+    if (pthread_create(&high_tid, &attr, sim_high_logger, &high) != 0)
+    {
+        *fifo = 0;
+        pthread_create(&high_tid, NULL, sim_high_logger, &high);
+    }
+    pthread_attr_destroy(&attr);
+
+    usleep(run_ms * 1000);
+    stop = 1;
+    for (index = 0; index < loggers; index++)
+    {
+        pthread_join(tids[index], NULL);
+        total += logged[index];
+    }
+    pthread_join(high_tid, NULL);
+
+    /* wait for the async output thread */
+    usleep(100 * 1000);
+
+    printf("%7d %10.0f %10.0f %9u %9lu %10.2f %10.2f\n", loggers, total * 1000.0 / run_ms,
+            (received - output) * 1000.0 / run_ms, ulog_async_dropped_get() - dropped, high.calls,
+            high.calls ? high.total_ns / 1000.0 / high.calls : 0, high.max_ns / 1000.0);
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_mutexattr_t attr;
+    cpu_set_t cpus;
+    int run_ms = 1000, fifo = 1, loggers;
+
+    if (argc > 1)
+        run_ms = atoi(argv[1]);
+
+    /* the interrupt disabling is nestable, the output locker has the priority inheritance */
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&irq_lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&output_mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_mutex_init(&async_sem.lock, NULL);
+    pthread_cond_init(&async_sem.cond, NULL);
+
+    ulog_init();
+    ulog_backend_register(&sim_backend, "sim", RT_FALSE);
+
+    sched_getaffinity(0, sizeof(cpus), &cpus);
+#ifdef ULOG_USING_LOCKLESS
+    printf("lockless output, %d CPU, %dms each run\n\n", CPU_COUNT(&cpus), run_ms);
+#else
+    printf("locked output, %d CPU, %dms each run\n\n", CPU_COUNT(&cpus), run_ms);
+#endif
+    printf("%7s %10s %10s %9s %9s %10s %10s\n", "loggers", "logs/s", "output/s", "dropped", "high", "high avg",
+            "high max");
+    for (loggers = 1; loggers <= SIM_LOGGERS_MAX; loggers *= 2)
+        sim_run(loggers, run_ms, &fifo);
+
+    printf("\n%lu lines are received, the high priority thread is %s\n", received,
+            fifo ? "SCHED_FIFO" : "SCHED_OTHER, the preemption isn't modelled");
+    if (bad_lines)
+    {
+        printf("FAIL, %lu lines are wrong\n", bad_lines);
+        failed = 1;
+    }
+    else
+    {
+        printf("PASS\n");
+    }
+
+    return failed;
+}
@@ -6,6 +6,10 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-08-25     armink       the first version
+ * 2020-11-11     luhuadong    add binary log mode, the formatting is deferred
+ *                             to async output or host
+ * 2020-11-12     luhuadong    add lockless output by per-thread staging buffer
+ *                             and the dropped log counter
  */
 
 #include <stdarg.h>
@@ -74,6 +78,13 @@
 #error "the log line buffer size must more than 80"
 #endif
 
+#ifdef ULOG_USING_LOCKLESS
+/* the formater is called by many threads at the same time without locker */
+#define ULOG_FORMATER_STATIC
+#else
+#define ULOG_FORMATER_STATIC           static
+#endif
+
 struct rt_ulog
 {
     rt_bool_t init_ok;
@@ -93,6 +104,9 @@ struct rt_ulog
     rt_rbb_t async_rbb;
     rt_thread_t async_th;
     struct rt_semaphore async_notice;
+    /* the number of logs which are dropped when async buffer is full */
+    rt_uint32_t async_dropped;
+    rt_uint32_t async_dropped_reported;
 #endif
 
 #ifdef ULOG_USING_FILTER
@@ -232,9 +246,9 @@ static char *get_log_buf(void)
 RT_WEAK rt_size_t ulog_formater(char *log_buf, rt_uint32_t level, const char *tag, rt_bool_t newline,
         const char *format, va_list args)
 {
-    /* the caller has locker, so it can use static variable for reduce stack usage */
-    static rt_size_t log_len, newline_len;
-    static int fmt_result;
+    /* the caller has locker, so it can use static variable for reduce stack usage (not for lockless output) */
+    ULOG_FORMATER_STATIC rt_size_t log_len, newline_len;
+    ULOG_FORMATER_STATIC int fmt_result;
 
     RT_ASSERT(log_buf);
     RT_ASSERT(level <= LOG_LVL_DBG);
@@ -257,8 +271,8 @@ RT_WEAK rt_size_t ulog_formater(char *log_buf, rt_uint32_t level, const char *ta
     /* add time info */
     {
 #ifdef ULOG_TIME_USING_TIMESTAMP
-        static time_t now;
-        static struct tm *tm, tm_tmp;
+        ULOG_FORMATER_STATIC time_t now;
+        ULOG_FORMATER_STATIC struct tm *tm, tm_tmp;
 
         now = time(NULL);
         tm = gmtime_r(&now, &tm_tmp);
@@ -272,7 +286,7 @@ RT_WEAK rt_size_t ulog_formater(char *log_buf, rt_uint32_t level, const char *ta
 #endif /* RT_USING_SOFT_RTC */
 
 #else
-        static rt_size_t tick_len = 0;
+        ULOG_FORMATER_STATIC rt_size_t tick_len = 0;
 
         log_buf[log_len] = '[';
         tick_len = ulog_ultoa(log_buf + log_len + 1, rt_tick_get());
@@ -381,6 +395,32 @@ RT_WEAK rt_size_t ulog_formater(char *log_buf, rt_uint32_t level, const char *ta
     return log_len;
 }
 
+static void ulog_output_to_backend(ulog_backend_t backend, rt_uint32_t level, const char *tag, rt_bool_t is_raw,
+        const char *log, rt_size_t size)
+{
+#if !defined(ULOG_USING_COLOR) || defined(ULOG_USING_SYSLOG)
+    backend->output(backend, level, tag, is_raw, log, size);
+#else
+    if (backend->support_color || is_raw)
+    {
+        backend->output(backend, level, tag, is_raw, log, size);
+    }
+    else
+    {
+        /* recalculate the log start address and log size when backend not supported color */
+        rt_size_t color_info_len = rt_strlen(color_output_info[level]), output_size = size;
+        if (color_info_len)
+        {
+            rt_size_t color_hdr_len = rt_strlen(CSI_START) + color_info_len;
+
+            log += color_hdr_len;
+            output_size -= (color_hdr_len + (sizeof(CSI_END) - 1));
+        }
+        backend->output(backend, level, tag, is_raw, log, output_size);
+    }
+#endif /* !defined(ULOG_USING_COLOR) || defined(ULOG_USING_SYSLOG) */
+}
+
 void ulog_output_to_all_backend(rt_uint32_t level, const char *tag, rt_bool_t is_raw, const char *log, rt_size_t size)
 {
     rt_slist_t *node;
@@ -393,30 +433,21 @@ void ulog_output_to_all_backend(rt_uint32_t level, const char *tag, rt_bool_t is
     for (node = rt_slist_first(&ulog.backend_list); node; node = rt_slist_next(node))
     {
         backend = rt_slist_entry(node, struct ulog_backend, list);
-#if !defined(ULOG_USING_COLOR) || defined(ULOG_USING_SYSLOG)
-        backend->output(backend, level, tag, is_raw, log, size);
-#else
-        if (backend->support_color || is_raw)
-        {
-            backend->output(backend, level, tag, is_raw, log, size);
-        }
-        else
-        {
-            /* recalculate the log start address and log size when backend not supported color */
-            rt_size_t color_info_len = rt_strlen(color_output_info[level]), output_size = size;
-            if (color_info_len)
-            {
-                rt_size_t color_hdr_len = rt_strlen(CSI_START) + color_info_len;
-
-                log += color_hdr_len;
-                output_size -= (color_hdr_len + (sizeof(CSI_END) - 1));
-            }
-            backend->output(backend, level, tag, is_raw, log, output_size);
-        }
-#endif /* !defined(ULOG_USING_COLOR) || defined(ULOG_USING_SYSLOG) */
+        ulog_output_to_backend(backend, level, tag, is_raw, log, size);
     }
 }
 
+#ifdef ULOG_USING_ASYNC_OUTPUT
+static void async_dropped_inc(void)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    ulog.async_dropped++;
+    rt_hw_interrupt_enable(level);
+}
+#endif /* ULOG_USING_ASYNC_OUTPUT */
+
 static void do_output(rt_uint32_t level, const char *tag, rt_bool_t is_raw, const char *log_buf, rt_size_t log_len)
 {
 #ifdef ULOG_USING_ASYNC_OUTPUT
@@ -445,6 +476,8 @@ static void do_output(rt_uint32_t level, const char *tag, rt_bool_t is_raw, cons
     else
     {
         static rt_bool_t already_output = RT_FALSE;
+
+        async_dropped_inc();
         if (already_output == RT_FALSE)
         {
             rt_kprintf("Warning: There is no enough buffer for saving async log,"
@@ -472,6 +505,548 @@ static void do_output(rt_uint32_t level, const char *tag, rt_bool_t is_raw, cons
 #endif /* ULOG_USING_ASYNC_OUTPUT */
 }
 
+#ifdef ULOG_USING_BINARY
+/* the argument type of conversion specification in binary log */
+enum ulog_bin_arg
+{
+    ULOG_BIN_ARG_NONE,
+    ULOG_BIN_ARG_INT,
+    ULOG_BIN_ARG_LONG,
+    ULOG_BIN_ARG_LLONG,
+    ULOG_BIN_ARG_PTR,
+    ULOG_BIN_ARG_DOUBLE,
+    ULOG_BIN_ARG_STR,
+};
+
+#ifdef ULOG_OUTPUT_FLOAT
+#define ulog_bin_snprintf              snprintf
+#else
+#define ulog_bin_snprintf              rt_snprintf
+#endif
+
+/**
+ * parse one conversion specification which is after the '%'
+ *
+ * @param fmt the specification
+ * @param type the argument type will be saved in
+ *
+ * @return the next character after the specification
+ */
+static const char *ulog_bin_parse_spec(const char *fmt, enum ulog_bin_arg *type)
+{
+    int qualifier = 0;
+
+    /* flags, width and precision */
+    while ((*fmt >= '0' && *fmt <= '9') || *fmt == '-' || *fmt == '+' || *fmt == ' ' || *fmt == '#'
+            || *fmt == '.' || *fmt == '*')
+    {
+        fmt++;
+    }
+
+    /* length modifier */
+    while (*fmt == 'h' || *fmt == 'l' || *fmt == 'L' || *fmt == 'z' || *fmt == 't' || *fmt == 'j')
+    {
+        if (*fmt == 'l' || *fmt == 'z' || *fmt == 't')
+            qualifier++;
+        else if (*fmt == 'j' || *fmt == 'L')
+            qualifier = 2;
+        fmt++;
+    }
+
+    switch (*fmt)
+    {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+        *type = qualifier == 0 ? ULOG_BIN_ARG_INT : (qualifier == 1 ? ULOG_BIN_ARG_LONG : ULOG_BIN_ARG_LLONG);
+        break;
+    case 'p':
+        *type = ULOG_BIN_ARG_PTR;
+        break;
+    case 's':
+        *type = ULOG_BIN_ARG_STR;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G':
+        *type = ULOG_BIN_ARG_DOUBLE;
+        break;
+    default:
+        *type = ULOG_BIN_ARG_NONE;
+        break;
+    }
+
+    return *fmt ? fmt + 1 : fmt;
+}
+
+/* pack one fixed size argument, return the packed size, 0 is no space */
+static rt_size_t ulog_bin_pack(rt_uint8_t *buf, rt_size_t size, const void *value, rt_size_t len)
+{
+    if (RT_ALIGN(len, 4) > size)
+        return 0;
+
+    rt_memcpy(buf, value, len);
+
+    return RT_ALIGN(len, 4);
+}
+
+/* copy the string to buffer, return the copied length */
+static rt_size_t ulog_bin_strcpy(char *buf, rt_size_t size, const char *src)
+{
+    rt_size_t len = 0;
+
+    while (src[len] != '\0' && len < size)
+    {
+        buf[len] = src[len];
+        len++;
+    }
+
+    return len;
+}
+
+/**
+ * pack the arguments by the format without formatting them
+ *
+ * @return the packed size
+ */
+static rt_size_t ulog_bin_pack_args(rt_uint8_t *buf, rt_size_t size, const char *format, va_list args)
+{
+    rt_size_t len = 0, pack_len;
+    enum ulog_bin_arg type;
+    const char *spec;
+
+    while (*format)
+    {
+        if (*format++ != '%')
+            continue;
+
+        spec = format;
+        format = ulog_bin_parse_spec(format, &type);
+
+        /* the '*' width and precision are int arguments before the value */
+        for (; spec < format; spec++)
+        {
+            if (*spec == '*')
+            {
+                int star = va_arg(args, int);
+
+                pack_len = ulog_bin_pack(buf + len, size - len, &star, sizeof(star));
+                if (pack_len == 0)
+                    return len;
+                len += pack_len;
+            }
+        }
+
+        switch (type)
+        {
+        case ULOG_BIN_ARG_INT:
+        {
+            int value = va_arg(args, int);
+            pack_len = ulog_bin_pack(buf + len, size - len, &value, sizeof(value));
+            break;
+        }
+        case ULOG_BIN_ARG_LONG:
+        {
+            long value = va_arg(args, long);
+            pack_len = ulog_bin_pack(buf + len, size - len, &value, sizeof(value));
+            break;
+        }
+        case ULOG_BIN_ARG_LLONG:
+        {
+            long long value = va_arg(args, long long);
+            pack_len = ulog_bin_pack(buf + len, size - len, &value, sizeof(value));
+            break;
+        }
+        case ULOG_BIN_ARG_PTR:
+        {
+            void *value = va_arg(args, void *);
+            pack_len = ulog_bin_pack(buf + len, size - len, &value, sizeof(value));
+            break;
+        }
+        case ULOG_BIN_ARG_DOUBLE:
+        {
+            double value = va_arg(args, double);
+            pack_len = ulog_bin_pack(buf + len, size - len, &value, sizeof(value));
+            break;
+        }
+        case ULOG_BIN_ARG_STR:
+        {
+            const char *str = va_arg(args, const char *);
+            rt_uint32_t str_len;
+
+            if (str == RT_NULL)
+                str = "(NULL)";
+            /* the string is copied, it maybe on the stack of caller */
+            if (size - len < sizeof(str_len) + 4)
+                return len;
+            str_len = rt_strnlen(str, size - len - sizeof(str_len) - 1) + 1;
+            rt_memcpy(buf + len + sizeof(str_len), str, str_len - 1);
+            buf[len + sizeof(str_len) + str_len - 1] = '\0';
+            rt_memcpy(buf + len, &str_len, sizeof(str_len));
+            pack_len = sizeof(str_len) + RT_ALIGN(str_len, 4);
+            break;
+        }
+        default:
+            continue;
+        }
+
+        if (pack_len == 0)
+            break;
+        len += pack_len;
+    }
+
+    return len;
+}
+
+/**
+ * output the log as a binary frame, the formatting is deferred to the async output
+ *
+ * @note only the addresses of tag and format are saved into the frame, they
+ * must be static strings (e.g. string literals) which are still valid when
+ * the frame is formatted later or decoded with the ELF file on the host.
+ */
+static void ulog_bin_voutput(rt_uint32_t level, const char *tag, rt_bool_t newline, const char *format, va_list args)
+{
+    rt_uint8_t args_buf[ULOG_BINARY_ARGS_MAX];
+    rt_size_t args_len;
+    rt_rbb_blk_t log_blk;
+    ulog_bin_frame_t frame;
+
+    args_len = ulog_bin_pack_args(args_buf, sizeof(args_buf), format, args);
+
+    log_blk = rt_rbb_blk_alloc(ulog.async_rbb, RT_ALIGN(sizeof(struct ulog_bin_frame) + args_len, RT_ALIGN_SIZE));
+    if (log_blk == RT_NULL)
+    {
+        static rt_bool_t already_output = RT_FALSE;
+
+        async_dropped_inc();
+        if (already_output == RT_FALSE)
+        {
+            rt_kprintf("Warning: There is no enough buffer for saving async log,"
+                    " please increase the ULOG_ASYNC_OUTPUT_BUF_SIZE option.\n");
+            already_output = RT_TRUE;
+        }
+        return;
+    }
+
+    frame = (ulog_bin_frame_t) log_blk->buf;
+    frame->magic = ULOG_FRAME_MAGIC_BIN;
+    frame->newline = newline;
+    frame->args_len = args_len;
+    frame->level = level;
+    frame->tag = tag;
+    frame->fmt = format;
+    frame->tick = rt_tick_get();
+#ifdef ULOG_OUTPUT_THREAD_NAME
+    if (rt_interrupt_get_nest() == 0)
+    {
+        rt_strncpy(frame->thread, rt_thread_self()->name, RT_NAME_MAX);
+    }
+    else
+    {
+        rt_strncpy(frame->thread, "ISR", RT_NAME_MAX);
+    }
+#endif
+    rt_memcpy(frame + 1, args_buf, args_len);
+    /* put the block */
+    rt_rbb_blk_put(log_blk);
+    /* send a notice */
+    rt_sem_release(&ulog.async_notice);
+}
+
+/**
+ * format the message of binary log frame by the packed arguments
+ *
+ * @return the formatted length
+ */
+static rt_size_t ulog_bin_format_msg(char *buf, rt_size_t size, const struct ulog_bin_frame *frame)
+{
+    const rt_uint8_t *args = (const rt_uint8_t *)(frame + 1), *args_end = args + frame->args_len;
+    const char *format = frame->fmt, *spec;
+    char spec_buf[24];
+    rt_size_t len = 0, spec_len;
+    enum ulog_bin_arg type;
+    int fmt_result;
+
+    while (*format && len < size)
+    {
+        if (*format != '%')
+        {
+            buf[len++] = *format++;
+            continue;
+        }
+
+        spec = format++;
+        format = ulog_bin_parse_spec(format, &type);
+        if (*(format - 1) == '%' && format - spec == 2)
+        {
+            buf[len++] = '%';
+            continue;
+        }
+
+        /* rebuild the specification, replace the '*' by the packed value */
+        for (spec_len = 0; spec < format && spec_len < sizeof(spec_buf) - 12; spec++)
+        {
+            if (*spec == '*')
+            {
+                int star;
+
+                if (args + sizeof(star) > args_end)
+                    break;
+                rt_memcpy(&star, args, sizeof(star));
+                args += sizeof(star);
+                spec_len += rt_snprintf(spec_buf + spec_len, sizeof(spec_buf) - spec_len, "%d", star);
+            }
+            else
+            {
+                spec_buf[spec_len++] = *spec;
+            }
+        }
+        spec_buf[spec_len] = '\0';
+
+        /* the arguments are truncated, output the remaining format as it is */
+        if (spec < format || (type != ULOG_BIN_ARG_NONE && args >= args_end))
+        {
+            len += ulog_bin_strcpy(buf + len, size - len, spec_buf);
+            len += ulog_bin_strcpy(buf + len, size - len, format);
+            break;
+        }
+
+        switch (type)
+        {
+        case ULOG_BIN_ARG_INT:
+        {
+            int value;
+            rt_memcpy(&value, args, sizeof(value));
+            args += RT_ALIGN(sizeof(value), 4);
+            fmt_result = ulog_bin_snprintf(buf + len, size - len, spec_buf, value);
+            break;
+        }
+        case ULOG_BIN_ARG_LONG:
+        {
+            long value;
+            rt_memcpy(&value, args, sizeof(value));
+            args += RT_ALIGN(sizeof(value), 4);
+            fmt_result = ulog_bin_snprintf(buf + len, size - len, spec_buf, value);
+            break;
+        }
+        case ULOG_BIN_ARG_LLONG:
+        {
+            long long value;
+            rt_memcpy(&value, args, sizeof(value));
+            args += RT_ALIGN(sizeof(value), 4);
+            fmt_result = ulog_bin_snprintf(buf + len, size - len, spec_buf, value);
+            break;
+        }
+        case ULOG_BIN_ARG_PTR:
+        {
+            void *value;
+            rt_memcpy(&value, args, sizeof(value));
+            args += RT_ALIGN(sizeof(value), 4);
+            fmt_result = ulog_bin_snprintf(buf + len, size - len, spec_buf, value);
+            break;
+        }
+        case ULOG_BIN_ARG_DOUBLE:
+        {
+            double value;
+            rt_memcpy(&value, args, sizeof(value));
+            args += RT_ALIGN(sizeof(value), 4);
+#ifdef ULOG_OUTPUT_FLOAT
+            fmt_result = ulog_bin_snprintf(buf + len, size - len, spec_buf, value);
+#else
+            /* rt_vsnprintf is not supported float number */
+            fmt_result = ulog_bin_strcpy(buf + len, size - len, spec_buf);
+#endif
+            break;
+        }
+        case ULOG_BIN_ARG_STR:
+        {
+            rt_uint32_t str_len;
+            rt_memcpy(&str_len, args, sizeof(str_len));
+            fmt_result = ulog_bin_snprintf(buf + len, size - len, spec_buf, (const char *)args + sizeof(str_len));
+            args += sizeof(str_len) + RT_ALIGN(str_len, 4);
+            break;
+        }
+        default:
+            /* unknown specification, output it as it is */
+            fmt_result = ulog_bin_strcpy(buf + len, size - len, spec_buf);
+            break;
+        }
+
+        if (fmt_result < 0 || len + fmt_result >= size)
+        {
+            len = size;
+            break;
+        }
+        len += fmt_result;
+    }
+
+    return len;
+}
+
+/**
+ * format the binary log frame to the text log, the time is when the log was written
+ *
+ * @return the log length
+ */
+static rt_size_t ulog_bin_formater(char *log_buf, const struct ulog_bin_frame *frame)
+{
+    rt_size_t log_len = 0, newline_len = rt_strlen(ULOG_NEWLINE_SIGN);
+    rt_uint32_t level = frame->level;
+
+#ifdef ULOG_USING_COLOR
+    /* add CSI start sign and color info */
+    if (color_output_info[level])
+    {
+        log_len += ulog_strcpy(log_len, log_buf + log_len, CSI_START);
+        log_len += ulog_strcpy(log_len, log_buf + log_len, color_output_info[level]);
+    }
+#endif /* ULOG_USING_COLOR */
+
+#ifdef ULOG_OUTPUT_TIME
+    /* add time info, the timestamp format is using the tick also */
+    log_buf[log_len] = '[';
+    log_len += 1 + ulog_ultoa(log_buf + log_len + 1, frame->tick);
+    log_len += ulog_strcpy(log_len, log_buf + log_len, "]");
+#endif /* ULOG_OUTPUT_TIME */
+
+#ifdef ULOG_OUTPUT_LEVEL
+#ifdef ULOG_OUTPUT_TIME
+    log_len += ulog_strcpy(log_len, log_buf + log_len, " ");
+#endif
+    /* add level info */
+    log_len += ulog_strcpy(log_len, log_buf + log_len, level_output_info[level]);
+#endif /* ULOG_OUTPUT_LEVEL */
+
+#ifdef ULOG_OUTPUT_TAG
+#if !defined(ULOG_OUTPUT_LEVEL) && defined(ULOG_OUTPUT_TIME)
+    log_len += ulog_strcpy(log_len, log_buf + log_len, " ");
+#endif
+    /* add tag info */
+    log_len += ulog_strcpy(log_len, log_buf + log_len, frame->tag);
+#endif /* ULOG_OUTPUT_TAG */
+
+#ifdef ULOG_OUTPUT_THREAD_NAME
+    /* add thread info */
+#if defined(ULOG_OUTPUT_TIME) || defined(ULOG_OUTPUT_LEVEL) || defined(ULOG_OUTPUT_TAG)
+    log_len += ulog_strcpy(log_len, log_buf + log_len, " ");
+#endif
+    {
+        rt_size_t name_len = rt_strnlen(frame->thread, RT_NAME_MAX);
+
+        rt_strncpy(log_buf + log_len, frame->thread, name_len);
+        log_len += name_len;
+    }
+#endif /* ULOG_OUTPUT_THREAD_NAME */
+
+    log_len += ulog_strcpy(log_len, log_buf + log_len, ": ");
+
+    log_len += ulog_bin_format_msg(log_buf + log_len, ULOG_LINE_BUF_SIZE - log_len, frame);
+
+    /* overflow check and reserve some space for CSI end sign and newline sign */
+#ifdef ULOG_USING_COLOR
+    if (log_len + (sizeof(CSI_END) - 1) + newline_len > ULOG_LINE_BUF_SIZE)
+    {
+        log_len = ULOG_LINE_BUF_SIZE - (sizeof(CSI_END) - 1) - newline_len;
+    }
+#else
+    if (log_len + newline_len > ULOG_LINE_BUF_SIZE)
+    {
+        log_len = ULOG_LINE_BUF_SIZE - newline_len;
+    }
+#endif /* ULOG_USING_COLOR */
+
+    /* package newline sign */
+    if (frame->newline)
+    {
+        log_len += ulog_strcpy(log_len, log_buf + log_len, ULOG_NEWLINE_SIGN);
+    }
+
+#ifdef ULOG_USING_COLOR
+    /* add CSI end sign  */
+    if (color_output_info[level])
+    {
+        log_len += ulog_strcpy(log_len, log_buf + log_len, CSI_END);
+    }
+#endif /* ULOG_USING_COLOR */
+
+    return log_len;
+}
+
+/**
+ * output the binary log frame to all backends, it will be formatted for the
+ * backends which are not supported binary frame.
+ */
+static void ulog_bin_output_to_all_backend(const struct ulog_bin_frame *frame, rt_size_t frame_len)
+{
+    rt_slist_t *node;
+    ulog_backend_t backend;
+    rt_size_t log_len = 0;
+
+    /* the format buffer is shared with the thread log */
+    output_lock();
+
+    for (node = rt_slist_first(&ulog.backend_list); node; node = rt_slist_next(node))
+    {
+        backend = rt_slist_entry(node, struct ulog_backend, list);
+        if (backend->output_bin)
+        {
+            backend->output_bin(backend, frame, frame_len);
+            continue;
+        }
+
+        if (log_len == 0)
+        {
+            log_len = ulog_bin_formater(ulog.log_buf_th, frame);
+            ulog.log_buf_th[log_len] = '\0';
+#ifdef ULOG_USING_FILTER
+            /* keyword filter */
+            if (ulog.filter.keyword[0] != '\0' && !rt_strstr(ulog.log_buf_th, ulog.filter.keyword))
+            {
+                break;
+            }
+#endif /* ULOG_USING_FILTER */
+        }
+        ulog_output_to_backend(backend, frame->level, frame->tag, RT_FALSE, ulog.log_buf_th, log_len);
+    }
+
+    output_unlock();
+}
+#endif /* ULOG_USING_BINARY */
+
+#ifdef ULOG_USING_LOCKLESS
+/**
+ * output the log without the output locker, the log is formatted on the staging
+ * buffer of current thread's stack and committed to the async buffer.
+ */
+static void ulog_lockless_voutput(rt_uint32_t level, const char *tag, rt_bool_t newline, const char *format,
+        va_list args)
+{
+    char log_buf[ULOG_LINE_BUF_SIZE + 1];
+    rt_size_t log_len;
+
+#ifndef ULOG_USING_SYSLOG
+    log_len = ulog_formater(log_buf, level, tag, newline, format, args);
+#else
+    extern rt_size_t syslog_formater(char *log_buf, rt_uint8_t level, const char *tag, rt_bool_t newline, const char *format, va_list args);
+    log_len = syslog_formater(log_buf, level, tag, newline, format, args);
+#endif /* ULOG_USING_SYSLOG */
+
+#ifdef ULOG_USING_FILTER
+    /* keyword filter */
+    if (ulog.filter.keyword[0] != '\0')
+    {
+        /* add string end sign */
+        log_buf[log_len] = '\0';
+        /* find the keyword */
+        if (!rt_strstr(log_buf, ulog.filter.keyword))
+        {
+            return;
+        }
+    }
+#endif /* ULOG_USING_FILTER */
+
+    /* the async buffer block is reserved with interrupt disabled */
+    do_output(level, tag, RT_FALSE, log_buf, log_len);
+}
+#endif /* ULOG_USING_LOCKLESS */
+
 /**
  * output the log by variable argument list
  *
@@ -480,6 +1055,12 @@ static void do_output(rt_uint32_t level, const char *tag, rt_bool_t is_raw, cons
  * @param newline has_newline
  * @param format output format
  * @param args variable argument list
+ *
+ * @note when ULOG_USING_BINARY is enabled, tag and format must be static
+ * strings (e.g. string literals) as the LOG_X macros use. Only their
+ * addresses are saved and the log is formatted later, so a tag or format
+ * on the stack or in a released buffer will be formatted as garbage.
+ * The string arguments are copied, they have no such limitation.
  */
 void ulog_voutput(rt_uint32_t level, const char *tag, rt_bool_t newline, const char *format, va_list args)
 {
@@ -521,6 +1102,21 @@ void ulog_voutput(rt_uint32_t level, const char *tag, rt_bool_t newline, const c
     }
 #endif /* ULOG_USING_FILTER */
 
+#ifdef ULOG_USING_BINARY
+    /* only pack the arguments, the keyword filter is done when it's formatted */
+    ulog_bin_voutput(level, tag, newline, format, args);
+    return;
+#endif
+
+#ifdef ULOG_USING_LOCKLESS
+    /* the ISR log is still using the ISR's line buffer */
+    if (rt_interrupt_get_nest() == 0)
+    {
+        ulog_lockless_voutput(level, tag, newline, format, args);
+        return;
+    }
+#endif
+
     /* get log buffer */
     log_buf = get_log_buf();
 
@@ -564,6 +1160,9 @@ void ulog_voutput(rt_uint32_t level, const char *tag, rt_bool_t newline, const c
  * @param newline has newline
  * @param format output format
  * @param ... args
+ *
+ * @note tag and format must be static strings when ULOG_USING_BINARY is
+ * enabled, @see ulog_voutput
  */
 void ulog_output(rt_uint32_t level, const char *tag, rt_bool_t newline, const char *format, ...)
 {
@@ -1172,8 +1771,38 @@ void ulog_async_output(void)
             ulog_output_to_all_backend(log_frame->level, log_frame->tag, log_frame->is_raw, log_frame->log,
                     log_frame->log_len);
         }
+#ifdef ULOG_USING_BINARY
+        else if (log_frame->magic == ULOG_FRAME_MAGIC_BIN)
+        {
+            ulog_bin_output_to_all_backend((ulog_bin_frame_t) log_blk->buf,
+                    sizeof(struct ulog_bin_frame) + ((ulog_bin_frame_t) log_blk->buf)->args_len);
+        }
+#endif /* ULOG_USING_BINARY */
         rt_rbb_blk_free(ulog.async_rbb, log_blk);
     }
+
+    /* report the dropped logs */
+    if (ulog.async_dropped != ulog.async_dropped_reported)
+    {
+        char log_buf[48];
+        rt_uint32_t dropped = ulog.async_dropped;
+        rt_size_t log_len;
+
+        log_len = rt_snprintf(log_buf, sizeof(log_buf), "ulog: %d logs are dropped" ULOG_NEWLINE_SIGN,
+                dropped - ulog.async_dropped_reported);
+        ulog.async_dropped_reported = dropped;
+        ulog_output_to_all_backend(LOG_LVL_WARNING, "ulog", RT_TRUE, log_buf, log_len);
+    }
+}
+
+/**
+ * get the number of logs which are dropped when the async output buffer is full
+ *
+ * @return the dropped number
+ */
+rt_uint32_t ulog_async_dropped_get(void)
+{
+    return ulog.async_dropped;
 }
 
 /**
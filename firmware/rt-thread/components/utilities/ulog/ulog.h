@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-08-25     armink       the first version
+ * 2020-11-20     luhuadong    add file backend statistics API
  */
 
 #ifndef _ULOG_H_
@@ -79,6 +80,14 @@ void ulog_flush(void);
  */
 void ulog_async_output(void);
 void ulog_async_waiting_log(rt_int32_t time);
+rt_uint32_t ulog_async_dropped_get(void);
+#endif
+
+#ifdef ULOG_BACKEND_USING_FILE
+/*
+ * file backend statistics API
+ */
+void ulog_file_backend_stats_get(struct ulog_file_be_stats *stats);
 #endif
 
 /*
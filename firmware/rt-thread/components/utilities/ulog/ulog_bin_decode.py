@@ -0,0 +1,124 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2006-2020, RT-Thread Development Team
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Change Logs:
+# Date           Author       Notes
+# 2020-11-11     luhuadong    the first version
+#
+# Decode the binary log frames (ULOG_USING_BINARY) which are saved by a
+# backend's output_bin, the format and tag strings are read from the ELF file.
+#
+# usage: ulog_bin_decode.py <rtthread.elf> <log.bin> [thread name max length]
+#
+# The thread name max length is RT_NAME_MAX, it's needed when the
+# ULOG_OUTPUT_THREAD_NAME is enabled.
+#
+
+import re
+import sys
+import struct
+
+from elftools.elf.elffile import ELFFile
+
+FRAME_MAGIC_BIN = 0x11
+LEVEL_INFO = {0: 'A', 3: 'E', 4: 'W', 6: 'I', 7: 'D'}
+SPEC_RE = re.compile(r'%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?(hh|h|ll|l|L|z|t|j)?([diuoxXcpsfFeEgG%])')
+
+class Image(object):
+    def __init__(self, path):
+        self.sections = []
+        with open(path, 'rb') as f:
+            elf = ELFFile(f)
+            for sec in elf.iter_sections():
+                if sec['sh_addr'] and sec['sh_type'] == 'SHT_PROGBITS':
+                    self.sections.append((sec['sh_addr'], sec.data()))
+
+    def string(self, addr):
+        for base, data in self.sections:
+            if base <= addr < base + len(data):
+                end = data.find(b'\0', addr - base)
+                return data[addr - base:end].decode('ascii', 'replace')
+        return '<0x%08x>' % addr
+
+def format_msg(fmt, args):
+    off = [0]
+
+    def take(size, code):
+        if off[0] + size > len(args):
+            raise IndexError
+        value = struct.unpack_from(code, args, off[0])[0]
+        off[0] += (size + 3) & ~3
+        return value
+
+    def repl(m):
+        flags, width, prec, length, conv = m.groups()
+        if conv == '%':
+            return '%'
+        if width == '*':
+            width = str(take(4, '<i'))
+        if prec == '*':
+            prec = str(take(4, '<i'))
+        spec = '%' + flags + (width or '') + ('.' + prec if prec is not None else '')
+        if conv in 'diuoxXc':
+            value = take(8, '<q') if length in ('ll', 'L', 'j') else take(4, '<i')
+            if conv in 'uoxX' and value < 0:
+                value &= 0xffffffffffffffff if length in ('ll', 'L', 'j') else 0xffffffff
+            return (spec + ('d' if conv in 'iu' else conv)) % value
+        if conv == 'p':
+            return '0x%08x' % take(4, '<I')
+        if conv in 'fFeEgG':
+            return (spec + conv) % take(8, '<d')
+        str_len = take(4, '<I')
+        value = args[off[0]:off[0] + str_len - 1].decode('ascii', 'replace')
+        off[0] += (str_len + 3) & ~3
+        return (spec + 's') % value
+
+    out, pos = [], 0
+    for m in SPEC_RE.finditer(fmt):
+        out.append(fmt[pos:m.start()])
+        try:
+            out.append(repl(m))
+        except IndexError:
+            # the arguments are truncated
+            out.append(fmt[m.start():])
+            return ''.join(out)
+        pos = m.end()
+    out.append(fmt[pos:])
+    return ''.join(out)
+
+def decode(image, data, name_max):
+    head_size = 20 + name_max
+    off = 0
+    while off + head_size <= len(data):
+        word, level, tag, fmt, tick = struct.unpack_from('<IIIII', data, off)
+        if word & 0xff != FRAME_MAGIC_BIN:
+            # lost sync, find the next frame
+            off += 4
+            continue
+        newline, args_len = (word >> 8) & 1, word >> 9
+        thread = data[off + 20:off + head_size].split(b'\0')[0].decode('ascii', 'replace')
+        args = data[off + head_size:off + head_size + args_len]
+        off += head_size + args_len
+
+        line = '[%d] %s/%s' % (tick, LEVEL_INFO.get(level, '?'), image.string(tag))
+        if name_max:
+            line += ' ' + thread
+        line += ': ' + format_msg(image.string(fmt), args)
+        sys.stdout.write(line + ('\n' if newline else ''))
+
+def main():
+    if len(sys.argv) < 3:
+        print('usage: %s <rtthread.elf> <log.bin> [thread name max length]' % sys.argv[0])
+        return 1
+
+    name_max = int(sys.argv[3]) if len(sys.argv) > 3 else 0
+    with open(sys.argv[2], 'rb') as f:
+        data = f.read()
+    decode(Image(sys.argv[1]), data, (name_max + 3) & ~3)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -6,6 +6,8 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-08-25     armink       the first version
+ * 2020-11-11     luhuadong    add binary log frame
+ * 2020-11-20     luhuadong    add file backend statistics
  */
 
 #ifndef _ULOG_DEF_H_
@@ -175,6 +177,12 @@ extern "C" {
 #endif
 
 #define ULOG_FRAME_MAGIC               0x10
+#define ULOG_FRAME_MAGIC_BIN           0x11
+
+/* the max size of arguments packed in every binary log */
+#ifndef ULOG_BINARY_ARGS_MAX
+#define ULOG_BINARY_ARGS_MAX           64
+#endif
 
 /* tag's level filter */
 struct ulog_tag_lvl_filter
@@ -197,6 +205,29 @@ struct ulog_frame
 };
 typedef struct ulog_frame *ulog_frame_t;
 
+/**
+ * The binary log frame, the format string will not be formatted when logging.
+ * The packed arguments follow the frame, every one is 4 bytes aligned:
+ *   integer, pointer and double: the raw value
+ *   string: a 32 bits length (including '\0'), then the string
+ * The host tool can decode it by the format and tag address in the ELF file.
+ */
+struct ulog_bin_frame
+{
+    /* magic word is 0x11 */
+    rt_uint32_t magic:8;
+    rt_uint32_t newline:1;
+    rt_uint32_t args_len:23;
+    rt_uint32_t level;
+    const char *tag;
+    const char *fmt;
+    rt_tick_t tick;
+#ifdef ULOG_OUTPUT_THREAD_NAME
+    char thread[RT_NAME_MAX];
+#endif
+};
+typedef struct ulog_bin_frame *ulog_bin_frame_t;
+
 struct ulog_backend
 {
     char name[RT_NAME_MAX];
@@ -205,10 +236,23 @@ struct ulog_backend
     void (*output)(struct ulog_backend *backend, rt_uint32_t level, const char *tag, rt_bool_t is_raw, const char *log, size_t len);
     void (*flush) (struct ulog_backend *backend);
     void (*deinit)(struct ulog_backend *backend);
+#ifdef ULOG_USING_BINARY
+    /* output the binary log frame directly, it's optional */
+    void (*output_bin)(struct ulog_backend *backend, const struct ulog_bin_frame *frame, size_t len);
+#endif
     rt_slist_t list;
 };
 typedef struct ulog_backend *ulog_backend_t;
 
+/* the logs which are lost or cut by the file backend */
+struct ulog_file_be_stats
+{
+    rt_uint32_t unavailable;                           /* dropped when the file system is not mounted */
+    rt_uint32_t write_failed;                          /* dropped by failed chunk write */
+    rt_uint32_t truncated;                             /* truncated to ULOG_FILE_BE_BUF_SIZE */
+    rt_uint32_t torn_bytes;                            /* torn tail bytes dropped when opening file */
+};
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,115 @@
+#!/usr/bin/env python
+#
+# Copyright (c) 2006-2020, RT-Thread Development Team
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+# Change Logs:
+# Date           Author       Notes
+# 2020-11-13     luhuadong    the first version
+#
+# Dump the log files which are written by the ulog file backend. The torn
+# chunk on power loss is skipped. The binary log chunks need the ELF file.
+#
+# usage: ulog_file_dump.py <ulog file> [ulog file ...] [--elf rtthread.elf [--name-max RT_NAME_MAX]]
+#
+# The rotated files should be given from the oldest to the newest, such as:
+#   ulog_file_dump.py ulog.lz.3 ulog.lz.2 ulog.lz.1 ulog.lz
+#
+
+import sys
+import struct
+import binascii
+
+CHUNK_MAGIC = 0x43464C55
+CHUNK_LZ4 = 1 << 0
+CHUNK_BIN = 1 << 1
+CHUNK_HEAD_SIZE = 16
+CHUNK_MIN_ALIGN = 4
+
+def lz4_decompress(src, raw_len):
+    out = bytearray()
+    i = 0
+    while i < len(src):
+        token = src[i]
+        i += 1
+        lit_len = token >> 4
+        if lit_len == 15:
+            while True:
+                b = src[i]
+                i += 1
+                lit_len += b
+                if b != 255:
+                    break
+        out += src[i:i + lit_len]
+        i += lit_len
+        if i >= len(src):
+            break
+        offset = src[i] | (src[i + 1] << 8)
+        i += 2
+        match_len = token & 15
+        if match_len == 15:
+            while True:
+                b = src[i]
+                i += 1
+                match_len += b
+                if b != 255:
+                    break
+        match_len += 4
+        start = len(out) - offset
+        for k in range(match_len):
+            out.append(out[start + k])
+    if len(out) != raw_len:
+        raise ValueError('bad LZ4 block')
+    return bytes(out)
+
+def read_chunks(data):
+    off = 0
+    while off + CHUNK_HEAD_SIZE <= len(data):
+        magic, flags, raw_len, data_len, crc = struct.unpack_from('<IHHII', data, off)
+        payload = data[off + CHUNK_HEAD_SIZE:off + CHUNK_HEAD_SIZE + data_len]
+        if magic != CHUNK_MAGIC or len(payload) != data_len or binascii.crc32(payload) & 0xffffffff != crc:
+            # the torn chunk or padding, search the next chunk
+            off += CHUNK_MIN_ALIGN
+            continue
+        off += CHUNK_HEAD_SIZE + data_len
+        try:
+            records = lz4_decompress(payload, raw_len) if flags & CHUNK_LZ4 else payload
+        except (ValueError, IndexError):
+            continue
+        yield flags, records
+
+def main():
+    args = sys.argv[1:]
+    elf, name_max = None, 0
+    if '--elf' in args:
+        pos = args.index('--elf')
+        elf = args[pos + 1]
+        del args[pos:pos + 2]
+    if '--name-max' in args:
+        pos = args.index('--name-max')
+        name_max = int(args[pos + 1])
+        del args[pos:pos + 2]
+    if not args:
+        print('usage: %s <ulog file> [ulog file ...] [--elf rtthread.elf [--name-max RT_NAME_MAX]]' % sys.argv[0])
+        return 1
+
+    image = None
+    for path in args:
+        with open(path, 'rb') as f:
+            data = f.read()
+        for flags, records in read_chunks(data):
+            if not flags & CHUNK_BIN:
+                sys.stdout.write(records.decode('ascii', 'replace'))
+                continue
+            if elf is None:
+                sys.stderr.write('binary log chunk is skipped, please input the ELF file by --elf\n')
+                continue
+            import ulog_bin_decode
+            if image is None:
+                image = ulog_bin_decode.Image(elf)
+            ulog_bin_decode.decode(image, records, (name_max + 3) & ~3)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())
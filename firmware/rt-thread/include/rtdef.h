@@ -556,6 +556,28 @@ struct rt_cpu
 
 #endif
 
+#ifdef RT_USING_THREAD_STATS
+#define RT_THREAD_STATS_HIST_NR         8               /**< number of latency histogram buckets */
+#define RT_THREAD_STATS_HIST_BASE       10              /**< bucket 0 holds latency < (1 << 10) cputime ticks */
+
+/**
+ * Thread scheduling statistics, the time unit is cputime tick
+ *
+ * The n-th latency bucket counts wake-up to run latencies less than
+ * (1 << (RT_THREAD_STATS_HIST_BASE + 2 * n)) ticks, the last one counts the rest.
+ */
+struct rt_thread_stats
+{
+    rt_uint64_t run_time;                               /**< accumulated running time */
+    rt_uint32_t switches;                               /**< times of switching to this thread */
+    rt_uint32_t latency_max;                            /**< maximal wake-up to run latency */
+    rt_uint32_t latency_hist[RT_THREAD_STATS_HIST_NR];  /**< wake-up to run latency histogram */
+
+    rt_uint32_t switch_in;                              /**< timestamp of the last switch in */
+    rt_uint32_t ready_at;                               /**< timestamp of becoming ready */
+};
+#endif
+
 /**
  * Thread structure
  */
@@ -633,6 +655,14 @@ struct rt_thread
 #endif
 
     rt_ubase_t user_data;                             /**< private user data beyond this thread */
+
+#ifdef RT_USING_MUTEX
+    struct rt_mutex *pending_mutex;                     /**< the mutex this thread is blocked on */
+#endif
+
+#ifdef RT_USING_THREAD_STATS
+    struct rt_thread_stats stats;                       /**< scheduling statistics */
+#endif
 };
 typedef struct rt_thread *rt_thread_t;
 
@@ -694,6 +724,13 @@ struct rt_mutex
     rt_uint8_t           hold;                          /**< numbers of thread hold the mutex */
 
     struct rt_thread    *owner;                         /**< current owner of mutex */
+
+#ifdef RT_USING_MUTEX_STATS
+    rt_uint32_t          take_count;                    /**< times of taking by a non-owner thread */
+    rt_uint32_t          contended;                     /**< times of finding it held by others */
+    rt_uint32_t          spin_acquired;                 /**< contended takes acquired by spinning */
+    rt_uint32_t          wait_max;                      /**< maximal blocked time in tick */
+#endif
 };
 typedef struct rt_mutex *rt_mutex_t;
 #endif
@@ -921,6 +958,8 @@ enum rt_device_class_type
 #define RT_DEVICE_CTRL_BLK_SYNC         0x11            /**< flush data to block device */
 #define RT_DEVICE_CTRL_BLK_ERASE        0x12            /**< erase block on block device */
 #define RT_DEVICE_CTRL_BLK_AUTOREFRESH  0x13            /**< block device : enter/exit auto refresh mode */
+#define RT_DEVICE_CTRL_BLK_CACHE_STAT   0x14            /**< get statistics of block cache, struct rt_blk_cache_stat */
+#define RT_DEVICE_CTRL_BLK_MMCSD_STAT   0x15            /**< get statistics of mmcsd block device, struct rt_mmcsd_blk_stat */
 #define RT_DEVICE_CTRL_NETIF_GETMAC     0x10            /**< get mac address */
 #define RT_DEVICE_CTRL_MTD_FORMAT       0x10            /**< format a MTD device */
 #define RT_DEVICE_CTRL_RTC_GET_TIME     0x10            /**< get time */
@@ -106,6 +106,17 @@ rt_base_t rt_hw_interrupt_disable(void);
 void rt_hw_interrupt_enable(rt_base_t level);
 #endif /*RT_USING_SMP*/
 
+#ifdef RT_USING_CPU_EXCLUSIVE
+/*
+ * Exclusive access interfaces, the store returns 0 on success
+ */
+rt_uint16_t rt_hw_exclusive_load16(volatile rt_uint16_t *addr);
+rt_uint32_t rt_hw_exclusive_store16(volatile rt_uint16_t *addr, rt_uint16_t value);
+rt_uint32_t rt_hw_exclusive_load32(volatile rt_uint32_t *addr);
+rt_uint32_t rt_hw_exclusive_store32(volatile rt_uint32_t *addr, rt_uint32_t value);
+void rt_hw_exclusive_clear(void);
+#endif
+
 /*
  * Context interfaces
  */
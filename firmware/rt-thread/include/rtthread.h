@@ -189,6 +189,12 @@ rt_uint16_t rt_critical_level(void);
 void rt_scheduler_sethook(void (*hook)(rt_thread_t from, rt_thread_t to));
 #endif
 
+#ifdef RT_USING_THREAD_STATS
+rt_err_t rt_thread_stats_get(rt_thread_t thread, struct rt_thread_stats *stats);
+void rt_thread_stats_reset(rt_thread_t thread);
+void rt_thread_stats_tick(rt_thread_t thread);
+#endif
+
 #ifdef RT_USING_SMP
 void rt_scheduler_ipi_handler(int vector, void *param);
 #endif
@@ -393,6 +399,16 @@ rt_err_t rt_mq_recv(rt_mq_t    mq,
                     rt_size_t  size,
                     rt_int32_t timeout);
 rt_err_t rt_mq_control(rt_mq_t mq, int cmd, void *arg);
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+rt_err_t rt_mq_reserve(rt_mq_t mq, void **buffer, rt_int32_t timeout);
+rt_err_t rt_mq_commit(rt_mq_t mq, void *buffer, rt_size_t size);
+rt_err_t rt_mq_cancel(rt_mq_t mq, void *buffer);
+rt_err_t rt_mq_peek(rt_mq_t     mq,
+                    void      **buffer,
+                    rt_size_t  *size,
+                    rt_int32_t  timeout);
+rt_err_t rt_mq_release(rt_mq_t mq, void *buffer);
+#endif
 #endif
 
 /*
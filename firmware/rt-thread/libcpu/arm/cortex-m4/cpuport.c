@@ -15,6 +15,7 @@
  * 2013-06-23     aozima       support lazy stack optimized.
  * 2018-07-24     aozima       enhancement hard fault exception handler.
  * 2019-07-03     yangjie      add __rt_ffs() for armclang.
+ * 2020-11-09     luhuadong    add exclusive access functions.
  */
 
 #include <rtthread.h>
@@ -504,3 +505,103 @@ int __rt_ffs(int value)
 #endif
 
 #endif
+
+#ifdef RT_USING_CPU_EXCLUSIVE
+/**
+ * The exclusive access functions are used by the lock-free fast path of IPC.
+ * The store functions return 0 on success, and fail when the exclusive
+ * monitor is cleared by an exception or a store to the same location after
+ * the load.
+ */
+#if defined(__CC_ARM)
+rt_uint16_t rt_hw_exclusive_load16(volatile rt_uint16_t *addr)
+{
+    return (rt_uint16_t)__ldrex(addr);
+}
+
+rt_uint32_t rt_hw_exclusive_store16(volatile rt_uint16_t *addr, rt_uint16_t value)
+{
+    return __strex(value, addr);
+}
+
+rt_uint32_t rt_hw_exclusive_load32(volatile rt_uint32_t *addr)
+{
+    return __ldrex(addr);
+}
+
+rt_uint32_t rt_hw_exclusive_store32(volatile rt_uint32_t *addr, rt_uint32_t value)
+{
+    return __strex(value, addr);
+}
+
+void rt_hw_exclusive_clear(void)
+{
+    __clrex();
+}
+#elif defined(__IAR_SYSTEMS_ICC__)
+#include <intrinsics.h>
+
+rt_uint16_t rt_hw_exclusive_load16(volatile rt_uint16_t *addr)
+{
+    return __LDREXH(addr);
+}
+
+rt_uint32_t rt_hw_exclusive_store16(volatile rt_uint16_t *addr, rt_uint16_t value)
+{
+    return __STREXH(value, addr);
+}
+
+rt_uint32_t rt_hw_exclusive_load32(volatile rt_uint32_t *addr)
+{
+    return __LDREX((unsigned long *)addr);
+}
+
+rt_uint32_t rt_hw_exclusive_store32(volatile rt_uint32_t *addr, rt_uint32_t value)
+{
+    return __STREX(value, (unsigned long *)addr);
+}
+
+void rt_hw_exclusive_clear(void)
+{
+    __CLREX();
+}
+#elif defined(__CLANG_ARM) || defined(__GNUC__)
+rt_uint16_t rt_hw_exclusive_load16(volatile rt_uint16_t *addr)
+{
+    rt_uint32_t result;
+
+    __asm volatile ("ldrexh %0, %1" : "=r" (result) : "Q" (*addr));
+    return (rt_uint16_t)result;
+}
+
+rt_uint32_t rt_hw_exclusive_store16(volatile rt_uint16_t *addr, rt_uint16_t value)
+{
+    rt_uint32_t result;
+
+    __asm volatile ("strexh %0, %2, %1" : "=&r" (result), "=Q" (*addr) : "r" ((rt_uint32_t)value));
+    return result;
+}
+
+rt_uint32_t rt_hw_exclusive_load32(volatile rt_uint32_t *addr)
+{
+    rt_uint32_t result;
+
+    __asm volatile ("ldrex %0, %1" : "=r" (result) : "Q" (*addr));
+    return result;
+}
+
+rt_uint32_t rt_hw_exclusive_store32(volatile rt_uint32_t *addr, rt_uint32_t value)
+{
+    rt_uint32_t result;
+
+    __asm volatile ("strex %0, %2, %1" : "=&r" (result), "=Q" (*addr) : "r" (value));
+    return result;
+}
+
+void rt_hw_exclusive_clear(void)
+{
+    __asm volatile ("clrex" ::: "memory");
+}
+#endif
+
+#endif /* RT_USING_CPU_EXCLUSIVE */
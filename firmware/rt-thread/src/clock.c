@@ -13,6 +13,7 @@
  * 2010-07-13     Bernard      fix rt_tick_from_millisecond issue found by kuronca
  * 2011-06-26     Bernard      add rt_tick_set function.
  * 2018-11-22     Jesven       add per cpu tick
+ * 2020-11-20     luhuadong    account thread running time on every tick
  */
 
 #include <rthw.h>
@@ -83,6 +84,10 @@ void rt_tick_increase(void)
     /* check time slice */
     thread = rt_thread_self();
 
+#ifdef RT_USING_THREAD_STATS
+    rt_thread_stats_tick(thread);
+#endif
+
     -- thread->remaining_tick;
     if (thread->remaining_tick == 0)
     {
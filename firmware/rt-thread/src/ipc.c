@@ -37,6 +37,11 @@
  * 2020-07-29     Meco Man     fix thread->event_set/event_info when received an 
  *                             event without pending
  * 2020-10-11     Meco Man     add value overflow-check code
+ * 2020-11-06     luhuadong    add transitive priority inheritance, adaptive
+ *                             spinning and contention statistics for mutex
+ * 2020-11-09     luhuadong    add lock-free fast path for semaphore and event
+ * 2020-11-10     luhuadong    add zero-copy reserve/commit and peek/release
+ *                             for message queue
  */
 
 #include <rtthread.h>
@@ -318,6 +323,53 @@ rt_err_t rt_sem_delete(rt_sem_t sem)
 RTM_EXPORT(rt_sem_delete);
 #endif
 
+#ifdef RT_USING_IPC_FAST_PATH
+/*
+ * Take the semaphore with exclusive access instead of disabling interrupt.
+ * An interrupt or a thread switch between the load and the store clears the
+ * exclusive monitor, then the store fails and it's retried. It returns
+ * RT_FALSE when the value is 0 and the slow path should be taken.
+ */
+rt_inline rt_bool_t _rt_sem_fast_take(rt_sem_t sem)
+{
+    rt_uint16_t value;
+
+    do
+    {
+        value = rt_hw_exclusive_load16(&sem->value);
+        if (value == 0)
+        {
+            rt_hw_exclusive_clear();
+            return RT_FALSE;
+        }
+    } while (rt_hw_exclusive_store16(&sem->value, value - 1) != 0);
+
+    return RT_TRUE;
+}
+
+/*
+ * Release the semaphore with exclusive access when no thread is waiting on
+ * it. The waiting thread is suspended with interrupt disabled, so the list
+ * can't change between the load and the store without clearing the monitor.
+ */
+rt_inline rt_bool_t _rt_sem_fast_release(rt_sem_t sem)
+{
+    rt_uint16_t value;
+
+    do
+    {
+        value = rt_hw_exclusive_load16(&sem->value);
+        if (value >= RT_SEM_VALUE_MAX || !rt_list_isempty(&sem->parent.suspend_thread))
+        {
+            rt_hw_exclusive_clear();
+            return RT_FALSE;
+        }
+    } while (rt_hw_exclusive_store16(&sem->value, value + 1) != 0);
+
+    return RT_TRUE;
+}
+#endif
+
 /**
  * This function will take a semaphore, if the semaphore is unavailable, the
  * thread shall wait for a specified time.
@@ -338,6 +390,15 @@ rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
 
     RT_OBJECT_HOOK_CALL(rt_object_trytake_hook, (&(sem->parent.parent)));
 
+#ifdef RT_USING_IPC_FAST_PATH
+    if (_rt_sem_fast_take(sem) == RT_TRUE)
+    {
+        RT_OBJECT_HOOK_CALL(rt_object_take_hook, (&(sem->parent.parent)));
+
+        return RT_EOK;
+    }
+#endif
+
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
 
@@ -447,6 +508,11 @@ rt_err_t rt_sem_release(rt_sem_t sem)
 
     RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(sem->parent.parent)));
 
+#ifdef RT_USING_IPC_FAST_PATH
+    if (_rt_sem_fast_release(sem) == RT_TRUE)
+        return RT_EOK;
+#endif
+
     need_schedule = RT_FALSE;
 
     /* disable interrupt */
@@ -558,6 +624,12 @@ rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag)
     mutex->owner = RT_NULL;
     mutex->original_priority = 0xFF;
     mutex->hold  = 0;
+#ifdef RT_USING_MUTEX_STATS
+    mutex->take_count    = 0;
+    mutex->contended     = 0;
+    mutex->spin_acquired = 0;
+    mutex->wait_max      = 0;
+#endif
 
     /* set flag */
     mutex->parent.parent.flag = flag;
@@ -621,6 +693,12 @@ rt_mutex_t rt_mutex_create(const char *name, rt_uint8_t flag)
     mutex->owner              = RT_NULL;
     mutex->original_priority  = 0xFF;
     mutex->hold               = 0;
+#ifdef RT_USING_MUTEX_STATS
+    mutex->take_count         = 0;
+    mutex->contended          = 0;
+    mutex->spin_acquired      = 0;
+    mutex->wait_max           = 0;
+#endif
 
     /* set flag */
     mutex->parent.parent.flag = flag;
@@ -658,6 +736,67 @@ rt_err_t rt_mutex_delete(rt_mutex_t mutex)
 RTM_EXPORT(rt_mutex_delete);
 #endif
 
+#ifndef RT_MUTEX_PI_DEPTH_MAX
+#define RT_MUTEX_PI_DEPTH_MAX   8
+#endif
+
+/*
+ * Raise the priority of the mutex owner, and the owner of the mutex this
+ * owner is blocked on, and so on along the blocking chain. The depth is
+ * limited in case of a deadlock cycle.
+ */
+static void _rt_mutex_inherit_priority(struct rt_mutex *mutex, rt_uint8_t priority)
+{
+    struct rt_thread *owner;
+    int depth;
+
+    for (depth = 0; mutex != RT_NULL && depth < RT_MUTEX_PI_DEPTH_MAX; depth ++)
+    {
+        owner = mutex->owner;
+        if (owner == RT_NULL || owner->current_priority <= priority)
+            break;
+
+        rt_thread_control(owner, RT_THREAD_CTRL_CHANGE_PRIORITY, &priority);
+
+        mutex = owner->pending_mutex;
+    }
+}
+
+#ifdef RT_USING_MUTEX_ADAPTIVE
+#ifndef RT_MUTEX_SPIN_COUNT
+#define RT_MUTEX_SPIN_COUNT     1000
+#endif
+
+rt_inline rt_bool_t _rt_mutex_owner_running(struct rt_mutex *mutex)
+{
+    struct rt_thread *owner = *(struct rt_thread * volatile *)&mutex->owner;
+
+    return (owner != RT_NULL &&
+            (owner->stat & RT_THREAD_STAT_MASK) == RT_THREAD_RUNNING &&
+            owner->oncpu != RT_CPU_DETACHED);
+}
+
+/*
+ * Spin with the cpus lock released while the owner keeps running on another
+ * CPU. It returns when the mutex is released, the owner is switched out or
+ * the spin count is exhausted.
+ */
+static void _rt_mutex_spin(struct rt_mutex *mutex)
+{
+    struct rt_thread *owner;
+    int count;
+
+    owner = *(struct rt_thread * volatile *)&mutex->owner;
+    for (count = 0; count < RT_MUTEX_SPIN_COUNT; count ++)
+    {
+        if (*(volatile rt_uint16_t *)&mutex->value > 0 ||
+            *(struct rt_thread * volatile *)&mutex->owner != owner ||
+            !_rt_mutex_owner_running(mutex))
+            break;
+    }
+}
+#endif
+
 /**
  * This function will take a mutex, if the mutex is unavailable, the
  * thread shall wait for a specified time.
@@ -671,6 +810,12 @@ rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
 {
     register rt_base_t temp;
     struct rt_thread *thread;
+#ifdef RT_USING_MUTEX_ADAPTIVE
+    rt_bool_t spun = RT_FALSE;
+#endif
+#ifdef RT_USING_MUTEX_STATS
+    rt_tick_t wait_tick;
+#endif
 
     /* this function must not be used in interrupt even if time = 0 */
     RT_DEBUG_IN_THREAD_CONTEXT;
@@ -709,9 +854,13 @@ rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
     }
     else
     {
-#ifdef RT_USING_SIGNALS
+#ifdef RT_USING_MUTEX_STATS
+        mutex->take_count ++;
+#endif
+
+#if defined(RT_USING_SIGNALS) || defined(RT_USING_MUTEX_ADAPTIVE)
 __again:
-#endif /* end of RT_USING_SIGNALS */
+#endif
         /* The value of mutex is 1 in initial status. Therefore, if the
          * value is great than 0, it indicates the mutex is avaible.
          */
@@ -720,6 +869,11 @@ __again:
             /* mutex is available */
             mutex->value --;
 
+#if defined(RT_USING_MUTEX_ADAPTIVE) && defined(RT_USING_MUTEX_STATS)
+            if (spun == RT_TRUE)
+                mutex->spin_acquired ++;
+#endif
+
             /* set mutex owner and original priority */
             mutex->owner             = thread;
             mutex->original_priority = thread->current_priority;
@@ -735,6 +889,13 @@ __again:
         }
         else
         {
+#ifdef RT_USING_MUTEX_STATS
+#ifdef RT_USING_MUTEX_ADAPTIVE
+            if (spun == RT_FALSE)
+#endif
+                mutex->contended ++;
+#endif
+
             /* no waiting, return with timeout */
             if (time == 0)
             {
@@ -748,18 +909,31 @@ __again:
             }
             else
             {
+#ifdef RT_USING_MUTEX_ADAPTIVE
+                /* the owner is running on another CPU, spin a while before blocking */
+                if (spun == RT_FALSE && _rt_mutex_owner_running(mutex))
+                {
+                    spun = RT_TRUE;
+
+                    rt_hw_interrupt_enable(temp);
+                    _rt_mutex_spin(mutex);
+                    temp = rt_hw_interrupt_disable();
+
+                    goto __again;
+                }
+#endif
+
                 /* mutex is unavailable, push to suspend list */
                 RT_DEBUG_LOG(RT_DEBUG_IPC, ("mutex_take: suspend thread: %s\n",
                                             thread->name));
 
-                /* change the owner thread priority of mutex */
-                if (thread->current_priority < mutex->owner->current_priority)
-                {
-                    /* change the owner thread priority */
-                    rt_thread_control(mutex->owner,
-                                      RT_THREAD_CTRL_CHANGE_PRIORITY,
-                                      &thread->current_priority);
-                }
+                /* change the owner thread priority of mutex along the blocking chain */
+                _rt_mutex_inherit_priority(mutex, thread->current_priority);
+
+                thread->pending_mutex = mutex;
+#ifdef RT_USING_MUTEX_STATS
+                wait_tick = rt_tick_get();
+#endif
 
                 /* suspend current thread */
                 rt_ipc_list_suspend(&(mutex->parent.suspend_thread),
@@ -786,6 +960,16 @@ __again:
                 /* do schedule */
                 rt_schedule();
 
+                thread->pending_mutex = RT_NULL;
+#ifdef RT_USING_MUTEX_STATS
+                /* the statistics are protected by interrupt lock */
+                temp = rt_hw_interrupt_disable();
+                wait_tick = rt_tick_get() - wait_tick;
+                if (wait_tick > mutex->wait_max)
+                    mutex->wait_max = wait_tick;
+                rt_hw_interrupt_enable(temp);
+#endif
+
                 if (thread->error != RT_EOK)
                 {
 #ifdef RT_USING_SIGNALS
@@ -1069,6 +1253,56 @@ rt_err_t rt_event_delete(rt_event_t event)
 RTM_EXPORT(rt_event_delete);
 #endif
 
+#ifdef RT_USING_IPC_FAST_PATH
+/*
+ * Set the event bits with exclusive access when no thread is waiting on the
+ * event, otherwise RT_FALSE is returned and the slow path resumes threads.
+ */
+rt_inline rt_bool_t _rt_event_fast_send(rt_event_t event, rt_uint32_t set)
+{
+    rt_uint32_t value;
+
+    do
+    {
+        value = rt_hw_exclusive_load32(&event->set);
+        if (!rt_list_isempty(&event->parent.suspend_thread))
+        {
+            rt_hw_exclusive_clear();
+            return RT_FALSE;
+        }
+    } while (rt_hw_exclusive_store32(&event->set, value | set) != 0);
+
+    return RT_TRUE;
+}
+
+/*
+ * Receive the event with exclusive access when the condition is satisfied
+ * already. The received bits are returned by recved, and RT_FALSE means the
+ * thread should go to the slow path.
+ */
+rt_inline rt_bool_t _rt_event_fast_recv(rt_event_t event, rt_uint32_t set,
+                                        rt_uint8_t option, rt_uint32_t *recved)
+{
+    rt_uint32_t value;
+
+    do
+    {
+        value = rt_hw_exclusive_load32(&event->set);
+        if (!(((option & RT_EVENT_FLAG_AND) && (value & set) == set) ||
+              ((option & RT_EVENT_FLAG_OR) && (value & set))))
+        {
+            rt_hw_exclusive_clear();
+            return RT_FALSE;
+        }
+    } while (rt_hw_exclusive_store32(&event->set,
+             (option & RT_EVENT_FLAG_CLEAR) ? (value & ~set) : value) != 0);
+
+    *recved = value & set;
+
+    return RT_TRUE;
+}
+#endif
+
 /**
  * This function will send an event to the event object, if there are threads
  * suspended on event object, it will be waked up.
@@ -1095,6 +1329,15 @@ rt_err_t rt_event_send(rt_event_t event, rt_uint32_t set)
 
     need_schedule = RT_FALSE;
 
+#ifdef RT_USING_IPC_FAST_PATH
+    if (_rt_event_fast_send(event, set) == RT_TRUE)
+    {
+        RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(event->parent.parent)));
+
+        return RT_EOK;
+    }
+#endif
+
     /* disable interrupt */
     level = rt_hw_interrupt_disable();
 
@@ -1211,6 +1454,26 @@ rt_err_t rt_event_recv(rt_event_t   event,
 
     RT_OBJECT_HOOK_CALL(rt_object_trytake_hook, (&(event->parent.parent)));
 
+#ifdef RT_USING_IPC_FAST_PATH
+    {
+        rt_uint32_t received;
+
+        if (_rt_event_fast_recv(event, set, option, &received) == RT_TRUE)
+        {
+            if (recved)
+                *recved = received;
+
+            /* fill thread event info */
+            thread->event_set  = received;
+            thread->event_info = option;
+
+            RT_OBJECT_HOOK_CALL(rt_object_take_hook, (&(event->parent.parent)));
+
+            return RT_EOK;
+        }
+    }
+#endif
+
     /* disable interrupt */
     level = rt_hw_interrupt_disable();
 
@@ -1840,6 +2103,9 @@ RTM_EXPORT(rt_mb_control);
 struct rt_mq_message
 {
     struct rt_mq_message *next;
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+    rt_size_t length;                                   /* length of the message */
+#endif
 };
 
 /**
@@ -2163,6 +2429,9 @@ rt_err_t rt_mq_send_wait(rt_mq_t     mq,
     msg->next = RT_NULL;
     /* copy buffer */
     rt_memcpy(msg + 1, buffer, size);
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+    msg->length = size;
+#endif
 
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
@@ -2275,6 +2544,9 @@ rt_err_t rt_mq_urgent(rt_mq_t mq, const void *buffer, rt_size_t size)
 
     /* copy buffer */
     rt_memcpy(msg + 1, buffer, size);
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+    msg->length = size;
+#endif
 
     /* disable interrupt */
     temp = rt_hw_interrupt_disable();
@@ -2477,6 +2749,408 @@ rt_err_t rt_mq_recv(rt_mq_t    mq,
 }
 RTM_EXPORT(rt_mq_recv);
 
+#ifdef RT_USING_MESSAGEQUEUE_ZEROCOPY
+/* get the message node from a buffer returned by rt_mq_reserve/rt_mq_peek */
+static struct rt_mq_message *_rt_mq_buffer_to_msg(rt_mq_t mq, void *buffer)
+{
+    struct rt_mq_message *msg;
+    rt_size_t node_size;
+
+    msg = (struct rt_mq_message *)buffer - 1;
+    node_size = mq->msg_size + sizeof(struct rt_mq_message);
+
+    /* the buffer must be the payload of one node in the message pool */
+    RT_ASSERT((rt_uint8_t *)msg >= (rt_uint8_t *)mq->msg_pool);
+    RT_ASSERT((rt_uint8_t *)msg < (rt_uint8_t *)mq->msg_pool + node_size * mq->max_msgs);
+    RT_ASSERT(((rt_uint8_t *)msg - (rt_uint8_t *)mq->msg_pool) % node_size == 0);
+
+    return msg;
+}
+
+/* put a message node back to free list and wake up one suspended sender */
+static void _rt_mq_put_free(rt_mq_t mq, struct rt_mq_message *msg)
+{
+    register rt_ubase_t temp;
+
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
+    /* put message to free list */
+    msg->next = (struct rt_mq_message *)mq->msg_queue_free;
+    mq->msg_queue_free = msg;
+
+    /* resume suspended thread */
+    if (!rt_list_isempty(&(mq->suspend_sender_thread)))
+    {
+        rt_ipc_list_resume(&(mq->suspend_sender_thread));
+
+        /* enable interrupt */
+        rt_hw_interrupt_enable(temp);
+
+        rt_schedule();
+
+        return;
+    }
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(temp);
+}
+
+/**
+ * This function will reserve a message slot in message queue object, the
+ * sender can fill the message in place and then commit it by rt_mq_commit,
+ * or give it up by rt_mq_cancel. If the message queue is full, current thread
+ * will be suspended until timeout.
+ *
+ * @param mq the message queue object
+ * @param buffer the reserved message buffer will be saved in, which has
+ *        mq->msg_size bytes
+ * @param timeout the waiting time
+ *
+ * @return the error code
+ */
+rt_err_t rt_mq_reserve(rt_mq_t mq, void **buffer, rt_int32_t timeout)
+{
+    register rt_ubase_t temp;
+    struct rt_mq_message *msg;
+    rt_uint32_t tick_delta;
+    struct rt_thread *thread;
+
+    /* parameter check */
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(rt_object_get_type(&mq->parent.parent) == RT_Object_Class_MessageQueue);
+    RT_ASSERT(buffer != RT_NULL);
+
+    /* initialize delta tick */
+    tick_delta = 0;
+    /* get current thread */
+    thread = rt_thread_self();
+
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
+
+    /* message queue is full */
+    while ((msg = mq->msg_queue_free) == RT_NULL)
+    {
+        /* reset error number in thread */
+        thread->error = RT_EOK;
+
+        /* no waiting, return full */
+        if (timeout == 0)
+        {
+            /* enable interrupt */
+            rt_hw_interrupt_enable(temp);
+
+            return -RT_EFULL;
+        }
+
+        RT_DEBUG_IN_THREAD_CONTEXT;
+        /* suspend current thread */
+        rt_ipc_list_suspend(&(mq->suspend_sender_thread),
+                            thread,
+                            mq->parent.parent.flag);
+
+        /* has waiting time, start thread timer */
+        if (timeout > 0)
+        {
+            /* get the start tick of timer */
+            tick_delta = rt_tick_get();
+
+            RT_DEBUG_LOG(RT_DEBUG_IPC, ("mq_reserve: start timer of thread:%s\n",
+                                        thread->name));
+
+            /* reset the timeout of thread timer and start it */
+            rt_timer_control(&(thread->thread_timer),
+                             RT_TIMER_CTRL_SET_TIME,
+                             &timeout);
+            rt_timer_start(&(thread->thread_timer));
+        }
+
+        /* enable interrupt */
+        rt_hw_interrupt_enable(temp);
+
+        /* re-schedule */
+        rt_schedule();
+
+        /* resume from suspend state */
+        if (thread->error != RT_EOK)
+        {
+            /* return error */
+            return thread->error;
+        }
+
+        /* disable interrupt */
+        temp = rt_hw_interrupt_disable();
+
+        /* if it's not waiting forever and then re-calculate timeout tick */
+        if (timeout > 0)
+        {
+            tick_delta = rt_tick_get() - tick_delta;
+            timeout -= tick_delta;
+            if (timeout < 0)
+                timeout = 0;
+        }
+    }
+
+    /* move free list pointer */
+    mq->msg_queue_free = msg->next;
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(temp);
+
+    msg->next = RT_NULL;
+    msg->length = 0;
+    *buffer = msg + 1;
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_mq_reserve);
+
+/**
+ * This function will commit a message reserved by rt_mq_reserve to the tail
+ * of message queue object, if there are threads suspended on message queue
+ * object, it will be waked up.
+ *
+ * @param mq the message queue object
+ * @param buffer the buffer returned by rt_mq_reserve
+ * @param size the length of message filled in buffer
+ *
+ * @return the error code
+ */
+rt_err_t rt_mq_commit(rt_mq_t mq, void *buffer, rt_size_t size)
+{
+    register rt_ubase_t temp;
+    struct rt_mq_message *msg;
+
+    /* parameter check */
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(rt_object_get_type(&mq->parent.parent) == RT_Object_Class_MessageQueue);
+    RT_ASSERT(buffer != RT_NULL);
+    RT_ASSERT(size != 0);
+
+    msg = _rt_mq_buffer_to_msg(mq, buffer);
+
+    /* greater than one message size */
+    if (size > mq->msg_size)
+    {
+        _rt_mq_put_free(mq, msg);
+
+        return -RT_ERROR;
+    }
+
+    RT_OBJECT_HOOK_CALL(rt_object_put_hook, (&(mq->parent.parent)));
+
+    msg->next = RT_NULL;
+    msg->length = size;
+
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
+    /* link msg to message queue */
+    if (mq->msg_queue_tail != RT_NULL)
+    {
+        /* if the tail exists, */
+        ((struct rt_mq_message *)mq->msg_queue_tail)->next = msg;
+    }
+
+    /* set new tail */
+    mq->msg_queue_tail = msg;
+    /* if the head is empty, set head */
+    if (mq->msg_queue_head == RT_NULL)
+        mq->msg_queue_head = msg;
+
+    /* increase message entry, the number of nodes limits it to max_msgs */
+    mq->entry ++;
+
+    /* resume suspended thread */
+    if (!rt_list_isempty(&mq->parent.suspend_thread))
+    {
+        rt_ipc_list_resume(&(mq->parent.suspend_thread));
+
+        /* enable interrupt */
+        rt_hw_interrupt_enable(temp);
+
+        rt_schedule();
+
+        return RT_EOK;
+    }
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(temp);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_mq_commit);
+
+/**
+ * This function will give up a message reserved by rt_mq_reserve.
+ *
+ * @param mq the message queue object
+ * @param buffer the buffer returned by rt_mq_reserve
+ *
+ * @return the error code
+ */
+rt_err_t rt_mq_cancel(rt_mq_t mq, void *buffer)
+{
+    /* parameter check */
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(rt_object_get_type(&mq->parent.parent) == RT_Object_Class_MessageQueue);
+    RT_ASSERT(buffer != RT_NULL);
+
+    _rt_mq_put_free(mq, _rt_mq_buffer_to_msg(mq, buffer));
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_mq_cancel);
+
+/**
+ * This function will take the message at the head of message queue object
+ * without copying it, the message stays valid until it is returned by
+ * rt_mq_release. If there is no message in message queue object, the thread
+ * shall wait for a specified time.
+ *
+ * @param mq the message queue object
+ * @param buffer the address of message will be saved in
+ * @param size the length of message will be saved in, can be RT_NULL
+ * @param timeout the waiting time
+ *
+ * @return the error code
+ */
+rt_err_t rt_mq_peek(rt_mq_t     mq,
+                    void      **buffer,
+                    rt_size_t  *size,
+                    rt_int32_t  timeout)
+{
+    struct rt_thread *thread;
+    register rt_ubase_t temp;
+    struct rt_mq_message *msg;
+    rt_uint32_t tick_delta;
+
+    /* parameter check */
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(rt_object_get_type(&mq->parent.parent) == RT_Object_Class_MessageQueue);
+    RT_ASSERT(buffer != RT_NULL);
+
+    /* initialize delta tick */
+    tick_delta = 0;
+    /* get current thread */
+    thread = rt_thread_self();
+    RT_OBJECT_HOOK_CALL(rt_object_trytake_hook, (&(mq->parent.parent)));
+
+    /* disable interrupt */
+    temp = rt_hw_interrupt_disable();
+
+    /* message queue is empty */
+    while (mq->entry == 0)
+    {
+        /* reset error number in thread */
+        thread->error = RT_EOK;
+
+        /* no waiting, return timeout */
+        if (timeout == 0)
+        {
+            /* enable interrupt */
+            rt_hw_interrupt_enable(temp);
+
+            thread->error = -RT_ETIMEOUT;
+
+            return -RT_ETIMEOUT;
+        }
+
+        RT_DEBUG_IN_THREAD_CONTEXT;
+        /* suspend current thread */
+        rt_ipc_list_suspend(&(mq->parent.suspend_thread),
+                            thread,
+                            mq->parent.parent.flag);
+
+        /* has waiting time, start thread timer */
+        if (timeout > 0)
+        {
+            /* get the start tick of timer */
+            tick_delta = rt_tick_get();
+
+            RT_DEBUG_LOG(RT_DEBUG_IPC, ("mq_peek: start timer of thread:%s\n",
+                                        thread->name));
+
+            /* reset the timeout of thread timer and start it */
+            rt_timer_control(&(thread->thread_timer),
+                             RT_TIMER_CTRL_SET_TIME,
+                             &timeout);
+            rt_timer_start(&(thread->thread_timer));
+        }
+
+        /* enable interrupt */
+        rt_hw_interrupt_enable(temp);
+
+        /* re-schedule */
+        rt_schedule();
+
+        /* recv message */
+        if (thread->error != RT_EOK)
+        {
+            /* return error */
+            return thread->error;
+        }
+
+        /* disable interrupt */
+        temp = rt_hw_interrupt_disable();
+
+        /* if it's not waiting forever and then re-calculate timeout tick */
+        if (timeout > 0)
+        {
+            tick_delta = rt_tick_get() - tick_delta;
+            timeout -= tick_delta;
+            if (timeout < 0)
+                timeout = 0;
+        }
+    }
+
+    /* get message from queue, it's owned by current thread until released */
+    msg = (struct rt_mq_message *)mq->msg_queue_head;
+
+    /* move message queue head */
+    mq->msg_queue_head = msg->next;
+    /* reach queue tail, set to NULL */
+    if (mq->msg_queue_tail == msg)
+        mq->msg_queue_tail = RT_NULL;
+
+    /* decrease message entry */
+    mq->entry --;
+
+    /* enable interrupt */
+    rt_hw_interrupt_enable(temp);
+
+    *buffer = msg + 1;
+    if (size != RT_NULL)
+        *size = msg->length;
+
+    RT_OBJECT_HOOK_CALL(rt_object_take_hook, (&(mq->parent.parent)));
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_mq_peek);
+
+/**
+ * This function will return a message taken by rt_mq_peek to message queue
+ * object, if there are threads suspended on sending, it will be waked up.
+ *
+ * @param mq the message queue object
+ * @param buffer the buffer returned by rt_mq_peek
+ *
+ * @return the error code
+ */
+rt_err_t rt_mq_release(rt_mq_t mq, void *buffer)
+{
+    /* parameter check */
+    RT_ASSERT(mq != RT_NULL);
+    RT_ASSERT(rt_object_get_type(&mq->parent.parent) == RT_Object_Class_MessageQueue);
+    RT_ASSERT(buffer != RT_NULL);
+
+    _rt_mq_put_free(mq, _rt_mq_buffer_to_msg(mq, buffer));
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_mq_release);
+#endif /* RT_USING_MESSAGEQUEUE_ZEROCOPY */
+
 /**
  * This function can get or set some extra attributions of a message queue
  * object.
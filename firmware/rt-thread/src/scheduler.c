@@ -27,6 +27,8 @@
  *                             rt_schedule_insert_thread won't insert current task to ready queue
  *                             in smp version, rt_hw_context_switch_interrupt maybe switch to
  *                               new task directly
+ * 2020-11-05     luhuadong    add thread CPU usage and latency statistics
+ * 2020-11-20     luhuadong    fold running time on every tick for counter wraparound
  *
  */
 
@@ -73,6 +75,126 @@ rt_scheduler_sethook(void (*hook)(struct rt_thread *from, struct rt_thread *to))
 /**@}*/
 #endif
 
+#ifdef RT_USING_THREAD_STATS
+extern rt_uint32_t clock_cpu_gettime(void);
+
+/*
+ * account the running time of from thread and the wake-up latency of to
+ * thread, it's invoked with interrupt disabled.
+ */
+static void _rt_scheduler_stats_switch(struct rt_thread *from, struct rt_thread *to)
+{
+    rt_uint32_t now, latency;
+    int index;
+
+    now = clock_cpu_gettime();
+
+    if (from != RT_NULL)
+    {
+        from->stats.run_time += (rt_uint32_t)(now - from->stats.switch_in);
+    }
+
+    to->stats.switch_in = now;
+    to->stats.switches ++;
+
+    if (to->stats.ready_at != 0)
+    {
+        latency = now - to->stats.ready_at;
+        to->stats.ready_at = 0;
+
+        if (latency > to->stats.latency_max)
+            to->stats.latency_max = latency;
+
+        latency >>= RT_THREAD_STATS_HIST_BASE;
+        for (index = 0; latency && index < RT_THREAD_STATS_HIST_NR - 1; index ++)
+            latency >>= 2;
+        to->stats.latency_hist[index] ++;
+    }
+}
+
+/**
+ * This function will fold the running time of current thread into its 64-bit
+ * accumulator. It's invoked on every OS tick, so each 32-bit counter delta is
+ * far less than the counter period and the unsigned subtraction handles the
+ * counter wraparound even if the thread runs for several counter periods
+ * without switching.
+ *
+ * @param thread the current thread
+ */
+void rt_thread_stats_tick(rt_thread_t thread)
+{
+    rt_base_t level;
+    rt_uint32_t now;
+
+    level = rt_hw_interrupt_disable();
+    if ((thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_RUNNING)
+    {
+        now = clock_cpu_gettime();
+        thread->stats.run_time += (rt_uint32_t)(now - thread->stats.switch_in);
+        thread->stats.switch_in = now;
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+rt_inline void _rt_scheduler_stats_ready(struct rt_thread *thread)
+{
+    /* force the bit 0, the timestamp 0 means the thread is not ready */
+    thread->stats.ready_at = clock_cpu_gettime() | 0x01;
+}
+
+/**
+ * This function will get the scheduling statistics of a thread. The running
+ * time includes the current time slice when the thread is running.
+ *
+ * @param thread the thread
+ * @param stats the statistics buffer
+ *
+ * @return RT_EOK
+ */
+rt_err_t rt_thread_stats_get(rt_thread_t thread, struct rt_thread_stats *stats)
+{
+    rt_base_t level;
+
+    RT_ASSERT(thread != RT_NULL);
+    RT_ASSERT(stats != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    *stats = thread->stats;
+    if ((thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_RUNNING)
+    {
+        stats->run_time += (rt_uint32_t)(clock_cpu_gettime() - thread->stats.switch_in);
+    }
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+RTM_EXPORT(rt_thread_stats_get);
+
+/**
+ * This function will reset the scheduling statistics of a thread.
+ *
+ * @param thread the thread
+ */
+void rt_thread_stats_reset(rt_thread_t thread)
+{
+    rt_base_t level;
+
+    RT_ASSERT(thread != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    thread->stats.run_time    = 0;
+    thread->stats.switches    = 0;
+    thread->stats.latency_max = 0;
+    rt_memset(thread->stats.latency_hist, 0, sizeof(thread->stats.latency_hist));
+    if ((thread->stat & RT_THREAD_STAT_MASK) == RT_THREAD_RUNNING)
+    {
+        thread->stats.switch_in = clock_cpu_gettime();
+    }
+    rt_hw_interrupt_enable(level);
+}
+RTM_EXPORT(rt_thread_stats_reset);
+#endif
+
 #ifdef RT_USING_OVERFLOW_CHECK
 static void _rt_scheduler_stack_check(struct rt_thread *thread)
 {
@@ -255,6 +377,10 @@ void rt_system_scheduler_start(void)
     rt_schedule_remove_thread(to_thread);
     to_thread->stat = RT_THREAD_RUNNING;
 
+#ifdef RT_USING_THREAD_STATS
+    _rt_scheduler_stats_switch(RT_NULL, to_thread);
+#endif
+
     /* switch to new thread */
 #ifdef RT_USING_SMP
     rt_hw_context_switch_to((rt_ubase_t)&to_thread->sp, to_thread);
@@ -358,6 +484,10 @@ void rt_schedule(void)
 
                 RT_OBJECT_HOOK_CALL(rt_scheduler_hook, (current_thread, to_thread));
 
+#ifdef RT_USING_THREAD_STATS
+                _rt_scheduler_stats_switch(current_thread, to_thread);
+#endif
+
                 rt_schedule_remove_thread(to_thread);
                 to_thread->stat = RT_THREAD_RUNNING | (to_thread->stat & ~RT_THREAD_STAT_MASK);
 
@@ -458,6 +588,10 @@ void rt_schedule(void)
 
                 RT_OBJECT_HOOK_CALL(rt_scheduler_hook, (from_thread, to_thread));
 
+#ifdef RT_USING_THREAD_STATS
+                _rt_scheduler_stats_switch(from_thread, to_thread);
+#endif
+
                 if (need_insert_from_thread)
                 {
                     rt_schedule_insert_thread(from_thread);
@@ -608,6 +742,10 @@ void rt_scheduler_do_irq_switch(void *context)
 
                 RT_OBJECT_HOOK_CALL(rt_scheduler_hook, (current_thread, to_thread));
 
+#ifdef RT_USING_THREAD_STATS
+                _rt_scheduler_stats_switch(current_thread, to_thread);
+#endif
+
                 rt_schedule_remove_thread(to_thread);
                 to_thread->stat = RT_THREAD_RUNNING | (to_thread->stat & ~RT_THREAD_STAT_MASK);
 
@@ -658,6 +796,10 @@ void rt_schedule_insert_thread(struct rt_thread *thread)
     /* READY thread, insert to ready queue */
     thread->stat = RT_THREAD_READY | (thread->stat & ~RT_THREAD_STAT_MASK);
 
+#ifdef RT_USING_THREAD_STATS
+    _rt_scheduler_stats_ready(thread);
+#endif
+
     cpu_id   = rt_hw_cpu_id();
     bind_cpu = thread->bind_cpu ;
 
@@ -719,6 +861,10 @@ void rt_schedule_insert_thread(struct rt_thread *thread)
 
     /* READY thread, insert to ready queue */
     thread->stat = RT_THREAD_READY | (thread->stat & ~RT_THREAD_STAT_MASK);
+
+#ifdef RT_USING_THREAD_STATS
+    _rt_scheduler_stats_ready(thread);
+#endif
     /* insert thread to ready list */
     rt_list_insert_before(&(rt_thread_priority_table[thread->current_priority]),
                           &(thread->tlist));
@@ -179,6 +179,14 @@ static rt_err_t _rt_thread_init(struct rt_thread *thread,
     thread->cleanup   = 0;
     thread->user_data = 0;
 
+#ifdef RT_USING_MUTEX
+    thread->pending_mutex = RT_NULL;
+#endif
+
+#ifdef RT_USING_THREAD_STATS
+    rt_memset(&(thread->stats), 0, sizeof(thread->stats));
+#endif
+
     /* initialize thread timer */
     rt_timer_init(&(thread->thread_timer),
                   thread->name,
@@ -0,0 +1,318 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * ipc_sim runs the semaphore and the event on the host. It prints the time
+ * and the interrupt disabled sections of an uncontended rt_sem_take and
+ * rt_sem_release pair and of an uncontended rt_event_send and rt_event_recv
+ * pair in one thread. Then it checks them with 1, 2 and 4 threads which take
+ * and release the semaphore, and send and receive their own event bit, with
+ * no timeout.
+ *
+ * The interrupt disabling is modeled as PRIMASK of Cortex-M: the functions
+ * save and set a variable. LDREX/STREX are modeled as the local monitor of a
+ * single core: the load remembers the address, and the store succeeds if it
+ * is the same address. In the check with threads, the interrupt disabling
+ * also takes a global mutex, and the store is a CAS which fails while the
+ * mutex is taken, as an interrupt or a thread switch clears the monitor.
+ *
+ * The threads check that the event bits are not lost, and the value of the
+ * semaphore is the initial value at the end.
+ *
+ * ipc.c is built into this program with the configuration in rtconfig.h, it
+ * has the fast path unless SIM_NO_FAST_PATH is defined:
+ *
+ *   gcc -O2 -std=gnu99 -I. -I../../include ipc_sim.c -o ipc_sim -lpthread
+ *   gcc -O2 -std=gnu99 -DSIM_NO_FAST_PATH -I. -I../../include ipc_sim.c -o ipc_sim_slow -lpthread
+ *
+ * usage: ipc_sim [rounds]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "../ipc.c"
+
+#define SIM_THREADS_MAX     4
+#define SIM_SEM_VALUE       2
+
+static volatile rt_base_t sim_primask;
+static unsigned long irq_sections;
+static int sim_threaded;
+static pthread_mutex_t irq_lock;
+static __thread struct rt_thread thread_self;
+static __thread volatile void *exclusive_addr;
+static __thread rt_uint32_t exclusive_value;
+
+static struct rt_semaphore sem;
+static struct rt_event event;
+static unsigned long retries;
+static int thread_index[SIM_THREADS_MAX];
+static int rounds = 10000000;
+static int failed;
+
+/* the stubs of kernel for the semaphore and the event */
+void (*rt_object_trytake_hook)(struct rt_object *object);
+void (*rt_object_take_hook)(struct rt_object *object);
+void (*rt_object_put_hook)(struct rt_object *object);
+
+void rt_object_init(struct rt_object *object, enum rt_object_class_type type, const char *name)
+{
+    memset(object, 0, sizeof(*object));
+    object->type = type | RT_Object_Class_Static;
+    snprintf(object->name, RT_NAME_MAX, "%s", name);
+}
+
+void rt_object_detach(rt_object_t object) { }
+rt_thread_t rt_thread_self(void) { return &thread_self; }
+
+static void sim_no_wait(const char *func)
+{
+    fprintf(stderr, "%s is called, nothing waits in ipc_sim\n", func);
+    abort();
+}
+
+rt_err_t rt_thread_suspend(rt_thread_t thread) { sim_no_wait(__func__); return RT_EOK; }
+rt_err_t rt_thread_resume(rt_thread_t thread) { sim_no_wait(__func__); return RT_EOK; }
+rt_err_t rt_timer_start(rt_timer_t timer) { sim_no_wait(__func__); return RT_EOK; }
+rt_err_t rt_timer_control(rt_timer_t timer, int cmd, void *arg) { sim_no_wait(__func__); return RT_EOK; }
+void rt_schedule(void) { sim_no_wait(__func__); }
+rt_err_t rt_thread_control(rt_thread_t thread, int cmd, void *arg) { sim_no_wait(__func__); return RT_EOK; }
+rt_tick_t rt_tick_get(void) { sim_no_wait(__func__); return 0; }
+
+__attribute__((noinline)) rt_base_t rt_hw_interrupt_disable(void)
+{
+    rt_base_t level = sim_primask;
+
+    if (sim_threaded)
+        pthread_mutex_lock(&irq_lock);
+    sim_primask = 1;
+    irq_sections++;
+
+    return level;
+}
+
+__attribute__((noinline)) void rt_hw_interrupt_enable(rt_base_t level)
+{
+    sim_primask = level;
+    if (sim_threaded)
+        pthread_mutex_unlock(&irq_lock);
+}
+
+static rt_uint32_t sim_exclusive_store(volatile void *addr, rt_uint32_t value, int size)
+{
+    rt_uint32_t expected = exclusive_value;
+    int stored;
+
+    if (exclusive_addr != addr)
+        return 1;
+    exclusive_addr = RT_NULL;
+
+    if (!sim_threaded)
+    {
+        if (size == 2)
+            *(volatile rt_uint16_t *)addr = value;
+        else
+            *(volatile rt_uint32_t *)addr = value;
+
+        return 0;
+    }
+
+    /* the monitor is cleared while the interrupt is disabled by others */
+    if (pthread_mutex_trylock(&irq_lock) != 0)
+    {
+        __atomic_add_fetch(&retries, 1, __ATOMIC_RELAXED);
+        sched_yield();
+
+        return 1;
+    }
+    if (size == 2)
+    {
+        rt_uint16_t expected16 = expected;
+
+        stored = __atomic_compare_exchange_n((volatile rt_uint16_t *)addr, &expected16, value, 0,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        stored = __atomic_compare_exchange_n((volatile rt_uint32_t *)addr, &expected, value, 0,
+                                             __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&irq_lock);
+    if (!stored)
+        __atomic_add_fetch(&retries, 1, __ATOMIC_RELAXED);
+
+    return stored ? 0 : 1;
+}
+
+__attribute__((noinline)) rt_uint16_t rt_hw_exclusive_load16(volatile rt_uint16_t *addr)
+{
+    exclusive_addr = addr;
+    exclusive_value = __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+
+    return exclusive_value;
+}
+
+__attribute__((noinline)) rt_uint32_t rt_hw_exclusive_store16(volatile rt_uint16_t *addr, rt_uint16_t value)
+{
+    return sim_exclusive_store(addr, value, 2);
+}
+
+__attribute__((noinline)) rt_uint32_t rt_hw_exclusive_load32(volatile rt_uint32_t *addr)
+{
+    exclusive_addr = addr;
+    exclusive_value = __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+
+    return exclusive_value;
+}
+
+__attribute__((noinline)) rt_uint32_t rt_hw_exclusive_store32(volatile rt_uint32_t *addr, rt_uint32_t value)
+{
+    return sim_exclusive_store(addr, value, 4);
+}
+
+__attribute__((noinline)) void rt_hw_exclusive_clear(void)
+{
+    exclusive_addr = RT_NULL;
+}
+
+static double sim_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sim_fail(const char *msg)
+{
+    if (!failed)
+        printf("%s\n", msg);
+    failed = 1;
+}
+
+/* returns ns of each pair */
+static double sim_time_sem(void)
+{
+    double start;
+    int round;
+
+    irq_sections = 0;
+    start = sim_now();
+    for (round = 0; round < rounds; round++)
+    {
+        if (rt_sem_take(&sem, 0) != RT_EOK)
+            sim_fail("the semaphore isn't taken");
+        rt_sem_release(&sem);
+    }
+
+    return (sim_now() - start) * 1e9 / rounds;
+}
+
+static double sim_time_event(void)
+{
+    rt_uint32_t recved;
+    double start;
+    int round;
+
+    irq_sections = 0;
+    start = sim_now();
+    for (round = 0; round < rounds; round++)
+    {
+        rt_event_send(&event, 0x01);
+        if (rt_event_recv(&event, 0x01, RT_EVENT_FLAG_OR | RT_EVENT_FLAG_CLEAR, 0, &recved) != RT_EOK
+                || recved != 0x01)
+            sim_fail("the event isn't received");
+    }
+
+    return (sim_now() - start) * 1e9 / rounds;
+}
+
+static void *sim_thread(void *param)
+{
+    int index = *(int *)param;
+    rt_uint32_t bit = 1u << index, recved;
+    int round;
+
+    for (round = 0; round < rounds / 10; round++)
+    {
+        /* there may be no token left for this thread, it's not waited */
+        if (rt_sem_take(&sem, 0) == RT_EOK)
+            rt_sem_release(&sem);
+
+        rt_event_send(&event, bit);
+        if (rt_event_recv(&event, bit, RT_EVENT_FLAG_AND | RT_EVENT_FLAG_CLEAR, 0, &recved) != RT_EOK
+                || recved != bit)
+            sim_fail("an event bit is lost");
+    }
+
+    return NULL;
+}
+
+static void sim_check(int threads)
+{
+    pthread_t tids[SIM_THREADS_MAX];
+    int index;
+
+    retries = 0;
+    for (index = 0; index < threads; index++)
+    {
+        thread_index[index] = index;
+        pthread_create(&tids[index], NULL, sim_thread, &thread_index[index]);
+    }
+    for (index = 0; index < threads; index++)
+        pthread_join(tids[index], NULL);
+
+    if (sem.value != SIM_SEM_VALUE)
+        sim_fail("the value of semaphore is changed");
+    if (event.set != 0)
+        sim_fail("an event bit is left");
+    printf("%d threads: %s, %lu stores retried\n", threads, failed ? "FAIL" : "ok", retries);
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_mutexattr_t attr;
+    double ns;
+    int threads;
+
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&irq_lock, &attr);
+    rt_sem_init(&sem, "sem", SIM_SEM_VALUE, RT_IPC_FLAG_FIFO);
+    rt_event_init(&event, "event", RT_IPC_FLAG_FIFO);
+
+#ifdef RT_USING_IPC_FAST_PATH
+    printf("fast path, %d rounds\n\n", rounds);
+#else
+    printf("interrupt disabled, %d rounds\n\n", rounds);
+#endif
+    printf("%-18s %8s %14s\n", "pair", "ns", "irq off/pair");
+    ns = sim_time_sem();
+    printf("%-18s %8.1f %14.1f\n", "sem take/release", ns, (double)irq_sections / rounds);
+    ns = sim_time_event();
+    printf("%-18s %8.1f %14.1f\n\n", "event send/recv", ns, (double)irq_sections / rounds);
+
+    sim_threaded = 1;
+    for (threads = 1; threads <= SIM_THREADS_MAX; threads *= 2)
+        sim_check(threads);
+
+    printf("\n%s\n", failed ? "FAIL" : "PASS");
+
+    return failed;
+}
@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/*
+ * mutex_sim runs the mutex on the host with a small scheduler of a single
+ * CPU, and checks the priority inheritance along the blocking chain and the
+ * statistics of mutex in three cases:
+ *
+ *   chain  L holds m1, M holds m2 and waits for m1, then H waits for m2, both
+ *          M and L run at the priority of H until they release the mutexes.
+ *   depth  10 threads wait for each other in a chain, the priority of the
+ *          thread which waits at the end is only inherited by the first
+ *          RT_MUTEX_PI_DEPTH_MAX owners.
+ *   cycle  A and B wait for each other, C waits for the mutex of A, the
+ *          inheritance stops in the cycle.
+ *
+ * The threads are the contexts of ucontext. The highest priority thread
+ * which is ready runs, a thread of the same priority doesn't preempt the
+ * current one. The suspend and resume only change the state, the priority
+ * is changed directly, and the tick is only increased by the threads. The
+ * adaptive spinning needs another CPU, it isn't built.
+ *
+ * ipc.c is built into this program with the configuration in rtconfig.h:
+ *
+ *   gcc -O2 -std=gnu99 -I. -I../../include mutex_sim.c -o mutex_sim
+ *
+ * usage: mutex_sim
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+
+/* the semaphore and the event are not used, they are built without the fast path */
+#define SIM_NO_FAST_PATH
+#include "../ipc.c"
+
+#define SIM_THREADS_MAX     12
+#define SIM_STACK_SIZE      (64 * 1024)
+#define SIM_CHAIN           (RT_MUTEX_PI_DEPTH_MAX + 2)
+
+struct sim_thread
+{
+    struct rt_thread thread;
+    rt_uint8_t init_priority;
+    void (*entry)(int index);
+    int index;
+    ucontext_t context;
+    char stack[SIM_STACK_SIZE];
+};
+
+static struct sim_thread sim_threads[SIM_THREADS_MAX];
+static int sim_thread_count;
+static struct sim_thread *sim_current;
+static ucontext_t sim_main;
+static rt_tick_t sim_tick;
+static int failed;
+
+#define SIM_CHECK(cond)     sim_check((cond), #cond, __LINE__)
+
+static void sim_check(int cond, const char *expr, int line)
+{
+    if (!cond)
+    {
+        printf("line %d: %s is false\n", line, expr);
+        failed = 1;
+    }
+}
+
+/* the stubs of kernel for the mutex */
+void (*rt_object_trytake_hook)(struct rt_object *object);
+void (*rt_object_take_hook)(struct rt_object *object);
+void (*rt_object_put_hook)(struct rt_object *object);
+
+void rt_object_init(struct rt_object *object, enum rt_object_class_type type, const char *name)
+{
+    memset(object, 0, sizeof(*object));
+    object->type = type | RT_Object_Class_Static;
+    snprintf(object->name, RT_NAME_MAX, "%s", name);
+}
+
+void rt_object_detach(rt_object_t object) { }
+rt_base_t rt_hw_interrupt_disable(void) { return 0; }
+void rt_hw_interrupt_enable(rt_base_t level) { }
+rt_tick_t rt_tick_get(void) { return sim_tick; }
+rt_thread_t rt_thread_self(void) { return &sim_current->thread; }
+
+rt_err_t rt_thread_suspend(rt_thread_t thread)
+{
+    thread->stat = RT_THREAD_SUSPEND;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_resume(rt_thread_t thread)
+{
+    if ((thread->stat & RT_THREAD_STAT_MASK) != RT_THREAD_SUSPEND)
+        return -RT_ERROR;
+
+    rt_list_remove(&(thread->tlist));
+    thread->stat = RT_THREAD_READY;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_control(rt_thread_t thread, int cmd, void *arg)
+{
+    if (cmd == RT_THREAD_CTRL_CHANGE_PRIORITY)
+        thread->current_priority = *(rt_uint8_t *)arg;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_timer_start(rt_timer_t timer)
+{
+    printf("FAIL, no thread waits with timeout in mutex_sim\n");
+    exit(1);
+}
+
+rt_err_t rt_timer_control(rt_timer_t timer, int cmd, void *arg) { return rt_timer_start(timer); }
+
+static struct sim_thread *sim_pick(void)
+{
+    struct sim_thread *next = RT_NULL;
+    int index;
+
+    if (sim_current != RT_NULL && sim_current->thread.stat == RT_THREAD_READY)
+        next = sim_current;
+    for (index = 0; index < sim_thread_count; index++)
+    {
+        if (sim_threads[index].thread.stat == RT_THREAD_READY
+                && (next == RT_NULL || sim_threads[index].thread.current_priority < next->thread.current_priority))
+            next = &sim_threads[index];
+    }
+
+    return next;
+}
+
+/* switch to the highest priority thread, or back to main if none is ready */
+void rt_schedule(void)
+{
+    struct sim_thread *prev = sim_current, *next;
+
+    next = sim_pick();
+    if (next == prev)
+        return;
+
+    sim_current = next;
+    if (next == RT_NULL)
+        swapcontext(&prev->context, &sim_main);
+    else if (prev == RT_NULL)
+        swapcontext(&sim_main, &next->context);
+    else
+        swapcontext(&prev->context, &next->context);
+}
+
+static void sim_entry(void)
+{
+    struct sim_thread *self = sim_current;
+
+    self->entry(self->index);
+
+    SIM_CHECK(self->thread.current_priority == self->init_priority);
+    self->thread.stat = RT_THREAD_CLOSE;
+    rt_schedule();
+}
+
+static struct sim_thread *sim_thread_init(const char *name, rt_uint8_t priority, void (*entry)(int), int index)
+{
+    struct sim_thread *sim = &sim_threads[sim_thread_count++];
+
+    memset(&sim->thread, 0, sizeof(sim->thread));
+    snprintf(sim->thread.name, RT_NAME_MAX, "%s", name);
+    rt_list_init(&(sim->thread.tlist));
+    sim->thread.stat = RT_THREAD_INIT;
+    sim->thread.current_priority = priority;
+    sim->init_priority = priority;
+    sim->entry = entry;
+    sim->index = index;
+
+    getcontext(&sim->context);
+    sim->context.uc_stack.ss_sp = sim->stack;
+    sim->context.uc_stack.ss_size = sizeof(sim->stack);
+    sim->context.uc_link = RT_NULL;
+    makecontext(&sim->context, sim_entry, 0);
+
+    return sim;
+}
+
+/* make the thread ready, it preempts the current thread of lower priority */
+static void sim_startup(struct sim_thread *sim)
+{
+    sim->thread.stat = RT_THREAD_READY;
+    if (sim_current != RT_NULL)
+        rt_schedule();
+}
+
+/* run the threads from main until they exit or block */
+static void sim_run(void)
+{
+    sim_current = RT_NULL;
+    rt_schedule();
+    sim_current = RT_NULL;
+}
+
+static void sim_reset(void)
+{
+    sim_thread_count = 0;
+    sim_current = RT_NULL;
+}
+
+/* chain */
+static struct rt_mutex m1, m2;
+static struct sim_thread *thread_l, *thread_m, *thread_h;
+
+static void sim_chain_h(int index)
+{
+    SIM_CHECK(rt_mutex_take(&m2, RT_WAITING_FOREVER) == RT_EOK);
+    SIM_CHECK(m2.owner == &thread_h->thread);
+    /* m is back to its own priority when m2 is handed over */
+    SIM_CHECK(thread_m->thread.current_priority == 15);
+    SIM_CHECK(rt_mutex_release(&m2) == RT_EOK);
+}
+
+static void sim_chain_m(int index)
+{
+    SIM_CHECK(rt_mutex_take(&m2, RT_WAITING_FOREVER) == RT_EOK);
+    SIM_CHECK(rt_mutex_take(&m1, RT_WAITING_FOREVER) == RT_EOK);
+    SIM_CHECK(m1.owner == &thread_m->thread);
+    SIM_CHECK(thread_m->thread.pending_mutex == RT_NULL);
+    SIM_CHECK(thread_m->thread.current_priority == 5);
+    SIM_CHECK(rt_mutex_release(&m1) == RT_EOK);
+    SIM_CHECK(rt_mutex_release(&m2) == RT_EOK);
+}
+
+static void sim_chain_l(int index)
+{
+    SIM_CHECK(rt_mutex_take(&m1, RT_WAITING_FOREVER) == RT_EOK);
+
+    /* m waits for m1 */
+    sim_startup(thread_m);
+    SIM_CHECK(thread_m->thread.pending_mutex == &m1);
+    SIM_CHECK(thread_l->thread.current_priority == 15);
+
+    /* h waits for m2, l inherits the priority of h by m */
+    sim_startup(thread_h);
+    SIM_CHECK(thread_h->thread.pending_mutex == &m2);
+    SIM_CHECK(thread_m->thread.current_priority == 5);
+    SIM_CHECK(thread_l->thread.current_priority == 5);
+
+    sim_tick += 3;
+    SIM_CHECK(rt_mutex_release(&m1) == RT_EOK);
+}
+
+static void sim_chain(void)
+{
+    sim_reset();
+    sim_tick = 0;
+    rt_mutex_init(&m1, "m1", RT_IPC_FLAG_PRIO);
+    rt_mutex_init(&m2, "m2", RT_IPC_FLAG_PRIO);
+    thread_l = sim_thread_init("l", 20, sim_chain_l, 0);
+    thread_m = sim_thread_init("m", 15, sim_chain_m, 0);
+    thread_h = sim_thread_init("h", 5, sim_chain_h, 0);
+
+    sim_startup(thread_l);
+    sim_run();
+
+    SIM_CHECK(thread_l->thread.stat == RT_THREAD_CLOSE);
+    SIM_CHECK(thread_m->thread.stat == RT_THREAD_CLOSE);
+    SIM_CHECK(thread_h->thread.stat == RT_THREAD_CLOSE);
+    SIM_CHECK(m1.value == 1 && m1.owner == RT_NULL && m2.value == 1 && m2.owner == RT_NULL);
+    SIM_CHECK(m1.take_count == 2 && m1.contended == 1 && m1.wait_max == 3);
+    SIM_CHECK(m2.take_count == 2 && m2.contended == 1 && m2.wait_max == 3);
+
+    printf("%-6s %-4s %6u %9u %8u\n", "chain", "m1", (unsigned)m1.take_count, (unsigned)m1.contended,
+           (unsigned)m1.wait_max);
+    printf("%-6s %-4s %6u %9u %8u\n", "chain", "m2", (unsigned)m2.take_count, (unsigned)m2.contended,
+           (unsigned)m2.wait_max);
+}
+
+/* depth */
+static struct rt_mutex chain_mutex[SIM_CHAIN];
+static struct sim_thread *chain_threads[SIM_CHAIN], *thread_top;
+
+static void sim_depth_top(int index)
+{
+    SIM_CHECK(rt_mutex_take(&chain_mutex[SIM_CHAIN - 1], RT_WAITING_FOREVER) == RT_EOK);
+    SIM_CHECK(rt_mutex_release(&chain_mutex[SIM_CHAIN - 1]) == RT_EOK);
+}
+
+/* thread i holds mutex i and waits for mutex i - 1, thread 0 starts the others */
+static void sim_depth_thread(int index)
+{
+    int i;
+
+    SIM_CHECK(rt_mutex_take(&chain_mutex[index], RT_WAITING_FOREVER) == RT_EOK);
+    if (index > 0)
+    {
+        SIM_CHECK(rt_mutex_take(&chain_mutex[index - 1], RT_WAITING_FOREVER) == RT_EOK);
+        SIM_CHECK(rt_mutex_release(&chain_mutex[index - 1]) == RT_EOK);
+        SIM_CHECK(rt_mutex_release(&chain_mutex[index]) == RT_EOK);
+
+        return;
+    }
+
+    for (i = 1; i < SIM_CHAIN; i++)
+        sim_startup(chain_threads[i]);
+
+    /* only the owners in the depth inherit the priority of top */
+    sim_startup(thread_top);
+    for (i = 0; i < SIM_CHAIN; i++)
+    {
+        if (i >= SIM_CHAIN - RT_MUTEX_PI_DEPTH_MAX)
+            SIM_CHECK(chain_threads[i]->thread.current_priority == thread_top->init_priority);
+        else
+            SIM_CHECK(chain_threads[i]->thread.current_priority > thread_top->init_priority);
+    }
+    printf("%-6s %d threads, the priority of top is inherited by %d of them\n", "depth", SIM_CHAIN,
+           RT_MUTEX_PI_DEPTH_MAX);
+
+    SIM_CHECK(rt_mutex_release(&chain_mutex[0]) == RT_EOK);
+}
+
+static void sim_depth(void)
+{
+    char name[RT_NAME_MAX];
+    int i;
+
+    sim_reset();
+    for (i = 0; i < SIM_CHAIN; i++)
+    {
+        snprintf(name, sizeof(name), "c%d", i);
+        rt_mutex_init(&chain_mutex[i], name, RT_IPC_FLAG_PRIO);
+        chain_threads[i] = sim_thread_init(name, 30 - i, sim_depth_thread, i);
+    }
+    thread_top = sim_thread_init("top", 1, sim_depth_top, 0);
+
+    sim_startup(chain_threads[0]);
+    sim_run();
+
+    SIM_CHECK(thread_top->thread.stat == RT_THREAD_CLOSE);
+    for (i = 0; i < SIM_CHAIN; i++)
+    {
+        SIM_CHECK(chain_threads[i]->thread.stat == RT_THREAD_CLOSE);
+        SIM_CHECK(chain_mutex[i].value == 1 && chain_mutex[i].owner == RT_NULL);
+    }
+}
+
+/* cycle */
+static struct rt_mutex ma, mb;
+static struct sim_thread *thread_a, *thread_b, *thread_c;
+
+static void sim_cycle_b(int index)
+{
+    rt_mutex_take(&mb, RT_WAITING_FOREVER);
+    rt_mutex_take(&ma, RT_WAITING_FOREVER);
+}
+
+static void sim_cycle_a(int index)
+{
+    rt_mutex_take(&ma, RT_WAITING_FOREVER);
+    sim_startup(thread_b);
+    rt_mutex_take(&mb, RT_WAITING_FOREVER);
+}
+
+static void sim_cycle_c(int index)
+{
+    rt_mutex_take(&ma, RT_WAITING_FOREVER);
+}
+
+static void sim_cycle(void)
+{
+    sim_reset();
+    rt_mutex_init(&ma, "ma", RT_IPC_FLAG_PRIO);
+    rt_mutex_init(&mb, "mb", RT_IPC_FLAG_PRIO);
+    thread_a = sim_thread_init("a", 10, sim_cycle_a, 0);
+    thread_b = sim_thread_init("b", 9, sim_cycle_b, 0);
+    thread_c = sim_thread_init("c", 1, sim_cycle_c, 0);
+
+    /* a and b deadlock, then c waits for ma */
+    sim_startup(thread_a);
+    sim_run();
+    SIM_CHECK(thread_a->thread.pending_mutex == &mb && thread_b->thread.pending_mutex == &ma);
+    sim_startup(thread_c);
+    sim_run();
+
+    SIM_CHECK(thread_c->thread.pending_mutex == &ma);
+    SIM_CHECK(thread_a->thread.current_priority == 1 && thread_b->thread.current_priority == 1);
+    printf("%-6s a and b deadlock, c waits for them at priority %d\n", "cycle", thread_a->thread.current_priority);
+}
+
+int main(int argc, char *argv[])
+{
+    printf("%-6s %-4s %6s %9s %8s\n", "case", "name", "takes", "contended", "wait max");
+    sim_chain();
+    sim_depth();
+    sim_cycle();
+
+    printf("\n%s\n", failed ? "FAIL" : "PASS");
+
+    return failed;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2006-2020, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2020-11-20     luhuadong    the first version
+ */
+
+/* the configuration of ipc_sim and mutex_sim, the IPC objects are built for the host */
+
+#ifndef RT_CONFIG_H__
+#define RT_CONFIG_H__
+
+#define RT_NAME_MAX 8
+#define RT_ALIGN_SIZE 4
+#define RT_THREAD_PRIORITY_32
+#define RT_THREAD_PRIORITY_MAX 32
+#define RT_TICK_PER_SECOND 1000
+#define RT_USING_HOOK
+#define RT_USING_SEMAPHORE
+#define RT_USING_MUTEX
+#define RT_USING_MUTEX_STATS
+#define RT_MUTEX_PI_DEPTH_MAX 8
+#define RT_USING_EVENT
+
+/* the libc and the signals are from the host */
+#define RT_USING_NEWLIB
+#define LIBC_SIGNAL_H__
+#include <signal.h>
+
+/* the exclusive access is emulated by the sim, SIM_NO_FAST_PATH disables the fast path */
+#define RT_USING_CPU_EXCLUSIVE
+#ifndef SIM_NO_FAST_PATH
+#define RT_USING_IPC_FAST_PATH
+#endif
+
+#endif